@@ -0,0 +1,156 @@
+// Copyright (c) 2025 Daniel Moreno
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS”
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// SPDX-License-Identifier: BSD-2-Clause
+//
+// ---------------------------------------------------------------------------
+//
+// tiff_generate.cpp
+// =================
+// A program to generate uncompressed TIFF files of any size, layout, and
+// byte order, to benchmark and stress test readers with realistic files.
+//
+// Usage: tiff_generate [options] <output.tif>
+//
+
+#include "tiffGenerator.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+using namespace tiffgenerator;
+
+void printUsage(const char* program)
+{
+  std::cerr << "Usage: " << program << " [options] <output.tif>\n"
+    << "Options:\n"
+    << "  --size WxH            image size in pixels (default 1024x1024)\n"
+    << "  --bits N              bits per sample: 1, 2, 4, 8, 16, 32, or 64 (default 8)\n"
+    << "  --samples N           samples per pixel, 3 or more are RGB (default 1)\n"
+    << "  --planar              one set of strips or tiles per sample\n"
+    << "  --rows-per-strip N    rows of each strip (default: about 64 KiB)\n"
+    << "  --tiles WxH           tiles instead of strips, multiples of 16\n"
+    << "  --byte-order II|MM    byte order of the file (default II)\n"
+    << "  --bigtiff             BigTIFF even when not needed\n"
+    << "  --pages N             number of pages (default 1)\n"
+    << "  --sparse              do not write the pixels, which read as zeros\n"
+    << "  --pattern NAME        gradient, random, or zero (default gradient)\n"
+    << "  --seed N              seed of the random pattern (default 1)\n";
+}
+
+// Parses "WxH"
+std::pair<uint32_t, uint32_t> parseSize(const std::string& text)
+{
+  const size_t x = text.find('x');
+  if (x == std::string::npos) {
+    throw std::runtime_error("Invalid size: " + text);
+  }
+  return { static_cast<uint32_t>(std::stoul(text.substr(0, x))),
+    static_cast<uint32_t>(std::stoul(text.substr(x + 1))) };
+}
+
+int main(int argc, char* argv[]) {
+  Params params;
+  std::string output;
+  try {
+    for (int i = 1; i < argc; ++i) {
+      const std::string arg = argv[i];
+      auto value = [&]() -> std::string {
+        if (i + 1 >= argc) {
+          throw std::runtime_error("Missing value of " + arg);
+        }
+        return argv[++i];
+      };
+      if (arg == "--size") {
+        std::tie(params.width, params.height) = parseSize(value());
+      } else if (arg == "--bits") {
+        params.bitsPerSample = std::stoi(value());
+      } else if (arg == "--samples") {
+        params.samplesPerPixel = std::stoi(value());
+      } else if (arg == "--planar") {
+        params.isPlanar = true;
+      } else if (arg == "--rows-per-strip") {
+        params.rowsPerStrip = static_cast<uint32_t>(std::stoul(value()));
+      } else if (arg == "--tiles") {
+        std::tie(params.tileWidth, params.tileLength) = parseSize(value());
+      } else if (arg == "--byte-order") {
+        const std::string order = value();
+        if (order != "II" && order != "MM") {
+          throw std::runtime_error("Invalid byte order: " + order);
+        }
+        params.byteOrder = order == "II" ? std::endian::little : std::endian::big;
+      } else if (arg == "--bigtiff") {
+        params.isBigTiff = true;
+      } else if (arg == "--pages") {
+        params.pages = static_cast<uint32_t>(std::stoul(value()));
+      } else if (arg == "--sparse") {
+        params.isSparse = true;
+      } else if (arg == "--pattern") {
+        const std::string pattern = value();
+        if (pattern == "gradient") {
+          params.pattern = Pattern::Gradient;
+        } else if (pattern == "random") {
+          params.pattern = Pattern::Random;
+        } else if (pattern == "zero") {
+          params.pattern = Pattern::Zero;
+        } else {
+          throw std::runtime_error("Invalid pattern: " + pattern);
+        }
+      } else if (arg == "--seed") {
+        params.seed = std::stoull(value());
+      } else if (!arg.starts_with("--") && output.empty()) {
+        output = arg;
+      } else {
+        throw std::runtime_error("Invalid argument: " + arg);
+      }
+    }
+    if (output.empty()) {
+      printUsage(argv[0]);
+      return 1;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    std::ofstream file(output, std::ios::binary | std::ios::trunc);
+    if (!file) {
+      throw std::runtime_error("Failed to create " + output);
+    }
+    Generator generator(file, params);
+    generator.generate();
+    file.close();
+    const double seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+    std::cout << output << ": " << std::filesystem::file_size(output) << " bytes"
+      << (generator.isBigTiff() ? ", BigTIFF" : "")
+      << (params.isSparse ? ", sparse" : "")
+      << ", " << seconds << " s" << std::endl;
+  }
+  catch (const std::exception& ex) {
+    std::cerr << "Error: " << ex.what() << std::endl;
+    printUsage(argv[0]);
+    return 1;
+  }
+  return 0;
+}
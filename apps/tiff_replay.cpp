@@ -0,0 +1,407 @@
+// Copyright (c) 2025 Daniel Moreno
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS”
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// SPDX-License-Identifier: BSD-2-Clause
+//
+// ---------------------------------------------------------------------------
+//
+// tiff_replay.cpp
+// ===============
+// A program to record the reads made while loading a TIFF file, and to replay
+// them against a file with different read strategies, to tune coalescing and
+// readahead for a given storage:
+//
+//   direct     one read per recorded read, in the recorded order
+//   coalesced  reads sorted by offset and merged when closer than --gap bytes
+//   mmap       recorded reads copied from a memory mapping of the file
+//   async      recorded reads issued by --threads threads at once
+//
+// Usage: tiff_replay record [--ifd N] <input.tif> <reads.csv>
+//        tiff_replay replay [options] <input.tif> <reads.csv>
+//
+
+#include <tiffcraft/TiffExporter.hpp>
+#include <tiffcraft/TiffRecorder.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+# define TIFF_REPLAY_POSIX
+#endif
+
+using namespace TiffCraft;
+using Clock = std::chrono::steady_clock;
+
+void printUsage(const char* program)
+{
+  std::cerr << "Usage: " << program << " record [--ifd N] <input.tif> <reads.csv>\n"
+    << "       " << program << " replay [options] <input.tif> <reads.csv>\n"
+    << "Replay options:\n"
+    << "  --strategy NAME       direct, coalesced, mmap, async, or all (default all)\n"
+    << "  --gap N               largest gap in bytes merged by coalesced (default 65536)\n"
+    << "  --threads N           threads of async (default 8)\n"
+    << "  --repeat N            runs of each strategy (default 3)\n"
+#ifdef __linux__
+    << "  --cold                drop the file from the page cache before each run\n"
+#endif
+    ;
+}
+
+// Loads the image through a recording stream and writes the reads
+void record(const std::string& input, const std::string& output, int ifd)
+{
+  std::ifstream file(input, std::ios::binary);
+  if (!file) {
+    throw std::runtime_error("Failed to open TIFF file: " + input);
+  }
+  ReadRecorder recorder;
+  RecordingStreamBuf buf(file.rdbuf(), recorder);
+  std::istream stream(&buf);
+  TiffExporterAny exporter;
+  load(stream, std::ref(exporter), LoadParams{ .ifdIndex = static_cast<uint16_t>(ifd) });
+  std::ofstream log(output);
+  if (!log) {
+    throw std::runtime_error("Failed to create " + output);
+  }
+  recorder.write(log);
+  const auto records = recorder.records();
+  uint64_t bytes = 0;
+  for (const auto& r : records) {
+    bytes += r.length;
+  }
+  std::cout << output << ": " << records.size() << " reads, " << bytes << " bytes" << std::endl;
+}
+
+// Reads of a file that can be issued from several threads at once
+class File
+{
+public:
+  explicit File(const std::string& filename) : filename_(filename)
+  {
+#ifdef TIFF_REPLAY_POSIX
+    fd_ = ::open(filename.c_str(), O_RDONLY);
+    if (fd_ < 0) {
+      throw std::runtime_error("Failed to open " + filename);
+    }
+    struct stat st;
+    ::fstat(fd_, &st);
+    size_ = static_cast<uint64_t>(st.st_size);
+#else
+    std::ifstream file(filename, std::ios::binary | std::ios::ate);
+    if (!file) {
+      throw std::runtime_error("Failed to open " + filename);
+    }
+    size_ = static_cast<uint64_t>(file.tellg());
+#endif
+  }
+
+  ~File()
+  {
+#ifdef TIFF_REPLAY_POSIX
+    if (map_) {
+      ::munmap(map_, size_);
+    }
+    ::close(fd_);
+#endif
+  }
+
+  File(const File&) = delete;
+  File& operator=(const File&) = delete;
+
+  uint64_t size() const { return size_; }
+
+  void read(uint64_t offset, char* buffer, uint64_t length)
+  {
+#ifdef TIFF_REPLAY_POSIX
+    while (length > 0) {
+      const ssize_t count = ::pread(fd_, buffer, length, static_cast<off_t>(offset));
+      if (count <= 0) {
+        return; // end of the file
+      }
+      buffer += count;
+      offset += count;
+      length -= count;
+    }
+#else
+    thread_local std::ifstream file;
+    thread_local std::string openName;
+    if (openName != filename_) {
+      file = std::ifstream(filename_, std::ios::binary);
+      openName = filename_;
+    }
+    file.clear();
+    file.seekg(offset);
+    file.read(buffer, length);
+#endif
+  }
+
+  // Whole file mapped in memory, or null when not supported
+  const char* map()
+  {
+#ifdef TIFF_REPLAY_POSIX
+    if (!map_ && size_ > 0) {
+      void* map = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+      if (map == MAP_FAILED) {
+        throw std::runtime_error("Failed to map " + filename_);
+      }
+      map_ = map;
+    }
+    return static_cast<const char*>(map_);
+#else
+    return nullptr;
+#endif
+  }
+
+  // Removes the file from the page cache, when supported
+  void dropCache()
+  {
+#ifdef __linux__
+    if (map_) {
+      ::munmap(map_, size_);
+      map_ = nullptr;
+    }
+    ::posix_fadvise(fd_, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+  }
+
+private:
+  std::string filename_;
+  uint64_t size_ = 0;
+#ifdef TIFF_REPLAY_POSIX
+  int fd_ = -1;
+  void* map_ = nullptr;
+#endif
+};
+
+// Read issued by a strategy
+struct Request {
+  uint64_t offset = 0;
+  uint64_t length = 0;
+};
+
+// Recorded reads sorted by offset, merged when at most `gap` bytes apart
+std::vector<Request> coalesce(std::vector<Request> requests, uint64_t gap)
+{
+  std::sort(requests.begin(), requests.end(),
+    [](const Request& a, const Request& b) { return a.offset < b.offset; });
+  std::vector<Request> merged;
+  for (const auto& request : requests) {
+    if (!merged.empty() && request.offset <= merged.back().offset + merged.back().length + gap) {
+      auto& last = merged.back();
+      last.length = std::max(last.offset + last.length, request.offset + request.length)
+        - last.offset;
+    } else {
+      merged.push_back(request);
+    }
+  }
+  return merged;
+}
+
+// Latencies and wall time of one run
+struct Run {
+  std::vector<double> latencies; // microseconds
+  double seconds = 0;
+  uint64_t bytes = 0;
+};
+
+// Issues `requests` one after the other, or from `threads` threads at once
+Run replay(File& file, const std::vector<Request>& requests, bool isMapped, int threads)
+{
+  Run run;
+  run.latencies.resize(requests.size());
+  for (const auto& request : requests) {
+    run.bytes += request.length;
+  }
+  const char* map = isMapped ? file.map() : nullptr;
+  if (isMapped && !map) {
+    throw std::runtime_error("Memory mapping is not supported on this platform");
+  }
+
+  std::atomic<size_t> next = 0;
+  auto worker = [&]() {
+    std::vector<char> buffer;
+    for (size_t i = next++; i < requests.size(); i = next++) {
+      const auto& request = requests[i];
+      const uint64_t length = request.offset < file.size()
+        ? std::min(request.length, file.size() - request.offset) : 0;
+      buffer.resize(length);
+      const auto start = Clock::now();
+      if (map) {
+        std::copy_n(map + request.offset, length, buffer.data());
+      } else {
+        file.read(request.offset, buffer.data(), length);
+      }
+      run.latencies[i] = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+    }
+  };
+
+  const auto start = Clock::now();
+  std::vector<std::thread> pool;
+  for (int i = 1; i < threads; ++i) {
+    pool.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread : pool) {
+    thread.join();
+  }
+  run.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  return run;
+}
+
+// Value at `p` percent of sorted `values`
+double percentile(const std::vector<double>& values, double p)
+{
+  if (values.empty()) {
+    return 0;
+  }
+  const size_t index = static_cast<size_t>(p / 100 * (values.size() - 1) + 0.5);
+  return values[std::min(index, values.size() - 1)];
+}
+
+void printRun(const std::string& strategy, size_t requests, const Run& run)
+{
+  auto latencies = run.latencies;
+  std::sort(latencies.begin(), latencies.end());
+  std::cout << std::left << std::setw(11) << strategy << std::right
+    << std::setw(9) << requests
+    << std::setw(13) << run.bytes
+    << std::fixed << std::setprecision(3)
+    << std::setw(11) << run.seconds * 1e3
+    << std::setprecision(1)
+    << std::setw(10) << (run.seconds > 0 ? run.bytes / run.seconds / 1e6 : 0)
+    << std::setw(10) << percentile(latencies, 50)
+    << std::setw(10) << percentile(latencies, 90)
+    << std::setw(10) << percentile(latencies, 99)
+    << std::setw(10) << (latencies.empty() ? 0 : latencies.back())
+    << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    printUsage(argv[0]);
+    return 1;
+  }
+  const std::string command = argv[1];
+  std::string strategy = "all";
+  uint64_t gap = 65536;
+  int threads = 8;
+  int repeat = 3;
+  int ifd = 0;
+  bool isCold = false;
+  std::vector<std::string> files;
+  try {
+    for (int i = 2; i < argc; ++i) {
+      const std::string arg = argv[i];
+      auto value = [&]() -> std::string {
+        if (i + 1 >= argc) {
+          throw std::runtime_error("Missing value of " + arg);
+        }
+        return argv[++i];
+      };
+      if (arg == "--strategy") {
+        strategy = value();
+      } else if (arg == "--gap") {
+        gap = std::stoull(value());
+      } else if (arg == "--threads") {
+        threads = std::max(1, std::stoi(value()));
+      } else if (arg == "--repeat") {
+        repeat = std::max(1, std::stoi(value()));
+      } else if (arg == "--ifd") {
+        ifd = std::stoi(value());
+      } else if (arg == "--cold") {
+        isCold = true;
+      } else if (!arg.starts_with("--")) {
+        files.push_back(arg);
+      } else {
+        throw std::runtime_error("Invalid argument: " + arg);
+      }
+    }
+    if (files.size() != 2 || (command != "record" && command != "replay")) {
+      printUsage(argv[0]);
+      return 1;
+    }
+
+    if (command == "record") {
+      record(files[0], files[1], ifd);
+      return 0;
+    }
+
+    if (strategy != "all" && strategy != "direct" && strategy != "coalesced"
+      && strategy != "mmap" && strategy != "async") {
+      throw std::runtime_error("Invalid strategy: " + strategy);
+    }
+
+    std::ifstream log(files[1]);
+    if (!log) {
+      throw std::runtime_error("Failed to open " + files[1]);
+    }
+    std::vector<Request> recorded;
+    for (const auto& r : ReadRecorder::read(log)) {
+      recorded.push_back({ r.offset, r.length });
+    }
+    const std::vector<Request> merged = coalesce(recorded, gap);
+
+    File file(files[0]);
+    std::cout << std::left << std::setw(11) << "strategy" << std::right
+      << std::setw(9) << "requests" << std::setw(13) << "bytes"
+      << std::setw(11) << "wall ms" << std::setw(10) << "MB/s"
+      << std::setw(10) << "p50 us" << std::setw(10) << "p90 us"
+      << std::setw(10) << "p99 us" << std::setw(10) << "max us" << std::endl;
+    auto run = [&](const std::string& name, const std::vector<Request>& requests,
+      bool isMapped, int runThreads) {
+      if (strategy != "all" && strategy != name) {
+        return;
+      }
+      for (int i = 0; i < repeat; ++i) {
+        if (isCold) {
+          file.dropCache();
+        }
+        printRun(name, requests.size(), replay(file, requests, isMapped, runThreads));
+      }
+    };
+    run("direct", recorded, false, 1);
+    run("coalesced", merged, false, 1);
+#ifdef TIFF_REPLAY_POSIX
+    run("mmap", recorded, true, 1);
+#endif
+    run("async", recorded, false, threads);
+  }
+  catch (const std::exception& ex) {
+    std::cerr << "Error: " << ex.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,444 @@
+// Copyright (c) 2025 Daniel Moreno
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS”
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// SPDX-License-Identifier: BSD-2-Clause
+//
+// ---------------------------------------------------------------------------
+//
+// tiff_scan.cpp
+// =============
+// A program to list the dimensions, sample format, compression, page count,
+// and strip or tile layout of many TIFF files. Only the header and the IFDs
+// are read, plus the out-of-line values of BitsPerSample and SampleFormat;
+// offset and byte count arrays are never read. Directories are walked
+// recursively, and files are scanned by a pool of threads.
+//
+// One line is written per file (or per page, with --pages), as CSV or JSON
+// lines. Files that are not valid TIFF files get a line with an error. The
+// number of files scanned per second is printed to stderr at the end. Run it
+// with --cold to drop each file from the page cache before scanning it.
+//
+// Usage: tiff_scan [options] <file or directory>...
+//
+
+#include <tiffcraft/TiffImage.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+# include <fcntl.h>
+# include <unistd.h>
+#endif
+
+using namespace TiffCraft;
+using Clock = std::chrono::steady_clock;
+namespace fs = std::filesystem;
+
+void printUsage(const char* program)
+{
+  std::cerr << "Usage: " << program << " [options] <file or directory>...\n"
+    << "Options:\n"
+    << "  --format NAME         csv or jsonl (default csv)\n"
+    << "  --output FILE         write the lines to FILE instead of stdout\n"
+    << "  --threads N           scanning threads (default one per hardware thread)\n"
+    << "  --ext LIST            extensions scanned in directories (default .tif,.tiff,.btf)\n"
+    << "  --pages               one line per page instead of one per file\n"
+#ifdef __linux__
+    << "  --cold                drop each file from the page cache before scanning it\n"
+#endif
+    ;
+}
+
+// Properties of one page (IFD)
+struct Page
+{
+  uint64_t width = 0;
+  uint64_t height = 0;
+  uint64_t bitsPerSample = 0;
+  uint64_t samplesPerPixel = 0;
+  uint64_t sampleFormat = 0;
+  uint64_t compression = 0;
+  uint64_t photometric = 0;
+  uint64_t planar = 0;
+  bool isTiled = false;
+  uint64_t blockWidth = 0;  // tile width, or image width for strips
+  uint64_t blockHeight = 0; // tile length, or rows per strip
+  uint64_t blocks = 0;      // number of strips or tiles
+};
+
+// Result of scanning one file
+struct ScanResult
+{
+  std::string path{};
+  bool isBigTiff = false;
+  std::vector<Page> pages{};
+  std::string error{};
+};
+
+Page readPage(const TiffImage::IFD& ifd)
+{
+  Page page;
+  page.width = ifd.getValue(Tag::ImageWidth);
+  page.height = ifd.getValue(Tag::ImageLength);
+  page.bitsPerSample = ifd.getValue(Tag::BitsPerSample, 1);
+  page.samplesPerPixel = ifd.getValue(Tag::SamplesPerPixel, 1);
+  page.sampleFormat = ifd.getValue(Tag::SampleFormat, 1);
+  page.compression = ifd.getValue(Tag::Compression, 1);
+  page.photometric = ifd.getValue(Tag::PhotometricInterpretation, 1); // as the exporters
+  page.planar = ifd.getValue(Tag::PlanarConfiguration, 1);
+  page.isTiled = ifd.entries().contains(Tag::TileOffsets);
+  if (page.isTiled) {
+    page.blockWidth = ifd.getValue(Tag::TileWidth);
+    page.blockHeight = ifd.getValue(Tag::TileLength);
+    page.blocks = ifd.getEntry(Tag::TileOffsets).count();
+  } else {
+    page.blockWidth = page.width;
+    page.blockHeight = std::min(ifd.getValue(Tag::RowsPerStrip, page.height), page.height);
+    auto it = ifd.entries().find(Tag::StripOffsets);
+    page.blocks = it != ifd.entries().end() ? it->second.count() : 0;
+  }
+  return page;
+}
+
+ScanResult scan(const std::string& path, bool isCold)
+{
+  ScanResult result{ .path = path };
+  try {
+#ifdef __linux__
+    if (isCold) {
+      const int fd = ::open(path.c_str(), O_RDONLY);
+      if (fd >= 0) {
+        ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        ::close(fd);
+      }
+    }
+#endif
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+      throw std::runtime_error("Failed to open file");
+    }
+    const TiffImage image = TiffImage::read(file, [](Tag tag) {
+      return tag == Tag::BitsPerSample || tag == Tag::SampleFormat;
+    });
+    result.isBigTiff = image.header().isBigTiff();
+    for (const auto& ifd : image.ifds()) {
+      result.pages.push_back(readPage(ifd));
+    }
+  }
+  catch (const std::exception& ex) {
+    result.error = ex.what();
+  }
+  return result;
+}
+
+const char* sampleFormatName(uint64_t format)
+{
+  switch (format) {
+    case 1: return "uint";
+    case 2: return "int";
+    case 3: return "float";
+    default: return "undefined";
+  }
+}
+
+std::string csvQuoted(const std::string& text)
+{
+  if (text.find_first_of(",\"\n") == std::string::npos) {
+    return text;
+  }
+  std::string quoted = "\"";
+  for (char c : text) {
+    quoted += c;
+    if (c == '"') {
+      quoted += '"';
+    }
+  }
+  return quoted + "\"";
+}
+
+std::string jsonQuoted(const std::string& text)
+{
+  std::ostringstream os;
+  os << '"';
+  for (unsigned char c : text) {
+    if (c == '"' || c == '\\') {
+      os << '\\' << c;
+    } else if (c < 0x20) {
+      os << "\\u" << std::hex << std::setw(4) << std::setfill('0') << int(c) << std::dec;
+    } else {
+      os << c;
+    }
+  }
+  os << '"';
+  return os.str();
+}
+
+const char* csvHeader =
+  "path,page,pages,width,height,bits_per_sample,samples_per_pixel,sample_format,"
+  "compression,photometric,planar,layout,block_width,block_height,blocks,bigtiff,error\n";
+
+// Appends the lines of one file to `out`
+void format(std::string& out, const ScanResult& result, bool isJson, bool isPerPage)
+{
+  std::ostringstream os;
+  const size_t count = result.pages.empty() ? 1 : isPerPage ? result.pages.size() : 1;
+  for (size_t i = 0; i < count; ++i) {
+    const Page page = i < result.pages.size() ? result.pages[i] : Page{};
+    const char* layout = page.isTiled ? "tiles" : "strips";
+    if (isJson) {
+      os << "{\"path\":" << jsonQuoted(result.path);
+      if (result.error.empty()) {
+        os << ",\"page\":" << i << ",\"pages\":" << result.pages.size()
+          << ",\"width\":" << page.width << ",\"height\":" << page.height
+          << ",\"bits_per_sample\":" << page.bitsPerSample
+          << ",\"samples_per_pixel\":" << page.samplesPerPixel
+          << ",\"sample_format\":\"" << sampleFormatName(page.sampleFormat) << '"'
+          << ",\"compression\":" << page.compression
+          << ",\"photometric\":" << page.photometric
+          << ",\"planar\":" << page.planar
+          << ",\"layout\":\"" << layout << '"'
+          << ",\"block_width\":" << page.blockWidth
+          << ",\"block_height\":" << page.blockHeight
+          << ",\"blocks\":" << page.blocks
+          << ",\"bigtiff\":" << (result.isBigTiff ? "true" : "false");
+      } else {
+        os << ",\"error\":" << jsonQuoted(result.error);
+      }
+      os << "}\n";
+    } else {
+      os << csvQuoted(result.path) << ',';
+      if (result.error.empty()) {
+        os << i << ',' << result.pages.size() << ',' << page.width << ','
+          << page.height << ',' << page.bitsPerSample << ','
+          << page.samplesPerPixel << ',' << sampleFormatName(page.sampleFormat) << ','
+          << page.compression << ',' << page.photometric << ',' << page.planar << ','
+          << layout << ',' << page.blockWidth << ',' << page.blockHeight << ','
+          << page.blocks << ',' << int(result.isBigTiff) << ",\n";
+      } else {
+        os << ",,,,,,,,,,,,,,," << csvQuoted(result.error) << '\n';
+      }
+    }
+  }
+  out += os.str();
+}
+
+// Queue of paths filled by the directory walk and emptied by the threads
+class PathQueue
+{
+public:
+  static constexpr size_t Capacity = 4096;
+
+  void push(std::string path)
+  {
+    std::unique_lock lock(mutex_);
+    notFull_.wait(lock, [&]() { return queue_.size() < Capacity; });
+    queue_.push_back(std::move(path));
+    notEmpty_.notify_one();
+  }
+
+  // Returns false when the queue is closed and empty
+  bool pop(std::string& path)
+  {
+    std::unique_lock lock(mutex_);
+    notEmpty_.wait(lock, [&]() { return !queue_.empty() || isClosed_; });
+    if (queue_.empty()) {
+      return false;
+    }
+    path = std::move(queue_.front());
+    queue_.pop_front();
+    notFull_.notify_one();
+    return true;
+  }
+
+  void close()
+  {
+    std::lock_guard lock(mutex_);
+    isClosed_ = true;
+    notEmpty_.notify_all();
+  }
+
+private:
+  std::mutex mutex_;
+  std::condition_variable notEmpty_;
+  std::condition_variable notFull_;
+  std::deque<std::string> queue_;
+  bool isClosed_ = false;
+};
+
+std::vector<std::string> splitExtensions(const std::string& list)
+{
+  std::vector<std::string> extensions;
+  std::istringstream is(list);
+  for (std::string ext; std::getline(is, ext, ',');) {
+    if (!ext.empty()) {
+      std::transform(ext.begin(), ext.end(), ext.begin(),
+        [](unsigned char c) { return std::tolower(c); });
+      extensions.push_back(ext.starts_with('.') ? ext : "." + ext);
+    }
+  }
+  return extensions;
+}
+
+int main(int argc, char* argv[]) {
+  std::string formatName = "csv";
+  std::string outputName;
+  int threads = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<std::string> extensions = splitExtensions(".tif,.tiff,.btf");
+  bool isPerPage = false;
+  bool isCold = false;
+  std::vector<std::string> inputs;
+  try {
+    for (int i = 1; i < argc; ++i) {
+      const std::string arg = argv[i];
+      auto value = [&]() -> std::string {
+        if (i + 1 >= argc) {
+          throw std::runtime_error("Missing value of " + arg);
+        }
+        return argv[++i];
+      };
+      if (arg == "--format") {
+        formatName = value();
+      } else if (arg == "--output") {
+        outputName = value();
+      } else if (arg == "--threads") {
+        threads = std::max(1, std::stoi(value()));
+      } else if (arg == "--ext") {
+        extensions = splitExtensions(value());
+      } else if (arg == "--pages") {
+        isPerPage = true;
+      } else if (arg == "--cold") {
+        isCold = true;
+      } else if (!arg.starts_with("--")) {
+        inputs.push_back(arg);
+      } else {
+        throw std::runtime_error("Invalid argument: " + arg);
+      }
+    }
+    if (inputs.empty()) {
+      printUsage(argv[0]);
+      return 1;
+    }
+    if (formatName != "csv" && formatName != "jsonl") {
+      throw std::runtime_error("Invalid format: " + formatName);
+    }
+    const bool isJson = formatName == "jsonl";
+
+    std::ofstream outputFile;
+    if (!outputName.empty()) {
+      outputFile.open(outputName, std::ios::binary);
+      if (!outputFile) {
+        throw std::runtime_error("Failed to create " + outputName);
+      }
+    }
+    std::ostream& output = outputName.empty() ? std::cout : outputFile;
+    std::ios::sync_with_stdio(false);
+    if (!isJson) {
+      output << csvHeader;
+    }
+
+    PathQueue queue;
+    std::mutex outputMutex;
+    std::atomic<uint64_t> files = 0;
+    std::atomic<uint64_t> pages = 0;
+    std::atomic<uint64_t> errors = 0;
+    auto worker = [&]() {
+      std::string lines;
+      auto flush = [&]() {
+        std::lock_guard lock(outputMutex);
+        output << lines;
+        lines.clear();
+      };
+      for (std::string path; queue.pop(path);) {
+        const ScanResult result = scan(path, isCold);
+        ++files;
+        pages += result.pages.size();
+        errors += result.error.empty() ? 0 : 1;
+        format(lines, result, isJson, isPerPage);
+        if (lines.size() >= 64 * 1024) {
+          flush();
+        }
+      }
+      flush();
+    };
+
+    const auto start = Clock::now();
+    std::vector<std::thread> pool;
+    for (int i = 0; i < threads; ++i) {
+      pool.emplace_back(worker);
+    }
+    auto isScanned = [&](const fs::path& path) {
+      std::string ext = path.extension().string();
+      std::transform(ext.begin(), ext.end(), ext.begin(),
+        [](unsigned char c) { return std::tolower(c); });
+      return std::find(extensions.begin(), extensions.end(), ext) != extensions.end();
+    };
+    for (const auto& input : inputs) {
+      std::error_code error;
+      if (!fs::is_directory(input, error)) {
+        queue.push(input); // files given explicitly are always scanned
+        continue;
+      }
+      const auto options = fs::directory_options::skip_permission_denied;
+      for (fs::recursive_directory_iterator it(input, options, error), end;
+        !error && it != end; it.increment(error)) {
+        if (it->is_regular_file(error) && isScanned(it->path())) {
+          queue.push(it->path().string());
+        }
+      }
+      if (error) {
+        std::cerr << "Warning: " << input << ": " << error.message() << std::endl;
+      }
+    }
+    queue.close();
+    for (auto& thread : pool) {
+      thread.join();
+    }
+    output.flush();
+    const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::cerr << files << " files, " << pages << " pages, " << errors << " errors in "
+      << std::fixed << std::setprecision(3) << seconds << " s ("
+      << std::setprecision(0) << (seconds > 0 ? files / seconds : 0) << " files/s, "
+      << threads << " threads" << (isCold ? ", cold cache" : "") << ")" << std::endl;
+  }
+  catch (const std::exception& ex) {
+    std::cerr << "Error: " << ex.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
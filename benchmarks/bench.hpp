@@ -0,0 +1,332 @@
+// BSD 2-Clause License
+// Copyright (c) 2025 Daniel Moreno
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS”
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+// ---------------------------------------------------------------------------
+//
+// bench.hpp
+// =========
+// A minimal benchmark harness. Each case is run repeatedly until a minimum
+// amount of time has elapsed, and the throughput is reported in MB/s, and
+// also in items (e.g. pages) and pixels per second for cases that count them.
+// The results can be written as JSON to track them over time.
+//
+// In memory mode, each case is run once after a warm-up run instead, and its
+// heap allocations are measured with heapProfiler.hpp: the number of calls,
+// the bytes allocated, and the peak of the heap relative to the bytes the
+// case processes, e.g. the size of the exported image.
+//
+
+#pragma once
+
+#include "heapProfiler.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <optional>
+#include <streambuf>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <chrono>
+
+namespace bench {
+
+  struct Result {
+    std::string name;
+    size_t iterations = 0;
+    double seconds = 0;  // total time
+    double bytes = 0;    // bytes processed per iteration
+    double items = 0;    // items processed per iteration, if counted
+    double pixels = 0;   // pixels processed per iteration, if counted
+    bool hasMemory = false;    // whether the heap was measured
+    uint64_t allocations = 0;  // allocations of one iteration
+    uint64_t peakBytes = 0;    // peak heap usage of one iteration
+
+    double secondsPerIteration() const { return seconds / iterations; }
+    double megabytesPerSecond() const { return bytes / secondsPerIteration() / 1e6; }
+    double itemsPerSecond() const { return items / secondsPerIteration(); }
+    double pixelsPerSecond() const { return pixels / secondsPerIteration(); }
+    double peakRatio() const { return bytes > 0 ? peakBytes / bytes : 0; }
+  };
+
+  struct Case {
+    std::string name;
+    size_t bytes; // bytes processed per iteration
+    std::function<void()> run;
+    size_t items = 0;  // items processed per iteration, if counted
+    size_t pixels = 0; // pixels processed per iteration, if counted
+  };
+
+  class Suite {
+  public:
+    void add(std::string name, size_t bytes, std::function<void()> run, size_t items = 0) {
+      cases_.push_back({ std::move(name), bytes, std::move(run), items });
+    }
+
+    // Adds a case that processes `pixels` pixels per iteration
+    void addPixels(std::string name, size_t bytes, size_t pixels, std::function<void()> run) {
+      cases_.push_back({ std::move(name), bytes, std::move(run), 0, pixels });
+    }
+
+    using Selector = std::function<bool(const std::string&)>;
+
+    // Selects the cases whose name contains `filter`
+    static Selector contains(const std::string& filter) {
+      return [filter](const std::string& name) { return name.find(filter) != std::string::npos; };
+    }
+
+    // Runs the cases whose name contains `filter`
+    std::vector<Result> run(const std::string& filter = {}, double minSeconds = 0.5) const {
+      return run(contains(filter), minSeconds);
+    }
+
+    // Runs the selected cases
+    std::vector<Result> run(const Selector& isSelected, double minSeconds) const {
+      using Clock = std::chrono::steady_clock;
+      std::vector<Result> results;
+      std::cout << std::left << std::setw(48) << "case"
+                << std::right << std::setw(12) << "iterations"
+                << std::setw(14) << "ms/iter"
+                << std::setw(12) << "MB/s"
+                << std::setw(12) << "items/s"
+                << std::setw(12) << "Mpixels/s" << "\n";
+      for (const auto& c : cases_) {
+        if (!isSelected(c.name)) {
+          continue;
+        }
+        c.run(); // warm up
+        Result result{ c.name, 0, 0, static_cast<double>(c.bytes),
+          static_cast<double>(c.items), static_cast<double>(c.pixels) };
+        const auto start = Clock::now();
+        do {
+          c.run();
+          ++result.iterations;
+          result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        } while (result.seconds < minSeconds);
+        std::cout << std::left << std::setw(48) << result.name
+                  << std::right << std::setw(12) << result.iterations
+                  << std::setw(14) << std::fixed << std::setprecision(3)
+                  << result.secondsPerIteration() * 1e3
+                  << std::setw(12) << std::setprecision(1)
+                  << result.megabytesPerSecond();
+        if (c.items > 0) {
+          std::cout << std::setw(12) << result.itemsPerSecond();
+        } else if (c.pixels > 0) {
+          std::cout << std::setw(12) << "";
+        }
+        if (c.pixels > 0) {
+          std::cout << std::setw(12) << result.pixelsPerSecond() / 1e6;
+        }
+        std::cout << std::endl;
+        results.push_back(result);
+      }
+      return results;
+    }
+
+    // Measures the heap usage of the cases whose name contains `filter`
+    std::vector<Result> measureMemory(const std::string& filter = {}) const {
+      return measureMemory(contains(filter));
+    }
+
+    // Measures the heap usage of the selected cases
+    std::vector<Result> measureMemory(const Selector& isSelected) const {
+      std::vector<Result> results;
+      std::cout << std::left << std::setw(48) << "case"
+                << std::right << std::setw(12) << "allocs"
+                << std::setw(14) << "MB allocated"
+                << std::setw(12) << "peak MB"
+                << std::setw(12) << "peak/bytes" << "\n";
+      for (const auto& c : cases_) {
+        if (!isSelected(c.name)) {
+          continue;
+        }
+        c.run(); // warm up
+        const auto usage = heapprofiler::measure(c.run);
+        Result result{ c.name, 1, 0, static_cast<double>(c.bytes),
+          static_cast<double>(c.items), static_cast<double>(c.pixels),
+          true, usage.allocations, usage.peak };
+        std::cout << std::left << std::setw(48) << result.name
+                  << std::right << std::setw(12) << usage.allocations
+                  << std::setw(14) << std::fixed << std::setprecision(1)
+                  << usage.bytes / 1e6
+                  << std::setw(12) << usage.peak / 1e6
+                  << std::setw(12) << std::setprecision(2)
+                  << result.peakRatio() << std::endl;
+        results.push_back(result);
+      }
+      return results;
+    }
+
+  private:
+    std::vector<Case> cases_;
+  };
+
+  // Writes the results as a JSON object with a "benchmarks" array
+  inline void writeJson(std::ostream& os, const std::vector<Result>& results) {
+    auto quoted = [](std::string_view text) {
+      std::string out = "\"";
+      for (char c : text) {
+        if (c == '"' || c == '\\') {
+          out += '\\';
+        }
+        out += c;
+      }
+      return out + "\"";
+    };
+    os << "{\n  \"benchmarks\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+      const auto& result = results[i];
+      os << (i > 0 ? "," : "") << "\n    { "
+         << "\"name\": " << quoted(result.name)
+         << std::setprecision(6) << std::defaultfloat;
+      if (result.seconds > 0) {
+        os << ", \"iterations\": " << result.iterations
+           << ", \"seconds_per_iteration\": " << result.secondsPerIteration()
+           << ", \"bytes_per_second\": " << result.bytes / result.secondsPerIteration();
+        if (result.items > 0) {
+          os << ", \"items_per_second\": " << result.itemsPerSecond();
+        }
+        if (result.pixels > 0) {
+          os << ", \"pixels_per_second\": " << result.pixelsPerSecond();
+        }
+      }
+      if (result.hasMemory) {
+        os << ", \"allocations\": " << result.allocations
+           << ", \"peak_bytes\": " << result.peakBytes
+           << ", \"peak_ratio\": " << result.peakRatio();
+      }
+      os << " }";
+    }
+    os << "\n  ]\n}\n";
+  }
+
+  // Throughput and allocations of a case in a baseline file
+  struct Baseline {
+    std::string name;
+    double bytesPerSecond = 0;  // 0 if not measured
+    uint64_t allocations = 0;
+    bool hasAllocations = false;
+  };
+
+  // Reads the cases of a file written by `writeJson()`, one per line
+  inline std::vector<Baseline> readJson(std::istream& is) {
+    auto field = [](const std::string& line, const std::string& key) -> std::optional<std::string> {
+      const std::string pattern = "\"" + key + "\": ";
+      const size_t pos = line.find(pattern);
+      if (pos == std::string::npos) {
+        return std::nullopt;
+      }
+      const size_t start = pos + pattern.size();
+      if (line[start] == '"') {
+        return line.substr(start + 1, line.find('"', start + 1) - start - 1);
+      }
+      return line.substr(start, line.find_first_of(",}", start) - start);
+    };
+    std::vector<Baseline> baselines;
+    std::string line;
+    while (std::getline(is, line)) {
+      const auto name = field(line, "name");
+      if (!name) {
+        continue;
+      }
+      Baseline baseline{ *name };
+      if (const auto value = field(line, "bytes_per_second")) {
+        baseline.bytesPerSecond = std::stod(*value);
+      }
+      if (const auto value = field(line, "allocations")) {
+        baseline.allocations = std::stoull(*value);
+        baseline.hasAllocations = true;
+      }
+      baselines.push_back(std::move(baseline));
+    }
+    return baselines;
+  }
+
+  // Compares results with their baseline, and returns false if the throughput
+  // of a case dropped by more than `tolerance` (e.g. 0.25 for 25%) or its
+  // allocations grew by more than `allocationTolerance`
+  inline bool checkBaseline(const std::vector<Baseline>& baselines,
+    const std::vector<Result>& results, double tolerance, double allocationTolerance,
+    std::ostream& os) {
+    bool isOk = true;
+    os << std::left << std::setw(40) << "case" << std::right
+       << std::setw(12) << "MB/s" << std::setw(12) << "baseline"
+       << std::setw(10) << "allocs" << std::setw(10) << "baseline" << "  status\n";
+    for (const auto& baseline : baselines) {
+      auto it = std::find_if(results.begin(), results.end(),
+        [&](const Result& result) { return result.name == baseline.name; });
+      if (it == results.end()) {
+        os << std::left << std::setw(40) << baseline.name << "  MISSING\n";
+        isOk = false;
+        continue;
+      }
+      const double bytesPerSecond = it->seconds > 0 ? it->bytes / it->secondsPerIteration() : 0;
+      const bool isSlower = baseline.bytesPerSecond > 0
+        && bytesPerSecond < baseline.bytesPerSecond * (1 - tolerance);
+      const bool hasMoreAllocations = baseline.hasAllocations && it->hasMemory
+        && it->allocations > baseline.allocations * (1 + allocationTolerance) + 2;
+      os << std::left << std::setw(40) << baseline.name << std::right
+         << std::fixed << std::setprecision(1)
+         << std::setw(12) << bytesPerSecond / 1e6
+         << std::setw(12) << baseline.bytesPerSecond / 1e6
+         << std::setw(10) << it->allocations
+         << std::setw(10) << baseline.allocations
+         << "  " << (isSlower && hasMoreAllocations ? "SLOWER, MORE ALLOCATIONS"
+           : isSlower ? "SLOWER" : hasMoreAllocations ? "MORE ALLOCATIONS" : "ok") << "\n";
+      isOk = isOk && !isSlower && !hasMoreAllocations;
+    }
+    return isOk;
+  }
+
+  // Input stream over a buffer, without copying it
+  class MemoryStream : public std::istream {
+  public:
+    explicit MemoryStream(std::string_view data) : std::istream(&buf_), buf_(data) {}
+
+  private:
+    struct Buf : std::streambuf {
+      explicit Buf(std::string_view data) {
+        char* begin = const_cast<char*>(data.data());
+        setg(begin, begin, begin + data.size());
+      }
+      pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+        std::ios_base::openmode which) override {
+        const off_type base = dir == std::ios_base::beg ? 0
+          : dir == std::ios_base::cur ? gptr() - eback() : egptr() - eback();
+        return seekpos(base + off, which);
+      }
+      pos_type seekpos(pos_type pos, std::ios_base::openmode) override {
+        if (pos < 0 || pos > egptr() - eback()) {
+          return pos_type(off_type(-1));
+        }
+        setg(eback(), eback() + off_type(pos), egptr());
+        return pos;
+      }
+    };
+    Buf buf_;
+  };
+
+} // namespace bench
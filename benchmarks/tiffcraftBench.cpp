@@ -0,0 +1,852 @@
+// BSD 2-Clause License
+// Copyright (c) 2025 Daniel Moreno
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS”
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+// ---------------------------------------------------------------------------
+//
+// tiffcraftBench.cpp
+// ==================
+// Benchmarks for TiffCraft. When libtiff is found at configure time, the same
+// files are also decoded with libtiff for reference.
+//
+// Usage: tiffcraft_bench [--json file] [--min-time seconds] [--memory] [filter...]
+//        tiffcraft_bench --write-baseline file [--min-time seconds] [filter...]
+//        tiffcraft_bench --check file [--min-time seconds] [--tolerance t] [--allocations]
+//
+// Only the cases whose name contains one of the filters are run. With --json, the
+// results are also written to `file`. With --memory, the heap usage of each
+// case is measured instead of its speed.
+//
+// The performance regression test uses the parse, read, export, and corpus
+// cases. --write-baseline measures the speed and the allocations of these
+// cases and writes them to `file`; --check runs the cases listed in `file`
+// and fails when a case is slower than its baseline by more than the
+// tolerance (default 0.25, i.e. 25%), or makes more allocations. With
+// --allocations, only the allocations are compared; they do not depend on
+// the speed of the machine, but they do on the standard library and the
+// build type, so the baseline must come from the same toolchain.
+//
+
+#define HEAP_PROFILER_IMPLEMENTATION
+#include "heapProfiler.hpp"
+
+#include <tiffcraft/TiffCraft.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <deque>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef TIFFCRAFT_BENCH_LIBTIFF
+# include <tiffio.h>
+#endif
+
+#include "bench.hpp"
+#include "tiffBuilder.hpp"
+#include "tiffGenerator.hpp"
+
+using namespace TiffCraft;
+
+namespace {
+
+  // Synthetic 8-bit image: smooth gradients with some noise, which is closer
+  // to real photographs than random data.
+  std::vector<std::byte> makeImage8(int width, int height, int channels) {
+    std::mt19937 rng(42);
+    std::vector<std::byte> data(size_t(width) * height * channels);
+    for (int y = 0; y < height; ++y) {
+      for (int x = 0; x < width; ++x) {
+        for (int c = 0; c < channels; ++c) {
+          const int value = (x / 4 + y / 8 + 64 * c) + static_cast<int>(rng() % 4);
+          data[(size_t(y) * width + x) * channels + c] = static_cast<std::byte>(value);
+        }
+      }
+    }
+    return data;
+  }
+
+  // Synthetic 16-bit image, e.g. a camera or microscope capture, in host
+  // byte order
+  std::vector<std::byte> makeImage16(int width, int height) {
+    std::mt19937 rng(42);
+    std::vector<uint16_t> samples(size_t(width) * height);
+    for (int y = 0; y < height; ++y) {
+      for (int x = 0; x < width; ++x) {
+        samples[size_t(y) * width + x] = static_cast<uint16_t>(
+          8 * x + 4 * y + static_cast<int>(rng() % 64));
+      }
+    }
+    std::vector<std::byte> data(samples.size() * sizeof(uint16_t));
+    std::memcpy(data.data(), samples.data(), data.size());
+    return data;
+  }
+
+  // Synthetic scanned page: white background with lines of black "text"
+  std::vector<std::byte> makeDocument(int width, int height, int bitsPerSample,
+    unsigned seed = 42)
+  {
+    std::mt19937 rng(seed);
+    const size_t stride = (size_t(width) * bitsPerSample + 7) / 8;
+    std::vector<std::byte> data(stride * height, std::byte{ 0xFF });
+    for (int y = 0; y < height; ++y) {
+      if ((y / 24) % 2 == 0 || y < 200 || y > height - 200) {
+        continue; // margins and space between lines
+      }
+      for (int x = 200; x < width - 200; x += 8 + rng() % 24) {
+        const int blackPixels = 2 + rng() % 6; // a stroke of a glyph
+        for (int i = 0; i < blackPixels && x + i < width; ++i) {
+          const size_t bit = size_t(x + i) * bitsPerSample;
+          if (bitsPerSample == 1) {
+            data[y * stride + bit / 8] &= ~std::byte(0x80 >> (bit % 8));
+          } else {
+            data[y * stride + bit / 8] = std::byte{ 0 };
+          }
+        }
+      }
+    }
+    return data;
+  }
+
+  struct StripImage {
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    int rowsPerStrip = 0;
+    size_t stride = 0;                          // bytes per row
+    std::vector<std::vector<std::byte>> strips; // encoded strips
+    std::string path;                           // file with the strips
+  };
+
+  // Compresses the image `data` with `encode` in strips of `rowsPerStrip`
+  // rows and writes it to a temporary file.
+  template <typename Encoder>
+  StripImage makeStripImage(const std::string& name, int width, int height,
+    int channels, int bitsPerSample, int rowsPerStrip, int compression,
+    const std::vector<std::byte>& data, Encoder&& encode,
+    const std::vector<tiffbuilder::Field>& extraFields = {})
+  {
+    using namespace tiffbuilder;
+    const size_t stride = (size_t(width) * channels * bitsPerSample + 7) / 8;
+    StripImage image{ width, height, channels, rowsPerStrip, stride, {}, {} };
+    for (int y = 0; y < height; y += rowsPerStrip) {
+      const int rows = std::min(rowsPerStrip, height - y);
+      image.strips.push_back(encode(std::span(data).subspan(y * stride, rows * stride)));
+    }
+    std::vector<uint16_t> bitsPerSampleVec(channels, static_cast<uint16_t>(bitsPerSample));
+    std::vector<Field> fields = {
+      longs(Tag::ImageWidth, { static_cast<uint32_t>(width) }),
+      longs(Tag::ImageLength, { static_cast<uint32_t>(height) }),
+      shorts(Tag::BitsPerSample, bitsPerSampleVec),
+      shorts(Tag::Compression, { static_cast<uint16_t>(compression) }),
+      shorts(Tag::PhotometricInterpretation, { static_cast<uint16_t>(channels == 3 ? 2 : 1) }),
+      shorts(Tag::SamplesPerPixel, { static_cast<uint16_t>(channels) }),
+      longs(Tag::RowsPerStrip, { static_cast<uint32_t>(rowsPerStrip) }),
+    };
+    for (const auto& field : extraFields) {
+      std::erase_if(fields, [&](const Field& f) { return f.tag == field.tag; });
+      fields.push_back(field);
+    }
+    const auto tiff = makeTiff(fields, image.strips);
+    image.path = (std::filesystem::temp_directory_path() / ("tiffcraft_bench_" + name + ".tif")).string();
+    std::ofstream(image.path, std::ios::binary).write(tiff.data(), tiff.size());
+    return image;
+  }
+
+  // Same as above for the synthetic 8-bit image
+  template <typename Encoder>
+  StripImage makeStripImage(const std::string& name, int width, int height,
+    int channels, int rowsPerStrip, int compression, Encoder&& encode)
+  {
+    return makeStripImage(name, width, height, channels, 8, rowsPerStrip,
+      compression, makeImage8(width, height, channels), std::forward<Encoder>(encode));
+  }
+
+  void addLoadCases(bench::Suite& suite, const std::string& name, const StripImage& image) {
+    const size_t imageBytes = image.stride * image.height;
+    suite.add(name + "/load/tiffcraft", imageBytes, [&image]() {
+      TiffExporterAny exporter;
+      load(image.path, std::ref(exporter));
+    });
+#ifdef TIFFCRAFT_BENCH_LIBTIFF
+    suite.add(name + "/load/libtiff", imageBytes, [&image, imageBytes]() {
+      TIFF* tif = TIFFOpen(image.path.c_str(), "r");
+      if (!tif) {
+        throw std::runtime_error("libtiff failed to open " + image.path);
+      }
+      std::vector<std::byte> pixels(imageBytes);
+      const tmsize_t stripSize = TIFFStripSize(tif);
+      for (tstrip_t strip = 0; strip < TIFFNumberOfStrips(tif); ++strip) {
+        TIFFReadEncodedStrip(tif, strip, pixels.data() + strip * stripSize, -1);
+      }
+      TIFFClose(tif);
+    });
+#endif
+  }
+
+  template <typename Decoder>
+  void addDecodeCase(bench::Suite& suite, const std::string& name, const StripImage& image) {
+    const size_t stripBytes = image.stride * image.rowsPerStrip;
+    suite.add(name, stripBytes * image.strips.size(), [&image, stripBytes]() {
+      thread_local Decoder decoder;
+      std::vector<std::byte> out(stripBytes);
+      for (const auto& strip : image.strips) {
+        decoder.decode(strip, out);
+      }
+    });
+  }
+
+  void addLzwCases(bench::Suite& suite) {
+    static const auto gray = makeStripImage("lzw_gray8", 2048, 2048, 1, 16, 5,
+      [](std::span<const std::byte> rows) { return LzwEncoder().encode(rows); });
+    static const auto rgb = makeStripImage("lzw_rgb8", 2048, 2048, 3, 16, 5,
+      [](std::span<const std::byte> rows) { return LzwEncoder().encode(rows); });
+
+    for (const auto* image : { &gray, &rgb }) {
+      const std::string name = (image == &gray) ? "lzw/gray8" : "lzw/rgb8";
+      addDecodeCase<LzwDecoder>(suite, name + "/decode", *image);
+      addLoadCases(suite, name, *image);
+    }
+  }
+
+  void addDeflateCases(bench::Suite& suite) {
+    static const auto gray = makeStripImage("deflate_gray8", 2048, 2048, 1, 16, 8,
+      [](std::span<const std::byte> rows) { return Deflater().encode(rows); });
+    static const auto rgb = makeStripImage("deflate_rgb8", 2048, 2048, 3, 16, 8,
+      [](std::span<const std::byte> rows) { return Deflater().encode(rows); });
+
+    for (const auto* image : { &gray, &rgb }) {
+      const std::string name = (image == &gray) ? "deflate/gray8" : "deflate/rgb8";
+      addDecodeCase<Inflater>(suite, name + "/decode/" + Inflater::name, *image);
+      if constexpr (!std::is_same_v<DeflateDecoder, Inflater>) {
+        addDecodeCase<DeflateDecoder>(suite, name + "/decode/" + DeflateDecoder::name, *image);
+      }
+      addLoadCases(suite, name, *image);
+    }
+  }
+
+  void addUncompressedCases(bench::Suite& suite) {
+    static const auto gray = makeStripImage("none_gray8", 2048, 2048, 1, 16, 1,
+      [](std::span<const std::byte> rows) { return std::vector<std::byte>(rows.begin(), rows.end()); });
+    addLoadCases(suite, "none/gray8", gray);
+  }
+
+#ifdef TIFFCRAFT_USE_ZSTD
+  // Same images as the Deflate cases, for comparison
+  void addZstdCases(bench::Suite& suite) {
+    static const auto gray = makeStripImage("zstd_gray8", 2048, 2048, 1, 16, 50000,
+      [](std::span<const std::byte> rows) { return ZstdEncoder().encode(rows); });
+    static const auto rgb = makeStripImage("zstd_rgb8", 2048, 2048, 3, 16, 50000,
+      [](std::span<const std::byte> rows) { return ZstdEncoder().encode(rows); });
+
+    for (const auto* image : { &gray, &rgb }) {
+      const std::string name = (image == &gray) ? "zstd/gray8" : "zstd/rgb8";
+      addDecodeCase<ZstdDecoder>(suite, name + "/decode", *image);
+      addLoadCases(suite, name, *image);
+    }
+  }
+#endif
+
+  void addPackBitsCases(bench::Suite& suite) {
+    // A4 page at 300 dpi
+    constexpr int width = 2480;
+    constexpr int height = 3508;
+    static const auto bilevel = makeStripImage("packbits_bilevel", width, height, 1, 1, 32, 32773,
+      makeDocument(width, height, 1), [](std::span<const std::byte> rows) {
+        return PackBitsEncoder().encode(rows, (width + 7) / 8);
+      });
+    static const auto gray = makeStripImage("packbits_gray8", width, height, 1, 8, 32, 32773,
+      makeDocument(width, height, 8), [](std::span<const std::byte> rows) {
+        return PackBitsEncoder().encode(rows, width);
+      });
+
+    for (const auto* image : { &bilevel, &gray }) {
+      const std::string name = (image == &bilevel) ? "packbits/bilevel" : "packbits/gray8";
+      addDecodeCase<PackBitsDecoder>(suite, name + "/decode", *image);
+      addLoadCases(suite, name, *image);
+    }
+  }
+
+  void addPredictorCases(bench::Suite& suite) {
+    constexpr int width = 2048;
+    constexpr int height = 2048;
+    auto data = makeImage16(width, height);
+    auto encode = [](std::span<const std::byte> rows) {
+      std::vector<std::byte> differences(rows.begin(), rows.end());
+      for (size_t y = 0; y < rows.size() / (width * 2); ++y) {
+        auto* row = reinterpret_cast<uint16_t*>(differences.data()) + y * width;
+        applyHorizontalPredictor(row, width, 1);
+      }
+      return Deflater().encode(differences);
+    };
+    static const auto plain = makeStripImage("deflate_gray16", width, height, 1, 16, 16, 8,
+      data, [](std::span<const std::byte> rows) { return Deflater().encode(rows); });
+    static const auto predicted = makeStripImage("deflate_gray16_predictor", width, height, 1, 16, 16, 8,
+      data, encode, { tiffbuilder::shorts(Tag::Predictor, { 2 }) });
+
+    suite.add("predictor/gray16/undo", data.size(), [data]() mutable {
+      undoPredictor(2, data, width, height, width * 2, 1, 16, true);
+    });
+    addLoadCases(suite, "deflate/gray16", plain);
+    addLoadCases(suite, "deflate/gray16_predictor", predicted);
+  }
+
+  void addFaxCases(bench::Suite& suite) {
+    // corpus of fax pages: A4 at 204x196 dpi, the fine resolution of fax
+    constexpr int width = 1728;
+    constexpr int height = 2292;
+    constexpr int pages = 8;
+    constexpr size_t pageBytes = size_t(width) * height / 8;
+    struct Scheme { const char* name; int compression; uint32_t options; };
+    static const Scheme schemes[] = {
+      { "g3_1d", 3, 0 },
+      { "g3_2d", 3, FaxDecoder::TwoDimensional },
+      { "g4", 4, 0 },
+    };
+    static std::vector<std::vector<StripImage>> corpora;
+    for (const auto& scheme : schemes) {
+      auto& corpus = corpora.emplace_back();
+      for (int page = 0; page < pages; ++page) {
+        corpus.push_back(makeStripImage(std::string("fax_") + scheme.name + "_" + std::to_string(page),
+          width, height, 1, 1, height, scheme.compression,
+          makeDocument(width, height, 1, page),
+          [&](std::span<const std::byte> rows) {
+            return FaxEncoder(scheme.compression, width, scheme.options).encode(rows);
+          }, scheme.compression == 3
+            ? std::vector{ tiffbuilder::longs(Tag::T4Options, { scheme.options }) }
+            : std::vector<tiffbuilder::Field>{}));
+      }
+    }
+
+    for (size_t i = 0; i < corpora.size(); ++i) {
+      const auto& scheme = schemes[i];
+      const auto& corpus = corpora[i];
+      const std::string name = std::string("fax/") + scheme.name;
+      suite.add(name + "/decode", pageBytes * pages, [&corpus, &scheme]() {
+        std::vector<std::byte> out(corpus.front().stride * height);
+        for (const auto& page : corpus) {
+          FaxDecoder(page.strips.front(), scheme.compression, width, scheme.options).decode(out);
+        }
+      }, pages);
+      suite.add(name + "/load/tiffcraft", pageBytes * pages, [&corpus]() {
+        for (const auto& page : corpus) {
+          TiffExporterGray<uint8_t> exporter;
+          load(page.path, std::ref(exporter));
+        }
+      }, pages);
+#ifdef TIFFCRAFT_BENCH_LIBTIFF
+      suite.add(name + "/load/libtiff", pageBytes * pages, [&corpus]() {
+        for (const auto& page : corpus) {
+          TIFF* tif = TIFFOpen(page.path.c_str(), "r");
+          if (!tif) {
+            throw std::runtime_error("libtiff failed to open " + page.path);
+          }
+          std::vector<std::byte> pixels(TIFFStripSize(tif));
+          TIFFReadEncodedStrip(tif, 0, pixels.data(), -1);
+          TIFFClose(tif);
+        }
+      }, pages);
+#endif
+    }
+  }
+
+#ifdef TIFFCRAFT_USE_LIBJPEG
+  // Encodes 8-bit rows as an abbreviated JPEG stream, without the tables,
+  // which are returned in `tables` as stored in the JPEGTables tag.
+  std::vector<std::byte> encodeJpeg(std::span<const std::byte> rows, int width,
+    int channels, std::vector<std::byte>& tables)
+  {
+    jpeg_compress_struct cinfo;
+    jpeg_error_mgr error;
+    cinfo.err = jpeg_std_error(&error);
+    jpeg_create_compress(&cinfo);
+    cinfo.image_width = width;
+    cinfo.image_height = static_cast<JDIMENSION>(rows.size() / (size_t(width) * channels));
+    cinfo.input_components = channels;
+    cinfo.in_color_space = (channels == 1) ? JCS_GRAYSCALE : JCS_RGB;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, 75, TRUE);
+
+    unsigned char* buffer = nullptr;
+    unsigned long size = 0;
+    auto takeBuffer = [&]() {
+      std::vector<std::byte> bytes(size);
+      std::memcpy(bytes.data(), buffer, size);
+      std::free(buffer);
+      buffer = nullptr;
+      size = 0;
+      return bytes;
+    };
+    jpeg_mem_dest(&cinfo, &buffer, &size);
+    jpeg_write_tables(&cinfo);
+    tables = takeBuffer();
+    jpeg_mem_dest(&cinfo, &buffer, &size);
+    jpeg_start_compress(&cinfo, FALSE);
+    while (cinfo.next_scanline < cinfo.image_height) {
+      JSAMPROW row = reinterpret_cast<JSAMPROW>(const_cast<std::byte*>(rows.data()))
+        + size_t(cinfo.next_scanline) * width * channels;
+      jpeg_write_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+    return takeBuffer();
+  }
+
+  void addJpegCases(bench::Suite& suite) {
+    constexpr int width = 2048;
+    constexpr int height = 2048;
+    static std::vector<StripImage> images;
+    for (int channels : { 1, 3 }) {
+      // the tables only depend on the encoder settings
+      const auto data = makeImage8(width, height, channels);
+      std::vector<std::byte> tables;
+      encodeJpeg(std::span(data).first(size_t(width) * channels), width, channels, tables);
+      // color images are YCbCr, as written by most TIFF writers
+      const std::vector<tiffbuilder::Field> fields = {
+        tiffbuilder::undefined(Tag::JPEGTables, tables),
+        tiffbuilder::shorts(Tag::PhotometricInterpretation, { static_cast<uint16_t>(channels == 3 ? 6 : 1) }),
+      };
+      images.push_back(makeStripImage(channels == 3 ? "jpeg_ycbcr8" : "jpeg_gray8",
+        width, height, channels, 8, 16, 7, data,
+        [&](std::span<const std::byte> rows) {
+          std::vector<std::byte> unused;
+          return encodeJpeg(rows, width, channels, unused);
+        }, fields));
+    }
+
+    for (const auto& image : images) {
+      const std::string name = (image.channels == 3) ? "jpeg/ycbcr8" : "jpeg/gray8";
+      const size_t imageBytes = image.stride * image.height;
+      suite.add(name + "/load/tiffcraft", imageBytes, [&image]() {
+        TiffExporterAny exporter;
+        load(image.path, std::ref(exporter));
+      });
+#ifdef TIFFCRAFT_BENCH_LIBTIFF
+      suite.add(name + "/load/libtiff", imageBytes, [&image, imageBytes]() {
+        TIFF* tif = TIFFOpen(image.path.c_str(), "r");
+        if (!tif) {
+          throw std::runtime_error("libtiff failed to open " + image.path);
+        }
+        if (image.channels == 3) {
+          TIFFSetField(tif, TIFFTAG_JPEGCOLORMODE, JPEGCOLORMODE_RGB);
+        }
+        std::vector<std::byte> pixels(imageBytes);
+        const tmsize_t stripSize = TIFFStripSize(tif);
+        for (tstrip_t strip = 0; strip < TIFFNumberOfStrips(tif); ++strip) {
+          TIFFReadEncodedStrip(tif, strip, pixels.data() + strip * stripSize, -1);
+        }
+        TIFFClose(tif);
+      });
+#endif
+    }
+  }
+#endif
+
+  // Parsing of the header and of an IFD with many tags, and reading of the
+  // strips and tiles of an image, all from memory
+  void addParseCases(bench::Suite& suite) {
+    using namespace tiffbuilder;
+    constexpr int size = 512;
+    constexpr int extraTags = 200;
+    std::vector<Field> fields = {
+      longs(Tag::ImageWidth, { size }),
+      longs(Tag::ImageLength, { size }),
+      shorts(Tag::BitsPerSample, { 8 }),
+      shorts(Tag::Compression, { 1 }),
+      shorts(Tag::PhotometricInterpretation, { 1 }),
+      longs(Tag::RowsPerStrip, { size }),
+    };
+    // private tags, half of them with their values out of line
+    for (int i = 0; i < extraTags; ++i) {
+      const Tag tag = static_cast<Tag>(40000 + i);
+      fields.push_back(i % 2 ? longs(tag, std::vector<uint32_t>(8, i))
+        : shorts(tag, { static_cast<uint16_t>(i) }));
+    }
+    static const std::string file = makeTiff(fields,
+      { std::vector<std::byte>(size_t(size) * size) });
+    const size_t ifdBytes = file.size() - size_t(size) * size - 8;
+
+    constexpr int repeats = 1000;
+    suite.add("parse/header", 8 * repeats, []() {
+      bench::MemoryStream stream(file);
+      for (int i = 0; i < repeats; ++i) {
+        stream.seekg(0);
+        TiffImage::Header::read(stream);
+      }
+    }, repeats);
+    suite.add("parse/ifd/" + std::to_string(extraTags) + "_tags", ifdBytes * 10, []() {
+      bench::MemoryStream stream(file);
+      const auto header = TiffImage::Header::read(stream);
+      for (int i = 0; i < 10; ++i) {
+        stream.seekg(header.firstIFDOffset());
+        TiffImage::IFD::read(stream);
+      }
+    }, 10);
+
+    // 2k x 2k 8-bit image in 256 strips or 1024 tiles
+    constexpr int imageSize = 2048;
+    static const Image image = Image::make<uint8_t>(imageSize, imageSize, false,
+      makeImage8(imageSize, imageSize, 1));
+    static std::string strips, tiles;
+    {
+      std::ostringstream os;
+      save(os, image, WriteParams{ .rowsPerStrip = 8 });
+      strips = os.str();
+    }
+    {
+      std::ostringstream os;
+      save(os, image, WriteParams{ .tileWidth = 64, .tileLength = 64 });
+      tiles = os.str();
+    }
+    suite.add("read/strips", image.dataSize(), []() {
+      bench::MemoryStream stream(strips);
+      const auto tiff = TiffImage::read(stream);
+      TiffImage::readImageStrips(stream, tiff.ifds().front());
+    }, imageSize / 8);
+    suite.add("read/tiles", image.dataSize(), []() {
+      bench::MemoryStream stream(tiles);
+      const auto tiff = TiffImage::read(stream);
+      TiffImage::readImageTiles(stream, tiff.ifds().front());
+    }, (imageSize / 64) * (imageSize / 64));
+  }
+
+  // Uncompressed files in memory, kept for the lifetime of the cases
+  std::deque<std::string> exportFiles;
+
+  template <typename Exporter>
+  void addExportCase(bench::Suite& suite, const std::string& name,
+    std::string file, size_t bytes, size_t pixels)
+  {
+    const std::string& data = exportFiles.emplace_back(std::move(file));
+    suite.addPixels("export/" + name, bytes, pixels, [&data]() {
+      bench::MemoryStream stream(data);
+      Exporter exporter;
+      load(stream, std::ref(exporter));
+    });
+  }
+
+  // Every exporter, across bit depths, planar configurations, byte orders,
+  // and strips or tiles. Files are uncompressed to measure the export alone.
+  void addExportCases(bench::Suite& suite) {
+    constexpr int size = 1024;
+    constexpr size_t pixels = size_t(size) * size;
+    std::mt19937 rng(42);
+    auto randomImage = [&]<typename T, int N>(bool isPlanar) {
+      Image image = Image::make<T, N>(size, size, isPlanar);
+      for (auto& value : image.data) {
+        value = static_cast<std::byte>(rng());
+      }
+      return image;
+    };
+    auto saved = [](const Image& image, WriteParams params) {
+      std::ostringstream os;
+      save(os, image, params);
+      return os.str();
+    };
+    constexpr auto II = std::endian::little;
+    constexpr auto MM = std::endian::big;
+
+    const Image gray8 = randomImage.operator()<uint8_t, 1>(false);
+    const Image gray16 = randomImage.operator()<uint16_t, 1>(false);
+    const Image gray32 = randomImage.operator()<uint32_t, 1>(false);
+    addExportCase<TiffExporterGray<uint8_t>>(suite, "gray8/strips",
+      saved(gray8, {}), gray8.dataSize(), pixels);
+    addExportCase<TiffExporterGray<uint16_t, uint8_t>>(suite, "gray8/strips/to16",
+      saved(gray8, {}), gray8.dataSize(), pixels);
+    addExportCase<TiffExporterGray<uint8_t>>(suite, "gray8/tiles",
+      saved(gray8, { .tileWidth = 256, .tileLength = 256 }), gray8.dataSize(), pixels);
+    for (auto [order, orderName] : { std::pair{ II, "II" }, std::pair{ MM, "MM" } }) {
+      const std::string suffix = std::string("/") + orderName;
+      addExportCase<TiffExporterGray<uint16_t>>(suite, "gray16/strips" + suffix,
+        saved(gray16, { .byteOrder = order }), gray16.dataSize(), pixels);
+      addExportCase<TiffExporterGray<uint16_t>>(suite, "gray16/tiles" + suffix,
+        saved(gray16, { .byteOrder = order, .tileWidth = 256, .tileLength = 256 }),
+        gray16.dataSize(), pixels);
+      addExportCase<TiffExporterGray<uint32_t>>(suite, "gray32/strips" + suffix,
+        saved(gray32, { .byteOrder = order }), gray32.dataSize(), pixels);
+    }
+
+    // bilevel and 2 and 4-bit gray, and palette-color images
+    for (int bitsPerSample : { 1, 2, 4, 8 }) {
+      for (bool isPalette : { false, true }) {
+        if (isPalette && bitsPerSample < 4) {
+          continue;
+        }
+        using namespace tiffbuilder;
+        const size_t stride = (size_t(size) * bitsPerSample + 7) / 8;
+        std::vector<std::vector<std::byte>> strips;
+        for (int y = 0; y < size; y += 64) {
+          auto& strip = strips.emplace_back(stride * 64);
+          for (auto& value : strip) {
+            value = static_cast<std::byte>(rng());
+          }
+        }
+        std::vector<Field> fields = {
+          longs(Tag::ImageWidth, { size }),
+          longs(Tag::ImageLength, { size }),
+          shorts(Tag::BitsPerSample, { static_cast<uint16_t>(bitsPerSample) }),
+          shorts(Tag::Compression, { 1 }),
+          shorts(Tag::PhotometricInterpretation, { static_cast<uint16_t>(isPalette ? 3 : 1) }),
+          longs(Tag::RowsPerStrip, { 64 }),
+        };
+        const std::string name = std::to_string(bitsPerSample) + "/strips";
+        if (isPalette) {
+          std::vector<uint16_t> colorMap(3 << bitsPerSample);
+          for (auto& value : colorMap) {
+            value = static_cast<uint16_t>(rng());
+          }
+          fields.push_back(shorts(Tag::ColorMap, colorMap));
+          addExportCase<TiffExporterPalette<uint8_t>>(suite, "palette" + name,
+            makeTiff(fields, strips), stride * size, pixels);
+          addExportCase<TiffExporterPalette<uint16_t>>(suite, "palette" + name + "/to16",
+            makeTiff(fields, strips), stride * size, pixels);
+        } else if (bitsPerSample < 8) {
+          addExportCase<TiffExporterGray<uint8_t>>(suite, "gray" + name,
+            makeTiff(fields, strips), stride * size, pixels);
+        }
+      }
+    }
+
+    for (bool isPlanar : { false, true }) {
+      const std::string layout = isPlanar ? "/planar" : "/chunky";
+      const Image rgb8 = randomImage.operator()<uint8_t, 3>(isPlanar);
+      const Image rgb16 = randomImage.operator()<uint16_t, 3>(isPlanar);
+      addExportCase<TiffExporterRgb<uint8_t>>(suite, "rgb8" + layout,
+        saved(rgb8, { .isPlanar = isPlanar }), rgb8.dataSize(), pixels);
+      addExportCase<TiffExporterRgb<uint16_t, uint8_t>>(suite, "rgb8" + layout + "/to16",
+        saved(rgb8, { .isPlanar = isPlanar }), rgb8.dataSize(), pixels);
+      addExportCase<TiffExporterAny>(suite, "rgb8" + layout + "/any",
+        saved(rgb8, { .isPlanar = isPlanar }), rgb8.dataSize(), pixels);
+      for (auto [order, orderName] : { std::pair{ II, "II" }, std::pair{ MM, "MM" } }) {
+        addExportCase<TiffExporterRgb<uint16_t>>(suite, "rgb16" + layout + "/" + orderName,
+          saved(rgb16, { .byteOrder = order, .isPlanar = isPlanar }), rgb16.dataSize(), pixels);
+      }
+    }
+  }
+
+  // Files of the synthetic corpus, made by tiffGenerator.hpp, loaded from
+  // memory with TiffExporterAny
+  void addCorpusCases(bench::Suite& suite) {
+    using namespace tiffgenerator;
+    auto add = [&](const std::string& name, Params params) {
+      std::ostringstream os;
+      generate(os, params);
+      const size_t pixels = size_t(params.width) * params.height;
+      const size_t bytes = pixels * params.samplesPerPixel * params.bitsPerSample / 8
+        * params.pages;
+      const std::string& data = exportFiles.emplace_back(os.str());
+      suite.addPixels("corpus/" + name, bytes, pixels * params.pages, [&data]() {
+        bench::MemoryStream stream(data);
+        TiffExporterAny exporter;
+        load(stream, std::ref(exporter));
+      });
+    };
+    add("gray16/strips/II", { .width = 2048, .height = 2048, .bitsPerSample = 16 });
+    add("gray16/tiles/MM", { .width = 2048, .height = 2048, .bitsPerSample = 16,
+      .tileWidth = 256, .tileLength = 256, .byteOrder = std::endian::big });
+    add("rgb8/strips", { .width = 2048, .height = 2048, .samplesPerPixel = 3,
+      .rowsPerStrip = 16 });
+    add("rgb16/planar/tiles", { .width = 1024, .height = 1024, .bitsPerSample = 16,
+      .samplesPerPixel = 3, .isPlanar = true, .tileWidth = 128, .tileLength = 128 });
+    add("gray8/pages", { .width = 256, .height = 256, .pages = 64 });
+  }
+
+  // Writes an 8k x 8k 16-bit image in 256 x 256 tiles, compressed with
+  // horizontal differencing, with one thread and with all hardware threads
+  void addWriteCases(bench::Suite& suite) {
+    constexpr int size = 8192;
+    constexpr int tileSize = 256;
+    static const Image image = Image::make<uint16_t>(size, size, false, makeImage16(size, size));
+    static const std::string path =
+      (std::filesystem::temp_directory_path() / "tiffcraft_bench_write.tif").string();
+
+    std::vector<std::pair<std::string, int>> compressions = { { "lzw", 5 }, { "deflate", 8 } };
+#ifdef TIFFCRAFT_USE_ZSTD
+    compressions.push_back({ "zstd", 50000 });
+#endif
+    const int hardwareThreads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<int> threadCounts = { 1 };
+    if (hardwareThreads > 1) {
+      threadCounts.push_back(hardwareThreads);
+    }
+
+    suite.add("write/gray16/none/tiffcraft", image.dataSize(), []() {
+      save(path, image);
+    });
+    for (const auto& [name, compression] : compressions) {
+      for (int threads : threadCounts) {
+        WriteParams params;
+        params.tileWidth = tileSize;
+        params.tileLength = tileSize;
+        params.compression = compression;
+        params.predictor = 2;
+        params.threads = threads;
+        suite.add("write/gray16/" + name + "/tiffcraft/threads=" + std::to_string(threads),
+          image.dataSize(), [params]() { save(path, image, params); });
+      }
+#ifdef TIFFCRAFT_BENCH_LIBTIFF
+      suite.add("write/gray16/" + name + "/libtiff", image.dataSize(), [compression]() {
+        TIFF* tif = TIFFOpen(path.c_str(), "w");
+        if (!tif) {
+          throw std::runtime_error("libtiff failed to create " + path);
+        }
+        TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, size);
+        TIFFSetField(tif, TIFFTAG_IMAGELENGTH, size);
+        TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 16);
+        TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 1);
+        TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+        TIFFSetField(tif, TIFFTAG_COMPRESSION, compression);
+        TIFFSetField(tif, TIFFTAG_PREDICTOR, PREDICTOR_HORIZONTAL);
+        TIFFSetField(tif, TIFFTAG_TILEWIDTH, tileSize);
+        TIFFSetField(tif, TIFFTAG_TILELENGTH, tileSize);
+        std::vector<uint16_t> tile(tileSize * tileSize);
+        for (int y = 0; y < size; y += tileSize) {
+          for (int x = 0; x < size; x += tileSize) {
+            for (int row = 0; row < tileSize; ++row) {
+              std::memcpy(&tile[row * tileSize],
+                image.dataPtr<uint16_t>() + size_t(y + row) * size + x, tileSize * 2);
+            }
+            TIFFWriteTile(tif, tile.data(), x, y, 0, 0);
+          }
+        }
+        TIFFClose(tif);
+      });
+#endif
+    }
+  }
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  std::vector<std::string> filters;
+  std::string jsonFile;
+  double minSeconds = 0.5;
+  bool isMemory = false;
+  std::string baselineFile;
+  bool isCheck = false;
+  double tolerance = 0.25;
+  bool isAllocationsOnly = false;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--json" && i + 1 < argc) {
+      jsonFile = argv[++i];
+    } else if (arg == "--min-time" && i + 1 < argc) {
+      minSeconds = std::stod(argv[++i]);
+    } else if (arg == "--memory") {
+      isMemory = true;
+    } else if ((arg == "--write-baseline" || arg == "--check") && i + 1 < argc) {
+      baselineFile = argv[++i];
+      isCheck = arg == "--check";
+    } else if (arg == "--tolerance" && i + 1 < argc) {
+      tolerance = std::stod(argv[++i]);
+    } else if (arg == "--allocations") {
+      isAllocationsOnly = true;
+    } else if (arg.starts_with("--")) {
+      std::cerr << "Usage: " << argv[0]
+        << " [--json file] [--min-time seconds] [--memory] [filter...]\n"
+        << "       " << argv[0] << " --write-baseline file [--min-time seconds] [filter...]\n"
+        << "       " << argv[0] << " --check file [--min-time seconds] [--tolerance t] [--allocations]\n";
+      return 1;
+    } else {
+      filters.push_back(arg);
+    }
+  }
+
+  // cases whose name contains one of the filters, or all if there are none
+  bench::Suite::Selector isSelected = [&filters](const std::string& name) {
+    return filters.empty() || std::any_of(filters.begin(), filters.end(),
+      [&](const std::string& filter) { return name.find(filter) != std::string::npos; });
+  };
+
+  bench::Suite suite;
+  addParseCases(suite);
+  addExportCases(suite);
+  addCorpusCases(suite);
+  if (!baselineFile.empty()) {
+    // speed and allocations of the cases of the regression test
+    std::vector<bench::Baseline> baselines;
+    if (isCheck) {
+      std::ifstream file(baselineFile);
+      if (!file) {
+        std::cerr << "Failed to open " << baselineFile << "\n";
+        return 1;
+      }
+      baselines = bench::readJson(file);
+      if (isAllocationsOnly) {
+        minSeconds = 0;
+        for (auto& baseline : baselines) {
+          baseline.bytesPerSecond = 0; // not compared
+        }
+      }
+      isSelected = [&baselines](const std::string& name) {
+        return std::any_of(baselines.begin(), baselines.end(),
+          [&](const bench::Baseline& baseline) { return baseline.name == name; });
+      };
+    }
+    auto results = suite.run(isSelected, minSeconds);
+    const auto memory = suite.measureMemory(isSelected);
+    for (size_t i = 0; i < results.size(); ++i) {
+      results[i].hasMemory = true;
+      results[i].allocations = memory[i].allocations;
+      results[i].peakBytes = memory[i].peakBytes;
+    }
+    if (isCheck) {
+      return bench::checkBaseline(baselines, results, tolerance, 0.1, std::cout) ? 0 : 1;
+    }
+    std::ofstream json(baselineFile);
+    bench::writeJson(json, results);
+    if (!json) {
+      std::cerr << "Failed to write " << baselineFile << "\n";
+      return 1;
+    }
+    return 0;
+  }
+  addLzwCases(suite);
+  addDeflateCases(suite);
+#ifdef TIFFCRAFT_USE_ZSTD
+  addZstdCases(suite);
+#endif
+  addUncompressedCases(suite);
+  addPackBitsCases(suite);
+  addPredictorCases(suite);
+  addFaxCases(suite);
+#ifdef TIFFCRAFT_USE_LIBJPEG
+  addJpegCases(suite);
+#endif
+  addWriteCases(suite);
+  const auto results = isMemory ? suite.measureMemory(isSelected)
+    : suite.run(isSelected, minSeconds);
+  if (!jsonFile.empty()) {
+    std::ofstream json(jsonFile);
+    bench::writeJson(json, results);
+    if (!json) {
+      std::cerr << "Failed to write " << jsonFile << "\n";
+      return 1;
+    }
+  }
+
+  return 0;
+}
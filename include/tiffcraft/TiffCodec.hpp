@@ -0,0 +1,513 @@
+// BSD 2-Clause License
+// Copyright (c) 2025 Daniel Moreno
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS”
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+// ---------------------------------------------------------------------------
+//
+// TiffCodec.hpp
+// =============
+// This file connects the compression codecs to the strip and tile pipeline.
+// Strips and tiles are decoded one at a time, right before their pixels are
+// copied, into a buffer owned by the calling thread. The buffer is reused for
+// all the following strips and tiles, so no decoded copy of the whole image
+// is ever kept in memory. Compressed images are decoded by several threads,
+// each one handling a subset of the strips or tiles. The threads belong to a
+// pool that lives as long as the program, so their buffers and codecs are
+// reused from one load to the next.
+//
+// Codecs are looked up in the codec registry by their Compression tag value.
+// The built-in codecs are registered when the registry is created, and
+// applications can register their own, or replace the built-in ones, at any
+// time. Each thread creates its own instance of a codec the first time it
+// needs it, and reuses it afterwards. The exporters decode CCITT, JPEG, and
+// PackBits data row by row, or straight into the image, when the built-in
+// codec is the one registered for the Compression value.
+//
+
+#pragma once
+
+#include "TiffLzw.hpp"
+#include "TiffDeflate.hpp"
+#include "TiffPackBits.hpp"
+#include "TiffPredictor.hpp"
+#include "TiffFax.hpp"
+#include "TiffJpeg.hpp"
+#include "TiffZstd.hpp"
+
+#include <exception>
+#include <stdexcept>
+#include <algorithm>
+#include <cstdint>
+#include <thread>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <unordered_map>
+#include <memory>
+#include <span>
+#include <type_traits>
+
+namespace TiffCraft {
+
+  // Layout of the strip or tile being decoded, for codecs that need more than
+  // the encoded data
+  struct CodecParams
+  {
+    int compression = 1;    // Compression tag value
+    int width = 0;          // Pixels per encoded row
+    int height = 0;         // Rows
+    int channels = 1;       // Samples per pixel in the strip or tile
+    int bitsPerSample = 8;
+    uint32_t faxOptions = 0; // T4Options or T6Options
+    int fillOrder = 1;
+    int photometric = 1;
+    std::span<const std::byte> jpegTables; // JPEGTables, owned by the IFD
+  };
+
+  // Decoder of whole strips or tiles of one compression scheme
+  class Codec
+  {
+  public:
+    virtual ~Codec() = default;
+
+    // Sets the layout of the strip or tile decoded by the next `decode()`
+    virtual void setParams(const CodecParams&) {}
+
+    // Decodes `in` into `out` and returns the number of bytes written, which
+    // is less than `out.size()` if the data is shorter than expected.
+    virtual size_t decode(std::span<const std::byte> in, std::span<std::byte> out) = 0;
+  };
+
+  // Codec that forwards to a decoder class with the same `decode()` function
+  template <typename Decoder>
+  class CodecAdapter final : public Codec
+  {
+  public:
+    size_t decode(std::span<const std::byte> in, std::span<std::byte> out) override
+    {
+      return decoder_.decode(in, out);
+    }
+
+  private:
+    Decoder decoder_;
+  };
+
+  // PackBits codec, which the exporters also use to decode one row at a time
+  using PackBitsCodec = CodecAdapter<PackBitsDecoder>;
+
+  // CCITT codec for Compression=2, 3 or 4. Rows are decoded as packed 1-bit
+  // samples; the exporters use `FaxDecoder` directly to fill runs of pixels.
+  class FaxCodec final : public Codec
+  {
+  public:
+    void setParams(const CodecParams& params) override { params_ = params; }
+
+    size_t decode(std::span<const std::byte> in, std::span<std::byte> out) override
+    {
+      FaxDecoder decoder(in, params_.compression, params_.width,
+        params_.faxOptions, params_.fillOrder);
+      const size_t stride = (size_t(params_.width) + 7) / 8;
+      return decoder.decode(out.first(std::min(out.size(), stride * params_.height)));
+    }
+
+  private:
+    CodecParams params_;
+  };
+
+#ifdef TIFFCRAFT_USE_LIBJPEG
+  // JPEG codec, which keeps the tables of the last image it decoded. Rows are
+  // decoded as 8-bit samples; the exporters use `decoder()` directly to
+  // decode into the image when possible.
+  class JpegCodec final : public Codec
+  {
+  public:
+    void setParams(const CodecParams& params) override
+    {
+      params_ = params;
+      decoder_.setTables(params.jpegTables);
+    }
+
+    size_t decode(std::span<const std::byte> in, std::span<std::byte> out) override
+    {
+      if (params_.bitsPerSample != 8) {
+        throw std::runtime_error("JPEG compression with other than 8 bits per sample");
+      }
+      const size_t stride = size_t(params_.width) * params_.channels;
+      rows_.resize(std::min<size_t>(params_.height, out.size() / stride));
+      for (size_t y = 0; y < rows_.size(); ++y) {
+        rows_[y] = out.data() + y * stride;
+      }
+      return stride * decoder_.decode(in, rows_, params_.width,
+        params_.channels, params_.photometric);
+    }
+
+    JpegDecoder& decoder() { return decoder_; }
+
+  private:
+    JpegDecoder decoder_;
+    CodecParams params_;
+    std::vector<std::byte*> rows_;
+  };
+#endif
+
+  class CodecRegistry;
+  inline CodecRegistry& codecRegistry();
+
+  // Codecs by Compression tag value; see `codecRegistry()`
+  class CodecRegistry
+  {
+  public:
+    using Factory = std::function<std::unique_ptr<Codec>()>;
+
+    // Registers the codec created by `factory` for a Compression tag value,
+    // replacing the previous one, if any. `usesPredictor` tells whether the
+    // Predictor tag applies to the decoded data.
+    void add(int compression, Factory factory, bool usesPredictor = true)
+    {
+      std::unique_lock lock(mutex_);
+      entries_[compression] = { std::move(factory), usesPredictor };
+      ++generation_;
+    }
+
+    // Registers a `Codec` class, or a decoder class wrapped by `CodecAdapter`
+    template <typename Decoder>
+    void add(int compression, bool usesPredictor = true)
+    {
+      if constexpr (std::is_base_of_v<Codec, Decoder>) {
+        add(compression, []() { return std::make_unique<Decoder>(); }, usesPredictor);
+      } else {
+        add(compression, []() { return std::make_unique<CodecAdapter<Decoder>>(); },
+          usesPredictor);
+      }
+    }
+
+    void remove(int compression)
+    {
+      std::unique_lock lock(mutex_);
+      entries_.erase(compression);
+      ++generation_;
+    }
+
+    bool contains(int compression) const
+    {
+      std::shared_lock lock(mutex_);
+      return entries_.contains(compression);
+    }
+
+    bool usesPredictor(int compression) const
+    {
+      std::shared_lock lock(mutex_);
+      auto it = entries_.find(compression);
+      return it != entries_.end() && it->second.usesPredictor;
+    }
+
+    // Codec instance of the calling thread
+    Codec& codec(int compression)
+    {
+      auto& cache = threadCache();
+      if (cache.generation != generation_) {
+        cache.codecs.clear(); // some codec was replaced or removed
+        cache.generation = generation_;
+      }
+      if (auto it = cache.codecs.find(compression); it != cache.codecs.end()) {
+        return *it->second;
+      }
+      Factory factory;
+      {
+        std::shared_lock lock(mutex_);
+        auto it = entries_.find(compression);
+        if (it == entries_.end()) {
+          throw std::runtime_error(
+            "Unsupported compression: " + std::to_string(compression));
+        }
+        factory = it->second.factory;
+      }
+      return *(cache.codecs[compression] = factory());
+    }
+
+  private:
+    struct Entry {
+      Factory factory;
+      bool usesPredictor = true;
+    };
+
+    struct ThreadCache {
+      uint64_t generation = 0;
+      std::unordered_map<int, std::unique_ptr<Codec>> codecs;
+    };
+
+    mutable std::shared_mutex mutex_;
+    std::unordered_map<int, Entry> entries_;
+    std::atomic<uint64_t> generation_ = 1;
+
+    friend CodecRegistry& codecRegistry();
+
+    // Built-in codecs
+    CodecRegistry()
+    {
+      add<FaxCodec>(2, false);
+      add<FaxCodec>(3, false);
+      add<FaxCodec>(4, false);
+      add<LzwDecoder>(5);
+#ifdef TIFFCRAFT_USE_LIBJPEG
+      add<JpegCodec>(7, false);
+#endif
+      add<DeflateDecoder>(8);
+      add<DeflateDecoder>(32946);
+      add<PackBitsCodec>(32773, false);
+#ifdef TIFFCRAFT_USE_ZSTD
+      add<ZstdDecoder>(50000);
+#endif
+    }
+
+    static ThreadCache& threadCache()
+    {
+      thread_local ThreadCache cache;
+      return cache;
+    }
+  };
+
+  // Registry used by the exporters
+  inline CodecRegistry& codecRegistry()
+  {
+    static CodecRegistry registry;
+    return registry;
+  }
+
+  // Registers a codec during static initialization, e.g.
+  //   static const TiffCraft::CodecRegistration<MyDecoder> myCodec(65000);
+  template <typename Decoder>
+  struct CodecRegistration
+  {
+    explicit CodecRegistration(int compression, bool usesPredictor = true)
+    {
+      codecRegistry().add<Decoder>(compression, usesPredictor);
+    }
+  };
+
+  // TIFF Compression tag values
+  // ===========================
+  // 1 = No compression
+  // 2 = CCITT modified Huffman
+  // 3 = CCITT Group 3 fax
+  // 4 = CCITT Group 4 fax
+  // 5 = LZW
+  // 7 = JPEG (when built with libjpeg)
+  // 8 = Deflate
+  // 32773 = PackBits
+  // 32946 = Deflate (obsolete Adobe code)
+  // 50000 = Zstandard (when built with libzstd)
+  // Other values are supported when a codec is registered for them.
+  inline bool isCompressionSupported(int compression)
+  {
+    return compression == 1 || codecRegistry().contains(compression);
+  }
+
+  // Whether the compression is one of the CCITT bilevel schemes, the only
+  // ones that support FillOrder=2
+  inline bool isFaxCompression(int compression)
+  {
+    return compression >= 2 && compression <= 4;
+  }
+
+  // Whether the Predictor tag applies to data with the given compression
+  inline bool isPredictorSupported(int compression)
+  {
+    return codecRegistry().usesPredictor(compression);
+  }
+
+  // Buffer used to decode strips and tiles in the calling thread
+  inline std::vector<std::byte>& decodeBuffer()
+  {
+    thread_local std::vector<std::byte> buffer;
+    return buffer;
+  }
+
+  // Decodes one strip or tile. Uncompressed data is returned as is. Otherwise,
+  // at most `decodedSize` bytes are decoded into the buffer of the calling
+  // thread, which stays valid until the next call from the same thread.
+  inline std::span<const std::byte> decodeRectangle(
+    int compression, std::span<const std::byte> in, size_t decodedSize,
+    const CodecParams& params = {})
+  {
+    if (compression == 1) {
+      return in;
+    }
+    auto& buffer = decodeBuffer();
+    buffer.resize(decodedSize);
+    Codec& codec = codecRegistry().codec(compression);
+    codec.setParams(params);
+    const size_t size = codec.decode(in, buffer);
+    return std::span<const std::byte>(buffer.data(), size);
+  }
+
+  // Number of threads used to decode compressed images: 0 (the default) means
+  // one thread per hardware thread, and 1 decodes in the calling thread.
+  inline std::atomic<int>& decodeThreads()
+  {
+    static std::atomic<int> threads = 0;
+    return threads;
+  }
+
+  // Threads that run the work of parallelFor(). They are started when first
+  // needed and live as long as the program, so that the codecs and buffers of
+  // each thread are reused by all the following loads.
+  class WorkerPool
+  {
+  public:
+    WorkerPool() = default;
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    ~WorkerPool()
+    {
+      {
+        std::lock_guard lock(mutex_);
+        isStopping_ = true;
+      }
+      wakeUp_.notify_all();
+      for (auto& thread : threads_) {
+        thread.join();
+      }
+    }
+
+    // Queues `copies` calls of `task`, starting threads until there are at
+    // least as many as copies
+    void post(size_t copies, const std::function<void()>& task)
+    {
+      {
+        std::lock_guard lock(mutex_);
+        while (threads_.size() < copies) {
+          threads_.emplace_back([this]() { run(); });
+        }
+        tasks_.insert(tasks_.end(), copies, task);
+      }
+      wakeUp_.notify_all();
+    }
+
+  private:
+    std::mutex mutex_;
+    std::condition_variable wakeUp_;
+    std::deque<std::function<void()>> tasks_;
+    std::vector<std::thread> threads_;
+    bool isStopping_ = false;
+
+    void run()
+    {
+      std::unique_lock lock(mutex_);
+      while (true) {
+        wakeUp_.wait(lock, [&]() { return isStopping_ || !tasks_.empty(); });
+        if (tasks_.empty()) {
+          return; // stopping
+        }
+        auto task = std::move(tasks_.front());
+        tasks_.pop_front();
+        lock.unlock();
+        task();
+        lock.lock();
+      }
+    }
+  };
+
+  // Pool used by parallelFor()
+  inline WorkerPool& workerPool()
+  {
+    static WorkerPool pool;
+    return pool;
+  }
+
+  // Calls `f(i)` for every `i` in [0, count), distributing the calls among up
+  // to `decodeThreads()` threads: the calling thread and those of
+  // `workerPool()`. The first exception thrown is rethrown.
+  template <typename F>
+  void parallelFor(size_t count, F&& f)
+  {
+    size_t threads = decodeThreads() > 0 ? decodeThreads().load()
+      : std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min(threads, count);
+    if (threads <= 1) {
+      for (size_t i = 0; i < count; ++i) {
+        f(i);
+      }
+      return;
+    }
+
+    std::atomic<size_t> next = 0;
+    std::exception_ptr error;
+    std::mutex errorMutex;
+    auto worker = [&]() {
+      try {
+        for (size_t i = next++; i < count; i = next++) {
+          f(i);
+        }
+      } catch (...) {
+        std::lock_guard lock(errorMutex);
+        if (!error) {
+          error = std::current_exception();
+        }
+        next = count; // stop the other threads
+      }
+    };
+
+    // Tasks of the pool that start after the calling thread is done do
+    // nothing, so that a busy pool never makes the caller wait for them
+    struct Job {
+      std::mutex mutex;
+      std::condition_variable finished;
+      size_t running = 0;
+      bool isClosed = false;
+    };
+    auto job = std::make_shared<Job>();
+    const std::function<void()> task = [job, work = &worker]() {
+      {
+        std::lock_guard lock(job->mutex);
+        if (job->isClosed) {
+          return;
+        }
+        ++job->running;
+      }
+      (*work)();
+      {
+        std::lock_guard lock(job->mutex);
+        --job->running;
+      }
+      job->finished.notify_all();
+    };
+    workerPool().post(threads - 1, task);
+    worker();
+    {
+      std::unique_lock lock(job->mutex);
+      job->isClosed = true;
+      job->finished.wait(lock, [&]() { return job->running == 0; });
+    }
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+
+} // namespace TiffCraft
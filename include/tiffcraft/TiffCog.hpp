@@ -0,0 +1,352 @@
+// BSD 2-Clause License
+// Copyright (c) 2025 Daniel Moreno
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS”
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+// ---------------------------------------------------------------------------
+//
+// TiffCog.hpp
+// ===========
+// This file contains the CogWriter class, which writes a tiled image with
+// reduced-resolution overviews in the layout of Cloud Optimized GeoTIFF
+// files: the IFDs of all the levels come first, right after the header, and
+// the tiles follow, from the coarsest level to the full resolution one. A
+// reader can then open any level with one or two small ranged reads.
+//
+// Each overview is half the width and height of the previous level, and is
+// computed with a 2 x 2 box filter as the rows arrive, so the image is never
+// held in memory. The tiles of each level are encoded by a TiffWriter into a
+// temporary file. When the last row has been written, the final file is
+// assembled from the temporary files in a single forward pass.
+//
+
+#pragma once
+
+#include "TiffWriter.hpp"
+
+#include <filesystem>
+#include <stdexcept>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <thread>
+#include <string>
+#include <vector>
+#include <memory>
+#include <span>
+#include <type_traits>
+
+namespace TiffCraft {
+
+  struct CogParams {
+    int overviews = -1;                    // -1 for overviews down to a single tile
+    std::filesystem::path tempDirectory{}; // empty for the system temporary directory
+  };
+
+  class CogWriter
+  {
+  public:
+    // Starts writing an image of the given size and sample layout. Tiles are
+    // 256 x 256 unless `params` sets another size.
+    CogWriter(std::ostream& stream, int width, int height, int channels,
+      int bitDepth, const WriteParams& params = {}, const CogParams& cogParams = {})
+      : stream_(stream), params_(params), channels_(channels), bitDepth_(bitDepth)
+    {
+      if (params_.tileWidth == 0 && params_.tileLength == 0) {
+        params_.tileWidth = 256;
+        params_.tileLength = 256;
+      }
+      average_ = averageFunction(bitDepth, params.sampleFormat);
+
+      int overviews = cogParams.overviews;
+      if (overviews < 0) {
+        overviews = 0;
+        for (int w = width, h = height; w > params_.tileWidth || h > params_.tileLength; ++overviews) {
+          w = (w + 1) / 2;
+          h = (h + 1) / 2;
+        }
+      }
+
+      const std::filesystem::path directory = cogParams.tempDirectory.empty()
+        ? std::filesystem::temp_directory_path() : cogParams.tempDirectory;
+      const std::string prefix = "tiffcraft_cog_" + std::to_string(std::random_device{}()) + "_";
+      const int threads = params.threads > 0 ? params.threads
+        : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+
+      for (int level = 0; level <= overviews; ++level) {
+        auto& l = levels_.emplace_back();
+        l.width = level == 0 ? width : (levels_[level - 1].width + 1) / 2;
+        l.height = level == 0 ? height : (levels_[level - 1].height + 1) / 2;
+        l.path = directory / (prefix + std::to_string(level) + ".tif");
+        l.file = std::make_unique<std::fstream>(l.path,
+          std::ios::in | std::ios::out | std::ios::trunc | std::ios::binary);
+        if (!*l.file) {
+          throw std::runtime_error("Failed to create temporary file: " + l.path.string());
+        }
+        // each level gets threads in proportion to its number of pixels
+        WriteParams levelParams = params_;
+        levelParams.isBigTiff = true;
+        levelParams.threads = std::max(1, threads >> (2 * level));
+        l.writer = std::make_unique<TiffWriter>(*l.file, l.width, l.height,
+          channels, bitDepth, levelParams);
+        l.pending.resize(l.writer->rowBytes());
+      }
+    }
+
+    ~CogWriter()
+    {
+      for (auto& level : levels_) {
+        level.writer.reset();
+        level.file.reset();
+        std::error_code error;
+        std::filesystem::remove(level.path, error);
+      }
+    }
+
+    CogWriter(const CogWriter&) = delete;
+    CogWriter& operator=(const CogWriter&) = delete;
+
+    size_t rowBytes() const { return levels_.front().writer->rowBytes(); }
+
+    // Number of levels, including the full resolution one
+    size_t levels() const { return levels_.size(); }
+
+    // Writes whole rows of samples in host byte order, as TiffWriter does.
+    void writeRows(std::span<const std::byte> rows)
+    {
+      writeRows(0, rows);
+    }
+
+    // Writes the file. It is complete afterwards.
+    void finish()
+    {
+      std::vector<TiffImage::IFD> ifds;
+      for (auto& level : levels_) {
+        level.writer->finish();
+        level.file->seekg(0);
+        ifds.push_back(TiffImage::read(*level.file).ifds().front());
+      }
+
+      // layout: header, the IFDs of all the levels, and the tiles from the
+      // coarsest level to the finest
+      const bool isBigTiff = params_.isBigTiff;
+      const uint64_t headerBytes = isBigTiff ? 16 : 8;
+      std::vector<std::vector<TiffField>> fields(levels_.size());
+      std::vector<std::vector<uint64_t>> offsets(levels_.size());
+      std::vector<std::vector<uint64_t>> byteCounts(levels_.size());
+      std::vector<uint64_t> ifdOffsets;
+      uint64_t position = headerBytes;
+      for (size_t i = 0; i < levels_.size(); ++i) {
+        const auto& entries = ifds[i].entries();
+        const auto& offsetsEntry = ifds[i].getEntry(Tag::TileOffsets);
+        const auto& byteCountsEntry = ifds[i].getEntry(Tag::TileByteCounts);
+        copyVector<uint64_t>(offsetsEntry.type(), offsetsEntry.values(), offsetsEntry.count(), offsets[i]);
+        copyVector<uint64_t>(byteCountsEntry.type(), byteCountsEntry.values(), byteCountsEntry.count(), byteCounts[i]);
+        for (const auto& [tag, entry] : entries) {
+          if (tag != Tag::TileOffsets && tag != Tag::TileByteCounts) {
+            fields[i].push_back({ tag, entry.type(), entry.count(),
+              std::vector<std::byte>(entry.values(), entry.values() + entry.bytes()) });
+          }
+        }
+        if (i > 0) {
+          fields[i].push_back(TiffField::make(Tag::NewSubfileType, Type::LONG,
+            std::vector<uint32_t>{ 1 })); // reduced-resolution image
+        }
+        fields[i].push_back(offsetField(Tag::TileOffsets, std::vector<uint64_t>(offsets[i].size())));
+        fields[i].push_back(offsetField(Tag::TileByteCounts, byteCounts[i]));
+        std::sort(fields[i].begin(), fields[i].end(),
+          [](const TiffField& a, const TiffField& b) { return a.tag < b.tag; });
+        ifdOffsets.push_back(position);
+        position += TiffOutput::ifdBytes(fields[i], isBigTiff);
+      }
+      std::vector<std::vector<uint64_t>> newOffsets(levels_.size());
+      for (size_t i = levels_.size(); i-- > 0; ) {
+        for (uint64_t byteCount : byteCounts[i]) {
+          newOffsets[i].push_back(position);
+          position += byteCount;
+        }
+      }
+      if (!isBigTiff && position > UINT32_MAX) {
+        throw std::runtime_error("Image is too large for a classic TIFF file, use BigTIFF");
+      }
+
+      TiffOutput output(stream_, params_.byteOrder, isBigTiff, params_.bufferSize);
+      output.writeHeader(headerBytes);
+      for (size_t i = 0; i < levels_.size(); ++i) {
+        for (auto& field : fields[i]) {
+          if (field.tag == Tag::TileOffsets) {
+            field = offsetField(Tag::TileOffsets, newOffsets[i]);
+          }
+        }
+        output.writeIFD(std::move(fields[i]), i + 1 < levels_.size() ? ifdOffsets[i + 1] : 0);
+      }
+      std::vector<std::byte> tile;
+      for (size_t i = levels_.size(); i-- > 0; ) {
+        auto& file = *levels_[i].file;
+        for (size_t t = 0; t < offsets[i].size(); ++t) {
+          tile.resize(byteCounts[i][t]);
+          readAt(file, offsets[i][t], tile.data(), tile.size());
+          if (!file) {
+            throw std::runtime_error("Failed to read temporary file: " + levels_[i].path.string());
+          }
+          output.put(tile.data(), tile.size());
+        }
+      }
+      output.flush();
+      stream_.flush();
+      if (!stream_) {
+        throw std::runtime_error("Failed to write TIFF data");
+      }
+    }
+
+  private:
+    using AverageFunction = void (*)(const std::byte* row0, const std::byte* row1,
+      std::byte* out, size_t width, size_t channels);
+
+    struct Level {
+      int width = 0;
+      int height = 0;
+      std::filesystem::path path;
+      std::unique_ptr<std::fstream> file;
+      std::unique_ptr<TiffWriter> writer;
+      uint64_t rows = 0;               // rows written, in all planes
+      std::vector<std::byte> pending;  // first row of the next pair
+      std::vector<std::byte> reduced;  // row of the next level
+    };
+
+    std::ostream& stream_;
+    WriteParams params_;
+    int channels_;
+    int bitDepth_;
+    AverageFunction average_ = nullptr;
+    std::vector<Level> levels_;
+
+    TiffField offsetField(Tag tag, const std::vector<uint64_t>& values) const
+    {
+      if (params_.isBigTiff) {
+        return TiffField::make(tag, Type::LONG8, values);
+      }
+      return TiffField::make(tag, Type::LONG, std::vector<uint32_t>(values.begin(), values.end()));
+    }
+
+    // Writes rows to a level, and the pairs of rows reduced to the next one
+    void writeRows(size_t index, std::span<const std::byte> rows)
+    {
+      Level& level = levels_[index];
+      level.writer->writeRows(rows);
+      if (index + 1 == levels_.size()) {
+        return;
+      }
+      const size_t rowBytes = level.pending.size();
+      const size_t channels = params_.isPlanar ? 1 : channels_;
+      for (size_t offset = 0; offset < rows.size(); offset += rowBytes) {
+        const std::byte* row = rows.data() + offset;
+        const uint64_t y = level.rows++ % level.height;
+        const bool isLast = y + 1 == uint64_t(level.height);
+        if (y % 2 == 0 && !isLast) {
+          std::memcpy(level.pending.data(), row, rowBytes);
+          continue;
+        }
+        // the last row of an odd height is reduced on its own
+        const std::byte* first = (y % 2 == 0) ? row : level.pending.data();
+        level.reduced.resize(levels_[index + 1].pending.size());
+        average_(first, row, level.reduced.data(), level.width, channels);
+        writeRows(index + 1, level.reduced);
+      }
+    }
+
+    // Average of four samples, rounded to the nearest integer
+    template <typename T>
+    static T average(T a, T b, T c, T d)
+    {
+      if constexpr (std::is_floating_point_v<T>) {
+        return static_cast<T>((double(a) + b + c + d) * 0.25);
+      } else if constexpr (sizeof(T) <= 4) {
+        return static_cast<T>((int64_t(a) + b + c + d + 2) >> 2);
+      } else {
+        // 64-bit samples are averaged as unsigned, in two parts
+        constexpr uint64_t bias = std::is_signed_v<T> ? uint64_t(1) << 63 : 0;
+        const uint64_t w = uint64_t(a) ^ bias, x = uint64_t(b) ^ bias;
+        const uint64_t y = uint64_t(c) ^ bias, z = uint64_t(d) ^ bias;
+        const uint64_t sum = (w >> 2) + (x >> 2) + (y >> 2) + (z >> 2)
+          + (((w & 3) + (x & 3) + (y & 3) + (z & 3) + 2) >> 2);
+        return static_cast<T>(sum ^ bias);
+      }
+    }
+
+    // Reduces two rows of `width` pixels to one row of half the width. The
+    // last pixel of an odd width is averaged with itself.
+    template <typename T>
+    static void averageRows(const std::byte* row0, const std::byte* row1,
+      std::byte* out, size_t width, size_t channels)
+    {
+      const T* a = reinterpret_cast<const T*>(row0);
+      const T* b = reinterpret_cast<const T*>(row1);
+      T* dst = reinterpret_cast<T*>(out);
+      for (size_t x = 0; x < width; x += 2) {
+        const size_t left = x * channels;
+        const size_t right = std::min(x + 1, width - 1) * channels;
+        for (size_t c = 0; c < channels; ++c) {
+          *dst++ = average(a[left + c], a[right + c], b[left + c], b[right + c]);
+        }
+      }
+    }
+
+    static AverageFunction averageFunction(int bitDepth, int sampleFormat)
+    {
+      if (sampleFormat == 3) {
+        return bitDepth == 64 ? averageRows<double> : averageRows<float>;
+      }
+      const bool isSigned = sampleFormat == 2;
+      switch (bitDepth) {
+        case 8: return isSigned ? averageRows<int8_t> : averageRows<uint8_t>;
+        case 16: return isSigned ? averageRows<int16_t> : averageRows<uint16_t>;
+        case 32: return isSigned ? averageRows<int32_t> : averageRows<uint32_t>;
+        case 64: return isSigned ? averageRows<int64_t> : averageRows<uint64_t>;
+        default: throw FormatNotSupportedError("Writing " + std::to_string(bitDepth) + "-bit samples");
+      }
+    }
+  };
+
+  // Writes `image` with overviews in Cloud Optimized GeoTIFF layout.
+  inline void saveCog(std::ostream& stream, const Image& image,
+    const WriteParams& params = {}, const CogParams& cogParams = {})
+  {
+    CogWriter writer(stream, image.width, image.height, image.channels,
+      image.bitDepth, params, cogParams);
+    writeImageRows(writer, image, params.isPlanar);
+    writer.finish();
+  }
+
+  inline void saveCog(const std::string& filename, const Image& image,
+    const WriteParams& params = {}, const CogParams& cogParams = {})
+  {
+    std::ofstream file(filename, std::ios::binary);
+    if (!file) {
+      throw std::runtime_error("Failed to create TIFF file: " + filename);
+    }
+    saveCog(file, image, params, cogParams);
+  }
+
+} // namespace TiffCraft
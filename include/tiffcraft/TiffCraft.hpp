@@ -34,4 +34,12 @@
 #pragma once
 
 #include "TiffImage.hpp"
+#include "TiffCodec.hpp"
 #include "TiffExporter.hpp"
+#include "TiffWriter.hpp"
+#include "TiffCog.hpp"
+#include "TiffTileCache.hpp"
+#include "TiffStats.hpp"
+#include "TiffTrace.hpp"
+#include "TiffRecorder.hpp"
+#include "TiffIndex.hpp"
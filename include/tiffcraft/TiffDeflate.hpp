@@ -0,0 +1,1049 @@
+// BSD 2-Clause License
+// Copyright (c) 2025 Daniel Moreno
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS”
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+// ---------------------------------------------------------------------------
+//
+// TiffDeflate.hpp
+// ===============
+// This file contains the Deflate codec used by TIFF images with Compression=8
+// (Deflate) and Compression=32946 (the older Adobe-Deflate code). In both
+// cases each strip or tile is a zlib stream (RFC 1950 and RFC 1951).
+//
+// The built-in Inflater and Deflater have no dependencies. Defining
+// TIFFCRAFT_USE_LIBDEFLATE or TIFFCRAFT_USE_ZLIB (see the CMake options of the
+// same names) selects libdeflate or zlib as the DeflateDecoder and
+// DeflateEncoder instead.
+//
+
+#pragma once
+
+#include <stdexcept>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <array>
+#include <queue>
+#include <span>
+#include <bit>
+
+#ifdef TIFFCRAFT_USE_LIBDEFLATE
+# include <libdeflate.h>
+#endif
+#ifdef TIFFCRAFT_USE_ZLIB
+# include <zlib.h>
+#endif
+
+namespace TiffCraft {
+
+  namespace deflate {
+
+    // Length and distance codes (RFC 1951, section 3.2.5)
+    constexpr std::array<uint16_t, 29> LengthBase = {
+      3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+      35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    constexpr std::array<uint8_t, 29> LengthExtra = {
+      0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+      3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+    constexpr std::array<uint16_t, 30> DistBase = {
+      1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+      257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+      8193, 12289, 16385, 24577 };
+    constexpr std::array<uint8_t, 30> DistExtra = {
+      0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+      7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+    // Order of the code length code lengths in a dynamic block header
+    constexpr std::array<uint8_t, 19> CodeLengthOrder = {
+      16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+    constexpr uint32_t EndOfBlock = 256;
+    constexpr uint32_t MaxCodeBits = 15;
+    constexpr uint32_t WindowSize = 1 << 15;
+    constexpr uint32_t MinMatch = 3;
+    constexpr uint32_t MaxMatch = 258;
+
+    inline uint32_t reverseBits(uint32_t code, uint32_t bits) {
+      uint32_t result = 0;
+      for (uint32_t i = 0; i < bits; ++i) {
+        result = (result << 1) | (code & 1);
+        code >>= 1;
+      }
+      return result;
+    }
+
+    inline uint32_t adler32(std::span<const std::byte> data) {
+      uint32_t a = 1, b = 0;
+      const auto* p = reinterpret_cast<const uint8_t*>(data.data());
+      size_t n = data.size();
+      while (n > 0) {
+        const size_t block = std::min<size_t>(n, 5552); // no overflow
+        for (size_t i = 0; i < block; ++i) {
+          a += p[i];
+          b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+        p += block;
+        n -= block;
+      }
+      return (b << 16) | a;
+    }
+
+    inline void throwCorrupted() {
+      throw std::runtime_error("Corrupted Deflate data");
+    }
+
+  } // namespace deflate
+
+  // Built-in decoder of zlib streams
+  class Inflater
+  {
+  public:
+    static constexpr const char* name = "builtin";
+
+    Inflater()
+    {
+      std::array<uint8_t, 288 + 32> lengths;
+      std::fill(lengths.begin(), lengths.begin() + 144, uint8_t(8));
+      std::fill(lengths.begin() + 144, lengths.begin() + 256, uint8_t(9));
+      std::fill(lengths.begin() + 256, lengths.begin() + 280, uint8_t(7));
+      std::fill(lengths.begin() + 280, lengths.begin() + 288, uint8_t(8));
+      std::fill(lengths.begin() + 288, lengths.end(), uint8_t(5));
+      fixedLitLen_.build(lengths.data(), 288, LitLenTableBits);
+      fixedDist_.build(lengths.data() + 288, 32, DistTableBits);
+    }
+
+    // Decodes the zlib stream `in` into `out` and returns the number of bytes
+    // written. Decoding stops at the end of the stream or when the output is
+    // full, whichever happens first.
+    size_t decode(std::span<const std::byte> in, std::span<std::byte> out)
+    {
+      if (in.size() < 2) {
+        deflate::throwCorrupted();
+      }
+      const uint32_t cmf = std::to_integer<uint32_t>(in[0]);
+      const uint32_t flg = std::to_integer<uint32_t>(in[1]);
+      if ((cmf & 0x0F) != 8 || (cmf >> 4) > 7 || (cmf * 256 + flg) % 31 != 0) {
+        throw std::runtime_error("Invalid zlib header");
+      }
+      if (flg & 0x20) {
+        throw std::runtime_error("zlib preset dictionaries are not supported");
+      }
+
+      src_ = reinterpret_cast<const uint8_t*>(in.data()) + 2;
+      srcEnd_ = reinterpret_cast<const uint8_t*>(in.data()) + in.size();
+      bitBuffer_ = 0;
+      bitCount_ = 0;
+      padBytes_ = 0;
+
+      uint8_t* dst = reinterpret_cast<uint8_t*>(out.data());
+      const size_t dstSize = out.size();
+      size_t pos = 0;
+      bool isFinal = false;
+      while (!isFinal && pos < dstSize) {
+        refill();
+        isFinal = getBits(1) != 0;
+        switch (getBits(2)) {
+          case 0:
+            pos = copyStored(dst, pos, dstSize);
+            break;
+          case 1:
+            pos = inflateBlock(fixedLitLen_, fixedDist_, dst, pos, dstSize);
+            break;
+          case 2:
+            readDynamicTables();
+            pos = inflateBlock(litLen_, dist_, dst, pos, dstSize);
+            break;
+          default:
+            deflate::throwCorrupted();
+        }
+      }
+      return pos;
+    }
+
+  private:
+    static constexpr uint32_t LitLenTableBits = 10;
+    static constexpr uint32_t DistTableBits = 8;
+
+    // Huffman decoding table. The primary table is indexed by the next
+    // `tableBits` input bits; longer codes continue in a subtable. Entries
+    // hold the symbol (or subtable offset) in the upper 16 bits, a subtable
+    // flag, and the code length (or subtable bits) in the lowest byte. A zero
+    // entry is an invalid code.
+    struct HuffmanTable
+    {
+      static constexpr uint32_t SubtableFlag = 0x100;
+
+      std::vector<uint32_t> entries;
+      uint32_t tableBits = 1;
+
+      void build(const uint8_t* lengths, uint32_t count, uint32_t maxTableBits)
+      {
+        std::array<uint32_t, 16> lengthCount{};
+        for (uint32_t i = 0; i < count; ++i) {
+          ++lengthCount[lengths[i]];
+        }
+        lengthCount[0] = 0;
+        int left = 1;
+        uint32_t maxLength = 0;
+        for (uint32_t len = 1; len <= deflate::MaxCodeBits; ++len) {
+          left = (left << 1) - static_cast<int>(lengthCount[len]);
+          if (left < 0) {
+            deflate::throwCorrupted(); // over-subscribed code
+          }
+          if (lengthCount[len] > 0) {
+            maxLength = len;
+          }
+        }
+
+        tableBits = std::clamp(maxLength, 1u, maxTableBits);
+        const uint32_t subBits = maxLength > tableBits ? maxLength - tableBits : 0;
+        entries.assign(size_t(1) << tableBits, 0);
+
+        std::array<uint32_t, 16> nextCode{};
+        for (uint32_t len = 1, code = 0; len <= deflate::MaxCodeBits; ++len) {
+          code = (code + lengthCount[len - 1]) << 1;
+          nextCode[len] = code;
+        }
+        for (uint32_t symbol = 0; symbol < count; ++symbol) {
+          const uint32_t len = lengths[symbol];
+          if (len == 0) {
+            continue;
+          }
+          const uint32_t code = deflate::reverseBits(nextCode[len]++, len);
+          const uint32_t entry = (symbol << 16) | len;
+          if (len <= tableBits) {
+            for (uint32_t i = code; i < (1u << tableBits); i += 1u << len) {
+              entries[i] = entry;
+            }
+          } else {
+            const uint32_t prefix = code & ((1u << tableBits) - 1);
+            if (entries[prefix] == 0) {
+              const auto offset = static_cast<uint32_t>(entries.size());
+              entries[prefix] = (offset << 16) | SubtableFlag | subBits;
+              entries.resize(entries.size() + (size_t(1) << subBits), 0);
+            }
+            const uint32_t offset = entries[prefix] >> 16;
+            for (uint32_t i = code >> tableBits; i < (1u << subBits); i += 1u << (len - tableBits)) {
+              entries[offset + i] = entry;
+            }
+          }
+        }
+      }
+
+      uint32_t lookup(uint64_t bits) const
+      {
+        uint32_t entry = entries[bits & ((1u << tableBits) - 1)];
+        if (entry & SubtableFlag) {
+          const uint32_t subMask = (1u << (entry & 0xFF)) - 1;
+          entry = entries[(entry >> 16) + ((bits >> tableBits) & subMask)];
+        }
+        if (entry == 0) {
+          deflate::throwCorrupted();
+        }
+        return entry;
+      }
+    };
+
+    HuffmanTable fixedLitLen_;
+    HuffmanTable fixedDist_;
+    HuffmanTable litLen_;
+    HuffmanTable dist_;
+    HuffmanTable codeLengths_;
+
+    const uint8_t* src_ = nullptr;
+    const uint8_t* srcEnd_ = nullptr;
+    uint64_t bitBuffer_ = 0;
+    uint32_t bitCount_ = 0;
+    uint32_t padBytes_ = 0; // zero bytes read past the end of the input
+
+    // Fills the bit buffer with at least 56 bits, which is more than a
+    // literal/length code, a distance code, and their extra bits take.
+    void refill()
+    {
+      if (bitCount_ > 56) {
+        return;
+      }
+      if (srcEnd_ - src_ >= 8) {
+        uint64_t word;
+        if constexpr (std::endian::native == std::endian::little) {
+          std::memcpy(&word, src_, sizeof(word));
+        } else {
+          word = 0;
+          for (int i = 7; i >= 0; --i) {
+            word = (word << 8) | src_[i];
+          }
+        }
+        bitBuffer_ |= word << bitCount_;
+        src_ += (63 - bitCount_) >> 3;
+        bitCount_ |= 56;
+        return;
+      }
+      while (bitCount_ <= 56) {
+        if (src_ < srcEnd_) {
+          bitBuffer_ |= uint64_t(*src_++) << bitCount_;
+        } else if (++padBytes_ > 8) {
+          throw std::runtime_error("Unexpected end of Deflate data");
+        }
+        bitCount_ += 8;
+      }
+    }
+
+    uint32_t getBits(uint32_t count)
+    {
+      const auto bits = static_cast<uint32_t>(bitBuffer_ & ((uint64_t(1) << count) - 1));
+      bitBuffer_ >>= count;
+      bitCount_ -= count;
+      return bits;
+    }
+
+    uint32_t getSymbol(const HuffmanTable& table)
+    {
+      const uint32_t entry = table.lookup(bitBuffer_);
+      getBits(entry & 0xFF);
+      return entry >> 16;
+    }
+
+    size_t copyStored(uint8_t* dst, size_t pos, size_t dstSize)
+    {
+      // return the whole bytes left in the bit buffer to the input
+      getBits(bitCount_ & 7);
+      const uint32_t bufferedBytes = bitCount_ / 8;
+      if (bufferedBytes < padBytes_) {
+        throw std::runtime_error("Unexpected end of Deflate data");
+      }
+      src_ -= bufferedBytes - padBytes_;
+      bitBuffer_ = 0;
+      bitCount_ = 0;
+      padBytes_ = 0;
+
+      if (srcEnd_ - src_ < 4) {
+        throw std::runtime_error("Unexpected end of Deflate data");
+      }
+      const uint32_t length = src_[0] | (src_[1] << 8);
+      const uint32_t nlength = src_[2] | (src_[3] << 8);
+      if (length != (~nlength & 0xFFFF)) {
+        deflate::throwCorrupted();
+      }
+      src_ += 4;
+      if (static_cast<size_t>(srcEnd_ - src_) < length) {
+        throw std::runtime_error("Unexpected end of Deflate data");
+      }
+      const size_t count = std::min<size_t>(length, dstSize - pos);
+      std::memcpy(dst + pos, src_, count);
+      src_ += length;
+      return pos + count;
+    }
+
+    void readDynamicTables()
+    {
+      const uint32_t litLenCount = getBits(5) + 257;
+      const uint32_t distCount = getBits(5) + 1;
+      const uint32_t codeLengthCount = getBits(4) + 4;
+      if (litLenCount > 286 || distCount > 30) {
+        deflate::throwCorrupted();
+      }
+
+      std::array<uint8_t, 19> codeLengthLengths{};
+      for (uint32_t i = 0; i < codeLengthCount; ++i) {
+        refill();
+        codeLengthLengths[deflate::CodeLengthOrder[i]] = static_cast<uint8_t>(getBits(3));
+      }
+      codeLengths_.build(codeLengthLengths.data(), 19, 7);
+
+      std::array<uint8_t, 286 + 30> lengths{};
+      const uint32_t total = litLenCount + distCount;
+      for (uint32_t i = 0; i < total; ) {
+        refill();
+        const uint32_t symbol = getSymbol(codeLengths_);
+        if (symbol < 16) {
+          lengths[i++] = static_cast<uint8_t>(symbol);
+          continue;
+        }
+        uint8_t value = 0;
+        uint32_t repeat;
+        if (symbol == 16) {
+          if (i == 0) {
+            deflate::throwCorrupted();
+          }
+          value = lengths[i - 1];
+          repeat = 3 + getBits(2);
+        } else if (symbol == 17) {
+          repeat = 3 + getBits(3);
+        } else {
+          repeat = 11 + getBits(7);
+        }
+        if (i + repeat > total) {
+          deflate::throwCorrupted();
+        }
+        std::fill_n(lengths.begin() + i, repeat, value);
+        i += repeat;
+      }
+      if (lengths[deflate::EndOfBlock] == 0) {
+        deflate::throwCorrupted();
+      }
+      litLen_.build(lengths.data(), litLenCount, LitLenTableBits);
+      dist_.build(lengths.data() + litLenCount, distCount, DistTableBits);
+    }
+
+    size_t inflateBlock(const HuffmanTable& litLen, const HuffmanTable& dist,
+      uint8_t* dst, size_t pos, size_t dstSize)
+    {
+      while (true) {
+        refill();
+        uint32_t symbol = getSymbol(litLen);
+        if (symbol < 256) {
+          if (pos == dstSize) {
+            return pos;
+          }
+          dst[pos++] = static_cast<uint8_t>(symbol);
+          continue;
+        }
+        if (symbol == deflate::EndOfBlock) {
+          return pos;
+        }
+        symbol -= 257;
+        if (symbol >= deflate::LengthBase.size()) {
+          deflate::throwCorrupted();
+        }
+        size_t length = deflate::LengthBase[symbol] + getBits(deflate::LengthExtra[symbol]);
+        symbol = getSymbol(dist);
+        if (symbol >= deflate::DistBase.size()) {
+          deflate::throwCorrupted();
+        }
+        const size_t distance = deflate::DistBase[symbol] + getBits(deflate::DistExtra[symbol]);
+        if (distance > pos) {
+          deflate::throwCorrupted();
+        }
+
+        const uint8_t* from = dst + pos - distance;
+        uint8_t* to = dst + pos;
+        if (distance >= 8 && pos + length + 8 <= dstSize) {
+          // copy whole words; may write up to 7 bytes past the match, which
+          // are overwritten later
+          uint8_t* end = to + length;
+          do {
+            std::memcpy(to, from, 8);
+            to += 8;
+            from += 8;
+          } while (to < end);
+        } else {
+          length = std::min(length, dstSize - pos);
+          if (distance == 1) {
+            std::memset(to, *from, length);
+          } else {
+            for (size_t i = 0; i < length; ++i) {
+              to[i] = from[i];
+            }
+          }
+        }
+        pos += length;
+      }
+    }
+  };
+
+  // Encoder of zlib streams, used for writing and testing
+  class Deflater
+  {
+  public:
+    // `level` goes from 1 (fastest) to 9 (smallest output)
+    explicit Deflater(int level = 6)
+      : maxChain_(level <= 1 ? 4 : level >= 9 ? 1024 : 4u << (level - 1)),
+        niceLength_(level <= 1 ? 8 : level <= 3 ? 32 : level <= 7 ? 128 : deflate::MaxMatch),
+        head_(HashSize),
+        prev_(deflate::WindowSize)
+    {
+      for (uint32_t code = 0; code < deflate::LengthBase.size(); ++code) {
+        const uint32_t first = deflate::LengthBase[code];
+        const uint32_t last = code + 1 < deflate::LengthBase.size()
+          ? deflate::LengthBase[code + 1] : deflate::MaxMatch + 1;
+        for (uint32_t len = first; len < last; ++len) {
+          lengthCode_[len] = static_cast<uint8_t>(code);
+        }
+      }
+      lengthCode_[deflate::MaxMatch] = 28;
+      for (uint32_t code = 0; code < deflate::DistBase.size(); ++code) {
+        const uint32_t first = deflate::DistBase[code] - 1;
+        const uint32_t last = first + (1u << deflate::DistExtra[code]);
+        for (uint32_t d = first; d < last; ++d) {
+          if (d < 256) {
+            distCode_[d] = static_cast<uint8_t>(code);
+          } else {
+            distCode_[256 + (d >> 7)] = static_cast<uint8_t>(code);
+          }
+        }
+      }
+    }
+
+    // Encodes `in` as a zlib stream.
+    std::vector<std::byte> encode(std::span<const std::byte> in)
+    {
+      out_.clear();
+      out_.reserve(in.size() / 2 + 64);
+      bitBuffer_ = 0;
+      bitCount_ = 0;
+      putBits(0x78, 8); // 32K window, deflate
+      putBits(0x9C, 8);
+
+      if (in.size() >= UINT32_MAX) {
+        throw std::runtime_error("Deflate buffer is too large");
+      }
+      const auto* data = reinterpret_cast<const uint8_t*>(in.data());
+      const size_t size = in.size();
+      std::fill(head_.begin(), head_.end(), 0);
+
+      size_t blockStart = 0;
+      size_t pos = 0;
+      tokens_.clear();
+      while (pos < size) {
+        uint32_t bestLength = 0;
+        uint32_t bestDistance = 0;
+        if (pos + deflate::MinMatch <= size) {
+          const uint32_t hash = hash3(data + pos);
+          const uint32_t maxLength = static_cast<uint32_t>(
+            std::min<size_t>(deflate::MaxMatch, size - pos));
+          uint32_t candidate = head_[hash]; // position + 1, or 0 if none
+          for (uint32_t chain = maxChain_; candidate > 0 && chain > 0; --chain) {
+            const size_t distance = pos + 1 - candidate;
+            if (distance > deflate::WindowSize) {
+              break;
+            }
+            const uint8_t* a = data + candidate - 1;
+            const uint8_t* b = data + pos;
+            if (a[bestLength] == b[bestLength]) {
+              const uint32_t length = matchLength(a, b, maxLength);
+              if (length > bestLength) {
+                bestLength = length;
+                bestDistance = static_cast<uint32_t>(distance);
+                if (length >= niceLength_ || length == maxLength) {
+                  break; // good enough
+                }
+              }
+            }
+            candidate = prev_[(candidate - 1) & (deflate::WindowSize - 1)];
+          }
+          insert(pos, hash);
+        }
+
+        if (bestLength >= deflate::MinMatch) {
+          tokens_.push_back({ static_cast<uint16_t>(bestLength), static_cast<uint16_t>(bestDistance) });
+          const size_t end = pos + bestLength;
+          for (++pos; pos < end; ++pos) {
+            if (pos + deflate::MinMatch <= size) {
+              insert(pos, hash3(data + pos));
+            }
+          }
+        } else {
+          tokens_.push_back({ data[pos], 0 });
+          ++pos;
+        }
+
+        if (tokens_.size() == MaxBlockTokens) {
+          writeBlock(data + blockStart, pos - blockStart, false);
+          tokens_.clear();
+          blockStart = pos;
+        }
+      }
+      writeBlock(data + blockStart, pos - blockStart, true);
+
+      flushBits();
+      const uint32_t checksum = deflate::adler32(in);
+      for (int shift = 24; shift >= 0; shift -= 8) {
+        out_.push_back(static_cast<std::byte>(checksum >> shift));
+      }
+      return std::move(out_);
+    }
+
+  private:
+    static constexpr uint32_t HashBits = 15;
+    static constexpr uint32_t HashSize = 1 << HashBits;
+    static constexpr size_t MaxBlockTokens = 1 << 15;
+
+    // A literal (distance 0) or a match
+    struct Token {
+      uint16_t value;    // literal byte or match length
+      uint16_t distance;
+    };
+
+    struct HuffmanCode {
+      std::vector<uint8_t> lengths;
+      std::vector<uint16_t> codes; // bit-reversed, ready to write
+    };
+
+    const uint32_t maxChain_;
+    const uint32_t niceLength_; // matches as long as this end the search
+    std::vector<uint32_t> head_; // positions + 1, so that 0 means none
+    std::vector<uint32_t> prev_;
+    std::array<uint8_t, deflate::MaxMatch + 1> lengthCode_{};
+    std::array<uint8_t, 512> distCode_{};
+    std::vector<Token> tokens_;
+    std::vector<std::byte> out_;
+    uint64_t bitBuffer_ = 0;
+    uint32_t bitCount_ = 0;
+
+    static uint32_t hash3(const uint8_t* p) {
+      const uint32_t key = (uint32_t(p[0]) << 16) | (uint32_t(p[1]) << 8) | p[2];
+      return (key * 2654435761u) >> (32 - HashBits);
+    }
+
+    void insert(size_t pos, uint32_t hash) {
+      prev_[pos & (deflate::WindowSize - 1)] = head_[hash];
+      head_[hash] = static_cast<uint32_t>(pos + 1);
+    }
+
+    // Number of equal bytes at the start of `a` and `b`, up to `maxLength`
+    static uint32_t matchLength(const uint8_t* a, const uint8_t* b, uint32_t maxLength) {
+      uint32_t length = 0;
+      for (; length + 8 <= maxLength; length += 8) {
+        uint64_t x, y;
+        std::memcpy(&x, a + length, 8);
+        std::memcpy(&y, b + length, 8);
+        if (x != y) {
+          const int bits = (std::endian::native == std::endian::little)
+            ? std::countr_zero(x ^ y) : std::countl_zero(x ^ y);
+          return length + bits / 8;
+        }
+      }
+      while (length < maxLength && a[length] == b[length]) {
+        ++length;
+      }
+      return length;
+    }
+
+    uint32_t distSymbol(uint32_t distance) const {
+      const uint32_t d = distance - 1;
+      return d < 256 ? distCode_[d] : distCode_[256 + (d >> 7)];
+    }
+
+    void putBits(uint32_t bits, uint32_t count) {
+      bitBuffer_ |= uint64_t(bits) << bitCount_;
+      bitCount_ += count;
+      while (bitCount_ >= 8) {
+        out_.push_back(static_cast<std::byte>(bitBuffer_ & 0xFF));
+        bitBuffer_ >>= 8;
+        bitCount_ -= 8;
+      }
+    }
+
+    void flushBits() {
+      if (bitCount_ > 0) {
+        putBits(0, 8 - bitCount_);
+      }
+    }
+
+    // Computes length-limited Huffman code lengths from symbol frequencies
+    static HuffmanCode makeCode(const std::vector<uint32_t>& freqs, uint32_t maxBits)
+    {
+      const size_t count = freqs.size();
+      HuffmanCode code{ std::vector<uint8_t>(count, 0), std::vector<uint16_t>(count, 0) };
+
+      std::vector<uint32_t> symbols;
+      for (uint32_t i = 0; i < count; ++i) {
+        if (freqs[i] > 0) {
+          symbols.push_back(i);
+        }
+      }
+      if (symbols.size() <= 1) {
+        // a single code still needs one bit; an empty one gets a dummy code
+        code.lengths[symbols.empty() ? 0 : symbols.front()] = 1;
+      } else {
+        // plain Huffman tree
+        using Node = std::pair<uint64_t, int>; // weight, node index
+        std::priority_queue<Node, std::vector<Node>, std::greater<Node>> queue;
+        std::vector<int> parent(2 * symbols.size(), -1);
+        for (size_t i = 0; i < symbols.size(); ++i) {
+          queue.push({ freqs[symbols[i]], static_cast<int>(i) });
+        }
+        int next = static_cast<int>(symbols.size());
+        while (queue.size() > 1) {
+          const auto a = queue.top(); queue.pop();
+          const auto b = queue.top(); queue.pop();
+          parent[a.second] = parent[b.second] = next;
+          queue.push({ a.first + b.first, next++ });
+        }
+
+        // count the codes of each length, clamping them to `maxBits`
+        std::array<uint32_t, 64> lengthCount{};
+        for (size_t i = 0; i < symbols.size(); ++i) {
+          uint32_t depth = 0;
+          for (int node = static_cast<int>(i); parent[node] >= 0; node = parent[node]) {
+            ++depth;
+          }
+          ++lengthCount[std::min(depth, maxBits)];
+        }
+        // restore the Kraft equality after clamping
+        uint32_t kraft = 0;
+        for (uint32_t len = 1; len <= maxBits; ++len) {
+          kraft += lengthCount[len] << (maxBits - len);
+        }
+        while (kraft > (1u << maxBits)) {
+          --lengthCount[maxBits];
+          for (uint32_t len = maxBits - 1; len > 0; --len) {
+            if (lengthCount[len] > 0) {
+              --lengthCount[len];
+              lengthCount[len + 1] += 2;
+              break;
+            }
+          }
+          --kraft;
+        }
+
+        // the most frequent symbols get the shortest codes
+        std::stable_sort(symbols.begin(), symbols.end(),
+          [&](uint32_t a, uint32_t b) { return freqs[a] > freqs[b]; });
+        size_t index = 0;
+        for (uint32_t len = 1; len <= maxBits; ++len) {
+          for (uint32_t n = 0; n < lengthCount[len]; ++n) {
+            code.lengths[symbols[index++]] = static_cast<uint8_t>(len);
+          }
+        }
+      }
+
+      // canonical codes
+      std::array<uint32_t, 16> lengthCount{};
+      for (auto len : code.lengths) {
+        ++lengthCount[len];
+      }
+      lengthCount[0] = 0;
+      std::array<uint32_t, 16> nextCode{};
+      for (uint32_t len = 1, c = 0; len <= deflate::MaxCodeBits; ++len) {
+        c = (c + lengthCount[len - 1]) << 1;
+        nextCode[len] = c;
+      }
+      for (size_t i = 0; i < count; ++i) {
+        const uint32_t len = code.lengths[i];
+        if (len > 0) {
+          code.codes[i] = static_cast<uint16_t>(deflate::reverseBits(nextCode[len]++, len));
+        }
+      }
+      return code;
+    }
+
+    void writeBlock(const uint8_t* data, size_t size, bool isFinal)
+    {
+      std::vector<uint32_t> litLenFreqs(286, 0);
+      std::vector<uint32_t> distFreqs(30, 0);
+      for (const auto& token : tokens_) {
+        if (token.distance == 0) {
+          ++litLenFreqs[token.value];
+        } else {
+          ++litLenFreqs[257 + lengthCode_[token.value]];
+          ++distFreqs[distSymbol(token.distance)];
+        }
+      }
+      litLenFreqs[deflate::EndOfBlock] = 1;
+      const auto litLen = makeCode(litLenFreqs, deflate::MaxCodeBits);
+      const auto dist = makeCode(distFreqs, deflate::MaxCodeBits);
+
+      uint32_t litLenCount = 286;
+      while (litLenCount > 257 && litLen.lengths[litLenCount - 1] == 0) {
+        --litLenCount;
+      }
+      uint32_t distCount = 30;
+      while (distCount > 1 && dist.lengths[distCount - 1] == 0) {
+        --distCount;
+      }
+
+      // run-length encode the code lengths: (symbol, extra bits value)
+      std::vector<uint8_t> lengths(litLen.lengths.begin(), litLen.lengths.begin() + litLenCount);
+      lengths.insert(lengths.end(), dist.lengths.begin(), dist.lengths.begin() + distCount);
+      std::vector<std::pair<uint8_t, uint8_t>> runs;
+      for (size_t i = 0; i < lengths.size(); ) {
+        const uint8_t value = lengths[i];
+        size_t run = 1;
+        while (i + run < lengths.size() && lengths[i + run] == value) {
+          ++run;
+        }
+        i += run;
+        if (value == 0) {
+          while (run >= 11) {
+            const size_t n = std::min<size_t>(run, 138);
+            runs.push_back({ 18, static_cast<uint8_t>(n - 11) });
+            run -= n;
+          }
+          if (run >= 3) {
+            runs.push_back({ 17, static_cast<uint8_t>(run - 3) });
+            run = 0;
+          }
+        } else {
+          runs.push_back({ value, 0 });
+          --run;
+          while (run >= 3) {
+            const size_t n = std::min<size_t>(run, 6);
+            runs.push_back({ 16, static_cast<uint8_t>(n - 3) });
+            run -= n;
+          }
+        }
+        for (; run > 0; --run) {
+          runs.push_back({ value, 0 });
+        }
+      }
+      std::vector<uint32_t> codeLengthFreqs(19, 0);
+      for (const auto& run : runs) {
+        ++codeLengthFreqs[run.first];
+      }
+      const auto codeLengths = makeCode(codeLengthFreqs, 7);
+      uint32_t codeLengthCount = 19;
+      while (codeLengthCount > 4
+        && codeLengths.lengths[deflate::CodeLengthOrder[codeLengthCount - 1]] == 0) {
+        --codeLengthCount;
+      }
+
+      // fall back to stored blocks when compression does not pay off
+      uint64_t dynamicBits = 3 + 14 + 3 * codeLengthCount;
+      for (const auto& run : runs) {
+        dynamicBits += codeLengths.lengths[run.first]
+          + (run.first == 16 ? 2 : run.first == 17 ? 3 : run.first == 18 ? 7 : 0);
+      }
+      for (uint32_t i = 0; i < 286; ++i) {
+        dynamicBits += uint64_t(litLenFreqs[i]) * litLen.lengths[i];
+      }
+      for (uint32_t i = 0; i < 29; ++i) {
+        dynamicBits += uint64_t(litLenFreqs[257 + i]) * deflate::LengthExtra[i];
+      }
+      for (uint32_t i = 0; i < 30; ++i) {
+        dynamicBits += uint64_t(distFreqs[i]) * (dist.lengths[i] + deflate::DistExtra[i]);
+      }
+      const uint64_t storedBits = (size + 5 * (size / 65535 + 1)) * 8 + 7;
+      if (storedBits < dynamicBits) {
+        writeStored(data, size, isFinal);
+        return;
+      }
+
+      putBits(isFinal ? 1 : 0, 1);
+      putBits(2, 2);
+      putBits(litLenCount - 257, 5);
+      putBits(distCount - 1, 5);
+      putBits(codeLengthCount - 4, 4);
+      for (uint32_t i = 0; i < codeLengthCount; ++i) {
+        putBits(codeLengths.lengths[deflate::CodeLengthOrder[i]], 3);
+      }
+      for (const auto& [symbol, extra] : runs) {
+        putBits(codeLengths.codes[symbol], codeLengths.lengths[symbol]);
+        if (symbol >= 16) {
+          putBits(extra, symbol == 16 ? 2 : symbol == 17 ? 3 : 7);
+        }
+      }
+      for (const auto& token : tokens_) {
+        if (token.distance == 0) {
+          putBits(litLen.codes[token.value], litLen.lengths[token.value]);
+          continue;
+        }
+        const uint32_t lengthSymbol = lengthCode_[token.value];
+        putBits(litLen.codes[257 + lengthSymbol], litLen.lengths[257 + lengthSymbol]);
+        putBits(token.value - deflate::LengthBase[lengthSymbol], deflate::LengthExtra[lengthSymbol]);
+        const uint32_t distanceSymbol = distSymbol(token.distance);
+        putBits(dist.codes[distanceSymbol], dist.lengths[distanceSymbol]);
+        putBits(token.distance - deflate::DistBase[distanceSymbol], deflate::DistExtra[distanceSymbol]);
+      }
+      putBits(litLen.codes[deflate::EndOfBlock], litLen.lengths[deflate::EndOfBlock]);
+    }
+
+    void writeStored(const uint8_t* data, size_t size, bool isFinal)
+    {
+      do {
+        const size_t count = std::min<size_t>(size, 65535);
+        size -= count;
+        putBits((isFinal && size == 0) ? 1 : 0, 1);
+        putBits(0, 2);
+        flushBits();
+        putBits(static_cast<uint32_t>(count), 16);
+        putBits(static_cast<uint32_t>(~count & 0xFFFF), 16);
+        out_.insert(out_.end(),
+          reinterpret_cast<const std::byte*>(data),
+          reinterpret_cast<const std::byte*>(data + count));
+        data += count;
+      } while (size > 0);
+    }
+  };
+
+#ifdef TIFFCRAFT_USE_LIBDEFLATE
+  // Decoder of zlib streams based on libdeflate
+  class LibdeflateInflater
+  {
+  public:
+    static constexpr const char* name = "libdeflate";
+
+    LibdeflateInflater() : decompressor_(libdeflate_alloc_decompressor()) {
+      if (!decompressor_) {
+        throw std::bad_alloc();
+      }
+    }
+
+    ~LibdeflateInflater() { libdeflate_free_decompressor(decompressor_); }
+
+    LibdeflateInflater(const LibdeflateInflater&) = delete;
+    LibdeflateInflater& operator=(const LibdeflateInflater&) = delete;
+
+    size_t decode(std::span<const std::byte> in, std::span<std::byte> out)
+    {
+      size_t size = 0;
+      const auto result = libdeflate_zlib_decompress(decompressor_,
+        in.data(), in.size(), out.data(), out.size(), &size);
+      if (result == LIBDEFLATE_SUCCESS) {
+        return size;
+      }
+      if (result == LIBDEFLATE_INSUFFICIENT_SPACE) {
+        // libdeflate does not decode partial output
+        return fallback_.decode(in, out);
+      }
+      deflate::throwCorrupted();
+      return 0;
+    }
+
+  private:
+    libdeflate_decompressor* decompressor_;
+    Inflater fallback_;
+  };
+
+  // Encoder of zlib streams based on libdeflate
+  class LibdeflateDeflater
+  {
+  public:
+    explicit LibdeflateDeflater(int level = 6)
+      : compressor_(libdeflate_alloc_compressor(level)) {
+      if (!compressor_) {
+        throw std::bad_alloc();
+      }
+    }
+
+    ~LibdeflateDeflater() { libdeflate_free_compressor(compressor_); }
+
+    LibdeflateDeflater(const LibdeflateDeflater&) = delete;
+    LibdeflateDeflater& operator=(const LibdeflateDeflater&) = delete;
+
+    std::vector<std::byte> encode(std::span<const std::byte> in)
+    {
+      std::vector<std::byte> out(libdeflate_zlib_compress_bound(compressor_, in.size()));
+      const size_t size = libdeflate_zlib_compress(compressor_,
+        in.data(), in.size(), out.data(), out.size());
+      if (size == 0) {
+        throw std::runtime_error("Deflate compression failed");
+      }
+      out.resize(size);
+      return out;
+    }
+
+  private:
+    libdeflate_compressor* compressor_;
+  };
+#endif
+
+#ifdef TIFFCRAFT_USE_ZLIB
+  // Decoder of zlib streams based on zlib
+  class ZlibInflater
+  {
+  public:
+    static constexpr const char* name = "zlib";
+
+    ZlibInflater() {
+      if (inflateInit(&stream_) != Z_OK) {
+        throw std::runtime_error("zlib initialization failed");
+      }
+    }
+
+    ~ZlibInflater() { inflateEnd(&stream_); }
+
+    ZlibInflater(const ZlibInflater&) = delete;
+    ZlibInflater& operator=(const ZlibInflater&) = delete;
+
+    size_t decode(std::span<const std::byte> in, std::span<std::byte> out)
+    {
+      if (in.size() > UINT32_MAX || out.size() > UINT32_MAX) {
+        throw std::runtime_error("Deflate buffer is too large");
+      }
+      if (out.empty()) {
+        return 0; // zlib rejects a null output buffer
+      }
+      inflateReset(&stream_);
+      stream_.next_in = reinterpret_cast<Bytef*>(const_cast<std::byte*>(in.data()));
+      stream_.avail_in = static_cast<uInt>(in.size());
+      stream_.next_out = reinterpret_cast<Bytef*>(out.data());
+      stream_.avail_out = static_cast<uInt>(out.size());
+      const int result = inflate(&stream_, Z_FINISH);
+      if (result != Z_STREAM_END && result != Z_OK && result != Z_BUF_ERROR) {
+        deflate::throwCorrupted();
+      }
+      return out.size() - stream_.avail_out;
+    }
+
+  private:
+    z_stream stream_{};
+  };
+
+  // Encoder of zlib streams based on zlib
+  class ZlibDeflater
+  {
+  public:
+    explicit ZlibDeflater(int level = 6) {
+      if (deflateInit(&stream_, level) != Z_OK) {
+        throw std::runtime_error("zlib initialization failed");
+      }
+    }
+
+    ~ZlibDeflater() { deflateEnd(&stream_); }
+
+    ZlibDeflater(const ZlibDeflater&) = delete;
+    ZlibDeflater& operator=(const ZlibDeflater&) = delete;
+
+    std::vector<std::byte> encode(std::span<const std::byte> in)
+    {
+      if (in.size() > UINT32_MAX / 2) {
+        throw std::runtime_error("Deflate buffer is too large");
+      }
+      std::vector<std::byte> out(deflateBound(&stream_, static_cast<uLong>(in.size())));
+      deflateReset(&stream_);
+      stream_.next_in = reinterpret_cast<Bytef*>(const_cast<std::byte*>(in.data()));
+      stream_.avail_in = static_cast<uInt>(in.size());
+      stream_.next_out = reinterpret_cast<Bytef*>(out.data());
+      stream_.avail_out = static_cast<uInt>(out.size());
+      if (::deflate(&stream_, Z_FINISH) != Z_STREAM_END) {
+        throw std::runtime_error("Deflate compression failed");
+      }
+      out.resize(out.size() - stream_.avail_out);
+      return out;
+    }
+
+  private:
+    z_stream stream_{};
+  };
+#endif
+
+#if defined(TIFFCRAFT_USE_LIBDEFLATE)
+  using DeflateDecoder = LibdeflateInflater;
+#elif defined(TIFFCRAFT_USE_ZLIB)
+  using DeflateDecoder = ZlibInflater;
+#else
+  using DeflateDecoder = Inflater;
+#endif
+
+#if defined(TIFFCRAFT_USE_LIBDEFLATE)
+  using DeflateEncoder = LibdeflateDeflater;
+#elif defined(TIFFCRAFT_USE_ZLIB)
+  using DeflateEncoder = ZlibDeflater;
+#else
+  using DeflateEncoder = Deflater;
+#endif
+
+} // namespace TiffCraft
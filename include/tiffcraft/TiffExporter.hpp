@@ -51,12 +51,17 @@
 
 #pragma once
 
-#include "TiffCraft.hpp"
+#include "TiffImage.hpp"
+#include "TiffCodec.hpp"
 
 #include <functional>
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <climits>
 #include <numeric>
 #include <string>
+#include <typeinfo>
 
 namespace TiffCraft {
 
@@ -71,22 +76,34 @@ namespace TiffCraft {
     int bitDepth = 0;       // Bits per channel
     std::vector<std::byte> data;  // Raw pixel data
 
+    // Creates an image with the given layout. If `data` is not empty, it is
+    // adopted as the pixel buffer instead of allocating a new one; it must
+    // hold at least as many bytes as the image requires.
     template <typename T, int N = 1>
-    static Image make(int width, int height, bool isPlanar = false)
+    static Image make(int width, int height, bool isPlanar = false,
+      std::vector<std::byte> data = {})
     {
       constexpr int sT = static_cast<int>(sizeof(T));
+      const size_t dataSize = size_t(width) * height * N * sT;
+      if (data.empty()) {
+        data.resize(dataSize);
+      } else if (data.size() >= dataSize) {
+        data.resize(dataSize); // drop padding, no reallocation
+      } else {
+        throw std::runtime_error("Adopted pixel buffer is too small");
+      }
       if (isPlanar) {
         return Image{
           width, height, N,                     // width, height, channels
           width * sT,  sT, width * height * sT, // strides: row, column, channel
           sT * 8,                               // bit depth
-          std::vector<std::byte>(width * height * N * sT) };
+          std::move(data) };
       }
       return Image{
         width, height, N,             // width, height, channels
         width * N * sT,  N * sT, sT,  // strides: row, column, channel
         sT * 8,                       // bit depth
-        std::vector<std::byte>(width * height * N * sT) };
+        std::move(data) };
     }
 
     size_t dataSize() const { return data.size(); }
@@ -131,6 +148,12 @@ namespace TiffCraft {
     int height = 0;
     int stride = 0; // Bytes per row
     int bitsPerSample = 0;
+    int compression = 1;
+    int predictor = 1;
+    uint32_t faxOptions = 0; // T4Options or T6Options
+    int fillOrder = 1;
+    int photometric = 1;
+    std::span<const std::byte> jpegTables; // JPEGTables, owned by the IFD
   };
 
   class FormatNotSupportedError : public std::runtime_error
@@ -145,6 +168,11 @@ namespace TiffCraft {
   {
   protected:
     Image image_;
+    std::optional<LoadRegion> region_; // part of the image to export, if not all
+    std::optional<LoadRegion> bounds_; // part of the image held in image_
+    int imageWidth_ = 0;               // width of the whole image
+    int imageHeight_ = 0;              // height of the whole image
+    std::vector<uint64_t> sums_;       // sums of the boxes of an averaged image
 
   public:
     // Destructor
@@ -153,8 +181,8 @@ namespace TiffCraft {
     // Accessor for the exported image
     const Image& image() const { return image_; }
 
-    // Accessor for the exported image
-    [[nodiscard]] Image takeImage() const { return std::move(image_); }
+    // Moves the exported image out of the exporter
+    [[nodiscard]] Image takeImage() { return std::move(image_); }
 
     // Callback for TiffCraft::load() function
     virtual void operator()(
@@ -162,6 +190,32 @@ namespace TiffCraft {
       const TiffImage::IFD& ifd,
       TiffImage::ImageData imageData) = 0;
 
+    // Callback for TiffCraft::load() function, which exports only `region`,
+    // in pixels of the IFD
+    void operator()(
+      const TiffImage::Header& header,
+      const TiffImage::IFD& ifd,
+      TiffImage::ImageData imageData,
+      const LoadRegion& region)
+    {
+      region_ = region;
+      try {
+        (*this)(header, ifd, std::move(imageData));
+      } catch (...) {
+        region_.reset();
+        throw;
+      }
+      region_.reset();
+    }
+
+    // Adds `bytes` to the memory allocated in the statistics of the load, if any
+    void countAllocated(size_t bytes) const
+    {
+      if (region_ && region_->stats) {
+        region_->stats->bytesAllocated += bytes;
+      }
+    }
+
     // Copies the values from a TIFF entry to a vector of integers.
     template <typename T>
     static std::vector<int> makeIntVec(const TiffImage::IFD::Entry& entry)
@@ -258,6 +312,14 @@ namespace TiffCraft {
       return require(ifd, Tag::Compression, 1, requiredValue, comp);
     }
 
+    // Requires a compression scheme that can be decoded
+    static int requireCompression(const TiffImage::IFD& ifd)
+    {
+      return requireCompression(ifd, -1, [](int value, int) {
+        return isCompressionSupported(value);
+      });
+    }
+
     template <typename Comp = std::equal_to<>>
     static int requireBitsPerSample(
       const TiffImage::IFD& ifd, int requiredValue, Comp&& comp = {})
@@ -284,6 +346,16 @@ namespace TiffCraft {
       return require(ifd, Tag::FillOrder, 1, requiredValue, comp);
     }
 
+    // Requires a fill order that can be decoded: FillOrder=2 is supported
+    // only by the CCITT codecs
+    static int requireFillOrder(const TiffImage::IFD& ifd)
+    {
+      const int compression = getInt(ifd, Tag::Compression, 1);
+      return requireFillOrder(ifd, -1, [&](int value, int) {
+        return value == 1 || (value == 2 && isFaxCompression(compression));
+      });
+    }
+
     template <typename Comp = std::equal_to<>>
     static int requirePlanarConfiguration(
       const TiffImage::IFD& ifd, int requiredValue, Comp&& comp = {})
@@ -324,14 +396,152 @@ namespace TiffCraft {
       const int imageWidth = getWidth(ifd);
       const int imageHeight = getHeight(ifd);
 
-      const int rowsPerStrip = getInt(ifd, Tag::RowsPerStrip, imageHeight);
+      int rowsPerStrip = getInt(ifd, Tag::RowsPerStrip, imageHeight);
+      if (rowsPerStrip <= 0 || rowsPerStrip > imageHeight) {
+        rowsPerStrip = imageHeight; // e.g. 2**32-1 means a single strip
+      }
 
       const int tileWidth = getInt(ifd, Tag::TileWidth, imageWidth);
       const int tileHeight = getInt(ifd, Tag::TileLength, rowsPerStrip);
       const int tileChannels = (planarConfiguration == 1 ? samplesPerPixel : 1);
       const int tileStride = (tileWidth * tileChannels * bitsPerSample + 7) / 8;
 
-      return { tileWidth, tileHeight, tileStride, bitsPerSample };
+      const int compression = getInt(ifd, Tag::Compression, 1);
+      const int predictor = isPredictorSupported(compression)
+        ? getInt(ifd, Tag::Predictor, 1) : 1;
+      const uint32_t faxOptions = static_cast<uint32_t>(compression == 3
+        ? getInt(ifd, Tag::T4Options, 0) : getInt(ifd, Tag::T6Options, 0));
+      const int fillOrder = getInt(ifd, Tag::FillOrder, 1);
+      const int photometric = getInt(ifd, Tag::PhotometricInterpretation, 1);
+
+      std::span<const std::byte> jpegTables;
+      if (auto it = ifd.entries().find(Tag::JPEGTables); it != ifd.entries().end()) {
+        jpegTables = std::span(it->second.values(), it->second.bytes());
+      }
+
+      return { tileWidth, tileHeight, tileStride, bitsPerSample, compression,
+        predictor, faxOptions, fillOrder, photometric, jpegTables };
+    }
+
+    // Layout of a strip or tile for the codec that decodes it
+    static CodecParams codecParams(const RectInfo& rectInfo,
+      const RectInfo& currRectInfo, size_t channels)
+    {
+      return { rectInfo.compression, rectInfo.width, currRectInfo.height,
+        static_cast<int>(channels), rectInfo.bitsPerSample, rectInfo.faxOptions,
+        rectInfo.fillOrder, rectInfo.photometric, rectInfo.jpegTables };
+    }
+
+    // Part of the image copied by copyRectangles(): the region requested to
+    // load(), extended to whole strips or tiles, or the whole image. The
+    // exported image must have this size until cropToRegion() is called.
+    LoadRegion copyBounds(const TiffImage::IFD& ifd, const RectInfo& rectInfo)
+    {
+      imageWidth_ = getWidth(ifd);
+      imageHeight_ = getHeight(ifd);
+      bounds_ = LoadRegion{ 0, 0, imageWidth_, imageHeight_ };
+      if (region_) {
+        const auto& region = *region_;
+        if (region.x < 0 || region.y < 0 || region.width <= 0 || region.height <= 0
+          || region.decimation < 1
+          || region.x + region.width > imageWidth_
+          || region.y + region.height > imageHeight_) {
+          throw std::runtime_error("Region is outside the image");
+        }
+        const int x0 = region.x / rectInfo.width * rectInfo.width;
+        const int y0 = region.y / rectInfo.height * rectInfo.height;
+        const int x1 = std::min(imageWidth_, (region.x + region.width
+          + rectInfo.width - 1) / rectInfo.width * rectInfo.width);
+        const int y1 = std::min(imageHeight_, (region.y + region.height
+          + rectInfo.height - 1) / rectInfo.height * rectInfo.height);
+        bounds_ = LoadRegion{ x0, y0, x1 - x0, y1 - y0 };
+        if (isDecimated()) {
+          // the image is created with its final size
+          const int step = region.decimation;
+          return { 0, 0, (region.width + step - 1) / step, (region.height + step - 1) / step };
+        }
+      }
+      return *bounds_;
+    }
+
+    // Whether the image is decimated as it is copied
+    bool isDecimated() const
+    {
+      return region_ && region_->decimation > 1;
+    }
+
+    // Crops the exported image from the bounds returned by copyBounds() to
+    // the requested region, moving the rows in place.
+    void cropToRegion()
+    {
+      TIFFCRAFT_TRACE_SCOPE("crop to region");
+      const auto bounds = bounds_;
+      bounds_.reset();
+      if (!region_ || !bounds || isDecimated()) {
+        return;
+      }
+      const bool isBounds = region_->x == bounds->x && region_->y == bounds->y
+        && region_->width == bounds->width && region_->height == bounds->height;
+      if (isBounds) {
+        return;
+      }
+      const auto& region = *region_;
+      const bool isPlanar = image_.colStride < image_.channels * image_.chanStride;
+      const size_t planes = isPlanar ? image_.channels : 1;
+      const size_t srcRowStride = image_.rowStride;
+      const size_t dstRowStride = size_t(region.width) * image_.colStride;
+      const size_t srcPlaneStride = srcRowStride * image_.height;
+      const size_t dstPlaneStride = dstRowStride * region.height;
+      const size_t srcX = size_t(region.x - bounds->x) * image_.colStride;
+      const size_t srcY = region.y - bounds->y;
+      std::byte* data = image_.dataPtr();
+      for (size_t plane = 0; plane < planes; ++plane) {
+        for (size_t y = 0; y < size_t(region.height); ++y) {
+          // rows only move towards the start of the buffer
+          std::memmove(data + plane * dstPlaneStride + y * dstRowStride,
+            data + plane * srcPlaneStride + (y + srcY) * srcRowStride + srcX,
+            dstRowStride);
+        }
+      }
+      image_.width = region.width;
+      image_.height = region.height;
+      image_.rowStride = static_cast<int>(dstRowStride);
+      if (isPlanar) {
+        image_.chanStride = static_cast<int>(dstPlaneStride);
+      }
+      image_.data.resize(planes * dstPlaneStride);
+    }
+
+    // Takes the pixel data of a single rectangle covering the whole image when
+    // it can be used verbatim as the exported image data, i.e. the source
+    // layout equals the destination layout and `op` is the identity. The
+    // buffer is moved out of `imageData`. Returns an empty vector otherwise.
+    template <typename SrcType, typename DstType>
+    static std::vector<std::byte> takeVerbatimData(
+      TiffImage::ImageData& imageData,        // source pixel data
+      const RectInfo& rectInfo,               // source rectangle info
+      int width,                              // image width
+      int height,                             // image height
+      size_t channels,                        // source image channels
+      size_t planes,                          // source image planes
+      bool equalsHostByteOrder,               // source data byte order
+      bool isIdentityOp)                      // whether op is the identity
+    {
+      if constexpr (std::is_same_v<SrcType, DstType>) {
+        const size_t rowBytes = size_t(width) * channels * sizeof(SrcType);
+        const bool isVerbatim = isIdentityOp
+          && rectInfo.bitsPerSample == 8 * sizeof(SrcType)
+          && rectInfo.compression == 1
+          && (equalsHostByteOrder || sizeof(SrcType) == 1)
+          && planes == 1 && imageData.size() == 1
+          && rectInfo.width == width && rectInfo.height >= height
+          && rectInfo.stride >= 0 && static_cast<size_t>(rectInfo.stride) == rowBytes
+          && imageData.front().size() >= rowBytes * height;
+        if (isVerbatim) {
+          return std::move(imageData.front());
+        }
+      }
+      return {};
     }
 
     template <typename SrcType, typename DstType, typename UnaryOp>
@@ -341,51 +551,546 @@ namespace TiffCraft {
       size_t channels,                        // source image channels
       size_t planes,                          // source image planes
       bool equalsHostByteOrder,               // source data byte order
-      UnaryOp&& op)
+      UnaryOp&& op,
+      bool isIdentityOp = false)              // whether op is the identity
     {
-      const int imageWidth = image_.width;
-      const int imageHeight = image_.height;
+      // the image holds the bounds set by copyBounds(), or the whole image
+      const int imageWidth = bounds_ ? imageWidth_ : image_.width;
+      const int imageHeight = bounds_ ? imageHeight_ : image_.height;
+      const LoadRegion bounds = bounds_.value_or(LoadRegion{ 0, 0, imageWidth, imageHeight });
 
       const int rectAcross = (imageWidth + (rectInfo.width - 1)) / rectInfo.width;
       const int rectDown = (imageHeight + (rectInfo.height - 1)) / rectInfo.height;
       const int rectsInPlane = rectAcross * rectDown;
 
+      TIFFCRAFT_TRACE_SCOPE("copy rectangles", "count", imageData.size());
       const int rectsInImage = rectAcross * rectDown * planes;
       if (rectsInImage != imageData.size()) {
         throw std::runtime_error("Rectangle count mismatch");
       }
 
-      for (int plane = 0; plane < planes; ++plane) {
-        for (int rectY = 0; rectY < rectDown; ++rectY) {
-          for (int rectX = 0; rectX < rectAcross; ++rectX) {
-            const auto& rectData = imageData[plane * rectsInPlane + rectY * rectAcross + rectX];
-            auto currRectInfo = rectInfo;
-            currRectInfo.width = std::min(rectInfo.width, imageWidth - rectX * rectInfo.width);
-            currRectInfo.height = std::min(rectInfo.height, imageHeight - rectY * rectInfo.height);
-            copyRectangle<SrcType, DstType, UnaryOp>(
-              rectData,                    // source pixel data
-              currRectInfo,                // source rectangle info
-              channels,                    // source image channels
-              equalsHostByteOrder,         // source data byte order
-              plane,                       // destination plane
-              rectX * rectInfo.width,      // destination column
-              rectY * rectInfo.height,     // destination row
-              std::forward<UnaryOp>(op));
+      auto copy = [&](size_t index) {
+        const int plane = static_cast<int>(index / rectsInPlane);
+        const int rectY = static_cast<int>(index % rectsInPlane) / rectAcross;
+        const int rectX = static_cast<int>(index % rectsInPlane) % rectAcross;
+        const int x = rectX * rectInfo.width;
+        const int y = rectY * rectInfo.height;
+        if (x < bounds.x || x >= bounds.x + bounds.width
+          || y < bounds.y || y >= bounds.y + bounds.height) {
+          return; // outside the region being exported
+        }
+        TIFFCRAFT_TRACE_SCOPE("decode rectangle", "index", index);
+        const size_t dstX = x - bounds.x;
+        const size_t dstY = y - bounds.y;
+        const auto& rectData = imageData[index];
+        auto currRectInfo = rectInfo;
+        currRectInfo.width = std::min(rectInfo.width, imageWidth - x);
+        currRectInfo.height = std::min(rectInfo.height, imageHeight - y);
+        if (isDecimated()) {
+          decimateRectangle<SrcType, DstType, UnaryOp>(index, rectData, rectInfo,
+            currRectInfo, channels, equalsHostByteOrder, plane, x, y,
+            std::forward<UnaryOp>(op), isIdentityOp);
+          return;
+        }
+        if (region_ && region_->cache) {
+          const auto pixels = decodeRectanglePixels<SrcType, DstType, UnaryOp>(
+            index, rectData, rectInfo, currRectInfo, channels,
+            equalsHostByteOrder, std::forward<UnaryOp>(op), isIdentityOp);
+          const size_t rowBytes = size_t(currRectInfo.width) * image_.colStride;
+          for (int row = 0; row < currRectInfo.height; ++row) {
+            std::memcpy(destination<std::byte>(plane, dstX, dstY + row),
+              pixels.data + row * pixels.rowStride, rowBytes);
           }
+          return;
         }
+        copyRectangleData<SrcType, DstType, UnaryOp>(rectData, rectInfo,
+          currRectInfo, channels, equalsHostByteOrder, plane, dstX, dstY,
+          std::forward<UnaryOp>(op), isIdentityOp);
+      };
+
+      const bool isAverage = isDecimated()
+        && region_->decimationMode == DecimationMode::Average;
+      if (isAverage) {
+        sums_.assign(image_.dataSize() / (image_.bitDepth / 8), 0);
+        countAllocated(sums_.size() * sizeof(uint64_t));
+      }
+      if (rectInfo.compression == 1) {
+        // copying is bound by memory bandwidth, one thread is enough
+        for (size_t index = 0; index < imageData.size(); ++index) {
+          copy(index);
+        }
+      } else {
+        // rectangles are independent and cover disjoint parts of the image
+        parallelFor(imageData.size(), copy);
+      }
+      if (isAverage) {
+        averageBoxes();
+      }
+    }
+
+    // Decodes one strip or tile and copies it to the image. Rectangles that
+    // are not decoded row by row can be copied partially: only `rowStep`-th
+    // rows from `firstRow` to `lastRow` are decoded and copied.
+    template <typename SrcType, typename DstType, typename UnaryOp>
+    void copyRectangleData(
+      std::span<const std::byte> rectData,    // encoded pixel data
+      const RectInfo& rectInfo,               // source rectangle info
+      const RectInfo& currRectInfo,           // rectangle clipped by the image
+      size_t channels,                        // source image channels
+      bool equalsHostByteOrder,               // source data byte order
+      size_t dstPlane,                        // destination plane
+      size_t dstX,                            // destination column
+      size_t dstY,                            // destination row
+      UnaryOp&& op,
+      bool isIdentityOp = false,              // whether op is the identity
+      int firstRow = 0,                       // first row copied
+      int rowStep = 1,                        // distance between rows copied
+      int lastRow = INT_MAX)                  // last row copied
+    {
+      Codec* codec = rectInfo.compression != 1
+        ? &codecRegistry().codec(rectInfo.compression) : nullptr;
+      if (dynamic_cast<PackBitsCodec*>(codec)) {
+        // PackBits is decoded one row at a time, right before it is copied
+        copyPackBitsRectangle<SrcType, DstType, UnaryOp>(
+          rectData, currRectInfo, channels, equalsHostByteOrder, dstPlane,
+          dstX, dstY,
+          std::forward<UnaryOp>(op), isIdentityOp);
+        return;
+      }
+#ifdef TIFFCRAFT_USE_LIBJPEG
+      if (auto* jpegCodec = dynamic_cast<JpegCodec*>(codec)) {
+        // JPEG data is decoded straight into the image when possible
+        copyJpegRectangle<SrcType, DstType, UnaryOp>(jpegCodec->decoder(),
+          rectData, currRectInfo, rectInfo.width, channels, dstPlane,
+          dstX, dstY,
+          std::forward<UnaryOp>(op), isIdentityOp);
+        return;
+      }
+#endif
+      if (dynamic_cast<FaxCodec*>(codec)) {
+        // CCITT data is decoded one row at a time, right before it is copied
+        copyFaxRectangle<SrcType, DstType, UnaryOp>(
+          rectData, currRectInfo, rectInfo.width, channels, dstPlane,
+          dstX, dstY,
+          std::forward<UnaryOp>(op), isIdentityOp);
+        return;
+      }
+      // decode only the rows that are copied
+      const int rows = lastRow < currRectInfo.height ? lastRow + 1 : currRectInfo.height;
+      const auto decodedData = decodeRectangle(rectInfo.compression,
+        rectData, size_t(currRectInfo.stride) * rows,
+        codecParams(rectInfo, currRectInfo, channels));
+      bool isHostByteOrder = equalsHostByteOrder;
+      if (rectInfo.predictor != 1) {
+        // the decoded data is in the buffer of this thread, still cached;
+        // rows span the whole tile, which matters to the floating point
+        // predictor even when the tile is clipped by the image border
+        undoPredictor(rectInfo.predictor,
+          std::span(decodeBuffer().data(), decodedData.size()),
+          rectInfo.width, rows, currRectInfo.stride,
+          channels, rectInfo.bitsPerSample, equalsHostByteOrder);
+        isHostByteOrder = true;
+      }
+      if (rowStep > 1) {
+        // copy the rows one at a time, skipping the others
+        auto rowInfo = currRectInfo;
+        rowInfo.height = 1;
+        for (int row = firstRow; row < rows; row += rowStep) {
+          const size_t offset = size_t(row) * currRectInfo.stride;
+          if (offset >= decodedData.size()) {
+            throw std::runtime_error("Unexpected end of source tile");
+          }
+          copyRectangle<SrcType, DstType, UnaryOp>(decodedData.subspan(offset),
+            rowInfo, channels, isHostByteOrder, dstPlane, dstX, dstY + row,
+            std::forward<UnaryOp>(op), isIdentityOp);
+        }
+        return;
+      }
+      const size_t offset = size_t(firstRow) * currRectInfo.stride;
+      if (offset > decodedData.size()) {
+        throw std::runtime_error("Unexpected end of source tile");
+      }
+      auto copyInfo = currRectInfo;
+      copyInfo.height = rows - firstRow;
+      copyRectangle<SrcType, DstType, UnaryOp>(
+        decodedData.subspan(offset), // source pixel data
+        copyInfo,                    // source rectangle info
+        channels,                    // source image channels
+        isHostByteOrder,             // source data byte order
+        dstPlane,                    // destination plane
+        dstX,                        // destination column
+        dstY + firstRow,             // destination row
+        std::forward<UnaryOp>(op),
+        isIdentityOp);
+    }
+
+    // Pixels of one strip or tile in the layout of the exported image
+    struct RectPixels {
+      const std::byte* data = nullptr;
+      size_t rowStride = 0;                   // bytes between rows
+      TileCache::Tile tile = nullptr;         // cached tile holding the pixels
+    };
+
+    // Identity of the exported pixel format in a tile cache
+    uint64_t formatId() const
+    {
+      const char* name = typeid(*this).name();
+      return hashBytes(name, std::strlen(name));
+    }
+
+    // Decodes one strip or tile into a scratch image of this thread, which
+    // stays valid until the next call from the same thread. Only `rowStep`-th
+    // rows from `firstRow` to `lastRow` are decoded when possible. With a tile
+    // cache, the pixels of the whole rectangle are taken from the cache, or
+    // read, decoded, and added to it.
+    template <typename SrcType, typename DstType, typename UnaryOp>
+    RectPixels decodeRectanglePixels(
+      size_t index,                           // strip or tile index
+      std::span<const std::byte> rectData,    // encoded pixel data
+      const RectInfo& rectInfo,               // source rectangle info
+      const RectInfo& currRectInfo,           // rectangle clipped by the image
+      size_t channels,                        // source image channels
+      bool equalsHostByteOrder,               // source data byte order
+      UnaryOp&& op,
+      bool isIdentityOp = false,              // whether op is the identity
+      int firstRow = 0,                       // first row decoded
+      int rowStep = 1,                        // distance between rows decoded
+      int lastRow = INT_MAX)                  // last row decoded
+    {
+      const LoadCache* cache = region_ ? region_->cache : nullptr;
+      const size_t rowStride = size_t(currRectInfo.width) * image_.colStride;
+      TileKey key;
+      std::vector<std::byte> readData;
+      if (cache) {
+        key = { cache->file, cache->ifd, index, formatId() };
+        if (auto tile = cache->tileCache->find(key)) {
+          return { tile->data(), rowStride, std::move(tile) };
+        }
+        firstRow = 0;
+        rowStep = 1;
+        lastRow = INT_MAX;
+        if (rectData.empty() && cache->read) {
+          readData = cache->read(index);
+          rectData = readData;
+        }
+      }
+
+      class Scratch final : public TiffExporter {
+      public:
+        void operator()(const TiffImage::Header&, const TiffImage::IFD&,
+          TiffImage::ImageData) override {}
+      };
+      thread_local std::vector<std::byte> scratchData;
+      Scratch scratch;
+      Image& rect = static_cast<TiffExporter&>(scratch).image_;
+      const bool isPlanar = image_.colStride < image_.channels * image_.chanStride;
+      // only the layout of the image is copied: its pixels may be written by
+      // other threads, and copying them for each rectangle is quadratic
+      rect.width = currRectInfo.width;
+      rect.height = currRectInfo.height;
+      rect.channels = image_.channels;
+      rect.rowStride = static_cast<int>(rowStride);
+      rect.colStride = image_.colStride;
+      rect.chanStride = isPlanar ? rect.rowStride * rect.height : image_.chanStride;
+      rect.bitDepth = image_.bitDepth;
+      rect.data = std::move(scratchData);
+      rect.data.resize(rowStride * rect.height);
+      scratch.copyRectangleData<SrcType, DstType, UnaryOp>(rectData, rectInfo,
+        currRectInfo, channels, equalsHostByteOrder, 0, 0, 0,
+        std::forward<UnaryOp>(op), isIdentityOp, firstRow, rowStep, lastRow);
+      if (cache) {
+        auto tile = std::make_shared<const std::vector<std::byte>>(std::move(rect.data));
+        cache->tileCache->insert(key, tile);
+        return { tile->data(), rowStride, std::move(tile) };
+      }
+      scratchData = std::move(rect.data);
+      return { scratchData.data(), rowStride };
+    }
+
+    // Copies the pixels of one strip or tile that are picked by decimation,
+    // or adds them to the sums of their boxes. The rectangle is decoded into
+    // a scratch image of this thread, skipping rows when possible.
+    template <typename SrcType, typename DstType, typename UnaryOp>
+    void decimateRectangle(
+      size_t index,                           // strip or tile index
+      std::span<const std::byte> rectData,    // encoded pixel data
+      const RectInfo& rectInfo,               // source rectangle info
+      const RectInfo& currRectInfo,           // rectangle clipped by the image
+      size_t channels,                        // source image channels
+      bool equalsHostByteOrder,               // source data byte order
+      size_t plane,                           // source and destination plane
+      int x,                                  // rectangle column in the image
+      int y,                                  // rectangle row in the image
+      UnaryOp&& op,
+      bool isIdentityOp = false)              // whether op is the identity
+    {
+      const LoadRegion& region = *region_;
+      const int step = region.decimation;
+      const bool isAverage = region.decimationMode == DecimationMode::Average;
+
+      // part of the region in this rectangle, from the first picked pixel
+      auto firstPicked = [&](int start, int first) {
+        return start <= first ? first : first + (start - first + step - 1) / step * step;
+      };
+      int x0 = std::max(x, region.x);
+      int y0 = std::max(y, region.y);
+      const int x1 = std::min(x + currRectInfo.width, region.x + region.width);
+      const int y1 = std::min(y + currRectInfo.height, region.y + region.height);
+      if (!isAverage) {
+        x0 = firstPicked(x0, region.x);
+        y0 = firstPicked(y0, region.y);
+      }
+      if (x0 >= x1 || y0 >= y1) {
+        return; // no pixels of the region
+      }
+
+      const bool isPlanar = image_.colStride < image_.channels * image_.chanStride;
+      const auto pixels = decodeRectanglePixels<SrcType, DstType, UnaryOp>(
+        index, rectData, rectInfo, currRectInfo, channels, equalsHostByteOrder,
+        std::forward<UnaryOp>(op), isIdentityOp,
+        y0 - y, isAverage ? 1 : step, y1 - 1 - y);
+
+      auto decimate = [&]<typename T>() {
+        const size_t samplesPerPixel = image_.colStride / sizeof(T);
+        const size_t srcRowStride = pixels.rowStride / sizeof(T);
+        const T* src = reinterpret_cast<const T*>(pixels.data);
+        if (!isAverage) {
+          const size_t dstRowStride = image_.rowStride / sizeof(T);
+          T* dst = image_.dataPtr<T>() + (isPlanar ? plane * image_.chanStride / sizeof(T) : 0);
+          for (int srcY = y0; srcY < y1; srcY += step) {
+            const T* srcRow = src + (srcY - y) * srcRowStride;
+            T* dstRow = dst + size_t(srcY - region.y) / step * dstRowStride;
+            for (int srcX = x0; srcX < x1; srcX += step) {
+              std::copy_n(srcRow + (srcX - x) * samplesPerPixel, samplesPerPixel,
+                dstRow + size_t(srcX - region.x) / step * samplesPerPixel);
+            }
+          }
+          return;
+        }
+        // boxes may span several rectangles, decoded by different threads
+        const size_t planeSums = size_t(image_.width) * image_.height * samplesPerPixel;
+        for (int boxY = (y0 - region.y) / step; region.y + boxY * step < y1; ++boxY) {
+          const int boxY0 = std::max(y0, region.y + boxY * step);
+          const int boxY1 = std::min(y1, region.y + (boxY + 1) * step);
+          for (int boxX = (x0 - region.x) / step; region.x + boxX * step < x1; ++boxX) {
+            const int boxX0 = std::max(x0, region.x + boxX * step);
+            const int boxX1 = std::min(x1, region.x + (boxX + 1) * step);
+            uint64_t* sums = sums_.data() + plane * planeSums
+              + (size_t(boxY) * image_.width + boxX) * samplesPerPixel;
+            for (size_t sample = 0; sample < samplesPerPixel; ++sample) {
+              uint64_t sum = 0;
+              for (int srcY = boxY0; srcY < boxY1; ++srcY) {
+                const T* srcRow = src + (srcY - y) * srcRowStride + sample;
+                for (int srcX = boxX0; srcX < boxX1; ++srcX) {
+                  sum += srcRow[(srcX - x) * samplesPerPixel];
+                }
+              }
+              std::atomic_ref<uint64_t>(sums[sample]).fetch_add(sum, std::memory_order_relaxed);
+            }
+          }
+        }
+      };
+      switch (image_.bitDepth) {
+        case 8: decimate.template operator()<uint8_t>(); break;
+        case 16: decimate.template operator()<uint16_t>(); break;
+        case 32: decimate.template operator()<uint32_t>(); break;
+        default: throw FormatNotSupportedError("Decimation of " + std::to_string(image_.bitDepth) + "-bit samples");
+      }
+    }
+
+    // Writes the averages of the boxes summed by decimateRectangle()
+    void averageBoxes()
+    {
+      TIFFCRAFT_TRACE_SCOPE("average boxes");
+      const LoadRegion& region = *region_;
+      const int step = region.decimation;
+      auto average = [&]<typename T>() {
+        const bool isPlanar = image_.colStride < image_.channels * image_.chanStride;
+        const size_t planes = isPlanar ? image_.channels : 1;
+        const size_t samplesPerPixel = image_.colStride / sizeof(T);
+        const uint64_t* sums = sums_.data();
+        for (size_t plane = 0; plane < planes; ++plane) {
+          T* dst = image_.dataPtr<T>() + (isPlanar ? plane * image_.chanStride / sizeof(T) : 0);
+          for (int boxY = 0; boxY < image_.height; ++boxY) {
+            const uint64_t boxHeight = std::min(step, region.height - boxY * step);
+            T* dstRow = dst + size_t(boxY) * image_.rowStride / sizeof(T);
+            for (int boxX = 0; boxX < image_.width; ++boxX) {
+              const uint64_t count = boxHeight * std::min(step, region.width - boxX * step);
+              for (size_t sample = 0; sample < samplesPerPixel; ++sample) {
+                *dstRow++ = static_cast<T>((*sums++ + count / 2) / count);
+              }
+            }
+          }
+        }
+      };
+      switch (image_.bitDepth) {
+        case 8: average.template operator()<uint8_t>(); break;
+        case 16: average.template operator()<uint16_t>(); break;
+        case 32: average.template operator()<uint32_t>(); break;
+        default: throw FormatNotSupportedError("Decimation of " + std::to_string(image_.bitDepth) + "-bit samples");
+      }
+      sums_ = {};
+    }
+
+    template <typename SrcType, typename DstType, typename UnaryOp>
+    void copyPackBitsRectangle(
+      std::span<const std::byte> rectData,    // PackBits encoded pixel data
+      const RectInfo& rectInfo,               // source rectangle info
+      size_t channels,                        // source image channels
+      bool equalsHostByteOrder,               // source data byte order
+      size_t dstPlane,                        // destination plane
+      size_t dstX,                            // destination column
+      size_t dstY,                            // destination row
+      UnaryOp&& op,
+      bool isIdentityOp = false)              // whether op is the identity
+    {
+      PackBitsDecoder decoder(rectData);
+      auto& row = decodeBuffer();
+      row.resize(rectInfo.stride);
+      auto rowInfo = rectInfo;
+      rowInfo.height = 1;
+      for (int y = 0; y < rectInfo.height; ++y) {
+        const size_t rowSize = decoder.decode(row);
+        copyRectangle<SrcType, DstType, UnaryOp>(
+          std::span<const std::byte>(row.data(), rowSize), rowInfo, channels,
+          equalsHostByteOrder, dstPlane, dstX, dstY + y,
+          std::forward<UnaryOp>(op), isIdentityOp);
+      }
+    }
+
+    // Pointer to the destination of the first sample of a pixel
+    template <typename ValueType>
+    ValueType* destination(size_t dstPlane, size_t dstX, size_t dstY)
+    {
+      const size_t dstRowStride = image_.rowStride / sizeof(ValueType);
+      const size_t dstColStride = image_.colStride / sizeof(ValueType);
+      return image_.dataPtr<ValueType>()
+        + dstPlane * dstRowStride * image_.height
+        + dstY * dstRowStride
+        + dstX * dstColStride;
+    }
+
+#ifdef TIFFCRAFT_USE_LIBJPEG
+    template <typename SrcType, typename DstType, typename UnaryOp>
+    void copyJpegRectangle(
+      JpegDecoder& decoder,                   // JPEG decoder of this thread
+      std::span<const std::byte> rectData,    // JPEG encoded pixel data
+      const RectInfo& rectInfo,               // source rectangle info
+      int codedWidth,                         // pixels per encoded row
+      size_t channels,                        // source image channels
+      size_t dstPlane,                        // destination plane
+      size_t dstX,                            // destination column
+      size_t dstY,                            // destination row
+      UnaryOp&& op,
+      bool isIdentityOp = false)              // whether op is the identity
+    {
+      if (rectInfo.bitsPerSample != 8) {
+        throw FormatNotSupportedError("JPEG compression with other than 8 bits per sample");
+      }
+      decoder.setTables(rectInfo.jpegTables);
+      thread_local std::vector<std::byte*> rows;
+      rows.resize(rectInfo.height);
+
+      if constexpr (std::is_same_v<SrcType, uint8_t> && std::is_same_v<DstType, uint8_t>
+                 && std::is_same_v<std::invoke_result_t<UnaryOp, DstType>, uint8_t>) {
+        // Direct path: rows are decoded into the image, unless the
+        // rectangle is clipped by the image border
+        const size_t dstRowStride = image_.rowStride;
+        const bool isDirect = isIdentityOp
+          && codedWidth == rectInfo.width
+          && size_t(image_.colStride) == channels
+          && (channels == 1 || image_.chanStride == 1);
+        if (isDirect) {
+          auto* dst = destination<std::byte>(dstPlane, dstX, dstY);
+          for (int y = 0; y < rectInfo.height; ++y) {
+            rows[y] = dst + y * dstRowStride;
+          }
+          const size_t decoded = decoder.decode(rectData, rows, codedWidth,
+            static_cast<int>(channels), rectInfo.photometric);
+          if (decoded < rows.size()) {
+            throw std::runtime_error("Unexpected end of source tile");
+          }
+          return;
+        }
+      }
+
+      auto& buffer = decodeBuffer();
+      const size_t stride = size_t(codedWidth) * channels;
+      buffer.resize(stride * rectInfo.height);
+      for (int y = 0; y < rectInfo.height; ++y) {
+        rows[y] = buffer.data() + y * stride;
+      }
+      const size_t decoded = decoder.decode(rectData, rows, codedWidth,
+        static_cast<int>(channels), rectInfo.photometric);
+      auto decodedInfo = rectInfo;
+      decodedInfo.stride = static_cast<int>(stride);
+      // samples are bytes, read as big endian words if SrcType is wider
+      copyRectangle<SrcType, DstType, UnaryOp>(
+        std::span<const std::byte>(buffer.data(), decoded * stride), decodedInfo,
+        channels, std::endian::native == std::endian::big, dstPlane, dstX, dstY,
+        std::forward<UnaryOp>(op), isIdentityOp);
+    }
+#endif
+
+    template <typename SrcType, typename DstType, typename UnaryOp>
+    void copyFaxRectangle(
+      std::span<const std::byte> rectData,    // CCITT encoded pixel data
+      const RectInfo& rectInfo,               // source rectangle info
+      int codedWidth,                         // pixels per encoded row
+      size_t channels,                        // source image channels
+      size_t dstPlane,                        // destination plane
+      size_t dstX,                            // destination column
+      size_t dstY,                            // destination row
+      UnaryOp&& op,
+      bool isIdentityOp = false)              // whether op is the identity
+    {
+      if (rectInfo.bitsPerSample != 1 || channels != 1) {
+        throw FormatNotSupportedError("CCITT compression of non-bilevel images");
+      }
+      FaxDecoder decoder(rectData, rectInfo.compression, codedWidth,
+        rectInfo.faxOptions, rectInfo.fillOrder);
+
+      if constexpr (sizeof(SrcType) == 1) {
+        // Run path: each run of white or black pixels is a single fill
+        using ValueType = std::invoke_result_t<UnaryOp, DstType>;
+        const ValueType white = std::invoke(op, static_cast<DstType>(0));
+        const ValueType black = std::invoke(op, static_cast<DstType>(1));
+        const size_t dstRowStride = image_.rowStride / sizeof(ValueType);
+        const size_t dstColStride = image_.colStride / sizeof(ValueType);
+        auto* dst = destination<ValueType>(dstPlane, dstX, dstY);
+        for (int y = 0; y < rectInfo.height; ++y) {
+          FaxDecoder::expandRow(decoder.decodeRow(), rectInfo.width,
+            dst, dstColStride, white, black);
+          dst += dstRowStride;
+        }
+        return;
+      }
+
+      // packed rows are a stream of bytes, i.e. big endian words
+      constexpr bool isHostByteOrder = (std::endian::native == std::endian::big);
+      auto& row = decodeBuffer();
+      row.resize((size_t(codedWidth) + 7) / 8 + sizeof(SrcType));
+      auto rowInfo = rectInfo;
+      rowInfo.height = 1;
+      for (int y = 0; y < rectInfo.height; ++y) {
+        FaxDecoder::packRow(decoder.decodeRow(), codedWidth, row.data());
+        copyRectangle<SrcType, DstType, UnaryOp>(
+          row, rowInfo, channels, isHostByteOrder, dstPlane, dstX, dstY + y,
+          std::forward<UnaryOp>(op), isIdentityOp);
       }
     }
 
     template <typename SrcType, typename DstType, typename UnaryOp>
     void copyRectangle(
-      const std::vector<std::byte>& rectData, // source pixel data
+      std::span<const std::byte> rectData,    // source pixel data
       const RectInfo& rectInfo,               // source rectangle info
       size_t channels,                        // source image channels
       bool equalsHostByteOrder,               // source data byte order
       size_t dstPlane,                        // destination plane
       size_t dstX,                            // destination column
       size_t dstY,                            // destination row
-      UnaryOp&& op)
+      UnaryOp&& op,
+      bool isIdentityOp = false)              // whether op is the identity
     {
       constexpr size_t bitsPerSrcPixel = 8 * sizeof(SrcType);
       const auto* src = rectData.data();
@@ -405,6 +1110,85 @@ namespace TiffCraft {
         + dstY * dstRowStride
         + dstX * dstColStride;
 
+      if constexpr (std::is_same_v<SrcType, DstType>
+                 && std::is_same_v<ValueType, DstType>) {
+        // Verbatim path: rows already have the destination layout
+        const bool isVerbatim = isIdentityOp
+          && rectInfo.bitsPerSample == bitsPerSrcPixel
+          && (equalsHostByteOrder || sizeof(SrcType) == 1)
+          && dstColStride == channels
+          && (channels == 1 || dstChanStride == 1);
+        if (isVerbatim) {
+          const size_t rowBytes = rectInfo.width * channels * sizeof(SrcType);
+          for (int row = 0; row < rectInfo.height; ++row) {
+            if (src + rowBytes > srcEnd) {
+              // We've reached the end of the source tile
+              throw std::runtime_error("Unexpected end of source tile");
+            }
+            std::memcpy(dst, src, rowBytes);
+            src += rectInfo.stride;
+            dst += dstRowStride;
+          }
+          return;
+        }
+      }
+
+      if constexpr (sizeof(SrcType) == 1) {
+        // Lookup path: samples of 1, 2, 4, or 8 bits never straddle bytes, and
+        // `op` is evaluated once per possible sample value
+        const int bits = rectInfo.bitsPerSample;
+        if (bits == 1 || bits == 2 || bits == 4 || bits == 8) {
+          const uint32_t mask = (1u << bits) - 1;
+          std::array<ValueType, 256> lookup;
+          for (uint32_t value = 0; value <= mask; ++value) {
+            lookup[value] = std::invoke(op, static_cast<DstType>(value));
+          }
+          const size_t samples = rectInfo.width * channels;
+          for (int row = 0; row < rectInfo.height; ++row) {
+            if (src >= srcEnd || static_cast<size_t>(srcEnd - src) < (samples * bits + 7) / 8) {
+              // We've reached the end of the source tile
+              throw std::runtime_error("Unexpected end of source tile");
+            }
+            const auto* srcBytes = reinterpret_cast<const uint8_t*>(src);
+            auto* dstRow = dst;
+            if (channels == 1) {
+              // unpack a whole source byte at a time
+              const int perByte = 8 / bits;
+              const int width = rectInfo.width;
+              int col = 0;
+              for (; col + perByte <= width; col += perByte) {
+                const uint32_t byte = *srcBytes++;
+                for (int k = 0; k < perByte; ++k) {
+                  *dstRow = lookup[(byte >> (8 - bits * (k + 1))) & mask];
+                  dstRow += dstColStride;
+                }
+              }
+              for (int k = 0; col < width; ++col, ++k) {
+                *dstRow = lookup[(*srcBytes >> (8 - bits * (k + 1))) & mask];
+                dstRow += dstColStride;
+              }
+              src += rectInfo.stride;
+              dst += dstRowStride;
+              continue;
+            }
+            size_t bit = 0;
+            for (int col = 0; col < rectInfo.width; ++col) {
+              auto* dstChan = dstRow;
+              for (size_t chan = 0; chan < channels; ++chan) {
+                const uint32_t value = (srcBytes[bit >> 3] >> (8 - bits - (bit & 7))) & mask;
+                *dstChan = lookup[value];
+                dstChan += dstChanStride;
+                bit += bits;
+              }
+              dstRow += dstColStride;
+            }
+            src += rectInfo.stride;
+            dst += dstRowStride;
+          }
+          return;
+        }
+      }
+
       const auto* srcRow = src;
       auto* dstRow = dst;
 
@@ -492,6 +1276,8 @@ namespace TiffCraft {
   class TiffExporterGray : public TiffExporter
   {
   public:
+    using TiffExporter::operator();
+
     // Callback for TiffCraft::load() function
     void operator()(
       const TiffImage::Header& header,
@@ -500,8 +1286,8 @@ namespace TiffCraft {
     {
       const int samplesPerPixel = requireSamplesPerPixel(ifd, 1);
       const int photometricInterpretation = requirePhotometricInterpretation(ifd, 1, std::less_equal<>());
-      const int compression = requireCompression(ifd, 1);
-      const int fillOrder = requireFillOrder(ifd, 1);
+      requireCompression(ifd);
+      requireFillOrder(ifd);
 
       const int bitsPerSample = getInt(ifd, Tag::BitsPerSample, 1);
 
@@ -510,20 +1296,33 @@ namespace TiffCraft {
         ? (size_t(1) << bitsPerSample) - 1 : std::numeric_limits<size_t>::max();
 
       const auto rectInfo = getRectInfo(ifd);
-
-      // create the image and copy the pixel data
-      image_ = Image::make<DstType, 1>(getWidth(ifd), getHeight(ifd));
-      using UnaryOp = std::function<DstType(DstType)>;
-      copyRectangles<SrcType,DstType,UnaryOp>(
-        imageData, // source pixel data
-        rectInfo,  // rectangle info
-        1, // source image channels
-        1, // source image planes
-        header.equalsHostByteOrder(), // source data byte order
-        [&](DstType value) -> DstType {
-          return (value * maxDstValue) / maxSrcValue;
-        }
-      );
+      const bool isIdentityOp = (maxSrcValue == maxDstValue);
+
+      // create the image, adopting the source buffer if it can be used as is
+      const auto bounds = copyBounds(ifd, rectInfo);
+      auto verbatimData = takeVerbatimData<SrcType, DstType>(
+        imageData, rectInfo, bounds.width, bounds.height, 1, 1,
+        header.equalsHostByteOrder(), isIdentityOp && !isDecimated());
+      const bool isAdopted = !verbatimData.empty();
+      image_ = Image::make<DstType, 1>(bounds.width, bounds.height, false, std::move(verbatimData));
+
+      // copy the pixel data
+      if (!isAdopted) {
+        countAllocated(image_.dataSize());
+        using UnaryOp = std::function<DstType(DstType)>;
+        copyRectangles<SrcType,DstType,UnaryOp>(
+          imageData, // source pixel data
+          rectInfo,  // rectangle info
+          1, // source image channels
+          1, // source image planes
+          header.equalsHostByteOrder(), // source data byte order
+          [&](DstType value) -> DstType {
+            return (value * maxDstValue) / maxSrcValue;
+          },
+          isIdentityOp
+        );
+      }
+      cropToRegion();
 
       if (photometricInterpretation == 0) { // WhiteIsZero
         invertColors();
@@ -536,6 +1335,8 @@ namespace TiffCraft {
   class TiffExporterPalette : public TiffExporter
   {
   public:
+    using TiffExporter::operator();
+
     // Callback for TiffCraft::load() function
     void operator()(
       const TiffImage::Header& header,
@@ -544,8 +1345,8 @@ namespace TiffCraft {
     {
       const int samplesPerPixel = requireSamplesPerPixel(ifd, 1);
       const int photometricInterpretation = requirePhotometricInterpretation(ifd, 3);
-      const int compression = requireCompression(ifd, 1);
-      const int fillOrder = requireFillOrder(ifd, 1);
+      requireCompression(ifd);
+      requireFillOrder(ifd);
 
       const int bitsPerSample = getInt(ifd, Tag::BitsPerSample, 1);
 
@@ -561,7 +1362,9 @@ namespace TiffCraft {
       const auto rectInfo = getRectInfo(ifd);
 
       // create the image and copy the pixel data
-      image_ = Image::make<DstType, 3>(getWidth(ifd), getHeight(ifd));
+      const auto bounds = copyBounds(ifd, rectInfo);
+      image_ = Image::make<DstType, 3>(bounds.width, bounds.height);
+      countAllocated(image_.dataSize());
       using UnaryOp = std::function<Rgb<DstType>(DstType)>;
       copyRectangles<SrcType,DstType,UnaryOp>(
         imageData, // source pixel data
@@ -577,6 +1380,7 @@ namespace TiffCraft {
           };
         }
       );
+      cropToRegion();
     }
   };
 
@@ -585,6 +1389,8 @@ namespace TiffCraft {
   class TiffExporterRgb : public TiffExporter
   {
   public:
+    using TiffExporter::operator();
+
     // Callback for TiffCraft::load() function
     void operator()(
       const TiffImage::Header& header,
@@ -592,14 +1398,21 @@ namespace TiffCraft {
       TiffImage::ImageData imageData) override
     {
       const int samplesPerPixel = requireSamplesPerPixel(ifd, 3);
-      const int photometricInterpretation = requirePhotometricInterpretation(ifd, 2);
-      const int compression = requireCompression(ifd, 1);
+      const int compression = requireCompression(ifd);
+      // YCbCr is supported when the JPEG decoder converts it to RGB
+      const int photometricInterpretation = requirePhotometricInterpretation(ifd, -1,
+        [&](int value, int) {
+          return value == 2 || (value == 6 && compression == 7);
+        });
 
       const int planarConfiguration = requirePlanarConfiguration(ifd, -1,
         [](int value, int requiredValue) {
           return value == 1 || value == 2; // 1 for Contiguous, 2 for Planar
         });
       const bool isPlanar = (planarConfiguration == 2);
+      if (photometricInterpretation == 6 && isPlanar) {
+        throw FormatNotSupportedError("Planar YCbCr JPEG image");
+      }
 
       const auto bitsPerSampleVec = getIntVec(ifd, Tag::BitsPerSample);
       if (bitsPerSampleVec.size() != 3) {
@@ -618,20 +1431,36 @@ namespace TiffCraft {
         ? (size_t(1) << bitsPerSample) - 1 : std::numeric_limits<size_t>::max();
 
       const auto rectInfo = getRectInfo(ifd);
+      const bool isIdentityOp = (maxSrcValue == maxDstValue);
 
-      // create the image and copy the pixel data
-      image_ = Image::make<DstType, 3>(getWidth(ifd), getHeight(ifd), isPlanar);
-      using UnaryOp = std::function<DstType(DstType)>;
-      copyRectangles<SrcType,DstType,UnaryOp>(
-        imageData, // source pixel data
-        rectInfo,  // rectangle info
+      // create the image, adopting the source buffer if it can be used as is
+      const auto bounds = copyBounds(ifd, rectInfo);
+      auto verbatimData = takeVerbatimData<SrcType, DstType>(
+        imageData, rectInfo, bounds.width, bounds.height,
         isPlanar ? 1 : samplesPerPixel, // source image channels
         isPlanar ? samplesPerPixel : 1, // source image planes
-        header.equalsHostByteOrder(),   // source data byte order
-        [&](DstType value) -> DstType {
-          return (value * maxDstValue) / maxSrcValue;
-        }
-      );
+        header.equalsHostByteOrder(), isIdentityOp && !isDecimated());
+      const bool isAdopted = !verbatimData.empty();
+      image_ = Image::make<DstType, 3>(bounds.width, bounds.height, isPlanar,
+        std::move(verbatimData));
+
+      // copy the pixel data
+      if (!isAdopted) {
+        countAllocated(image_.dataSize());
+        using UnaryOp = std::function<DstType(DstType)>;
+        copyRectangles<SrcType,DstType,UnaryOp>(
+          imageData, // source pixel data
+          rectInfo,  // rectangle info
+          isPlanar ? 1 : samplesPerPixel, // source image channels
+          isPlanar ? samplesPerPixel : 1, // source image planes
+          header.equalsHostByteOrder(),   // source data byte order
+          [&](DstType value) -> DstType {
+            return (value * maxDstValue) / maxSrcValue;
+          },
+          isIdentityOp
+        );
+      }
+      cropToRegion();
     }
   };
 
@@ -640,6 +1469,8 @@ namespace TiffCraft {
   {
     bool exported_ = false;
   public:
+    using TiffExporter::operator();
+
     // Callback for TiffCraft::load() function
     void operator()(
       const TiffImage::Header& header,
@@ -652,18 +1483,18 @@ namespace TiffCraft {
         // grayscale image types
         const int bitsPerSample = getInt(ifd, Tag::BitsPerSample, 1);
         if (bitsPerSample <= 8) {
-          tryToExport<TiffExporterGray<uint8_t>>(header, ifd, imageData);
+          tryToExport<TiffExporterGray<uint8_t>>(header, ifd, std::move(imageData));
         } else if (bitsPerSample <= 15) {
-          tryToExport<TiffExporterGray<uint16_t,uint8_t>>(header, ifd, imageData);
+          tryToExport<TiffExporterGray<uint16_t,uint8_t>>(header, ifd, std::move(imageData));
         } else if (bitsPerSample == 16) {
-          tryToExport<TiffExporterGray<uint16_t>>(header, ifd, imageData);
+          tryToExport<TiffExporterGray<uint16_t>>(header, ifd, std::move(imageData));
         } else if (bitsPerSample <= 31) {
-          tryToExport<TiffExporterGray<uint32_t,uint8_t>>(header, ifd, imageData);
+          tryToExport<TiffExporterGray<uint32_t,uint8_t>>(header, ifd, std::move(imageData));
         } else if (bitsPerSample == 32) {
-          tryToExport<TiffExporterGray<uint32_t>>(header, ifd, imageData);
+          tryToExport<TiffExporterGray<uint32_t>>(header, ifd, std::move(imageData));
         }
-      } else if (photometricInterpretation == 2) {
-        // RGB image types
+      } else if (photometricInterpretation == 2 || photometricInterpretation == 6) {
+        // RGB image types, and YCbCr converted to RGB
         std::vector<int> bitsPerSampleVec = getIntVec(ifd, Tag::BitsPerSample);
         if (bitsPerSampleVec.size() > 0
           && std::any_of(bitsPerSampleVec.begin(), bitsPerSampleVec.end(),
@@ -672,23 +1503,23 @@ namespace TiffCraft {
         }
         const int bitsPerSample = bitsPerSampleVec.empty() ? 1 : bitsPerSampleVec.front();
         if (bitsPerSample <= 8) {
-          tryToExport<TiffExporterRgb<uint8_t>>(header, ifd, imageData);
+          tryToExport<TiffExporterRgb<uint8_t>>(header, ifd, std::move(imageData));
         } else if (bitsPerSample <= 15) {
-          tryToExport<TiffExporterRgb<uint16_t,uint8_t>>(header, ifd, imageData);
+          tryToExport<TiffExporterRgb<uint16_t,uint8_t>>(header, ifd, std::move(imageData));
         } else if (bitsPerSample == 16) {
-          tryToExport<TiffExporterRgb<uint16_t>>(header, ifd, imageData);
+          tryToExport<TiffExporterRgb<uint16_t>>(header, ifd, std::move(imageData));
         } else if (bitsPerSample <= 31) {
-          tryToExport<TiffExporterRgb<uint32_t,uint8_t>>(header, ifd, imageData);
+          tryToExport<TiffExporterRgb<uint32_t,uint8_t>>(header, ifd, std::move(imageData));
         } else if (bitsPerSample == 32) {
-          tryToExport<TiffExporterRgb<uint32_t>>(header, ifd, imageData);
+          tryToExport<TiffExporterRgb<uint32_t>>(header, ifd, std::move(imageData));
         }
       } else if (photometricInterpretation == 3) {
         // palette-color image types
         const int bitsPerSample = getInt(ifd, Tag::BitsPerSample, 1);
         if (bitsPerSample <= 8) {
-          tryToExport<TiffExporterPalette<uint8_t>>(header, ifd, imageData);
+          tryToExport<TiffExporterPalette<uint8_t>>(header, ifd, std::move(imageData));
         } else if (bitsPerSample <= 16) {
-          tryToExport<TiffExporterPalette<uint16_t>>(header, ifd, imageData);
+          tryToExport<TiffExporterPalette<uint16_t>>(header, ifd, std::move(imageData));
         }
       }
 
@@ -708,7 +1539,12 @@ namespace TiffCraft {
         try {
           // Try with the provided exporter
           Exporter exporter;
-          exporter(header, ifd, imageData);
+          // only one exporter is tried for each image, so it can take the data
+          if (region_) {
+            exporter(header, ifd, std::move(imageData), *region_);
+          } else {
+            exporter(header, ifd, std::move(imageData));
+          }
           image_ = exporter.takeImage();
           exported_ = true;
         } catch (const FormatNotSupportedError&) {
@@ -0,0 +1,688 @@
+// BSD 2-Clause License
+// Copyright (c) 2025 Daniel Moreno
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS”
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+// ---------------------------------------------------------------------------
+//
+// TiffFax.hpp
+// ===========
+// This file contains the CCITT codecs used by bilevel TIFF images:
+//
+//   2 = CCITT modified Huffman (one-dimensional, rows byte aligned)
+//   3 = CCITT Group 3 fax (T.4), one or two-dimensional
+//   4 = CCITT Group 4 fax (T.6), two-dimensional
+//
+// Rows are decoded into their changing elements, i.e. the columns where the
+// color changes, starting with a change from white to black. The decoder
+// reads codes with lookup tables indexed by the next 7, 12, or 13 bits of
+// the input, so each code costs one table access. Rows are then written as
+// runs, either as packed 1-bit samples (0 is white) or as 8-bit samples, with
+// one `memset` per run.
+//
+
+#pragma once
+
+#include <stdexcept>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <array>
+#include <span>
+#include <bit>
+
+namespace TiffCraft {
+
+  namespace fax {
+
+    struct Code {
+      uint16_t run;   // run length, or mode
+      uint8_t bits;   // code length
+      uint16_t code;  // code bits, MSB first
+    };
+
+    // Terminating and make-up codes of white runs (T.4, tables 2 and 3)
+    inline constexpr Code WhiteCodes[] = {
+      { 0, 8, 0b00110101 }, { 1, 6, 0b000111 }, { 2, 4, 0b0111 }, { 3, 4, 0b1000 },
+      { 4, 4, 0b1011 }, { 5, 4, 0b1100 }, { 6, 4, 0b1110 }, { 7, 4, 0b1111 },
+      { 8, 5, 0b10011 }, { 9, 5, 0b10100 }, { 10, 5, 0b00111 }, { 11, 5, 0b01000 },
+      { 12, 6, 0b001000 }, { 13, 6, 0b000011 }, { 14, 6, 0b110100 }, { 15, 6, 0b110101 },
+      { 16, 6, 0b101010 }, { 17, 6, 0b101011 }, { 18, 7, 0b0100111 }, { 19, 7, 0b0001100 },
+      { 20, 7, 0b0001000 }, { 21, 7, 0b0010111 }, { 22, 7, 0b0000011 }, { 23, 7, 0b0000100 },
+      { 24, 7, 0b0101000 }, { 25, 7, 0b0101011 }, { 26, 7, 0b0010011 }, { 27, 7, 0b0100100 },
+      { 28, 7, 0b0011000 }, { 29, 8, 0b00000010 }, { 30, 8, 0b00000011 }, { 31, 8, 0b00011010 },
+      { 32, 8, 0b00011011 }, { 33, 8, 0b00010010 }, { 34, 8, 0b00010011 }, { 35, 8, 0b00010100 },
+      { 36, 8, 0b00010101 }, { 37, 8, 0b00010110 }, { 38, 8, 0b00010111 }, { 39, 8, 0b00101000 },
+      { 40, 8, 0b00101001 }, { 41, 8, 0b00101010 }, { 42, 8, 0b00101011 }, { 43, 8, 0b00101100 },
+      { 44, 8, 0b00101101 }, { 45, 8, 0b00000100 }, { 46, 8, 0b00000101 }, { 47, 8, 0b00001010 },
+      { 48, 8, 0b00001011 }, { 49, 8, 0b01010010 }, { 50, 8, 0b01010011 }, { 51, 8, 0b01010100 },
+      { 52, 8, 0b01010101 }, { 53, 8, 0b00100100 }, { 54, 8, 0b00100101 }, { 55, 8, 0b01011000 },
+      { 56, 8, 0b01011001 }, { 57, 8, 0b01011010 }, { 58, 8, 0b01011011 }, { 59, 8, 0b01001010 },
+      { 60, 8, 0b01001011 }, { 61, 8, 0b00110010 }, { 62, 8, 0b00110011 }, { 63, 8, 0b00110100 },
+      { 64, 5, 0b11011 }, { 128, 5, 0b10010 }, { 192, 6, 0b010111 }, { 256, 7, 0b0110111 },
+      { 320, 8, 0b00110110 }, { 384, 8, 0b00110111 }, { 448, 8, 0b01100100 }, { 512, 8, 0b01100101 },
+      { 576, 8, 0b01101000 }, { 640, 8, 0b01100111 }, { 704, 9, 0b011001100 }, { 768, 9, 0b011001101 },
+      { 832, 9, 0b011010010 }, { 896, 9, 0b011010011 }, { 960, 9, 0b011010100 }, { 1024, 9, 0b011010101 },
+      { 1088, 9, 0b011010110 }, { 1152, 9, 0b011010111 }, { 1216, 9, 0b011011000 }, { 1280, 9, 0b011011001 },
+      { 1344, 9, 0b011011010 }, { 1408, 9, 0b011011011 }, { 1472, 9, 0b010011000 }, { 1536, 9, 0b010011001 },
+      { 1600, 9, 0b010011010 }, { 1664, 6, 0b011000 }, { 1728, 9, 0b010011011 },
+    };
+
+    // Terminating and make-up codes of black runs (T.4, tables 2 and 3)
+    inline constexpr Code BlackCodes[] = {
+      { 0, 10, 0b0000110111 }, { 1, 3, 0b010 }, { 2, 2, 0b11 }, { 3, 2, 0b10 },
+      { 4, 3, 0b011 }, { 5, 4, 0b0011 }, { 6, 4, 0b0010 }, { 7, 5, 0b00011 },
+      { 8, 6, 0b000101 }, { 9, 6, 0b000100 }, { 10, 7, 0b0000100 }, { 11, 7, 0b0000101 },
+      { 12, 7, 0b0000111 }, { 13, 8, 0b00000100 }, { 14, 8, 0b00000111 }, { 15, 9, 0b000011000 },
+      { 16, 10, 0b0000010111 }, { 17, 10, 0b0000011000 }, { 18, 10, 0b0000001000 }, { 19, 11, 0b00001100111 },
+      { 20, 11, 0b00001101000 }, { 21, 11, 0b00001101100 }, { 22, 11, 0b00000110111 }, { 23, 11, 0b00000101000 },
+      { 24, 11, 0b00000010111 }, { 25, 11, 0b00000011000 }, { 26, 12, 0b000011001010 }, { 27, 12, 0b000011001011 },
+      { 28, 12, 0b000011001100 }, { 29, 12, 0b000011001101 }, { 30, 12, 0b000001101000 }, { 31, 12, 0b000001101001 },
+      { 32, 12, 0b000001101010 }, { 33, 12, 0b000001101011 }, { 34, 12, 0b000011010010 }, { 35, 12, 0b000011010011 },
+      { 36, 12, 0b000011010100 }, { 37, 12, 0b000011010101 }, { 38, 12, 0b000011010110 }, { 39, 12, 0b000011010111 },
+      { 40, 12, 0b000001101100 }, { 41, 12, 0b000001101101 }, { 42, 12, 0b000011011010 }, { 43, 12, 0b000011011011 },
+      { 44, 12, 0b000001010100 }, { 45, 12, 0b000001010101 }, { 46, 12, 0b000001010110 }, { 47, 12, 0b000001010111 },
+      { 48, 12, 0b000001100100 }, { 49, 12, 0b000001100101 }, { 50, 12, 0b000001010010 }, { 51, 12, 0b000001010011 },
+      { 52, 12, 0b000000100100 }, { 53, 12, 0b000000110111 }, { 54, 12, 0b000000111000 }, { 55, 12, 0b000000100111 },
+      { 56, 12, 0b000000101000 }, { 57, 12, 0b000001011000 }, { 58, 12, 0b000001011001 }, { 59, 12, 0b000000101011 },
+      { 60, 12, 0b000000101100 }, { 61, 12, 0b000001011010 }, { 62, 12, 0b000001100110 }, { 63, 12, 0b000001100111 },
+      { 64, 10, 0b0000001111 }, { 128, 12, 0b000011001000 }, { 192, 12, 0b000011001001 }, { 256, 12, 0b000001011011 },
+      { 320, 12, 0b000000110011 }, { 384, 12, 0b000000110100 }, { 448, 12, 0b000000110101 }, { 512, 13, 0b0000001101100 },
+      { 576, 13, 0b0000001101101 }, { 640, 13, 0b0000001001010 }, { 704, 13, 0b0000001001011 }, { 768, 13, 0b0000001001100 },
+      { 832, 13, 0b0000001001101 }, { 896, 13, 0b0000001110010 }, { 960, 13, 0b0000001110011 }, { 1024, 13, 0b0000001110100 },
+      { 1088, 13, 0b0000001110101 }, { 1152, 13, 0b0000001110110 }, { 1216, 13, 0b0000001110111 }, { 1280, 13, 0b0000001010010 },
+      { 1344, 13, 0b0000001010011 }, { 1408, 13, 0b0000001010100 }, { 1472, 13, 0b0000001010101 }, { 1536, 13, 0b0000001011010 },
+      { 1600, 13, 0b0000001011011 }, { 1664, 13, 0b0000001100100 }, { 1728, 13, 0b0000001100101 },
+    };
+
+    // Make-up codes shared by white and black runs (T.4, table 4)
+    inline constexpr Code ExtendedCodes[] = {
+      { 1792, 11, 0b00000001000 }, { 1856, 11, 0b00000001100 }, { 1920, 11, 0b00000001101 },
+      { 1984, 12, 0b000000010010 }, { 2048, 12, 0b000000010011 }, { 2112, 12, 0b000000010100 },
+      { 2176, 12, 0b000000010101 }, { 2240, 12, 0b000000010110 }, { 2304, 12, 0b000000010111 },
+      { 2368, 12, 0b000000011100 }, { 2432, 12, 0b000000011101 }, { 2496, 12, 0b000000011110 },
+      { 2560, 12, 0b000000011111 },
+    };
+
+    // Two-dimensional coding modes (T.4, table 5)
+    enum Mode : uint16_t {
+      Pass, Horizontal, V0, VR1, VR2, VR3, VL1, VL2, VL3, Invalid
+    };
+
+    inline constexpr Code ModeCodes[] = {
+      { Pass, 4, 0b0001 }, { Horizontal, 3, 0b001 }, { V0, 1, 0b1 },
+      { VR1, 3, 0b011 }, { VR2, 6, 0b000011 }, { VR3, 7, 0b0000011 },
+      { VL1, 3, 0b010 }, { VL2, 6, 0b000010 }, { VL3, 7, 0b0000010 },
+    };
+
+    inline constexpr uint32_t EolCode = 0b000000000001;
+    inline constexpr uint32_t EolBits = 12;
+
+    // Entry of a lookup table indexed by the next `Bits` bits of the input.
+    // Entries with zero bits are codes that are not in the table.
+    struct Entry {
+      uint16_t run;
+      uint8_t bits;
+      uint8_t isMakeup;
+    };
+
+    template <int Bits>
+    using Table = std::array<Entry, size_t(1) << Bits>;
+
+    template <int Bits>
+    void addCodes(Table<Bits>& table, std::span<const Code> codes) {
+      for (const auto& code : codes) {
+        const uint32_t first = uint32_t(code.code) << (Bits - code.bits);
+        const uint32_t count = 1u << (Bits - code.bits);
+        for (uint32_t i = first; i < first + count; ++i) {
+          if (table[i].bits != 0) {
+            throw std::logic_error("CCITT codes are not prefix free");
+          }
+          table[i] = { code.run, code.bits, static_cast<uint8_t>(code.run >= 64) };
+        }
+      }
+    }
+
+    template <int Bits>
+    Table<Bits> makeRunTable(std::span<const Code> codes) {
+      Table<Bits> table{};
+      addCodes<Bits>(table, codes);
+      addCodes<Bits>(table, ExtendedCodes);
+      return table;
+    }
+
+    inline const Table<12>& whiteTable() {
+      static const auto table = makeRunTable<12>(WhiteCodes);
+      return table;
+    }
+
+    inline const Table<13>& blackTable() {
+      static const auto table = makeRunTable<13>(BlackCodes);
+      return table;
+    }
+
+    inline const Table<7>& modeTable() {
+      static const auto table = []() {
+        Table<7> table{};
+        addCodes<7>(table, ModeCodes);
+        for (auto& entry : table) {
+          if (entry.bits == 0) {
+            entry.run = Invalid; // extensions and EOL
+          }
+        }
+        return table;
+      }();
+      return table;
+    }
+
+    inline uint64_t byteswap(uint64_t value) {
+      value = ((value & 0x00FF00FF00FF00FFull) << 8) | ((value >> 8) & 0x00FF00FF00FF00FFull);
+      value = ((value & 0x0000FFFF0000FFFFull) << 16) | ((value >> 16) & 0x0000FFFF0000FFFFull);
+      return (value << 32) | (value >> 32);
+    }
+
+    [[noreturn]] inline void throwCorrupted() {
+      throw std::runtime_error("Corrupted CCITT data");
+    }
+
+    // Sets the bits of columns [x0, x1) of a packed row
+    inline void setBits(uint8_t* row, size_t x0, size_t x1) {
+      if (x0 >= x1) {
+        return;
+      }
+      const size_t first = x0 >> 3;
+      const size_t last = (x1 - 1) >> 3;
+      const uint8_t firstMask = 0xFF >> (x0 & 7);
+      const uint8_t lastMask = 0xFF << (7 - ((x1 - 1) & 7));
+      if (first == last) {
+        row[first] |= firstMask & lastMask;
+        return;
+      }
+      row[first] |= firstMask;
+      std::memset(row + first + 1, 0xFF, last - first - 1);
+      row[last] |= lastMask;
+    }
+
+  } // namespace fax
+
+  class FaxDecoder
+  {
+  public:
+    // T4Options and T6Options flags
+    static constexpr uint32_t TwoDimensional = 0x1;   // T4Options only
+    static constexpr uint32_t Uncompressed = 0x2;
+    static constexpr uint32_t FillBits = 0x4;         // T4Options only
+
+    // Decodes the strip or tile `in` of `width` pixels per row. `options` is
+    // the value of T4Options (Compression=3) or T6Options (Compression=4).
+    // FillOrder=2 data, with the bits of each byte reversed, is supported.
+    FaxDecoder(std::span<const std::byte> in, int compression, int width,
+      uint32_t options = 0, int fillOrder = 1)
+      : src_(reinterpret_cast<const uint8_t*>(in.data())),
+        srcEnd_(src_ + in.size()),
+        bitsLeft_(int64_t(in.size()) * 8),
+        compression_(compression),
+        width_(width),
+        options_(options),
+        bitOrder_(fillOrder == 2 ? reversedBits() : identityBits())
+    {
+      if (compression < 2 || compression > 4) {
+        throw std::runtime_error("Unsupported CCITT compression: " + std::to_string(compression));
+      }
+      if (options & Uncompressed) {
+        throw std::runtime_error("CCITT uncompressed mode is not supported");
+      }
+      if (width <= 0) {
+        throw std::runtime_error("Invalid CCITT row width");
+      }
+      // the reference line of the first row is all white
+      ref_.assign(3, width);
+      cur_.reserve(width + 3);
+    }
+
+    int width() const { return width_; }
+
+    // Decodes the next row and returns its changing elements
+    std::span<const int> decodeRow()
+    {
+      cur_.clear();
+      if (compression_ == 2) {
+        decode1D();
+        skipToByte(); // modified Huffman rows are byte aligned
+      } else if (compression_ == 3) {
+        bool is1D = true;
+        skipEol();
+        if (options_ & TwoDimensional) {
+          refill();
+          is1D = peek(1) != 0; // tag bit after EOL
+          skip(1);
+        }
+        if (is1D) {
+          decode1D();
+        } else {
+          decode2D();
+        }
+      } else {
+        decode2D();
+      }
+      if (bitsLeft_ < 0) {
+        throw std::runtime_error("Unexpected end of CCITT data");
+      }
+      std::swap(cur_, ref_);
+      const size_t count = ref_.size();
+      ref_.insert(ref_.end(), 3, width_); // sentinels
+      return std::span<const int>(ref_.data(), count);
+    }
+
+    // Decodes rows as packed 1-bit samples, 0 for white, with rows starting on
+    // byte boundaries. Stops when `out` is full and returns the bytes written.
+    size_t decode(std::span<std::byte> out)
+    {
+      const size_t stride = (size_t(width_) + 7) / 8;
+      size_t pos = 0;
+      for (; pos + stride <= out.size(); pos += stride) {
+        packRow(decodeRow(), width_, out.data() + pos);
+      }
+      return pos;
+    }
+
+    // Writes a row of changing elements as packed 1-bit samples
+    static void packRow(std::span<const int> changes, int width, std::byte* row)
+    {
+      auto* bytes = reinterpret_cast<uint8_t*>(row);
+      std::memset(bytes, 0, (size_t(width) + 7) / 8);
+      for (size_t i = 0; i < changes.size(); i += 2) {
+        const int end = (i + 1 < changes.size()) ? changes[i + 1] : width;
+        fax::setBits(bytes, std::min(changes[i], width), std::min(end, width));
+      }
+    }
+
+    // Writes a row of changing elements as one value per pixel, `step`
+    // values apart. Changes past `width` are ignored, e.g. when a tile is
+    // clipped by the image border.
+    template <typename T>
+    static void expandRow(std::span<const int> changes, int width, T* row,
+      size_t step, T white, T black)
+    {
+      auto fill = [&](int x0, int x1, T value) {
+        if (step == 1) {
+          std::fill(row + x0, row + x1, value);
+        } else {
+          for (int x = x0; x < x1; ++x) {
+            row[x * step] = value;
+          }
+        }
+      };
+      int x = 0;
+      size_t i = 0;
+      for (; i < changes.size() && changes[i] < width; ++i) {
+        fill(x, changes[i], (i & 1) ? black : white);
+        x = changes[i];
+      }
+      fill(x, width, (i & 1) ? black : white);
+    }
+
+  private:
+    const uint8_t* src_;
+    const uint8_t* srcEnd_;
+    int64_t bitsLeft_;      // input bits not consumed yet
+    uint64_t bitBuffer_ = 0;
+    int bitCount_ = 0;
+    int compression_;
+    int width_;
+    uint32_t options_;
+    const uint8_t* bitOrder_;
+    std::vector<int> ref_;  // changing elements of the reference line
+    std::vector<int> cur_;  // changing elements of the coding line
+
+    static const uint8_t* identityBits() {
+      static const auto table = []() {
+        std::array<uint8_t, 256> table;
+        for (int i = 0; i < 256; ++i) { table[i] = static_cast<uint8_t>(i); }
+        return table;
+      }();
+      return table.data();
+    }
+
+    static const uint8_t* reversedBits() {
+      static const auto table = []() {
+        std::array<uint8_t, 256> table;
+        for (int i = 0; i < 256; ++i) {
+          uint8_t r = 0;
+          for (int b = 0; b < 8; ++b) { r |= ((i >> b) & 1) << (7 - b); }
+          table[i] = r;
+        }
+        return table;
+      }();
+      return table.data();
+    }
+
+    // Fills the bit buffer with at least 56 bits, zero past the end
+    void refill()
+    {
+      if (bitCount_ > 56) {
+        return;
+      }
+      if (srcEnd_ - src_ >= 8 && bitOrder_ == identityBits()) {
+        // load whole bytes of a big endian word at once
+        uint64_t word;
+        std::memcpy(&word, src_, sizeof(word));
+        if constexpr (std::endian::native == std::endian::little) {
+          word = fax::byteswap(word);
+        }
+        const int bytes = (63 - bitCount_) >> 3;
+        bitBuffer_ |= word >> bitCount_;
+        src_ += bytes;
+        bitCount_ += bytes * 8;
+        bitBuffer_ &= ~uint64_t(0) << (64 - bitCount_);
+        return;
+      }
+      while (bitCount_ <= 56) {
+        const uint64_t byte = (src_ < srcEnd_) ? bitOrder_[*src_++] : 0;
+        bitBuffer_ |= byte << (56 - bitCount_);
+        bitCount_ += 8;
+      }
+    }
+
+    uint32_t peek(int bits) const {
+      return static_cast<uint32_t>(bitBuffer_ >> (64 - bits));
+    }
+
+    // Past the end of the input, zeros are read: they are not a valid code,
+    // so decoding stops soon, and `decodeRow()` checks `bitsLeft_`
+    void skip(int bits) {
+      bitBuffer_ <<= bits;
+      bitCount_ -= bits;
+      bitsLeft_ -= bits;
+    }
+
+    void skipToByte() {
+      const int extra = static_cast<int>(bitsLeft_ & 7);
+      if (extra > 0 && bitsLeft_ > 0) {
+        skip(extra);
+      }
+    }
+
+    // Skips an EOL code and the fill bits before it, if present
+    void skipEol()
+    {
+      refill();
+      if (peek(fax::EolBits - 1) != 0) {
+        return;
+      }
+      // at least 11 zeros: an EOL, maybe after fill bits
+      while (bitsLeft_ > 0) {
+        refill();
+        if (bitBuffer_ == 0) {
+          skip(bitCount_);
+          continue;
+        }
+        skip(std::countl_zero(bitBuffer_) + 1);
+        return;
+      }
+    }
+
+    template <int Bits>
+    int readRun(const fax::Table<Bits>& table)
+    {
+      int run = 0;
+      for (;;) {
+        refill();
+        const fax::Entry entry = table[peek(Bits)];
+        if (entry.bits == 0) {
+          fax::throwCorrupted();
+        }
+        skip(entry.bits);
+        run += entry.run;
+        if (!entry.isMakeup) {
+          return run;
+        }
+      }
+    }
+
+    int readRun(bool isBlack) {
+      return isBlack ? readRun<13>(fax::blackTable()) : readRun<12>(fax::whiteTable());
+    }
+
+    void addChange(int x) {
+      if (x < width_) {
+        cur_.push_back(x);
+      }
+    }
+
+    void decode1D()
+    {
+      int x = 0;
+      bool isBlack = false;
+      while (x < width_) {
+        x += readRun(isBlack);
+        if (x > width_) {
+          fax::throwCorrupted();
+        }
+        addChange(x);
+        isBlack = !isBlack;
+      }
+    }
+
+    void decode2D()
+    {
+      const auto& modes = fax::modeTable();
+      const int* ref = ref_.data();
+      int a0 = -1;          // -1 is the imaginary white pixel before the row
+      bool isBlack = false; // color of a0
+      size_t b = 0;         // index of b1; even when a0 is white
+      while (a0 < width_) {
+        // b1 is the first change on the reference line after a0 to the
+        // opposite color of a0
+        while (ref[b] <= a0) {
+          b += 2;
+        }
+        refill();
+        const fax::Entry entry = modes[peek(7)];
+        skip(entry.bits);
+        switch (entry.run) {
+          case fax::Pass:
+            a0 = ref[b + 1];
+            b += 2;
+            break;
+          case fax::Horizontal: {
+            const int a1 = std::max(a0, 0) + readRun(isBlack);
+            const int a2 = a1 + readRun(!isBlack);
+            if (a2 > width_) {
+              fax::throwCorrupted();
+            }
+            addChange(a1);
+            addChange(a2);
+            a0 = a2;
+            break;
+          }
+          case fax::Invalid:
+            fax::throwCorrupted();
+          default: {
+            // vertical modes: a1 is b1 shifted by -3 to 3
+            static constexpr int Shifts[] = { 0, 0, 0, 1, 2, 3, -1, -2, -3 };
+            const int a1 = ref[b] + Shifts[entry.run];
+            if (a1 < std::max(a0, 0) || a1 > width_) {
+              fax::throwCorrupted();
+            }
+            addChange(a1);
+            a0 = a1;
+            isBlack = !isBlack;
+            b = (b > 0) ? b - 1 : b + 1;
+            break;
+          }
+        }
+      }
+    }
+  };
+
+  class FaxEncoder
+  {
+  public:
+    // Encodes rows of `width` packed 1-bit samples (0 is white). `options`
+    // is the value of T4Options or T6Options. Two-dimensional Group 3 data
+    // codes one row in `k` one-dimensionally.
+    FaxEncoder(int compression, int width, uint32_t options = 0, int k = 4)
+      : compression_(compression), width_(width), options_(options), k_(k) {}
+
+    std::vector<std::byte> encode(std::span<const std::byte> rows)
+    {
+      out_.clear();
+      bitBuffer_ = 0;
+      bitCount_ = 0;
+      const size_t stride = (size_t(width_) + 7) / 8;
+      ref_.assign(3, width_);
+      for (size_t y = 0; y * stride + stride <= rows.size(); ++y) {
+        rowChanges(reinterpret_cast<const uint8_t*>(rows.data()) + y * stride);
+        if (compression_ == 2) {
+          encode1D();
+          flushByte();
+        } else if (compression_ == 3) {
+          const bool is2D = (options_ & FaxDecoder::TwoDimensional) != 0;
+          const bool is1D = !is2D || (y % k_ == 0);
+          putEol();
+          if (is2D) {
+            putBits(is1D ? 1 : 0, 1);
+          }
+          is1D ? encode1D() : encode2D();
+        } else {
+          encode2D();
+        }
+        std::swap(cur_, ref_);
+      }
+      if (compression_ == 4) {
+        putBits(fax::EolCode, fax::EolBits); // EOFB
+        putBits(fax::EolCode, fax::EolBits);
+      }
+      flushByte();
+      return std::move(out_);
+    }
+
+  private:
+    int compression_;
+    int width_;
+    uint32_t options_;
+    int k_;
+    std::vector<std::byte> out_;
+    uint32_t bitBuffer_ = 0;
+    int bitCount_ = 0;
+    std::vector<int> ref_;
+    std::vector<int> cur_;
+
+    void putBits(uint32_t code, int bits) {
+      bitBuffer_ = (bitBuffer_ << bits) | code;
+      bitCount_ += bits;
+      while (bitCount_ >= 8) {
+        bitCount_ -= 8;
+        out_.push_back(static_cast<std::byte>(bitBuffer_ >> bitCount_));
+      }
+    }
+
+    void flushByte() {
+      if (bitCount_ > 0) {
+        putBits(0, 8 - bitCount_);
+      }
+    }
+
+    void putEol() {
+      if (options_ & FaxDecoder::FillBits) {
+        // pad with zeros so that the EOL ends on a byte boundary
+        putBits(0, (8 + 4 - bitCount_) % 8);
+      }
+      putBits(fax::EolCode, fax::EolBits);
+    }
+
+    void putCode(const fax::Code& code) {
+      putBits(code.code, code.bits);
+    }
+
+    void putRun(int run, bool isBlack) {
+      const auto& codes = isBlack ? fax::BlackCodes : fax::WhiteCodes;
+      while (run >= 2560) {
+        putCode(fax::ExtendedCodes[12]);
+        run -= 2560;
+      }
+      if (run >= 1792) {
+        putCode(fax::ExtendedCodes[run / 64 - 28]);
+      } else if (run >= 64) {
+        putCode(codes[63 + run / 64]);
+      }
+      putCode(codes[run % 64]);
+    }
+
+    void rowChanges(const uint8_t* row) {
+      cur_.clear();
+      bool isBlack = false;
+      for (int x = 0; x < width_; ++x) {
+        const bool pixel = (row[x >> 3] >> (7 - (x & 7))) & 1;
+        if (pixel != isBlack) {
+          cur_.push_back(x);
+          isBlack = pixel;
+        }
+      }
+      cur_.insert(cur_.end(), 3, width_);
+    }
+
+    void encode1D() {
+      int x = 0;
+      for (size_t i = 0; x < width_; ++i) {
+        putRun(cur_[i] - x, i & 1);
+        x = cur_[i];
+      }
+    }
+
+    void encode2D() {
+      int a0 = -1;
+      bool isBlack = false;
+      size_t a = 0; // index of a1
+      size_t b = 0; // index of b1
+      while (a0 < width_) {
+        while (cur_[a] <= a0) { a += 2; }
+        while (ref_[b] <= a0) { b += 2; }
+        const int a1 = cur_[a];
+        const int b1 = ref_[b];
+        const int b2 = ref_[b + 1];
+        if (b2 < a1) {
+          putCode(fax::ModeCodes[fax::Pass]);
+          a0 = b2;
+        } else if (std::abs(a1 - b1) <= 3) {
+          static constexpr fax::Mode Modes[] = {
+            fax::VL3, fax::VL2, fax::VL1, fax::V0, fax::VR1, fax::VR2, fax::VR3 };
+          putCode(fax::ModeCodes[Modes[a1 - b1 + 3]]);
+          a0 = a1;
+          isBlack = !isBlack;
+          a += 1;
+          b = (b > 0) ? b - 1 : b + 1;
+        } else {
+          const int a2 = cur_[a + 1];
+          putCode(fax::ModeCodes[fax::Horizontal]);
+          putRun(a1 - std::max(a0, 0), isBlack);
+          putRun(a2 - a1, !isBlack);
+          a0 = a2;
+        }
+      }
+    }
+  };
+
+} // namespace TiffCraft
@@ -56,7 +56,13 @@
 
 #pragma once
 
+#include "TiffTileCache.hpp"
+#include "TiffStats.hpp"
+#include "TiffTrace.hpp"
+
 #include <type_traits>
+#include <algorithm>
+#include <cmath>
 #include <functional>
 #include <stdexcept>
 #include <optional>
@@ -68,6 +74,7 @@
 #include <string>
 #include <vector>
 #include <span>
+#include <mutex>
 #include <map>
 #include <bit>
 
@@ -133,17 +140,23 @@ namespace TiffCraft {
     YResolution = 0x011B,
     PlanarConfiguration = 0x011C,
     PageName = 0x011D,
+    T4Options = 0x0124,
+    T6Options = 0x0125,
     ResolutionUnit = 0x0128,
     Software = 0x0131,
     DateTime = 0x0132,
     Artist = 0x013B,
+    Predictor = 0x013D,
     ColorMap = 0x0140,
     HalftoneHints = 0x0141,
     TileWidth = 0x0142,
     TileLength = 0x0143,
     TileOffsets = 0x0144,
     TileByteCounts = 0x0145,
+    SubIFDs = 0x014A,
+    ExtraSamples = 0x0152,
     SampleFormat = 0x0153,
+    JPEGTables = 0x015B,
   };
 
   template <typename T>
@@ -185,6 +198,10 @@ namespace TiffCraft {
   //      fraction, the second the denominator.
   // 11 = FLOAT Single precision (4-byte) IEEE format.
   // 12 = DOUBLE Double precision (8-byte) IEEE format
+  // 13 = IFD A 32-bit (4-byte) offset of a child IFD.
+  // 16 = LONG8 64-bit (8-byte) unsigned integer (BigTIFF).
+  // 17 = SLONG8 64-bit (8-byte) signed integer (BigTIFF).
+  // 18 = IFD8 A 64-bit (8-byte) offset of a child IFD (BigTIFF).
   enum class Type : uint16_t {
     BYTE = 1,
     ASCII = 2,
@@ -197,7 +214,11 @@ namespace TiffCraft {
     SLONG = 9,
     SRATIONAL = 10,
     FLOAT = 11,
-    DOUBLE = 12
+    DOUBLE = 12,
+    IFD = 13,
+    LONG8 = 16,
+    SLONG8 = 17,
+    IFD8 = 18
   };
 
   template <Type type> struct TypeTraits;
@@ -213,6 +234,10 @@ namespace TiffCraft {
   template <> struct TypeTraits<Type::SRATIONAL> { using type = SRational; };
   template <> struct TypeTraits<Type::FLOAT> { using type = float; };
   template <> struct TypeTraits<Type::DOUBLE> { using type = double; };
+  template <> struct TypeTraits<Type::IFD> { using type = uint32_t; };
+  template <> struct TypeTraits<Type::LONG8> { using type = uint64_t; };
+  template <> struct TypeTraits<Type::SLONG8> { using type = int64_t; };
+  template <> struct TypeTraits<Type::IFD8> { using type = uint64_t; };
 
   template <Type type> using TypeTraits_t = typename TypeTraits<type>::type;
 
@@ -231,6 +256,10 @@ namespace TiffCraft {
       case Type::SRATIONAL: return f.template operator()<Type::SRATIONAL>();
       case Type::FLOAT:     return f.template operator()<Type::FLOAT>();
       case Type::DOUBLE:    return f.template operator()<Type::DOUBLE>();
+      case Type::IFD:       return f.template operator()<Type::IFD>();
+      case Type::LONG8:     return f.template operator()<Type::LONG8>();
+      case Type::SLONG8:    return f.template operator()<Type::SLONG8>();
+      case Type::IFD8:      return f.template operator()<Type::IFD8>();
       default:
         throw std::runtime_error("Unknown TIFF entry type");
     }
@@ -400,9 +429,14 @@ namespace TiffCraft {
     return stream;
   }
 
+  class TiffIndex;
+
   class TiffImage {
   public:
 
+    // Selects the tags whose out-of-line values are read
+    using TagFilter = std::function<bool(Tag)>;
+
     // Header class
     // ============
     // A TIFF file begins with an 8-byte image file header:
@@ -420,9 +454,14 @@ namespace TiffCraft {
     // - Bytes 4-7 The offset (in bytes) of the first IFD. The directory may be
     //   at any location in the file after the header but must begin on a word
     //   boundary.
+    //
+    // BigTIFF files use 43 as magic number, followed by the size of offsets
+    // (always 8), two zero bytes, and the 8-byte offset of the first IFD.
     class Header {
       std::endian byteOrder_;
-      uint32_t firstIFDOffset_;
+      bool isBigTiff_ = false;
+      uint64_t firstIFDOffset_;
+      friend class TiffIndex;
     public:
       std::endian byteOrder() const { return byteOrder_; }
 
@@ -430,9 +469,12 @@ namespace TiffCraft {
         return std::endian::native == byteOrder_;
       }
 
-      uint32_t firstIFDOffset() const { return firstIFDOffset_; }
+      bool isBigTiff() const { return isBigTiff_; }
+
+      uint64_t firstIFDOffset() const { return firstIFDOffset_; }
 
       static Header read(std::istream& stream) {
+        TIFFCRAFT_TRACE_SCOPE("read header");
         Header header;
 
         // Byte order
@@ -448,12 +490,26 @@ namespace TiffCraft {
 
         // Magic number
         uint16_t magicNumber = readValue<uint16_t>(stream, mustSwap);
-        if (magicNumber != 42) {
+        if (magicNumber != 42 && magicNumber != 43) {
           throw std::runtime_error("Invalid magic number in TIFF header");
         }
+        header.isBigTiff_ = (magicNumber == 43);
 
         // First IFD offset
-        uint32_t firstIFDOffset = readValue<uint32_t>(stream, mustSwap);
+        uint64_t firstIFDOffset = 0;
+        if (header.isBigTiff_) {
+          const uint16_t offsetBytes = readValue<uint16_t>(stream, mustSwap);
+          const uint16_t reserved = readValue<uint16_t>(stream, mustSwap);
+          if (offsetBytes != 8 || reserved != 0) {
+            throw std::runtime_error("Invalid BigTIFF header");
+          }
+          firstIFDOffset = readValue<uint64_t>(stream, mustSwap);
+        } else {
+          firstIFDOffset = readValue<uint32_t>(stream, mustSwap);
+        }
+        if (!stream) {
+          throw std::runtime_error("Truncated TIFF header");
+        }
         if (firstIFDOffset < 8) { // Minimum size of TIFF header
           throw std::runtime_error("Invalid first IFD offset in TIFF header");
         }
@@ -511,64 +567,83 @@ namespace TiffCraft {
       // Types
       // -----
       // The field types and their sizes are defined in the `Type` enum.
+      //
+      // BigTIFF entries are 20 bytes long: the Count and the Value Offset
+      // take 8 bytes each, and values up to 8 bytes are stored inline.
+      //
+      // Values stored out of line are not read when the tag filter passed to
+      // `read()` rejects the tag. Such entries keep their type, count, and
+      // value offset, but `isLoaded()` is false and they have no values.
       class Entry {
       public:
         Tag tag() const { return tag_; }
         Type type() const { return type_; }
         uint32_t count() const { return count_; }
         const std::byte* values() const { return values_.data(); }
+        bool isLoaded() const { return values_.size() == bytes(); }
+        uint64_t valueOffset() const { return valueOffset_; }
 
         template <typename T>
         std::span<const T> values() const {
           if (sizeof(T) != TiffCraft::typeBytes(type_)) {
             throw std::runtime_error("Invalid type size for values span");
           }
+          if (!isLoaded()) {
+            throw std::runtime_error("Values of TIFF entry were not read");
+          }
           return std::span<const T>(reinterpret_cast<const T*>(values_.data()), count());
         }
 
         uint32_t bytes() const { return count() * TiffCraft::typeBytes(type_); }
 
-        static Entry read(std::istream& stream, bool mustSwap = false) {
+        static Entry read(std::istream& stream, bool mustSwap = false,
+          bool isBigTiff = false, const TagFilter& filter = {}) {
           Entry entry;
           entry.tag_ = static_cast<Tag>(readValue<uint16_t>(stream, mustSwap));
           entry.type_ = static_cast<Type>(readValue<uint16_t>(stream, mustSwap));
-          entry.count_ = readValue<uint32_t>(stream, mustSwap);
+          const uint64_t count = isBigTiff ? readValue<uint64_t>(stream, mustSwap)
+            : readValue<uint32_t>(stream, mustSwap);
+          if (count > UINT32_MAX / 8) {
+            throw std::runtime_error("Too many values in TIFF entry");
+          }
+          entry.count_ = static_cast<uint32_t>(count);
 
           // Read the value
           const uint32_t valueSize = entry.bytes();
-          entry.values_.resize(valueSize);
-          if (valueSize <= sizeof(uint32_t)) {
-            // Value fits in 4 bytes, read directly
-            const uint32_t value = readValue<uint32_t>(stream);
-            std::memcpy(entry.values_.data(), &value, valueSize);
+          const uint32_t inlineSize = isBigTiff ? sizeof(uint64_t) : sizeof(uint32_t);
+          if (valueSize <= inlineSize) {
+            entry.values_.resize(valueSize);
+            // Value fits in 4 (or 8) bytes, read directly
+            std::byte value[sizeof(uint64_t)];
+            stream.read(reinterpret_cast<char*>(value), inlineSize);
+            std::memcpy(entry.values_.data(), value, valueSize);
           }
           else {
             // Value is too large, read as an offset
-            uint32_t valueOffset = readValue<uint32_t>(stream, mustSwap);
+            const uint64_t valueOffset = isBigTiff ? readValue<uint64_t>(stream, mustSwap)
+              : readValue<uint32_t>(stream, mustSwap);
             if (valueOffset < 8 || valueOffset % 2 != 0) {
               throw std::runtime_error("Invalid value offset in TIFF entry");
             }
+            entry.valueOffset_ = valueOffset;
+            if (filter && !filter(entry.tag_)) {
+              return entry; // values not needed
+            }
+            entry.values_.resize(valueSize);
             readAt(stream, valueOffset, entry.values_.data(), valueSize);
           }
+          entry.checkValues(mustSwap);
+          return entry;
+        }
 
-          // Swap values after reading them to treat them as an array, instead
-          // of a single `uint32_t`. This is because the values may not be a
-          // single `uint32_t` but rather a sequence of smaller types (e.g.,
-          // uint16_t, uint8_t).
-          // This is necessary to ensure that the values are correctly
-          // interpreted according to their type.
-          if (mustSwap) {
-            swapArray(entry.values_.data(), entry.type_, entry.count_);
-          }
-
-          if (entry.type_ == Type::ASCII) {
-            // Ensure the last byte is NUL for ASCII type
-            if (entry.values_[valueSize - 1] != std::byte{0}) {
-              throw std::runtime_error("ASCII value must end with NUL byte");
-            }
+        // Reads the out-of-line values that were not read by `read()`, if any
+        void readValues(std::istream& stream, bool mustSwap = false) {
+          if (isLoaded()) {
+            return;
           }
-
-          return entry;
+          values_.resize(bytes());
+          readAt(stream, valueOffset_, values_.data(), values_.size());
+          checkValues(mustSwap);
         }
 
         bool operator==(const Entry& other) const {
@@ -582,11 +657,48 @@ namespace TiffCraft {
         Tag tag_;                       // Tag identifying the field
         Type type_;                     // Type of the field
         uint32_t count_;                // Number of values
+        uint64_t valueOffset_ = 0;      // Offset of out-of-line values
         std::vector<std::byte> values_; // Pointer to the value data
+
+        friend class TiffIndex;
+
+        // Converts the values just read to the host byte order and checks them
+        void checkValues(bool mustSwap) {
+          // Swap values after reading them to treat them as an array, instead
+          // of a single `uint32_t`. This is because the values may not be a
+          // single `uint32_t` but rather a sequence of smaller types (e.g.,
+          // uint16_t, uint8_t).
+          // This is necessary to ensure that the values are correctly
+          // interpreted according to their type.
+          if (mustSwap) {
+            swapArray(values_.data(), type_, count_);
+          }
+
+          if (type_ == Type::ASCII) {
+            // Ensure the last byte is NUL for ASCII type
+            if (values_[bytes() - 1] != std::byte{0}) {
+              throw std::runtime_error("ASCII value must end with NUL byte");
+            }
+          }
+        }
       };
 
       const std::map<Tag, Entry>& entries() const { return entries_; }
 
+      // Whether the values of all the entries were read
+      bool isLoaded() const {
+        return std::all_of(entries_.begin(), entries_.end(),
+          [](const auto& item) { return item.second.isLoaded(); });
+      }
+
+      // Reads the out-of-line values of the entries that were not read by
+      // `read()` because of its tag filter
+      void readValues(std::istream& stream, bool mustSwap = false) {
+        for (auto& [tag, entry] : entries_) {
+          entry.readValues(stream, mustSwap);
+        }
+      }
+
       const Entry& getEntry(Tag tag,
         std::string errorMessage = "Entry not found") const {
         auto it = entries_.find(tag);
@@ -596,16 +708,37 @@ namespace TiffCraft {
         return it->second;
       }
 
-      static IFD read(std::istream& stream, bool mustSwap = false) {
+      // Gets the first value of an integer entry, or `defaultValue` if the
+      // entry is missing.
+      uint64_t getValue(Tag tag, uint64_t defaultValue = 0) const {
+        auto it = entries_.find(tag);
+        if (it == entries_.end() || it->second.count() == 0) {
+          return defaultValue;
+        }
+        if (!it->second.isLoaded()) {
+          throw std::runtime_error("Values of TIFF entry were not read");
+        }
+        std::vector<uint64_t> values;
+        copyVector<uint64_t>(it->second.type(), it->second.values(), 1, values);
+        return values.front();
+      }
+
+      static IFD read(std::istream& stream, bool mustSwap = false,
+        bool isBigTiff = false, const TagFilter& filter = {}) {
+        TIFFCRAFT_TRACE_SCOPE("read IFD");
         IFD ifd;
 
         // Read the number of entries
-        uint16_t entryCount = readValue<uint16_t>(stream, mustSwap);
+        const uint64_t entryCount = isBigTiff ? readValue<uint64_t>(stream, mustSwap)
+          : readValue<uint16_t>(stream, mustSwap);
+        if (entryCount > UINT16_MAX) {
+          throw std::runtime_error("Too many entries in IFD");
+        }
 
         // Read each entry
         Tag lastTag = Tag::Null;
-        for (uint16_t i = 0; i < entryCount; ++i) {
-          Entry entry = Entry::read(stream, mustSwap);
+        for (uint64_t i = 0; i < entryCount; ++i) {
+          Entry entry = Entry::read(stream, mustSwap, isBigTiff, filter);
           ifd.entries_[entry.tag()] = std::move(entry);
           if (entry.tag() <= lastTag) {
             throw std::runtime_error("Entries must be sorted by tag in ascending order");
@@ -618,6 +751,8 @@ namespace TiffCraft {
 
       private:
         std::map<Tag, Entry> entries_; // Map of directory entries
+
+        friend class TiffIndex;
     };
 
     using ImageData = std::vector<std::vector<std::byte>>;
@@ -642,7 +777,9 @@ namespace TiffCraft {
       return image;
     }
 
-    static TiffImage read(std::istream& stream) {
+    // Reads the header and all the IFDs. Out-of-line values are read only for
+    // the tags accepted by `filter`, or for all tags if it is empty.
+    static TiffImage read(std::istream& stream, const TagFilter& filter = {}) {
       TiffImage image;
 
       // Read and parse the header
@@ -650,7 +787,8 @@ namespace TiffCraft {
 
       // Read the IFDs
       const bool mustSwap = !image.header_.equalsHostByteOrder();
-      uint32_t offset = image.header_.firstIFDOffset();
+      const bool isBigTiff = image.header_.isBigTiff();
+      uint64_t offset = image.header_.firstIFDOffset();
       while (offset > 0) {
         // Seek to the IFD offset
         stream.seekg(offset);
@@ -659,34 +797,101 @@ namespace TiffCraft {
         }
 
         // Read the IFD
-        TiffImage::IFD ifd = TiffImage::IFD::read(stream, mustSwap);
+        TiffImage::IFD ifd = TiffImage::IFD::read(stream, mustSwap, isBigTiff, filter);
         image.ifds_.push_back(std::move(ifd));
 
         // Read the next IFD offset
-        offset = readValue<uint32_t>(stream, mustSwap);
+        offset = isBigTiff ? readValue<uint64_t>(stream, mustSwap)
+          : readValue<uint32_t>(stream, mustSwap);
       }
 
       return image;
     }
 
-    static ImageData readImageStrips(std::istream& stream, const IFD& ifd) {
+    // Reads the out-of-line values of the IFD at `index` that were not read
+    // by `read()` because of its tag filter
+    void readValues(std::istream& stream, size_t index) {
+      ifds_.at(index).readValues(stream, !header_.equalsHostByteOrder());
+    }
+
+    // Reads the child IFDs listed in the SubIFDs entry of `ifd`, if any. A
+    // single child may be followed by others, chained as in the main list.
+    // Out-of-line values are read only for the tags accepted by `filter`.
+    static std::vector<IFD> readSubIFDs(std::istream& stream,
+      const Header& header, const IFD& ifd, const TagFilter& filter = {}) {
+      std::vector<IFD> subIFDs;
+      auto it = ifd.entries().find(Tag::SubIFDs);
+      if (it == ifd.entries().end()) {
+        return subIFDs;
+      }
+      std::vector<uint64_t> offsets;
+      copyVector<uint64_t>(it->second.type(), it->second.values(), it->second.count(), offsets);
+      const bool mustSwap = !header.equalsHostByteOrder();
+      const bool isBigTiff = header.isBigTiff();
+      for (uint64_t offset : offsets) {
+        while (offset > 0) {
+          stream.seekg(offset);
+          if (stream.fail()) {
+            throw std::runtime_error("Failed to seek to SubIFD offset");
+          }
+          subIFDs.push_back(IFD::read(stream, mustSwap, isBigTiff, filter));
+          offset = 0;
+          if (offsets.size() == 1 && subIFDs.size() <= UINT16_MAX) {
+            offset = isBigTiff ? readValue<uint64_t>(stream, mustSwap)
+              : readValue<uint32_t>(stream, mustSwap);
+          }
+        }
+      }
+      return subIFDs;
+    }
+
+    // Offsets and byte counts of the strips or tiles of `ifd`
+    static std::pair<std::vector<uint64_t>, std::vector<uint64_t>>
+      rectangleLocations(const IFD& ifd) {
+      const bool isTiled = ifd.entries().contains(Tag::TileOffsets);
+      std::vector<uint64_t> offsets, byteCounts;
+      { //copy offsets
+        const auto& entry = ifd.getEntry(isTiled ? Tag::TileOffsets : Tag::StripOffsets,
+          "Strip or tile offsets not found in IFD");
+        copyVector<uint64_t>(entry.type(), entry.values(), entry.count(), offsets);
+      }
+      { //copy byte counts
+        const auto& entry = ifd.getEntry(isTiled ? Tag::TileByteCounts : Tag::StripByteCounts,
+          "Strip or tile byte counts not found in IFD");
+        copyVector<uint64_t>(entry.type(), entry.values(), entry.count(), byteCounts);
+      }
+      if (offsets.size() != byteCounts.size()) {
+        throw std::runtime_error("Mismatch between number of offsets and byte counts");
+      }
+      return { std::move(offsets), std::move(byteCounts) };
+    }
+
+    // Reads the strips of `ifd`. When `isNeeded` is given, strips for which it
+    // returns false are not read, and are left empty.
+    static ImageData readImageStrips(std::istream& stream, const IFD& ifd,
+      const std::function<bool(size_t)>& isNeeded = {}) {
       const auto& entries = ifd.entries();
-      std::vector<uint32_t> stripOffsets, stripByteCounts;
+      std::vector<uint64_t> stripOffsets, stripByteCounts;
       { //copy offsets
         const auto& entry = ifd.getEntry(Tag::StripOffsets, "StripOffsets entry not found in IFD");
-        copyVector<uint32_t>(entry.type(), entry.values(), entry.count(), stripOffsets);
+        copyVector<uint64_t>(entry.type(), entry.values(), entry.count(), stripOffsets);
       }
       { //copy byte counts
         const auto& entry = ifd.getEntry(Tag::StripByteCounts, "StripByteCounts entry not found in IFD");
-        copyVector<uint32_t>(entry.type(), entry.values(), entry.count(), stripByteCounts);
+        copyVector<uint64_t>(entry.type(), entry.values(), entry.count(), stripByteCounts);
       }
       if (stripOffsets.size() != stripByteCounts.size()) {
         throw std::runtime_error("Mismatch between number of StripOffsets and StripByteCounts");
       }
       ImageData imageData;
       for (size_t i = 0; i < stripOffsets.size(); ++i) {
-        const uint32_t offset = stripOffsets[i];
-        const uint32_t byteCount = stripByteCounts[i];
+        if (isNeeded && !isNeeded(i)) {
+          imageData.emplace_back();
+          continue;
+        }
+        TIFFCRAFT_TRACE_SCOPE("read strip", "index", i);
+        const uint64_t offset = stripOffsets[i];
+        const uint64_t byteCount = stripByteCounts[i];
         if (offset < 8 || byteCount == 0) {
           throw std::runtime_error("Invalid strip offset or byte count");
         }
@@ -696,24 +901,32 @@ namespace TiffCraft {
       return imageData;
     }
 
-    static ImageData readImageTiles(std::istream& stream, const IFD& ifd) {
+    // Reads the tiles of `ifd`. When `isNeeded` is given, tiles for which it
+    // returns false are not read, and are left empty.
+    static ImageData readImageTiles(std::istream& stream, const IFD& ifd,
+      const std::function<bool(size_t)>& isNeeded = {}) {
       const auto& entries = ifd.entries();
-      std::vector<uint32_t> tileOffsets, tileByteCounts;
+      std::vector<uint64_t> tileOffsets, tileByteCounts;
       { //copy offsets
         const auto& entry = ifd.getEntry(Tag::TileOffsets, "TileOffsets entry not found in IFD");
-        copyVector<uint32_t>(entry.type(), entry.values(), entry.count(), tileOffsets);
+        copyVector<uint64_t>(entry.type(), entry.values(), entry.count(), tileOffsets);
       }
       { //copy byte counts
         const auto& entry = ifd.getEntry(Tag::TileByteCounts, "TileByteCounts entry not found in IFD");
-        copyVector<uint32_t>(entry.type(), entry.values(), entry.count(), tileByteCounts);
+        copyVector<uint64_t>(entry.type(), entry.values(), entry.count(), tileByteCounts);
       }
       if (tileOffsets.size() != tileByteCounts.size()) {
         throw std::runtime_error("Mismatch between number of TileOffsets and TileByteCounts");
       }
       ImageData imageData;
       for (size_t i = 0; i < tileOffsets.size(); ++i) {
-        const uint32_t offset = tileOffsets[i];
-        const uint32_t byteCount = tileByteCounts[i];
+        if (isNeeded && !isNeeded(i)) {
+          imageData.emplace_back();
+          continue;
+        }
+        TIFFCRAFT_TRACE_SCOPE("read tile", "index", i);
+        const uint64_t offset = tileOffsets[i];
+        const uint64_t byteCount = tileByteCounts[i];
         if (offset < 8 || byteCount == 0) {
           throw std::runtime_error("Invalid tile offset or byte count");
         }
@@ -727,43 +940,389 @@ namespace TiffCraft {
       Header header_;
       std::vector<IFD> ifds_; // List of IFDs in the TIFF image
       std::unique_ptr<std::istream> stream_;
+
+      friend class TiffIndex;
+  };
+
+  // How a decimated image is computed from each box of pixels
+  enum class DecimationMode {
+    Pick,    // the top-left pixel of the box
+    Average, // the average of the box, rounded to the nearest integer
+  };
+
+  // Tile cache of the IFD being loaded. The strips and tiles are not read
+  // by the loader: the exporters look them up in the cache, and call `read`
+  // for those that are missing.
+  struct LoadCache {
+    TileCache* tileCache = nullptr;
+    uint64_t file = 0; // identity of the file
+    uint64_t ifd = 0;  // identity of the IFD in the file
+    std::function<std::vector<std::byte>(size_t)> read; // reads a strip or tile
+  };
+
+  // Rectangle of pixels of an image, exported one pixel in `decimation`
+  // across and down
+  struct LoadRegion {
+    int x = 0;
+    int y = 0;
+    int width = 0;
+    int height = 0;
+    int decimation = 1;
+    DecimationMode decimationMode = DecimationMode::Pick;
+    const LoadCache* cache = nullptr; // tile cache, if any
+    LoadStats* stats = nullptr;       // statistics of the load, if any
+
+    bool operator==(const LoadRegion&) const = default;
   };
 
   struct LoadParams {
-    std::optional<uint16_t> ifdIndex; // Optional IFD index to load
+    std::optional<uint16_t> ifdIndex = std::nullopt; // Optional IFD index to load
+
+    // Reduced-resolution reading: the smallest of the image and its overviews
+    // that still gives this many pixels across the region is loaded instead
+    // of the image. Overviews are the reduced-resolution IFDs that follow the
+    // image (NewSubfileType=1) and its SubIFDs.
+    int targetWidth = 0;  // Minimum width of the result, 0 for any
+    int targetHeight = 0; // Minimum height of the result, 0 for any
+    double scale = 0;     // Minimum size of the result relative to the region
+
+    // Part of the image to load, in pixels of the full resolution image. Only
+    // the strips or tiles that overlap it are read.
+    std::optional<LoadRegion> region = std::nullopt;
+
+    // Decimation of the loaded image: one pixel in N x N is kept, or each
+    // N x N box is averaged. Strips and tiles without any picked pixel are
+    // not read. The target size applies to the decimated image.
+    int decimation = 1;
+    DecimationMode decimationMode = DecimationMode::Pick;
+
+    // Cache of decoded strips and tiles, see TiffTileCache.hpp. Cached strips
+    // and tiles are neither read nor decoded again. The file is identified by
+    // `fileId`, which load() sets from the path, size, and modification time
+    // when a filename is given.
+    TileCache* tileCache = nullptr;
+    uint64_t fileId = 0;
+
+    // Statistics of the load, see TiffStats.hpp. The values are added to
+    // those already in `stats`. Nothing is measured when it is null.
+    LoadStats* stats = nullptr;
+
+    // Header and IFDs of the stream, already parsed, e.g. from an index (see
+    // TiffIndex.hpp). The stream is then only read for the pixels and the
+    // SubIFDs. It must describe the same file as the stream.
+    const TiffImage* image = nullptr;
   };
 
   using LoadCallback = std::function<void(
     const TiffImage::Header&, const TiffImage::IFD&, TiffImage::ImageData)>;
 
-  void load(std::istream& stream, LoadCallback&& callback, const LoadParams& params = {}) {
-    // Read the TIFF image from the stream
-    TiffImage image = TiffImage::read(stream);
+  // Callback that also receives the region to export, in pixels of the IFD
+  using LoadRegionCallback = std::function<void(
+    const TiffImage::Header&, const TiffImage::IFD&, TiffImage::ImageData,
+    const LoadRegion&)>;
+
+  // Whole image of an IFD
+  inline LoadRegion imageRegion(const TiffImage::IFD& ifd) {
+    return { 0, 0, static_cast<int>(ifd.getValue(Tag::ImageWidth)),
+      static_cast<int>(ifd.getValue(Tag::ImageLength)) };
+  }
+
+  // Maps a region of the image `from` to the same area of the image `to`, a
+  // scaled version of it. The result is rounded outwards.
+  inline LoadRegion scaleRegion(
+    const LoadRegion& region, const LoadRegion& from, const LoadRegion& to) {
+    if (from == to) {
+      return region;
+    }
+    auto scaleDown = [](int64_t value, int64_t num, int64_t den) {
+      return static_cast<int>(value * num / den);
+    };
+    auto scaleUp = [](int64_t value, int64_t num, int64_t den) {
+      return static_cast<int>((value * num + den - 1) / den);
+    };
+    const int x0 = scaleDown(region.x, to.width, from.width);
+    const int y0 = scaleDown(region.y, to.height, from.height);
+    const int x1 = std::max(x0 + 1, scaleUp(region.x + region.width, to.width, from.width));
+    const int y1 = std::max(y0 + 1, scaleUp(region.y + region.height, to.height, from.height));
+    return { x0, y0, std::min(x1, to.width) - x0, std::min(y1, to.height) - y0 };
+  }
+
+  // Tells whether each strip or tile of `ifd` has pixels of `region`, taking
+  // into account the rows and columns skipped by decimation
+  inline std::function<bool(size_t)> overlapsRegion(
+    const TiffImage::IFD& ifd, const LoadRegion& region) {
+    const LoadRegion image = imageRegion(ifd);
+    const bool isTiled = ifd.entries().contains(Tag::TileOffsets);
+    uint64_t rectWidth = image.width;
+    uint64_t rectHeight = ifd.getValue(Tag::RowsPerStrip, image.height);
+    if (rectHeight == 0 || rectHeight > uint64_t(image.height)) {
+      rectHeight = image.height;
+    }
+    if (isTiled) {
+      rectWidth = ifd.getValue(Tag::TileWidth);
+      rectHeight = ifd.getValue(Tag::TileLength);
+    }
+    if (rectWidth == 0 || rectHeight == 0) {
+      throw std::runtime_error("Invalid strip or tile size");
+    }
+    const uint64_t across = (image.width + rectWidth - 1) / rectWidth;
+    const uint64_t down = (image.height + rectHeight - 1) / rectHeight;
+    const uint64_t step = region.decimationMode == DecimationMode::Pick
+      ? std::max(1, region.decimation) : 1;
+    // whether [start, start + size) has one of the pixels picked in [first, end)
+    auto isPicked = [step](uint64_t start, uint64_t size, uint64_t first, uint64_t end) {
+      const uint64_t picked = start <= first ? first
+        : first + (start - first + step - 1) / step * step;
+      return picked < std::min(start + size, end);
+    };
+    return [=](size_t index) {
+      const uint64_t i = index % (across * down);
+      const uint64_t x = (i % across) * rectWidth;
+      const uint64_t y = (i / across) * rectHeight;
+      return isPicked(x, rectWidth, region.x, region.x + region.width)
+        && isPicked(y, rectHeight, region.y, region.y + region.height);
+    };
+  }
+
+  // Loads the IFDs selected by `params` from `stream`, see `load()`
+  inline void loadImages(std::istream& source, const LoadRegionCallback& callback,
+    const LoadParams& params) {
+    // with statistics, the stream is read through a buffer that counts the I/O
+    LoadStats* stats = params.stats;
+    std::optional<CountingStreamBuf> countingBuf;
+    std::optional<std::istream> countingStream;
+    if (stats) {
+      ++stats->loads;
+      countingBuf.emplace(source.rdbuf(), *stats);
+      countingStream.emplace(&*countingBuf);
+    }
+    std::istream& stream = stats ? *countingStream : source;
+    StatsTimer totalTimer(stats ? &stats->totalTime : nullptr);
+    TIFFCRAFT_TRACE_SCOPE("load");
+
+    // Read the TIFF image from the stream, unless it is given. The strip and
+    // tile locations, the largest arrays of most files, are read only for the
+    // IFD that is loaded.
+    const TiffImage::TagFilter deferLocations = [](Tag tag) {
+      return tag != Tag::StripOffsets && tag != Tag::StripByteCounts
+        && tag != Tag::TileOffsets && tag != Tag::TileByteCounts;
+    };
+    TiffImage parsed;
+    if (!params.image) {
+      StatsTimer timer(stats ? &stats->parseTime : nullptr);
+      parsed = TiffImage::read(stream, deferLocations);
+    }
+    const TiffImage& image = params.image ? *params.image : parsed;
     const auto& header = image.header();
 
     if (params.ifdIndex && params.ifdIndex.value() >= image.ifds().size()) {
       throw std::runtime_error("Requested IFD index is out of bounds");
     }
 
-    for (size_t i = 0; i < image.ifds().size(); ++i) {
-      if (!params.ifdIndex || params.ifdIndex.value() == i) {
-        // If a specific IFD index is requested, only process that IFD
-        // Otherwise, process all IFDs
-        const auto& ifd = image.ifds()[i];
+    if (params.tileCache && params.fileId == 0) {
+      throw std::runtime_error("A tile cache needs the identity of the file");
+    }
+
+    // `ifdId` identifies the IFD in the tile cache
+    auto loadIFD = [&](const TiffImage::IFD& parsedIFD, LoadRegion region, uint64_t ifdId) {
+      TIFFCRAFT_TRACE_SCOPE("load IFD", "id", ifdId);
+      std::optional<TiffImage::IFD> loadedIFD;
+      if (!parsedIFD.isLoaded()) {
+        // a given image is not modified; parsed IFDs are read in place
+        StatsTimer timer(stats ? &stats->parseTime : nullptr);
+        loadedIFD = parsedIFD;
+        loadedIFD->readValues(stream, !header.equalsHostByteOrder());
+      }
+      const TiffImage::IFD& ifd = loadedIFD ? *loadedIFD : parsedIFD;
+      std::function<bool(size_t)> isNeeded;
+      if (region != imageRegion(ifd)) {
+        isNeeded = overlapsRegion(ifd, region);
+      }
+      const bool isTiled = !ifd.entries().contains(Tag::StripOffsets);
+      LoadCache cache;
+      std::mutex readMutex;
+      if (params.tileCache) {
+        // strips and tiles are read by the exporter when not in the cache
+        isNeeded = [](size_t) { return false; };
+        auto locations = std::make_shared<std::pair<std::vector<uint64_t>,
+          std::vector<uint64_t>>>(TiffImage::rectangleLocations(ifd));
+        cache = { params.tileCache, params.fileId, ifdId,
+          [&stream, &readMutex, locations, stats, isTiled](size_t index) {
+            const auto& [offsets, byteCounts] = *locations;
+            if (index >= offsets.size() || offsets[index] < 8 || byteCounts[index] == 0) {
+              throw std::runtime_error("Invalid strip or tile offset or byte count");
+            }
+            std::vector<std::byte> data(byteCounts[index]);
+            std::lock_guard lock(readMutex);
+            TIFFCRAFT_TRACE_SCOPE(isTiled ? "read tile" : "read strip", "index", index);
+            StatsTimer timer(stats ? &stats->readTime : nullptr);
+            readAt(stream, offsets[index], data.data(), data.size());
+            if (stats) {
+              ++(isTiled ? stats->tiles : stats->strips);
+              stats->bytesAllocated += data.size();
+            }
+            return data;
+          } };
+        region.cache = &cache;
+      }
+      region.stats = stats;
+
+      TiffImage::ImageData imageData;
+      {
+        StatsTimer timer(stats ? &stats->readTime : nullptr);
         if (ifd.entries().contains(Tag::StripOffsets)) {
           // image contains strip offsets
-          callback(header, ifd, TiffImage::readImageStrips(stream, ifd));
+          imageData = TiffImage::readImageStrips(stream, ifd, isNeeded);
         } else if (ifd.entries().contains(Tag::TileByteCounts)) {
           // image contains tile byte counts
-          callback(header, ifd, TiffImage::readImageTiles(stream, ifd));
+          imageData = TiffImage::readImageTiles(stream, ifd, isNeeded);
         } else {
           throw std::runtime_error("Unsupported IFD format");
         }
       }
+      if (stats) {
+        for (const auto& rect : imageData) {
+          if (!rect.empty()) {
+            ++(isTiled ? stats->tiles : stats->strips);
+            stats->bytesAllocated += rect.size();
+          }
+        }
+      }
+      StatsTimer timer(stats ? &stats->exportTime : nullptr);
+      TIFFCRAFT_TRACE_SCOPE("export");
+      callback(header, ifd, std::move(imageData), region);
+    };
+
+    if (params.decimation < 1) {
+      throw std::runtime_error("Decimation must be at least 1");
+    }
+    auto decimated = [&](LoadRegion region) {
+      region.decimation = params.decimation;
+      region.decimationMode = params.decimationMode;
+      return region;
+    };
+
+    const bool hasTarget = params.targetWidth > 0 || params.targetHeight > 0
+      || params.scale > 0;
+    if (!hasTarget && !params.region) {
+      for (size_t i = 0; i < image.ifds().size(); ++i) {
+        if (!params.ifdIndex || params.ifdIndex.value() == i) {
+          // If a specific IFD index is requested, only process that IFD
+          // Otherwise, process all IFDs
+          if (!params.image) {
+            StatsTimer timer(stats ? &stats->parseTime : nullptr);
+            parsed.readValues(stream, i);
+          }
+          const auto& ifd = image.ifds()[i];
+          loadIFD(ifd, decimated(imageRegion(ifd)), i);
+        }
+      }
+      return;
     }
+
+    // clip the region to the full resolution image
+    const size_t index = params.ifdIndex.value_or(0);
+    const auto& mainIFD = image.ifds()[index];
+    const LoadRegion full = imageRegion(mainIFD);
+    LoadRegion region = params.region.value_or(full);
+    const int x1 = std::min(full.width, region.x + region.width);
+    const int y1 = std::min(full.height, region.y + region.height);
+    region.x = std::max(0, region.x);
+    region.y = std::max(0, region.y);
+    region.width = x1 - region.x;
+    region.height = y1 - region.y;
+    if (region.width <= 0 || region.height <= 0) {
+      throw std::runtime_error("Requested region is outside the image");
+    }
+
+    // pick the smallest level that is large enough
+    const TiffImage::IFD* best = &mainIFD;
+    std::vector<TiffImage::IFD> subIFDs;
+    if (hasTarget) {
+      const double minWidth = std::max<double>(params.targetWidth, params.scale * region.width);
+      const double minHeight = std::max<double>(params.targetHeight, params.scale * region.height);
+      const uint64_t samplesPerPixel = mainIFD.getValue(Tag::SamplesPerPixel, 1);
+      auto isOverview = [&](const TiffImage::IFD& ifd) {
+        const uint64_t subfileType = ifd.getValue(Tag::NewSubfileType);
+        return (subfileType & 1) != 0     // reduced-resolution image
+          && (subfileType & 4) == 0       // not a transparency mask
+          && ifd.getValue(Tag::SamplesPerPixel, 1) == samplesPerPixel;
+      };
+      std::vector<const TiffImage::IFD*> levels;
+      for (size_t i = index + 1; i < image.ifds().size(); ++i) {
+        const auto& ifd = image.ifds()[i];
+        if ((ifd.getValue(Tag::NewSubfileType) & 1) == 0) {
+          break; // the next full resolution image
+        }
+        if (isOverview(ifd)) {
+          levels.push_back(&ifd);
+        }
+      }
+      {
+        StatsTimer timer(stats ? &stats->parseTime : nullptr);
+        subIFDs = TiffImage::readSubIFDs(stream, header, mainIFD, deferLocations);
+      }
+      for (const auto& ifd : subIFDs) {
+        if (isOverview(ifd)) {
+          levels.push_back(&ifd);
+        }
+      }
+      uint64_t bestArea = uint64_t(full.width) * full.height;
+      for (const auto* level : levels) {
+        const LoadRegion size = imageRegion(*level);
+        const uint64_t area = uint64_t(size.width) * size.height;
+        const double width = double(size.width) * region.width / full.width;
+        const double height = double(size.height) * region.height / full.height;
+        const bool isLargeEnough = size.width > 0 && size.height > 0
+          && std::ceil(width / params.decimation) >= minWidth
+          && std::ceil(height / params.decimation) >= minHeight;
+        if (isLargeEnough && area < bestArea) {
+          best = level;
+          bestArea = area;
+        }
+      }
+    }
+    // SubIFDs are numbered after the IFD they belong to
+    const bool isSubIFD = !subIFDs.empty() && best >= subIFDs.data()
+      && best < subIFDs.data() + subIFDs.size();
+    const uint64_t bestId = isSubIFD
+      ? (uint64_t(index + 1) << 32) | uint64_t(best - subIFDs.data())
+      : uint64_t(best - image.ifds().data());
+    if (isSubIFD || !params.image) {
+      StatsTimer timer(stats ? &stats->parseTime : nullptr);
+      if (isSubIFD) {
+        subIFDs[best - subIFDs.data()].readValues(stream, !header.equalsHostByteOrder());
+      } else {
+        parsed.readValues(stream, best - image.ifds().data());
+      }
+    }
+    loadIFD(*best, decimated(scaleRegion(region, full, imageRegion(*best))), bestId);
+  }
+
+  // Loads the images of a TIFF file, calling `callback` with the pixel data
+  // of each one. A region or a decimated image cannot be loaded with this
+  // callback, since it does not receive the region, and neither can a tile
+  // cache be used; see the overload below.
+  inline void load(std::istream& stream, LoadCallback&& callback, const LoadParams& params = {}) {
+    if (params.region || params.decimation != 1 || params.tileCache) {
+      throw std::runtime_error("Loading a region needs a callback that takes it");
+    }
+    loadImages(stream, [&](const TiffImage::Header& header, const TiffImage::IFD& ifd,
+      TiffImage::ImageData imageData, const LoadRegion&) {
+      callback(header, ifd, std::move(imageData));
+    }, params);
   }
 
-  void load(const std::string& filename, LoadCallback&& callback, const LoadParams& params = {}) {
+  // Loads the images of a TIFF file with a callback that also receives the
+  // part of the image to export, such as the exporters in TiffExporter.hpp.
+  template <typename Callback>
+    requires std::is_invocable_v<Callback&, const TiffImage::Header&,
+      const TiffImage::IFD&, TiffImage::ImageData, const LoadRegion&>
+  void load(std::istream& stream, Callback&& callback, const LoadParams& params = {}) {
+    loadImages(stream, std::ref(callback), params);
+  }
+
+  inline void load(const std::string& filename, LoadCallback&& callback, const LoadParams& params = {}) {
     std::ifstream file(filename, std::ios::binary);
     if (!file) {
       throw std::runtime_error("Failed to open TIFF file: " + std::string(filename));
@@ -771,4 +1330,19 @@ namespace TiffCraft {
     load(file, std::move(callback), params);
   }
 
+  template <typename Callback>
+    requires std::is_invocable_v<Callback&, const TiffImage::Header&,
+      const TiffImage::IFD&, TiffImage::ImageData, const LoadRegion&>
+  void load(const std::string& filename, Callback&& callback, const LoadParams& params = {}) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file) {
+      throw std::runtime_error("Failed to open TIFF file: " + std::string(filename));
+    }
+    LoadParams fileParams = params;
+    if (fileParams.tileCache && fileParams.fileId == 0) {
+      fileParams.fileId = fileIdentity(filename);
+    }
+    load(file, callback, fileParams);
+  }
+
 } // namespace TiffCraft
@@ -0,0 +1,326 @@
+// BSD 2-Clause License
+// Copyright (c) 2025 Daniel Moreno
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS”
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+// ---------------------------------------------------------------------------
+//
+// TiffIndex.hpp
+// =============
+// This file contains the TiffIndex class, which saves the parsed header and
+// IFDs of a TIFF file, including the strip and tile offset tables, in a
+// sidecar index file next to it. Opening the file again then maps the index
+// in memory instead of walking the IFD chain with many small reads.
+//
+// The index records the size and modification time of the TIFF file, and is
+// ignored when they no longer match. Values are stored in host byte order,
+// each one aligned to 8 bytes, so the index is only valid on hosts of the
+// same byte order; other indexes are ignored as well. SubIFDs are not part
+// of the index, and are read from the TIFF file when needed.
+//
+// Indexes are written to a temporary file first and renamed, so concurrent
+// writers never leave a partial index behind.
+//
+
+#pragma once
+
+#include "TiffImage.hpp"
+
+#include <filesystem>
+#include <optional>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+#include <span>
+
+#if defined(__unix__) || defined(__APPLE__)
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+# define TIFFCRAFT_INDEX_MMAP
+#endif
+
+namespace TiffCraft {
+
+  class TiffIndex
+  {
+  public:
+    // Size and modification time of a TIFF file
+    struct FileStamp {
+      uint64_t size = 0;
+      int64_t time = 0;
+
+      static FileStamp of(const std::filesystem::path& path)
+      {
+        return { std::filesystem::file_size(path),
+          std::filesystem::last_write_time(path).time_since_epoch().count() };
+      }
+
+      bool operator==(const FileStamp&) const = default;
+    };
+
+    // Header of an index file
+    struct FileHeader {
+      char magic[8] = { 'T', 'C', 'I', 'N', 'D', 'E', 'X', '1' };
+      uint32_t byteOrderMark = 0x01020304; // in the byte order of the host
+      uint32_t ifdCount = 0;
+      FileStamp stamp;
+      uint8_t isBigEndian = 0; // byte order of the TIFF file
+      uint8_t isBigTiff = 0;
+      uint8_t reserved[6] = {};
+      uint64_t firstIFDOffset = 0;
+    };
+
+    // Entry of an IFD in an index file, followed by its values, if they were
+    // read, padded to a multiple of 8 bytes
+    struct EntryHeader {
+      uint16_t tag = 0;
+      uint16_t type = 0;
+      uint32_t count = 0;
+      uint64_t valueOffset = 0;
+      uint32_t bytes = 0; // bytes of values that follow
+      uint32_t reserved = 0;
+    };
+
+    // Path of the index of a TIFF file
+    static std::filesystem::path path(const std::filesystem::path& file)
+    {
+      return file.string() + ".tcindex";
+    }
+
+    // Writes the index of `image`, read from a file with the given stamp
+    static void write(std::ostream& stream, const TiffImage& image, const FileStamp& stamp)
+    {
+      FileHeader header;
+      header.ifdCount = static_cast<uint32_t>(image.ifds_.size());
+      header.stamp = stamp;
+      header.isBigEndian = image.header_.byteOrder_ == std::endian::big;
+      header.isBigTiff = image.header_.isBigTiff_;
+      header.firstIFDOffset = image.header_.firstIFDOffset_;
+      stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+      for (const auto& ifd : image.ifds_) {
+        const uint64_t entryCount = ifd.entries_.size();
+        stream.write(reinterpret_cast<const char*>(&entryCount), sizeof(entryCount));
+        for (const auto& [tag, entry] : ifd.entries_) {
+          EntryHeader entryHeader;
+          entryHeader.tag = static_cast<uint16_t>(entry.tag_);
+          entryHeader.type = static_cast<uint16_t>(entry.type_);
+          entryHeader.count = entry.count_;
+          entryHeader.valueOffset = entry.valueOffset_;
+          entryHeader.bytes = static_cast<uint32_t>(entry.values_.size());
+          stream.write(reinterpret_cast<const char*>(&entryHeader), sizeof(entryHeader));
+          stream.write(reinterpret_cast<const char*>(entry.values_.data()), entry.values_.size());
+          const char padding[8] = {};
+          stream.write(padding, padded(entry.values_.size()) - entry.values_.size());
+        }
+      }
+      if (!stream) {
+        throw std::runtime_error("Failed to write TIFF index");
+      }
+    }
+
+    // Reads an index, or returns nothing if it is not valid for a file with
+    // the given stamp
+    static std::optional<TiffImage> read(std::span<const std::byte> data, const FileStamp& stamp)
+    {
+      size_t pos = 0;
+      auto get = [&](void* value, size_t size) {
+        if (data.size() - pos < size) {
+          return false;
+        }
+        std::memcpy(value, data.data() + pos, size);
+        pos += size;
+        return true;
+      };
+
+      FileHeader header;
+      if (!get(&header, sizeof(header))
+        || std::memcmp(header.magic, FileHeader().magic, sizeof(header.magic)) != 0
+        || header.byteOrderMark != FileHeader().byteOrderMark
+        || !(header.stamp == stamp)
+        || header.ifdCount > (data.size() - pos) / sizeof(uint64_t)) {
+        return std::nullopt;
+      }
+      TiffImage image;
+      image.header_.byteOrder_ = header.isBigEndian ? std::endian::big : std::endian::little;
+      image.header_.isBigTiff_ = header.isBigTiff != 0;
+      image.header_.firstIFDOffset_ = header.firstIFDOffset;
+      image.ifds_.resize(header.ifdCount);
+      for (auto& ifd : image.ifds_) {
+        uint64_t entryCount = 0;
+        if (!get(&entryCount, sizeof(entryCount)) || entryCount > UINT16_MAX) {
+          return std::nullopt;
+        }
+        for (uint64_t i = 0; i < entryCount; ++i) {
+          EntryHeader entryHeader;
+          if (!get(&entryHeader, sizeof(entryHeader))) {
+            return std::nullopt;
+          }
+          TiffImage::IFD::Entry entry;
+          entry.tag_ = static_cast<Tag>(entryHeader.tag);
+          entry.type_ = static_cast<Type>(entryHeader.type);
+          entry.count_ = entryHeader.count;
+          entry.valueOffset_ = entryHeader.valueOffset;
+          if (!isValidType(entry.type_) || entryHeader.count > UINT32_MAX / 8
+            || entryHeader.bytes > data.size() - pos
+            || (entryHeader.bytes != 0 && entryHeader.bytes != entry.bytes())) {
+            return std::nullopt;
+          }
+          entry.values_.resize(entryHeader.bytes);
+          if (!get(entry.values_.data(), entry.values_.size())) {
+            return std::nullopt;
+          }
+          pos += std::min(data.size() - pos,
+            padded(entry.values_.size()) - entry.values_.size());
+          ifd.entries_[entry.tag_] = std::move(entry);
+        }
+      }
+      return image;
+    }
+
+    // Writes the index of `image`, read from `file` when it had the given
+    // stamp. Errors are ignored, since the index is only an optimization, and
+    // false is returned.
+    static bool save(const std::filesystem::path& file, const TiffImage& image,
+      const FileStamp& stamp)
+    {
+      std::error_code error;
+      const auto index = path(file);
+      const auto temp = index.string() + "." + std::to_string(randomId()) + ".tmp";
+      try {
+        std::ofstream stream(temp, std::ios::binary);
+        write(stream, image, stamp);
+        stream.close();
+        if (!stream) {
+          throw std::runtime_error("Failed to write TIFF index");
+        }
+      }
+      catch (const std::exception&) {
+        std::filesystem::remove(temp, error);
+        return false;
+      }
+      std::filesystem::rename(temp, index, error);
+      if (error) {
+        std::filesystem::remove(temp, error);
+        return false;
+      }
+      return true;
+    }
+
+    // Reads the index of `file` with a single mapping of the index file, or
+    // returns nothing if there is no valid index
+    static std::optional<TiffImage> load(const std::filesystem::path& file)
+    {
+      std::error_code error;
+      const auto index = path(file);
+      if (!std::filesystem::exists(index, error)) {
+        return std::nullopt;
+      }
+      FileStamp stamp;
+      try {
+        stamp = FileStamp::of(file);
+      }
+      catch (const std::filesystem::filesystem_error&) {
+        return std::nullopt;
+      }
+#ifdef TIFFCRAFT_INDEX_MMAP
+      const int fd = ::open(index.c_str(), O_RDONLY);
+      if (fd < 0) {
+        return std::nullopt;
+      }
+      struct stat st;
+      if (::fstat(fd, &st) != 0 || st.st_size <= 0) {
+        ::close(fd);
+        return std::nullopt;
+      }
+      const size_t size = static_cast<size_t>(st.st_size);
+      void* map = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      ::close(fd);
+      if (map == MAP_FAILED) {
+        return std::nullopt;
+      }
+      auto image = read({ static_cast<const std::byte*>(map), size }, stamp);
+      ::munmap(map, size);
+      return image;
+#else
+      std::ifstream stream(index, std::ios::binary | std::ios::ate);
+      if (!stream) {
+        return std::nullopt;
+      }
+      std::vector<std::byte> data(static_cast<size_t>(stream.tellg()));
+      stream.seekg(0);
+      if (!stream.read(reinterpret_cast<char*>(data.data()), data.size())) {
+        return std::nullopt;
+      }
+      return read(data, stamp);
+#endif
+    }
+
+    // Reads the header and IFDs of `file` from its index when it is valid.
+    // Otherwise, they are read from the file, and the index is written if
+    // `writeIndex` is true.
+    static TiffImage open(const std::filesystem::path& file, bool writeIndex = true)
+    {
+      if (auto image = load(file)) {
+        return std::move(*image);
+      }
+      std::ifstream stream(file, std::ios::binary);
+      if (!stream) {
+        throw std::runtime_error("Failed to open TIFF file: " + file.string());
+      }
+      const FileStamp stamp = FileStamp::of(file); // before the file is read
+      TiffImage image = TiffImage::read(stream);
+      if (writeIndex) {
+        save(file, image, stamp);
+      }
+      return image;
+    }
+
+  private:
+    static bool isValidType(Type type)
+    {
+      try {
+        typeBytes(type);
+        return true;
+      }
+      catch (const std::runtime_error&) {
+        return false;
+      }
+    }
+
+    static size_t padded(size_t size)
+    {
+      return (size + 7) / 8 * 8;
+    }
+
+    static uint64_t randomId()
+    {
+      thread_local std::mt19937_64 rng(std::random_device{}());
+      return rng();
+    }
+  };
+
+} // namespace TiffCraft
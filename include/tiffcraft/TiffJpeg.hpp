@@ -0,0 +1,204 @@
+// BSD 2-Clause License
+// Copyright (c) 2025 Daniel Moreno
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS”
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+// ---------------------------------------------------------------------------
+//
+// TiffJpeg.hpp
+// ============
+// This file contains the JPEG decoder used by TIFF images with Compression=7,
+// available when TiffCraft is built with libjpeg or libjpeg-turbo (see the
+// TIFFCRAFT_USE_LIBJPEG CMake option).
+//
+// The strips or tiles of an image usually share their quantization and
+// Huffman tables, stored once in the JPEGTables tag. A decoder keeps the last
+// tables it has loaded, so that each thread parses them only once per image
+// instead of once per tile. YCbCr data is converted to RGB by libjpeg while
+// decoding.
+//
+
+#pragma once
+
+#ifdef TIFFCRAFT_USE_LIBJPEG
+
+#include <stdexcept>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <csetjmp>
+#include <string>
+#include <vector>
+#include <span>
+
+#include <jpeglib.h>
+
+namespace TiffCraft {
+
+  class JpegDecoder
+  {
+  public:
+    static constexpr const char* name = "libjpeg";
+
+    JpegDecoder() { create(); }
+    ~JpegDecoder() { jpeg_destroy_decompress(&cinfo_); }
+
+    JpegDecoder(const JpegDecoder&) = delete;
+    JpegDecoder& operator=(const JpegDecoder&) = delete;
+
+    // Loads the tables of the JPEGTables tag, unless they are the ones
+    // already loaded. An empty span discards the loaded tables.
+    void setTables(std::span<const std::byte> tables)
+    {
+      if (std::ranges::equal(tables, tables_)) {
+        return;
+      }
+      tables_.clear();
+      if (tables.empty()) {
+        jpeg_destroy_decompress(&cinfo_);
+        create();
+        return;
+      }
+      if (setjmp(error_.jump)) {
+        jpeg_abort_decompress(&cinfo_);
+        throw std::runtime_error(std::string("Invalid JPEG tables: ") + error_.message);
+      }
+      setInput(tables);
+      jpeg_read_header(&cinfo_, FALSE);
+      tables_.assign(tables.begin(), tables.end());
+    }
+
+    // Decodes a strip or tile of `width` pixels per row with `channels`
+    // 8-bit samples per pixel, interpreted according to `photometric` (the
+    // PhotometricInterpretation tag). YCbCr data is converted to RGB. Row `y`
+    // is written to `rows[y]`; rows past the end of `rows` are not decoded.
+    // Returns the number of rows written.
+    size_t decode(std::span<const std::byte> in, std::span<std::byte* const> rows,
+      int width, int channels, int photometric)
+    {
+      if (setjmp(error_.jump)) {
+        jpeg_abort_decompress(&cinfo_);
+        throw std::runtime_error(std::string("Corrupted JPEG data: ") + error_.message);
+      }
+      if (!tables_.empty() && hasTables(in)) {
+        tables_.clear(); // replaced by the tables of this stream
+      }
+      setInput(in);
+      jpeg_read_header(&cinfo_, TRUE);
+      const J_COLOR_SPACE colorSpace = (channels == 1) ? JCS_GRAYSCALE
+        : (photometric == 6) ? JCS_YCbCr : JCS_RGB;
+      cinfo_.jpeg_color_space = colorSpace;
+      cinfo_.out_color_space = (colorSpace == JCS_YCbCr) ? JCS_RGB : colorSpace;
+      jpeg_start_decompress(&cinfo_);
+      if (cinfo_.output_width != static_cast<JDIMENSION>(width)
+        || cinfo_.output_components != channels) {
+        jpeg_abort_decompress(&cinfo_);
+        throw std::runtime_error("JPEG data does not match the image layout");
+      }
+      const size_t count = std::min<size_t>(rows.size(), cinfo_.output_height);
+      auto** samples = reinterpret_cast<JSAMPROW*>(const_cast<std::byte**>(rows.data()));
+      while (cinfo_.output_scanline < count) {
+        jpeg_read_scanlines(&cinfo_, samples + cinfo_.output_scanline,
+          static_cast<JDIMENSION>(count - cinfo_.output_scanline));
+      }
+      // the remaining rows, if any, are not needed; the tables are kept
+      jpeg_abort_decompress(&cinfo_);
+      return count;
+    }
+
+  private:
+    struct ErrorManager {
+      jpeg_error_mgr manager;
+      std::jmp_buf jump;
+      char message[JMSG_LENGTH_MAX];
+    };
+
+    jpeg_decompress_struct cinfo_;
+    ErrorManager error_;
+    jpeg_source_mgr source_;
+    std::vector<std::byte> tables_; // tables loaded in `cinfo_`
+
+    void create()
+    {
+      cinfo_.err = jpeg_std_error(&error_.manager);
+      error_.manager.error_exit = [](j_common_ptr cinfo) {
+        auto* error = reinterpret_cast<ErrorManager*>(cinfo->err);
+        (*cinfo->err->format_message)(cinfo, error->message);
+        std::longjmp(error->jump, 1);
+      };
+      error_.manager.output_message = [](j_common_ptr) {}; // no warnings
+      jpeg_create_decompress(&cinfo_);
+
+      source_.init_source = [](j_decompress_ptr) {};
+      source_.fill_input_buffer = [](j_decompress_ptr cinfo) -> boolean {
+        // truncated data: end the image, as libjpeg does for files
+        static const JOCTET eoi[] = { 0xFF, JPEG_EOI };
+        cinfo->src->next_input_byte = eoi;
+        cinfo->src->bytes_in_buffer = sizeof(eoi);
+        return TRUE;
+      };
+      source_.skip_input_data = [](j_decompress_ptr cinfo, long count) {
+        auto* src = cinfo->src;
+        if (count > 0) {
+          const size_t skipped = std::min<size_t>(count, src->bytes_in_buffer);
+          src->next_input_byte += skipped;
+          src->bytes_in_buffer -= skipped;
+        }
+      };
+      source_.resync_to_restart = jpeg_resync_to_restart;
+      source_.term_source = [](j_decompress_ptr) {};
+      cinfo_.src = &source_;
+    }
+
+    // Whether a JPEG stream defines quantization or Huffman tables before
+    // its first scan
+    static bool hasTables(std::span<const std::byte> in)
+    {
+      const auto* data = reinterpret_cast<const uint8_t*>(in.data());
+      size_t pos = 2; // skip SOI
+      while (pos + 4 <= in.size() && data[pos] == 0xFF) {
+        const uint8_t marker = data[pos + 1];
+        if (marker == 0xFF) { // fill byte
+          ++pos;
+          continue;
+        }
+        if (marker == 0xDB || marker == 0xC4) { // DQT or DHT
+          return true;
+        }
+        if (marker == 0xDA) { // SOS
+          return false;
+        }
+        pos += 2 + ((size_t(data[pos + 2]) << 8) | data[pos + 3]);
+      }
+      return false;
+    }
+
+    void setInput(std::span<const std::byte> in)
+    {
+      source_.next_input_byte = reinterpret_cast<const JOCTET*>(in.data());
+      source_.bytes_in_buffer = in.size();
+    }
+  };
+
+} // namespace TiffCraft
+
+#endif // TIFFCRAFT_USE_LIBJPEG
@@ -0,0 +1,261 @@
+// BSD 2-Clause License
+// Copyright (c) 2025 Daniel Moreno
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS”
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+// ---------------------------------------------------------------------------
+//
+// TiffLzw.hpp
+// ===========
+// This file contains the LZW codec used by TIFF images with Compression=5.
+//
+// The decoder does not keep the strings of the code table. Every string it
+// decodes is already in the output buffer, so a table entry only records
+// where in the output that string starts and how long it is. Decoding a code
+// is then a single copy from recently written (i.e. cached) output.
+//
+
+#pragma once
+
+#include <stdexcept>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <array>
+#include <span>
+
+namespace TiffCraft {
+
+  class LzwDecoder
+  {
+  public:
+    static constexpr uint32_t ClearCode = 256;
+    static constexpr uint32_t EndOfInformation = 257;
+    static constexpr uint32_t FirstCode = 258;
+    static constexpr uint32_t MinBits = 9;
+    static constexpr uint32_t MaxBits = 12;
+    static constexpr uint32_t MaxCodes = 1 << MaxBits;
+
+    // Decodes `in` into `out` and returns the number of bytes written.
+    // Decoding stops at the end-of-information code, at the end of the input
+    // data, or when the output is full, whichever happens first.
+    //
+    // Old-style LZW data, written by very old versions of libtiff, stores
+    // codes LSB-first and switches to wider codes one code later than the
+    // TIFF 6.0 specification. It is detected by its first two bytes.
+    size_t decode(std::span<const std::byte> in, std::span<std::byte> out)
+    {
+      if (out.size() > UINT32_MAX) {
+        throw std::runtime_error("LZW output buffer is too large");
+      }
+      const bool isOldStyle = in.size() >= 2
+        && in[0] == std::byte{0} && (std::to_integer<uint8_t>(in[1]) & 0x01);
+      return isOldStyle ? decode<true>(in, out) : decode<false>(in, out);
+    }
+
+  private:
+    // Location of a string in the output buffer
+    struct Entry {
+      uint32_t offset;
+      uint32_t length;
+    };
+
+    std::array<Entry, MaxCodes> table_;
+
+    template <bool IsOldStyle>
+    size_t decode(std::span<const std::byte> in, std::span<std::byte> out)
+    {
+      const uint8_t* src = reinterpret_cast<const uint8_t*>(in.data());
+      const uint8_t* srcEnd = src + in.size();
+      uint8_t* dst = reinterpret_cast<uint8_t*>(out.data());
+      const uint32_t dstSize = static_cast<uint32_t>(out.size());
+
+      uint64_t bitBuffer = 0;
+      uint32_t bitCount = 0;
+      uint32_t codeBits = MinBits;
+      uint32_t nextCode = FirstCode;
+      // new-style data switches to wider codes one code early
+      constexpr uint32_t earlyChange = IsOldStyle ? 0 : 1;
+      uint32_t widenAt = (1u << codeBits) - earlyChange;
+
+      uint32_t pos = 0;          // output position
+      uint32_t prevOffset = 0;   // previous string in the output
+      uint32_t prevLength = 0;   // 0 means there is no previous string
+
+      while (pos < dstSize) {
+        // read the next code, refilling the bit buffer a few bytes at a time
+        if (bitCount < codeBits) {
+          const bool isRefillSafe = (srcEnd - src) >= 8;
+          while (isRefillSafe ? bitCount <= 56 : bitCount < codeBits) {
+            if (src == srcEnd) {
+              return pos; // data not terminated with EndOfInformation
+            }
+            if constexpr (IsOldStyle) {
+              bitBuffer |= uint64_t(*src++) << bitCount;
+            } else {
+              bitBuffer = (bitBuffer << 8) | *src++;
+            }
+            bitCount += 8;
+          }
+        }
+        uint32_t code;
+        if constexpr (IsOldStyle) {
+          code = static_cast<uint32_t>(bitBuffer & ((1u << codeBits) - 1));
+          bitBuffer >>= codeBits;
+        } else {
+          code = static_cast<uint32_t>(bitBuffer >> (bitCount - codeBits))
+            & ((1u << codeBits) - 1);
+        }
+        bitCount -= codeBits;
+
+        if (code == ClearCode) {
+          codeBits = MinBits;
+          nextCode = FirstCode;
+          widenAt = (1u << codeBits) - earlyChange;
+          prevLength = 0;
+          continue;
+        }
+        if (code == EndOfInformation) {
+          break;
+        }
+
+        // emit the string for this code
+        uint32_t length;
+        if (code < ClearCode) {
+          length = 1;
+          dst[pos] = static_cast<uint8_t>(code);
+        } else if (code < nextCode) {
+          const Entry entry = table_[code];
+          length = std::min(entry.length, dstSize - pos);
+          std::memcpy(dst + pos, dst + entry.offset, length);
+        } else if (code == nextCode && prevLength > 0) {
+          // the string is the previous string followed by its first byte,
+          // which overlaps with the bytes being written
+          length = std::min(prevLength + 1, dstSize - pos);
+          for (uint32_t i = 0; i < length; ++i) {
+            dst[pos + i] = dst[prevOffset + i];
+          }
+        } else {
+          throw std::runtime_error("Corrupted LZW data");
+        }
+
+        // add the previous string followed by the first byte of this one;
+        // both are adjacent in the output
+        if (prevLength > 0 && nextCode < MaxCodes) {
+          table_[nextCode++] = { prevOffset, prevLength + 1 };
+          if (nextCode >= widenAt && codeBits < MaxBits) {
+            ++codeBits;
+            widenAt = (1u << codeBits) - earlyChange;
+          }
+        }
+        prevOffset = pos;
+        prevLength = length;
+        pos += length;
+      }
+      return pos;
+    }
+  };
+
+  class LzwEncoder
+  {
+  public:
+    // Encodes `in` as new-style (TIFF 6.0) LZW data.
+    std::vector<std::byte> encode(std::span<const std::byte> in)
+    {
+      std::vector<std::byte> out;
+      out.reserve(in.size() / 2 + 16);
+
+      uint64_t bitBuffer = 0;
+      uint32_t bitCount = 0;
+      uint32_t codeBits = LzwDecoder::MinBits;
+      uint32_t nextCode = LzwDecoder::FirstCode;
+
+      auto putCode = [&](uint32_t code) {
+        bitBuffer = (bitBuffer << codeBits) | code;
+        bitCount += codeBits;
+        while (bitCount >= 8) {
+          bitCount -= 8;
+          out.push_back(static_cast<std::byte>(bitBuffer >> bitCount));
+        }
+      };
+
+      // Adds a new table entry, widening or resetting the codes as needed
+      auto addEntry = [&]() {
+        ++nextCode;
+        if (nextCode == LzwDecoder::MaxCodes - 2) {
+          putCode(LzwDecoder::ClearCode);
+          clearHash();
+          codeBits = LzwDecoder::MinBits;
+          nextCode = LzwDecoder::FirstCode;
+        } else if (nextCode > (1u << codeBits) - 1) {
+          ++codeBits;
+        }
+      };
+
+      clearHash();
+      putCode(LzwDecoder::ClearCode);
+      if (!in.empty()) {
+        uint32_t prefix = std::to_integer<uint8_t>(in[0]);
+        for (size_t i = 1; i < in.size(); ++i) {
+          const uint8_t c = std::to_integer<uint8_t>(in[i]);
+          const uint32_t key = (prefix << 8) | c;
+          uint32_t slot = hash(key);
+          while (keys_[slot] != EmptyKey && keys_[slot] != key) {
+            slot = (slot + 1) & (HashSize - 1);
+          }
+          if (keys_[slot] == key) {
+            prefix = codes_[slot];
+            continue;
+          }
+          putCode(prefix);
+          keys_[slot] = key;
+          codes_[slot] = static_cast<uint16_t>(nextCode);
+          addEntry();
+          prefix = c;
+        }
+        putCode(prefix);
+        addEntry();
+      }
+      putCode(LzwDecoder::EndOfInformation);
+      if (bitCount > 0) {
+        out.push_back(static_cast<std::byte>(bitBuffer << (8 - bitCount)));
+      }
+      return out;
+    }
+
+  private:
+    static constexpr uint32_t HashSize = 1 << 13;
+    static constexpr uint32_t EmptyKey = UINT32_MAX;
+
+    std::vector<uint32_t> keys_ = std::vector<uint32_t>(HashSize, EmptyKey);
+    std::vector<uint16_t> codes_ = std::vector<uint16_t>(HashSize);
+
+    static uint32_t hash(uint32_t key) {
+      return (key * 2654435761u) >> (32 - 13);
+    }
+
+    void clearHash() {
+      std::fill(keys_.begin(), keys_.end(), EmptyKey);
+    }
+  };
+
+} // namespace TiffCraft
@@ -0,0 +1,154 @@
+// BSD 2-Clause License
+// Copyright (c) 2025 Daniel Moreno
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS”
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+// ---------------------------------------------------------------------------
+//
+// TiffPackBits.hpp
+// ================
+// This file contains the PackBits codec used by TIFF images with
+// Compression=32773.
+//
+// PackBits data is a sequence of literal and repeated runs, so it can be
+// decoded in pieces of any size. The exporters use this to decode one row at
+// a time straight into the pixel copy, without a decoded copy of the strip.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <span>
+
+namespace TiffCraft {
+
+  class PackBitsDecoder
+  {
+  public:
+    explicit PackBitsDecoder(std::span<const std::byte> in = {}) : in_(in) {}
+
+    // Decodes up to `out.size()` bytes, continuing where the previous call
+    // stopped, and returns the number of bytes written. Runs may continue
+    // from one call to the next.
+    size_t decode(std::span<std::byte> out)
+    {
+      size_t pos = 0;
+      while (pos < out.size()) {
+        if (literal_ > 0) {
+          const size_t count = std::min({ literal_, out.size() - pos, in_.size() - inPos_ });
+          if (count == 0) {
+            break; // truncated data
+          }
+          std::memcpy(out.data() + pos, in_.data() + inPos_, count);
+          literal_ -= count;
+          inPos_ += count;
+          pos += count;
+        } else if (repeat_ > 0) {
+          const size_t count = std::min(repeat_, out.size() - pos);
+          std::memset(out.data() + pos, std::to_integer<int>(value_), count);
+          repeat_ -= count;
+          pos += count;
+        } else if (inPos_ < in_.size()) {
+          const auto header = static_cast<int8_t>(in_[inPos_++]);
+          if (header >= 0) {
+            literal_ = size_t(header) + 1;
+          } else if (header != -128 && inPos_ < in_.size()) {
+            value_ = in_[inPos_++];
+            repeat_ = size_t(1 - header);
+          }
+          // -128 is a no-op
+        } else {
+          break;
+        }
+      }
+      return pos;
+    }
+
+    // Decodes `in` into `out` and returns the number of bytes written.
+    size_t decode(std::span<const std::byte> in, std::span<std::byte> out)
+    {
+      *this = PackBitsDecoder(in);
+      return decode(out);
+    }
+
+  private:
+    std::span<const std::byte> in_;
+    size_t inPos_ = 0;
+    size_t literal_ = 0;   // literal bytes left in the current run
+    size_t repeat_ = 0;    // repetitions left in the current run
+    std::byte value_{};    // repeated value
+  };
+
+  class PackBitsEncoder
+  {
+  public:
+    // Encodes `in`, packing each row of `rowBytes` bytes separately as the
+    // TIFF specification recommends. A `rowBytes` of 0 packs `in` as a whole.
+    std::vector<std::byte> encode(std::span<const std::byte> in, size_t rowBytes = 0)
+    {
+      std::vector<std::byte> out;
+      out.reserve(in.size() + in.size() / 128 + 1);
+      if (rowBytes == 0) {
+        rowBytes = std::max<size_t>(in.size(), 1);
+      }
+      for (size_t start = 0; start < in.size(); start += rowBytes) {
+        encodeRow(in.subspan(start, std::min(rowBytes, in.size() - start)), out);
+      }
+      return out;
+    }
+
+  private:
+    static void encodeRow(std::span<const std::byte> row, std::vector<std::byte>& out)
+    {
+      size_t pos = 0;
+      while (pos < row.size()) {
+        // length of the run of identical bytes starting at `pos`
+        size_t run = 1;
+        while (pos + run < row.size() && run < 128 && row[pos + run] == row[pos]) {
+          ++run;
+        }
+        if (run >= 3 || (run == 2 && pos + run == row.size())) {
+          out.push_back(static_cast<std::byte>(1 - static_cast<int>(run)));
+          out.push_back(row[pos]);
+          pos += run;
+          continue;
+        }
+        // literal run until the next run of three identical bytes
+        size_t end = pos + run;
+        while (end < row.size() && end - pos < 128) {
+          if (end + 2 < row.size() && row[end] == row[end + 1] && row[end] == row[end + 2]) {
+            break;
+          }
+          ++end;
+        }
+        end = std::min(end, pos + 128);
+        out.push_back(static_cast<std::byte>(end - pos - 1));
+        out.insert(out.end(), row.begin() + pos, row.begin() + end);
+        pos = end;
+      }
+    }
+  };
+
+} // namespace TiffCraft
@@ -0,0 +1,350 @@
+// BSD 2-Clause License
+// Copyright (c) 2025 Daniel Moreno
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS”
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+// ---------------------------------------------------------------------------
+//
+// TiffPredictor.hpp
+// =================
+// This file contains the predictors of the TIFF Predictor tag (317), used
+// together with LZW, Deflate, and similar compression schemes:
+//
+//   1 = No prediction
+//   2 = Horizontal differencing of 8, 16, 32, or 64-bit integer samples
+//   3 = Floating point predictor: byte-shuffled horizontal differencing
+//
+// Predictors are reversed in place, one row at a time, right after a strip or
+// tile is decoded and while it is still in the cache. Reversing horizontal
+// differencing is a prefix sum along the row, which is vectorized with SSE2
+// when the bytes of a pixel divide the 16-byte vector width, or are 3 or 6
+// (8 and 16-bit RGB), which are done 12 bytes at a time.
+//
+
+#pragma once
+
+#include <stdexcept>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <span>
+#include <bit>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# include <emmintrin.h>
+# define TIFFCRAFT_PREDICTOR_SSE2
+#endif
+
+namespace TiffCraft {
+
+  namespace predictor {
+
+    template <typename T>
+    T byteswap(T value) {
+      auto* bytes = reinterpret_cast<uint8_t*>(&value);
+      std::reverse(bytes, bytes + sizeof(T));
+      return value;
+    }
+
+#ifdef TIFFCRAFT_PREDICTOR_SSE2
+    template <typename T>
+    __m128i add(__m128i a, __m128i b) {
+      if constexpr (sizeof(T) == 1) { return _mm_add_epi8(a, b); }
+      else if constexpr (sizeof(T) == 2) { return _mm_add_epi16(a, b); }
+      else if constexpr (sizeof(T) == 4) { return _mm_add_epi32(a, b); }
+      else { return _mm_add_epi64(a, b); }
+    }
+
+    // Prefix sum of the pixels of `Step` bytes in a vector
+    template <typename T, int Step>
+    __m128i prefixSum(__m128i x) {
+      if constexpr (Step <= 8) { x = add<T>(x, _mm_slli_si128(x, Step)); }
+      if constexpr (Step <= 4) { x = add<T>(x, _mm_slli_si128(x, 2 * Step)); }
+      if constexpr (Step <= 2) { x = add<T>(x, _mm_slli_si128(x, 4 * Step)); }
+      if constexpr (Step == 1) { x = add<T>(x, _mm_slli_si128(x, 8)); }
+      return x;
+    }
+
+    // Repeats the last pixel of `Step` bytes across the vector
+    template <int Step>
+    __m128i broadcastLast(__m128i x) {
+      if constexpr (Step == 1) {
+        x = _mm_unpackhi_epi8(x, x);
+      }
+      if constexpr (Step <= 2) {
+        x = _mm_shufflehi_epi16(x, 0xFF);
+      }
+      if constexpr (Step <= 8) {
+        x = (Step == 4) ? _mm_shuffle_epi32(x, 0xFF) : _mm_unpackhi_epi64(x, x);
+      }
+      return x;
+    }
+
+    // Reverses horizontal differencing for pixels of `Step` bytes. Returns
+    // the number of samples done; the remaining ones are left to the caller.
+    template <typename T, int Step>
+    size_t undoHorizontalSse2(T* row, size_t count) {
+      auto* bytes = reinterpret_cast<uint8_t*>(row);
+      const size_t size = count * sizeof(T);
+      __m128i carry = _mm_setzero_si128();
+      size_t i = 0;
+      for (; i + 16 <= size; i += 16) {
+        auto* p = reinterpret_cast<__m128i*>(bytes + i);
+        __m128i x = prefixSum<T, Step>(_mm_loadu_si128(p));
+        x = add<T>(x, carry);
+        _mm_storeu_si128(p, x);
+        carry = broadcastLast<Step>(x);
+      }
+      return i / sizeof(T);
+    }
+
+    // Reverses horizontal differencing for pixels of 3 or 6 bytes, which do
+    // not divide the vector: each step sums the 12 bytes of 4 or 2 pixels,
+    // and keeps the last 4 bytes of the vector as loaded, for the next step.
+    // The next vector is loaded before the store that overlaps it, which
+    // would otherwise stall on store forwarding.
+    template <typename T, int Step>
+    size_t undoHorizontalSse2Rgb(T* row, size_t count) {
+      static_assert(Step == 3 || Step == 6);
+      auto* bytes = reinterpret_cast<uint8_t*>(row);
+      const size_t size = count * sizeof(T);
+      const __m128i low12 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        0, 0, 0, 0);
+      const __m128i lowStep = _mm_srli_si128(low12, 12 - Step);
+      __m128i carry = _mm_setzero_si128();
+      __m128i next = size >= 16
+        ? _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes)) : _mm_setzero_si128();
+      size_t i = 0;
+      for (; i + 16 <= size; i += 12) {
+        auto* p = reinterpret_cast<__m128i*>(bytes + i);
+        const __m128i loaded = next;
+        if (i + 28 <= size) {
+          next = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + i + 12));
+        }
+        __m128i x = add<T>(loaded, _mm_slli_si128(loaded, Step));
+        if constexpr (Step == 3) { x = add<T>(x, _mm_slli_si128(x, 6)); }
+        // the last pixel of the sums, repeated over the first 12 bytes; it is
+        // added to the carry afterwards, so the carry only waits on one add
+        __m128i last = _mm_and_si128(_mm_srli_si128(x, 12 - Step), lowStep);
+        if constexpr (Step == 3) { last = _mm_or_si128(last, _mm_slli_si128(last, 3)); }
+        last = _mm_or_si128(last, _mm_slli_si128(last, 6));
+        x = add<T>(x, carry);
+        _mm_storeu_si128(p, _mm_or_si128(_mm_and_si128(low12, x),
+          _mm_andnot_si128(low12, loaded)));
+        carry = add<T>(carry, last);
+      }
+      return i / sizeof(T);
+    }
+#endif
+
+#ifdef TIFFCRAFT_PREDICTOR_SSE2
+    template <size_t Bytes>
+    __m128i unpackLo(__m128i a, __m128i b) {
+      if constexpr (Bytes == 1) { return _mm_unpacklo_epi8(a, b); }
+      else if constexpr (Bytes == 2) { return _mm_unpacklo_epi16(a, b); }
+      else { return _mm_unpacklo_epi32(a, b); }
+    }
+
+    template <size_t Bytes>
+    __m128i unpackHi(__m128i a, __m128i b) {
+      if constexpr (Bytes == 1) { return _mm_unpackhi_epi8(a, b); }
+      else if constexpr (Bytes == 2) { return _mm_unpackhi_epi16(a, b); }
+      else { return _mm_unpackhi_epi32(a, b); }
+    }
+
+    // Interleaves `N` vectors of bytes, the first one holding the first byte
+    // of 16 samples, into the 16 samples of `N` bytes
+    template <size_t N>
+    void interleave(const __m128i* planes, __m128i* samples) {
+      if constexpr (N == 1) {
+        samples[0] = planes[0];
+      } else {
+        __m128i low[N / 2], high[N / 2];
+        interleave<N / 2>(planes, low);
+        interleave<N / 2>(planes + N / 2, high);
+        for (size_t k = 0; k < N / 2; ++k) {
+          samples[2 * k] = unpackLo<N / 2>(low[k], high[k]);
+          samples[2 * k + 1] = unpackHi<N / 2>(low[k], high[k]);
+        }
+      }
+    }
+#endif
+
+    // Copies the byte planes of a row of the floating point predictor, most
+    // significant first, back into samples of `N` bytes in host byte order
+    template <size_t N>
+    void interleaveBytes(std::byte* row, const std::byte* planes, size_t count) {
+      auto significance = [](size_t b) {
+        return (std::endian::native == std::endian::big) ? b : N - 1 - b;
+      };
+      size_t i = 0;
+#ifdef TIFFCRAFT_PREDICTOR_SSE2
+      for (; i + 16 <= count; i += 16) {
+        __m128i bytes[N], samples[N];
+        for (size_t b = 0; b < N; ++b) {
+          bytes[b] = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(planes + significance(b) * count + i));
+        }
+        interleave<N>(bytes, samples);
+        for (size_t k = 0; k < N; ++k) {
+          _mm_storeu_si128(reinterpret_cast<__m128i*>(row + i * N + 16 * k), samples[k]);
+        }
+      }
+#endif
+      for (; i < count; ++i) {
+        for (size_t b = 0; b < N; ++b) {
+          row[i * N + b] = planes[significance(b) * count + i];
+        }
+      }
+    }
+
+  } // namespace predictor
+
+  // Reverses horizontal differencing in place on a row of `count` samples,
+  // with `channels` samples per pixel.
+  template <typename T>
+  void undoHorizontalPredictor(T* row, size_t count, size_t channels)
+  {
+    size_t done = std::min(channels, count); // the first pixel is as is
+#ifdef TIFFCRAFT_PREDICTOR_SSE2
+    switch (channels * sizeof(T)) {
+      case 1: done = predictor::undoHorizontalSse2<T, 1>(row, count); break;
+      case 2: done = predictor::undoHorizontalSse2<T, 2>(row, count); break;
+      case 3: done = predictor::undoHorizontalSse2Rgb<T, 3>(row, count); break;
+      case 4: done = predictor::undoHorizontalSse2<T, 4>(row, count); break;
+      case 6: done = predictor::undoHorizontalSse2Rgb<T, 6>(row, count); break;
+      case 8: done = predictor::undoHorizontalSse2<T, 8>(row, count); break;
+      case 16: done = predictor::undoHorizontalSse2<T, 16>(row, count); break;
+      default: break;
+    }
+    done = std::max(done, std::min(channels, count));
+#endif
+    for (size_t i = done; i < count; ++i) {
+      row[i] = static_cast<T>(row[i] + row[i - channels]);
+    }
+  }
+
+  // Applies horizontal differencing in place; the inverse of the above.
+  template <typename T>
+  void applyHorizontalPredictor(T* row, size_t count, size_t channels)
+  {
+    for (size_t i = count; i-- > channels; ) {
+      row[i] = static_cast<T>(row[i] - row[i - channels]);
+    }
+  }
+
+  // Reverses the floating point predictor in place on a row of `count`
+  // samples of `bytesPerSample` bytes, with `channels` samples per pixel.
+  // The samples end in host byte order, whatever the byte order of the file.
+  inline void undoFloatingPointPredictor(std::byte* row, size_t count,
+    size_t channels, size_t bytesPerSample, std::vector<std::byte>& scratch)
+  {
+    const size_t size = count * bytesPerSample;
+    undoHorizontalPredictor(reinterpret_cast<uint8_t*>(row), size, channels);
+    // the row holds the most significant bytes of all samples, followed by
+    // the next most significant bytes, and so on
+    scratch.assign(row, row + size);
+    switch (bytesPerSample) {
+      case 2: predictor::interleaveBytes<2>(row, scratch.data(), count); break;
+      case 4: predictor::interleaveBytes<4>(row, scratch.data(), count); break;
+      case 8: predictor::interleaveBytes<8>(row, scratch.data(), count); break;
+      default:
+        for (size_t b = 0; b < bytesPerSample; ++b) {
+          const size_t significance = (std::endian::native == std::endian::big)
+            ? b : bytesPerSample - 1 - b;
+          const std::byte* plane = scratch.data() + significance * count;
+          for (size_t i = 0; i < count; ++i) {
+            row[i * bytesPerSample + b] = plane[i];
+          }
+        }
+        break;
+    }
+  }
+
+  // Applies the floating point predictor in place to a row of samples in
+  // host byte order; the inverse of the above.
+  inline void applyFloatingPointPredictor(std::byte* row, size_t count,
+    size_t channels, size_t bytesPerSample, std::vector<std::byte>& scratch)
+  {
+    const size_t size = count * bytesPerSample;
+    scratch.resize(size);
+    for (size_t i = 0; i < count; ++i) {
+      for (size_t b = 0; b < bytesPerSample; ++b) {
+        const size_t significance = (std::endian::native == std::endian::big)
+          ? b : bytesPerSample - 1 - b;
+        scratch[significance * count + i] = row[i * bytesPerSample + b];
+      }
+    }
+    std::memcpy(row, scratch.data(), size);
+    applyHorizontalPredictor(reinterpret_cast<uint8_t*>(row), size, channels);
+  }
+
+  // Reverses `predictor` in place on the rows of a decoded strip or tile.
+  // Afterwards, the samples are in host byte order.
+  inline void undoPredictor(
+    int predictor,                // Predictor tag value
+    std::span<std::byte> data,    // decoded strip or tile
+    size_t width,                 // pixels per row
+    size_t height,                // rows
+    size_t stride,                // bytes per row
+    size_t channels,              // samples per pixel
+    int bitsPerSample,
+    bool equalsHostByteOrder)     // byte order of `data`
+  {
+    const size_t count = width * channels;
+    const size_t rows = std::min(height, stride > 0 ? data.size() / stride : 0);
+
+    auto undoHorizontal = [&]<typename T>(T) {
+      for (size_t row = 0; row < rows; ++row) {
+        T* samples = reinterpret_cast<T*>(data.data() + row * stride);
+        if (sizeof(T) > 1 && !equalsHostByteOrder) {
+          std::transform(samples, samples + count, samples, predictor::byteswap<T>);
+        }
+        undoHorizontalPredictor(samples, count, channels);
+      }
+    };
+
+    if (predictor == 1) {
+      return;
+    } else if (predictor == 2) {
+      switch (bitsPerSample) {
+        case 8: undoHorizontal(uint8_t{}); return;
+        case 16: undoHorizontal(uint16_t{}); return;
+        case 32: undoHorizontal(uint32_t{}); return;
+        case 64: undoHorizontal(uint64_t{}); return;
+        default: break;
+      }
+    } else if (predictor == 3 && bitsPerSample % 8 == 0) {
+      thread_local std::vector<std::byte> scratch;
+      for (size_t row = 0; row < rows; ++row) {
+        undoFloatingPointPredictor(data.data() + row * stride,
+          count, channels, bitsPerSample / 8, scratch);
+      }
+      return;
+    }
+    throw std::runtime_error("Unsupported predictor " + std::to_string(predictor)
+      + " for " + std::to_string(bitsPerSample) + " bits per sample");
+  }
+
+} // namespace TiffCraft
@@ -0,0 +1,207 @@
+// BSD 2-Clause License
+// Copyright (c) 2025 Daniel Moreno
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS”
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+// ---------------------------------------------------------------------------
+//
+// TiffRecorder.hpp
+// ================
+// This file contains ReadRecorder, a log of every read of a stream with its
+// offset, length, time, and thread, and RecordingStreamBuf, the stream
+// buffer that fills it. Loading a file through a recording stream captures
+// the exact I/O pattern of the parser and the strip and tile readers, which
+// the `tiff_replay` program can then replay against a file with different
+// read strategies:
+//
+//     std::ifstream file("image.tif", std::ios::binary);
+//     TiffCraft::ReadRecorder recorder;
+//     TiffCraft::RecordingStreamBuf buf(file.rdbuf(), recorder);
+//     std::istream stream(&buf);
+//     TiffCraft::load(stream, std::ref(exporter));
+//     std::ofstream log("reads.csv");
+//     recorder.write(log);
+//
+
+#pragma once
+
+#include <stdexcept>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <vector>
+#include <mutex>
+
+namespace TiffCraft {
+
+  // One read of a stream
+  struct ReadRecord {
+    uint64_t offset = 0;
+    uint64_t length = 0;  // bytes requested
+    uint64_t time = 0;    // nanoseconds since the recorder was created
+    uint32_t thread = 0;  // number of the reading thread, from 1
+
+    bool operator==(const ReadRecord&) const = default;
+  };
+
+  // Thread-safe log of reads
+  class ReadRecorder
+  {
+  public:
+    ReadRecorder() : start_(Clock::now()) {}
+
+    // Records a read by the calling thread
+    void add(uint64_t offset, uint64_t length)
+    {
+      const auto time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        Clock::now() - start_).count();
+      std::lock_guard lock(mutex_);
+      records_.push_back({ offset, length, static_cast<uint64_t>(time), threadNumber() });
+    }
+
+    std::vector<ReadRecord> records() const
+    {
+      std::lock_guard lock(mutex_);
+      return records_;
+    }
+
+    void clear()
+    {
+      std::lock_guard lock(mutex_);
+      records_.clear();
+    }
+
+    // Writes the records as CSV, one read per line after a header line
+    void write(std::ostream& os) const
+    {
+      std::lock_guard lock(mutex_);
+      os << "offset,length,time_ns,thread\n";
+      for (const auto& record : records_) {
+        os << record.offset << ',' << record.length << ','
+          << record.time << ',' << record.thread << '\n';
+      }
+    }
+
+    // Reads records written by `write()`
+    static std::vector<ReadRecord> read(std::istream& is)
+    {
+      std::vector<ReadRecord> records;
+      std::string line;
+      if (!std::getline(is, line) || line.rfind("offset,length", 0) != 0) {
+        throw std::runtime_error("Invalid read log header");
+      }
+      while (std::getline(is, line)) {
+        if (line.empty()) {
+          continue;
+        }
+        std::istringstream fields(line);
+        ReadRecord record;
+        char comma1 = 0, comma2 = 0, comma3 = 0;
+        fields >> record.offset >> comma1 >> record.length >> comma2
+          >> record.time >> comma3 >> record.thread;
+        if (!fields || comma1 != ',' || comma2 != ',' || comma3 != ',') {
+          throw std::runtime_error("Invalid read log line: " + line);
+        }
+        records.push_back(record);
+      }
+      return records;
+    }
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    mutable std::mutex mutex_;
+    std::vector<ReadRecord> records_;
+    Clock::time_point start_;
+
+    static uint32_t threadNumber()
+    {
+      static std::atomic<uint32_t> next = 1;
+      thread_local const uint32_t number = next++;
+      return number;
+    }
+  };
+
+  // Read-only stream buffer that forwards to `source` and records every read
+  // in `recorder`. It does no buffering of its own, so every read of the
+  // stream is one read of `source`.
+  class RecordingStreamBuf : public std::streambuf
+  {
+  public:
+    RecordingStreamBuf(std::streambuf* source, ReadRecorder& recorder)
+      : source_(source), recorder_(recorder),
+        pos_(source->pubseekoff(0, std::ios_base::cur, std::ios_base::in)) {}
+
+  protected:
+    std::streamsize xsgetn(char* s, std::streamsize n) override {
+      recorder_.add(static_cast<uint64_t>(std::streamoff(pos_)), static_cast<uint64_t>(n));
+      const std::streamsize count = source_->sgetn(s, n);
+      pos_ += count;
+      return count;
+    }
+
+    int_type underflow() override {
+      return source_->sgetc();
+    }
+
+    int_type uflow() override {
+      recorder_.add(static_cast<uint64_t>(std::streamoff(pos_)), 1);
+      const int_type c = source_->sbumpc();
+      if (!traits_type::eq_int_type(c, traits_type::eof())) {
+        pos_ += 1;
+      }
+      return c;
+    }
+
+    std::streamsize showmanyc() override {
+      return source_->in_avail();
+    }
+
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+      std::ios_base::openmode which) override {
+      return moveTo(source_->pubseekoff(off, dir, which));
+    }
+
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which) override {
+      return moveTo(source_->pubseekpos(pos, which));
+    }
+
+  private:
+    std::streambuf* source_;
+    ReadRecorder& recorder_;
+    pos_type pos_;
+
+    pos_type moveTo(pos_type pos) {
+      if (pos != pos_type(off_type(-1))) {
+        pos_ = pos;
+      }
+      return pos;
+    }
+  };
+
+} // namespace TiffCraft
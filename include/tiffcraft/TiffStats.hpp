@@ -0,0 +1,151 @@
+// BSD 2-Clause License
+// Copyright (c) 2025 Daniel Moreno
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS”
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+// ---------------------------------------------------------------------------
+//
+// TiffStats.hpp
+// =============
+// This file contains LoadStats, the optional statistics of `load()`: the time
+// spent in each phase of the load, the file I/O, and the memory allocated for
+// the pixel data. Loads without a LoadStats do no measurements at all.
+//
+// The I/O is counted by CountingStreamBuf, a stream buffer that forwards to
+// the buffer of the loaded stream and counts the read calls, bytes, and the
+// seeks that move the read position.
+//
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <streambuf>
+
+namespace TiffCraft {
+
+  // Statistics of one or more loads. Each load adds to the values, so the
+  // same LoadStats can be used to collect the totals of many files.
+  struct LoadStats {
+    using Clock = std::chrono::steady_clock;
+
+    // Wall time of each phase
+    Clock::duration parseTime{};  // header, IFDs, and SubIFDs
+    Clock::duration readTime{};   // strips and tiles read from the file
+    Clock::duration exportTime{}; // callback, i.e. decoding and conversion;
+                                  // includes the reads of a tile cache miss
+    Clock::duration totalTime{};
+
+    // File I/O
+    uint64_t bytesRead = 0;
+    uint64_t reads = 0;           // read calls on the stream
+    uint64_t seeks = 0;           // seeks that moved the read position
+
+    // Pixel data
+    uint64_t strips = 0;          // strips read from the file
+    uint64_t tiles = 0;           // tiles read from the file
+    uint64_t bytesAllocated = 0;  // encoded strips and tiles, exported images
+    uint64_t loads = 0;           // number of loads
+  };
+
+  // Adds the time from construction to destruction to `time`, if any
+  class StatsTimer
+  {
+  public:
+    explicit StatsTimer(LoadStats::Clock::duration* time)
+      : time_(time), start_(time ? LoadStats::Clock::now() : LoadStats::Clock::time_point{}) {}
+
+    ~StatsTimer() {
+      if (time_) {
+        *time_ += LoadStats::Clock::now() - start_;
+      }
+    }
+
+    StatsTimer(const StatsTimer&) = delete;
+    StatsTimer& operator=(const StatsTimer&) = delete;
+
+  private:
+    LoadStats::Clock::duration* time_;
+    LoadStats::Clock::time_point start_;
+  };
+
+  // Read-only stream buffer that forwards to `source` and counts the I/O in
+  // `stats`. It does no buffering of its own, so every read of the stream
+  // is one read of `source`.
+  class CountingStreamBuf : public std::streambuf
+  {
+  public:
+    CountingStreamBuf(std::streambuf* source, LoadStats& stats)
+      : source_(source), stats_(stats),
+        pos_(source->pubseekoff(0, std::ios_base::cur, std::ios_base::in)) {}
+
+  protected:
+    std::streamsize xsgetn(char* s, std::streamsize n) override {
+      const std::streamsize count = source_->sgetn(s, n);
+      ++stats_.reads;
+      stats_.bytesRead += count;
+      pos_ += count;
+      return count;
+    }
+
+    int_type underflow() override {
+      return source_->sgetc();
+    }
+
+    int_type uflow() override {
+      const int_type c = source_->sbumpc();
+      if (!traits_type::eq_int_type(c, traits_type::eof())) {
+        ++stats_.reads;
+        ++stats_.bytesRead;
+        pos_ += 1;
+      }
+      return c;
+    }
+
+    std::streamsize showmanyc() override {
+      return source_->in_avail();
+    }
+
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+      std::ios_base::openmode which) override {
+      return moveTo(source_->pubseekoff(off, dir, which));
+    }
+
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which) override {
+      return moveTo(source_->pubseekpos(pos, which));
+    }
+
+  private:
+    std::streambuf* source_;
+    LoadStats& stats_;
+    pos_type pos_;
+
+    pos_type moveTo(pos_type pos) {
+      if (pos != pos_type(off_type(-1)) && pos != pos_) {
+        ++stats_.seeks;
+        pos_ = pos;
+      }
+      return pos;
+    }
+  };
+
+} // namespace TiffCraft
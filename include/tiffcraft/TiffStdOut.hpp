@@ -68,16 +68,22 @@ namespace TiffCraft {
       case TiffCraft::Tag::PlanarConfiguration: return "PlanarConfiguration";
       case TiffCraft::Tag::ResolutionUnit: return "ResolutionUnit";
       case TiffCraft::Tag::PageName: return "PageName";
+      case TiffCraft::Tag::T4Options: return "T4Options";
+      case TiffCraft::Tag::T6Options: return "T6Options";
       case TiffCraft::Tag::Software: return "Software";
       case TiffCraft::Tag::DateTime: return "DateTime";
       case TiffCraft::Tag::Artist: return "Artist";
+      case TiffCraft::Tag::Predictor: return "Predictor";
       case TiffCraft::Tag::ColorMap: return "ColorMap";
       case TiffCraft::Tag::HalftoneHints: return "HalftoneHints";
       case TiffCraft::Tag::TileWidth: return "TileWidth";
       case TiffCraft::Tag::TileLength: return "TileLength";
       case TiffCraft::Tag::TileOffsets: return "TileOffsets";
       case TiffCraft::Tag::TileByteCounts: return "TileByteCounts";
+      case TiffCraft::Tag::SubIFDs: return "SubIFDs";
+      case TiffCraft::Tag::ExtraSamples: return "ExtraSamples";
       case TiffCraft::Tag::SampleFormat: return "SampleFormat";
+      case TiffCraft::Tag::JPEGTables: return "JPEGTables";
       default: /* unknown tag */ break;
     }
     char buf[8] = "0x0000";
@@ -99,6 +105,10 @@ namespace TiffCraft {
       case TiffCraft::Type::SRATIONAL: return "SRATIONAL";
       case TiffCraft::Type::FLOAT:     return "FLOAT";
       case TiffCraft::Type::DOUBLE:    return "DOUBLE";
+      case TiffCraft::Type::IFD:       return "IFD";
+      case TiffCraft::Type::LONG8:     return "LONG8";
+      case TiffCraft::Type::SLONG8:    return "SLONG8";
+      case TiffCraft::Type::IFD8:      return "IFD8";
       default:                         return "!UNKNOWN";
     }
   }
@@ -115,6 +125,7 @@ std::ostream& operator<<(std::ostream& os, TiffCraft::Type type) {
 std::ostream& operator<<(std::ostream& os, const TiffCraft::TiffImage::Header& header) {
   os << "TIFF Header:\n"
      << " - Byte Order: " << (header.byteOrder() == std::endian::little ? "Little Endian" : "Big Endian") << "\n"
+     << " - BigTIFF: " << (header.isBigTiff() ? "Yes" : "No") << "\n"
      << " - First IFD Offset: " << header.firstIFDOffset() << "\n"
      << " - Equals Host Byte Order: " << (header.equalsHostByteOrder() ? "Yes" : "No") << "\n";
   return os;
@@ -173,6 +184,16 @@ std::ostream& operator<<(std::ostream& os, const TiffCraft::TiffImage::IFD::Entr
         case Type::DOUBLE:
           os << " " << *reinterpret_cast<const TypeTraits_t<Type::DOUBLE>*>(value);
           break;
+        case Type::IFD:
+          os << " " << *reinterpret_cast<const TypeTraits_t<Type::IFD>*>(value);
+          break;
+        case Type::LONG8:
+        case Type::IFD8:
+          os << " " << *reinterpret_cast<const TypeTraits_t<Type::LONG8>*>(value);
+          break;
+        case Type::SLONG8:
+          os << " " << *reinterpret_cast<const TypeTraits_t<Type::SLONG8>*>(value);
+          break;
         default:
           os << " <Unsupported Type>";
       }
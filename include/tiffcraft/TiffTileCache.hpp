@@ -0,0 +1,461 @@
+// BSD 2-Clause License
+// Copyright (c) 2025 Daniel Moreno
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS”
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+// ---------------------------------------------------------------------------
+//
+// TiffTileCache.hpp
+// =================
+// This file contains the TileCache class, a thread-safe LRU cache of decoded
+// strips and tiles shared by all the files loaded with it. Entries are keyed
+// by the identity of the file, the IFD, the strip or tile index, and the
+// format of the exported pixels, and the cache holds at most a given number
+// of bytes.
+//
+// The cache is split into shards, each one with its own lock, LRU list, and
+// share of the byte budget, so that threads looking up different tiles
+// rarely wait for each other.
+//
+// A TileCache can be backed by a DiskTileCache, a directory of decoded tiles
+// shared by processes and kept between runs. Each tile is stored in its own
+// file, named after a hash of its key, with the pixels following a short
+// header that is checked against the size of the file before it is trusted.
+// Tiles are written to a temporary file first and linked in place, so
+// concurrent writers never leave a partial tile behind, tiles already in the
+// directory are not rewritten, and the least recently used files are removed
+// when the directory grows over its size limit.
+//
+
+#pragma once
+
+#include <filesystem>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <list>
+#include <unordered_map>
+
+namespace TiffCraft {
+
+  // FNV-1a hash of a sequence of bytes
+  inline uint64_t hashBytes(const void* data, size_t size,
+    uint64_t hash = 0xCBF29CE484222325ull)
+  {
+    const auto* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i) {
+      hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+    }
+    return hash;
+  }
+
+  // Identity of a file in a tile cache: its path, size, and modification
+  // time, so that a modified file does not hit the tiles of its old version
+  inline uint64_t fileIdentity(const std::filesystem::path& path)
+  {
+    const std::string name = std::filesystem::weakly_canonical(path).string();
+    const uint64_t size = std::filesystem::file_size(path);
+    const int64_t time = std::filesystem::last_write_time(path).time_since_epoch().count();
+    uint64_t hash = hashBytes(name.data(), name.size());
+    hash = hashBytes(&size, sizeof(size), hash);
+    return hashBytes(&time, sizeof(time), hash);
+  }
+
+  struct TileKey {
+    uint64_t file = 0;   // identity of the file, e.g. fileIdentity()
+    uint64_t ifd = 0;    // identity of the IFD in the file
+    uint64_t tile = 0;   // strip or tile index
+    uint64_t format = 0; // format of the decoded pixels
+
+    bool operator==(const TileKey&) const = default;
+  };
+
+  struct TileKeyHash {
+    size_t operator()(const TileKey& key) const
+    {
+      return static_cast<size_t>(hashBytes(&key, sizeof(key)));
+    }
+  };
+
+  // Directory of decoded tiles, see above
+  class DiskTileCache
+  {
+  public:
+    // Header of a tile file, followed by the pixels of the tile
+    struct FileHeader {
+      char magic[8] = { 'T', 'C', 'T', 'I', 'L', 'E', '0', '1' };
+      TileKey key;
+      uint64_t size = 0;
+    };
+
+    // Creates the cache in `directory`, which is created if needed, holding
+    // up to `maxBytes` bytes of tile files
+    DiskTileCache(std::filesystem::path directory, uint64_t maxBytes)
+      : directory_(std::move(directory)), maxBytes_(maxBytes)
+    {
+      std::filesystem::create_directories(directory_);
+      bytes_ = scan().second;
+    }
+
+    const std::filesystem::path& directory() const { return directory_; }
+
+    // Path of the file of a tile: the key hashed twice, in two levels of
+    // directories
+    std::filesystem::path path(const TileKey& key) const
+    {
+      const uint64_t h1 = hashBytes(&key, sizeof(key));
+      const uint64_t h2 = hashBytes(&key, sizeof(key), h1 ^ 0x9E3779B97F4A7C15ull);
+      char name[40];
+      std::snprintf(name, sizeof(name), "%016llx%016llx.tile",
+        static_cast<unsigned long long>(h1), static_cast<unsigned long long>(h2));
+      return directory_ / std::string(name, 2) / name;
+    }
+
+    // Reads a tile, or returns null if it is not in the cache or its file is
+    // not valid; files that are truncated or corrupt are removed. Reading a
+    // tile marks it as recently used, by refreshing the time of its file when
+    // it is older than `touchInterval`, so that hits rarely write metadata.
+    std::shared_ptr<const std::vector<std::byte>> find(const TileKey& key) const
+    {
+      const auto file = path(key);
+      std::ifstream stream(file, std::ios::binary | std::ios::ate);
+      if (!stream) {
+        return nullptr;
+      }
+      const uint64_t fileSize = static_cast<uint64_t>(stream.tellg());
+      stream.seekg(0);
+      // a header whose size does not fit in the file is not trusted
+      FileHeader header;
+      std::error_code error;
+      if (fileSize < sizeof(header)
+        || !stream.read(reinterpret_cast<char*>(&header), sizeof(header))
+        || std::memcmp(header.magic, FileHeader().magic, sizeof(header.magic)) != 0
+        || header.size > fileSize - sizeof(header)) {
+        stream.close();
+        std::filesystem::remove(file, error);
+        return nullptr;
+      }
+      if (header.key != key) {
+        return nullptr; // the file of another key with the same hash
+      }
+      auto tile = std::make_shared<std::vector<std::byte>>(header.size);
+      if (!stream.read(reinterpret_cast<char*>(tile->data()), tile->size())) {
+        return nullptr;
+      }
+      stream.close();
+      const auto now = std::filesystem::file_time_type::clock::now();
+      const auto time = std::filesystem::last_write_time(file, error);
+      if (!error && time < now - touchInterval) {
+        std::filesystem::last_write_time(file, now, error);
+      }
+      return tile;
+    }
+
+    // Writes a tile, unless the file of its key already exists: the key
+    // identifies the source file and the format of the pixels, so that file
+    // holds the same pixels, and replacing it would only force a flush of its
+    // data. Errors are ignored, since the cache is only an optimization.
+    void insert(const TileKey& key, const std::vector<std::byte>& tile)
+    {
+      const auto file = path(key);
+      std::error_code error;
+      if (std::filesystem::exists(file, error)) {
+        return;
+      }
+      std::filesystem::create_directories(file.parent_path(), error);
+      const auto temp = file.parent_path() / (file.filename().string()
+        + "." + std::to_string(randomId()) + ".tmp");
+      {
+        std::ofstream stream(temp, std::ios::binary);
+        FileHeader header;
+        header.key = key;
+        header.size = tile.size();
+        stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        stream.write(reinterpret_cast<const char*>(tile.data()), tile.size());
+        if (!stream.flush()) {
+          stream.close();
+          std::filesystem::remove(temp, error);
+          return;
+        }
+      }
+      // a hard link is only created when no other writer got there first;
+      // file systems without hard links fall back to a rename
+      std::filesystem::create_hard_link(temp, file, error);
+      if (!error) {
+        std::filesystem::remove(temp, error);
+      } else if (std::filesystem::exists(file, error)) {
+        std::filesystem::remove(temp, error);
+        return;
+      } else {
+        std::filesystem::rename(temp, file, error);
+        if (error) {
+          std::filesystem::remove(temp, error);
+          return;
+        }
+      }
+      if ((bytes_ += sizeof(FileHeader) + tile.size()) > maxBytes_) {
+        evict();
+      }
+    }
+
+    // Bytes of the tile files, as last counted
+    uint64_t bytes() const { return bytes_; }
+
+    // Removes the least recently used files until the directory holds at
+    // most 3/4 of its size limit. Files written by other processes are
+    // counted as well, and temporary files left by writers that did not
+    // finish are removed after an hour.
+    void evict()
+    {
+      std::lock_guard lock(evictMutex_);
+      auto [files, bytes] = scan(true);
+      std::sort(files.begin(), files.end(), [](const auto& a, const auto& b) {
+        return a.time < b.time;
+      });
+      const uint64_t target = maxBytes_ / 4 * 3;
+      for (const auto& file : files) {
+        if (bytes <= target) {
+          break;
+        }
+        std::error_code error;
+        if (std::filesystem::remove(file.path, error)) {
+          bytes -= file.size;
+        }
+      }
+      bytes_ = bytes;
+    }
+
+    // Reads refresh the time of a file at most once in this interval
+    static constexpr auto touchInterval = std::chrono::minutes(1);
+
+  private:
+    struct File {
+      std::filesystem::path path;
+      uint64_t size;
+      std::filesystem::file_time_type time;
+    };
+
+    std::filesystem::path directory_;
+    uint64_t maxBytes_;
+    std::atomic<uint64_t> bytes_ = 0;
+    std::mutex evictMutex_;
+
+    // Tile files in the directory and their total size
+    std::pair<std::vector<File>, uint64_t> scan(bool removeStaleFiles = false) const
+    {
+      std::vector<File> files;
+      uint64_t bytes = 0;
+      std::error_code error;
+      const auto staleTime = std::filesystem::file_time_type::clock::now()
+        - std::chrono::hours(1);
+      for (auto it = std::filesystem::recursive_directory_iterator(directory_, error);
+        !error && it != std::filesystem::recursive_directory_iterator(); it.increment(error)) {
+        if (removeStaleFiles && it->path().extension() == ".tmp"
+          && it->last_write_time(error) < staleTime && !error) {
+          std::filesystem::remove(it->path(), error);
+          error.clear();
+          continue;
+        }
+        if (it->is_regular_file(error) && it->path().extension() == ".tile") {
+          const uint64_t size = it->file_size(error);
+          const auto time = it->last_write_time(error);
+          if (!error) {
+            files.push_back({ it->path(), size, time });
+            bytes += size;
+          }
+        }
+      }
+      return { std::move(files), bytes };
+    }
+
+    static uint64_t randomId()
+    {
+      thread_local std::mt19937_64 rng(std::random_device{}());
+      return rng();
+    }
+  };
+
+  class TileCache
+  {
+  public:
+    using Tile = std::shared_ptr<const std::vector<std::byte>>;
+
+    struct Stats {
+      uint64_t hits = 0;
+      uint64_t diskHits = 0; // tiles read from the disk cache
+      uint64_t misses = 0;
+      uint64_t evictions = 0;
+      uint64_t tiles = 0; // tiles in the cache
+      uint64_t bytes = 0; // bytes of the tiles in the cache
+    };
+
+    // Creates a cache holding up to `budget` bytes of tiles. Each shard gets
+    // an equal share of the budget.
+    explicit TileCache(size_t budget, size_t shards = 16)
+      : budget_(budget), shards_(std::max<size_t>(1, shards))
+    {
+      for (auto& shard : shards_) {
+        shard = std::make_unique<Shard>();
+      }
+    }
+
+    TileCache(const TileCache&) = delete;
+    TileCache& operator=(const TileCache&) = delete;
+
+    size_t budget() const { return budget_; }
+
+    // Sets the disk cache looked up when a tile is not in memory, and where
+    // inserted tiles are also written
+    void setDiskCache(std::shared_ptr<DiskTileCache> diskCache)
+    {
+      diskCache_ = std::move(diskCache);
+    }
+
+    const std::shared_ptr<DiskTileCache>& diskCache() const { return diskCache_; }
+
+    // Returns the tile, or null if it is neither in memory nor on disk
+    Tile find(const TileKey& key)
+    {
+      Shard& shard = shardOf(key);
+      {
+        std::lock_guard lock(shard.mutex);
+        auto it = shard.index.find(key);
+        if (it != shard.index.end()) {
+          ++shard.stats.hits;
+          shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+          return it->second->second;
+        }
+      }
+      Tile tile = diskCache_ ? diskCache_->find(key) : nullptr;
+      std::lock_guard lock(shard.mutex);
+      if (!tile) {
+        ++shard.stats.misses;
+        return nullptr;
+      }
+      ++shard.stats.diskHits;
+      insert(shard, key, tile);
+      return tile;
+    }
+
+    // Adds a tile, or replaces it, evicting the least recently used tiles of
+    // its shard to stay within the budget. Tiles larger than the share of a
+    // shard are not kept in memory. The tile is also written to the disk
+    // cache, if any.
+    void insert(const TileKey& key, Tile tile)
+    {
+      if (!tile) {
+        return;
+      }
+      if (diskCache_) {
+        diskCache_->insert(key, *tile);
+      }
+      Shard& shard = shardOf(key);
+      std::lock_guard lock(shard.mutex);
+      insert(shard, key, std::move(tile));
+    }
+
+    // Counters of all the shards
+    Stats stats() const
+    {
+      Stats total;
+      for (const auto& shard : shards_) {
+        std::lock_guard lock(shard->mutex);
+        total.hits += shard->stats.hits;
+        total.diskHits += shard->stats.diskHits;
+        total.misses += shard->stats.misses;
+        total.evictions += shard->stats.evictions;
+        total.tiles += shard->lru.size();
+        total.bytes += shard->stats.bytes;
+      }
+      return total;
+    }
+
+    // Removes all the tiles from memory; the counters and the disk cache are
+    // kept
+    void clear()
+    {
+      for (auto& shard : shards_) {
+        std::lock_guard lock(shard->mutex);
+        shard->lru.clear();
+        shard->index.clear();
+        shard->stats.bytes = 0;
+      }
+    }
+
+  private:
+    using List = std::list<std::pair<TileKey, Tile>>;
+
+    struct Shard {
+      mutable std::mutex mutex;
+      List lru; // most recently used first
+      std::unordered_map<TileKey, List::iterator, TileKeyHash> index;
+      Stats stats;
+    };
+
+    size_t budget_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+    std::shared_ptr<DiskTileCache> diskCache_;
+
+    Shard& shardOf(const TileKey& key)
+    {
+      // the low bits of the hash select the bucket within the shard, so the
+      // shard is chosen from the high bits of the 64-bit hash, whatever the
+      // width of size_t
+      const uint64_t hash = hashBytes(&key, sizeof(key));
+      return *shards_[static_cast<size_t>((hash >> 32) % shards_.size())];
+    }
+
+    // Adds a tile to a locked shard
+    void insert(Shard& shard, const TileKey& key, Tile tile)
+    {
+      const size_t shardBudget = budget_ / shards_.size();
+      if (tile->size() > shardBudget) {
+        return;
+      }
+      if (auto it = shard.index.find(key); it != shard.index.end()) {
+        shard.stats.bytes -= it->second->second->size();
+        shard.lru.erase(it->second);
+        shard.index.erase(it);
+      }
+      shard.stats.bytes += tile->size();
+      shard.lru.emplace_front(key, std::move(tile));
+      shard.index[key] = shard.lru.begin();
+      while (shard.stats.bytes > shardBudget) {
+        const auto& [lastKey, lastTile] = shard.lru.back();
+        shard.stats.bytes -= lastTile->size();
+        shard.index.erase(lastKey);
+        shard.lru.pop_back();
+        ++shard.stats.evictions;
+      }
+    }
+  };
+
+} // namespace TiffCraft
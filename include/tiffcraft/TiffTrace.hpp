@@ -0,0 +1,301 @@
+// BSD 2-Clause License
+// Copyright (c) 2025 Daniel Moreno
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS”
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+// ---------------------------------------------------------------------------
+//
+// TiffTrace.hpp
+// =============
+// This file contains optional trace events of the load pipeline, written in
+// the Chrome trace JSON format that chrome://tracing and Perfetto open. They
+// show the timeline of parsing, reading, and decoding across threads.
+//
+// Tracing is compiled out unless TIFFCRAFT_USE_TRACE is defined, e.g. with
+// the `TIFFCRAFT_USE_TRACE` CMake option; TIFFCRAFT_TRACE_SCOPE() then
+// expands to nothing. When compiled in, events are recorded between
+// `startTrace()` and `stopTrace()` only:
+//
+//     TiffCraft::startTrace();
+//     TiffCraft::load("image.tif", std::ref(exporter));
+//     TiffCraft::stopTrace();
+//     std::ofstream file("trace.json");
+//     TiffCraft::writeTrace(file);
+//
+// Each thread records its events in its own ring buffer, without locks, and
+// the oldest events are overwritten when it is full. Buffers of threads that
+// exit are kept for `writeTrace()` and reused by new threads, which must not
+// be recording while the trace is started or written.
+//
+
+#pragma once
+
+#include <ostream>
+
+#ifdef TIFFCRAFT_USE_TRACE
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Number of events kept by each thread
+#ifndef TIFFCRAFT_TRACE_EVENTS
+#define TIFFCRAFT_TRACE_EVENTS 16384
+#endif
+#endif
+
+namespace TiffCraft {
+
+#ifdef TIFFCRAFT_USE_TRACE
+
+  // Complete event: a named span of time of one thread. Names must be string
+  // literals, since only the pointer is kept.
+  struct TraceEvent {
+    const char* name = nullptr;
+    const char* argName = nullptr; // name of `arg`, or null if none
+    int64_t arg = 0;
+    uint64_t start = 0;            // nanoseconds since the trace started
+    uint64_t duration = 0;         // nanoseconds
+    uint32_t thread = 0;
+  };
+
+  class Tracer
+  {
+  public:
+    // Discards the recorded events and starts recording
+    void start()
+    {
+      std::lock_guard lock(mutex_);
+      for (auto& buffer : buffers_) {
+        buffer->clear();
+      }
+      origin_ = Clock::now().time_since_epoch().count();
+      enabled_ = true;
+    }
+
+    void stop() { enabled_ = false; }
+
+    bool isEnabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+    // Nanoseconds since the trace started
+    uint64_t now() const
+    {
+      const auto ticks = Clock::now().time_since_epoch().count() - origin_;
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        Clock::duration(ticks)).count();
+    }
+
+    // Records an event of the calling thread
+    void record(TraceEvent event)
+    {
+      ThreadSlot& slot = threadSlot();
+      event.thread = slot.thread;
+      slot.buffer->push(event);
+    }
+
+    // Number of events overwritten since the trace started
+    uint64_t dropped() const
+    {
+      std::lock_guard lock(mutex_);
+      uint64_t count = 0;
+      for (const auto& buffer : buffers_) {
+        count += buffer->dropped();
+      }
+      return count;
+    }
+
+    // Writes the recorded events as Chrome trace JSON and discards them
+    void write(std::ostream& os)
+    {
+      std::lock_guard lock(mutex_);
+      uint64_t dropped = 0;
+      const char* separator = "\n";
+      os << "{\"traceEvents\":[";
+      for (auto& buffer : buffers_) {
+        dropped += buffer->dropped();
+        buffer->forEach([&](const TraceEvent& event) {
+          os << separator << "{\"name\":\"" << event.name
+            << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread
+            << ",\"ts\":" << event.start / 1000 << '.' << digits(event.start % 1000)
+            << ",\"dur\":" << event.duration / 1000 << '.' << digits(event.duration % 1000);
+          if (event.argName) {
+            os << ",\"args\":{\"" << event.argName << "\":" << event.arg << '}';
+          }
+          os << '}';
+          separator = ",\n";
+        });
+        buffer->clear();
+      }
+      os << "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"droppedEvents\":"
+        << dropped << "}}\n";
+    }
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    // Ring buffer of the events of one thread
+    class Buffer
+    {
+    public:
+      bool isInUse = false; // owned by a running thread
+
+      void push(const TraceEvent& event)
+      {
+        if (events_.empty()) {
+          events_.resize(TIFFCRAFT_TRACE_EVENTS);
+        }
+        events_[count_ % events_.size()] = event;
+        ++count_;
+      }
+
+      uint64_t dropped() const
+      {
+        return count_ > events_.size() ? count_ - events_.size() : 0;
+      }
+
+      // Calls `f` with the events kept, oldest first
+      template <typename F>
+      void forEach(F&& f) const
+      {
+        const uint64_t first = dropped();
+        for (uint64_t i = first; i < count_; ++i) {
+          f(events_[i % events_.size()]);
+        }
+      }
+
+      void clear() { count_ = 0; }
+
+    private:
+      std::vector<TraceEvent> events_;
+      uint64_t count_ = 0;
+    };
+
+    // Buffer of a thread, given back to the tracer when the thread exits
+    struct ThreadSlot {
+      Tracer& tracer;
+      Buffer* buffer;
+      uint32_t thread;
+
+      explicit ThreadSlot(Tracer& t)
+        : tracer(t), buffer(t.acquire()), thread(t.nextThread_++) {}
+
+      ~ThreadSlot() { tracer.release(buffer); }
+    };
+
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<Buffer>> buffers_;
+    std::atomic<bool> enabled_ = false;
+    std::atomic<Clock::rep> origin_ = 0;
+    std::atomic<uint32_t> nextThread_ = 1;
+
+    ThreadSlot& threadSlot()
+    {
+      thread_local ThreadSlot slot(*this);
+      return slot;
+    }
+
+    Buffer* acquire()
+    {
+      std::lock_guard lock(mutex_);
+      auto it = std::find_if(buffers_.begin(), buffers_.end(),
+        [](const auto& buffer) { return !buffer->isInUse; });
+      if (it == buffers_.end()) {
+        it = buffers_.insert(buffers_.end(), std::make_unique<Buffer>());
+      }
+      (*it)->isInUse = true;
+      return it->get();
+    }
+
+    void release(Buffer* buffer)
+    {
+      std::lock_guard lock(mutex_);
+      buffer->isInUse = false;
+    }
+
+    // Three digits of the fraction of a microsecond
+    static std::string digits(uint64_t nanoseconds)
+    {
+      std::string text = std::to_string(nanoseconds);
+      return std::string(3 - text.size(), '0') + text;
+    }
+  };
+
+  // Tracer used by TIFFCRAFT_TRACE_SCOPE()
+  inline Tracer& tracer()
+  {
+    static Tracer instance;
+    return instance;
+  }
+
+  // Records an event spanning the lifetime of the object, if tracing is on
+  class TraceScope
+  {
+  public:
+    explicit TraceScope(const char* name, const char* argName = nullptr, int64_t arg = 0)
+      : name_(name), argName_(argName), arg_(arg),
+        isEnabled_(tracer().isEnabled()), start_(isEnabled_ ? tracer().now() : 0) {}
+
+    ~TraceScope()
+    {
+      if (isEnabled_ && tracer().isEnabled()) {
+        tracer().record({ name_, argName_, arg_, start_, tracer().now() - start_ });
+      }
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+  private:
+    const char* name_;
+    const char* argName_;
+    int64_t arg_;
+    bool isEnabled_;
+    uint64_t start_;
+  };
+
+  inline void startTrace() { tracer().start(); }
+  inline void stopTrace() { tracer().stop(); }
+  inline void writeTrace(std::ostream& os) { tracer().write(os); }
+
+#define TIFFCRAFT_TRACE_CONCAT_(a, b) a##b
+#define TIFFCRAFT_TRACE_CONCAT(a, b) TIFFCRAFT_TRACE_CONCAT_(a, b)
+
+  // Records the enclosing scope as an event: TIFFCRAFT_TRACE_SCOPE(name) or
+  // TIFFCRAFT_TRACE_SCOPE(name, argName, arg), with string literal names
+#define TIFFCRAFT_TRACE_SCOPE(...) \
+  ::TiffCraft::TraceScope TIFFCRAFT_TRACE_CONCAT(tiffcraftTraceScope, __LINE__)(__VA_ARGS__)
+
+#else
+
+  inline void startTrace() {}
+  inline void stopTrace() {}
+  inline void writeTrace(std::ostream& os) { os << "{\"traceEvents\":[]}\n"; }
+
+#define TIFFCRAFT_TRACE_SCOPE(...) ((void)0)
+
+#endif // TIFFCRAFT_USE_TRACE
+
+} // namespace TiffCraft
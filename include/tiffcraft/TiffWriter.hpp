@@ -0,0 +1,839 @@
+// BSD 2-Clause License
+// Copyright (c) 2025 Daniel Moreno
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS”
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+// ---------------------------------------------------------------------------
+//
+// TiffWriter.hpp
+// ==============
+// This file contains the TiffWriter class, which writes an image as a TIFF
+// file organized in strips or tiles, uncompressed or compressed.
+//
+// Uncompressed strips are written in a single forward pass. The size of every
+// strip is known in advance, so the whole file layout is computed before the
+// first byte is written: the header, then the pixel data, and last the IFD
+// followed by its out-of-line values (e.g., the strip offsets). The writer
+// never seeks, so the output may be a pipe or a socket.
+//
+// Compressed strips and tiles are encoded in parallel by a pool of worker
+// threads, and appended to the file in the order they are finished. The
+// offset of each one is recorded as it is written, and the IFD follows the
+// last one. Only the offset of the IFD in the header is written afterwards,
+// which needs one seek back. The number of strips or tiles waiting to be
+// encoded or being encoded is bounded, so memory use does not grow with the
+// image size.
+//
+// All output goes through a buffer and is written to the stream in large
+// blocks.
+//
+
+#pragma once
+
+#include "TiffImage.hpp"
+#include "TiffExporter.hpp"
+#include "TiffLzw.hpp"
+#include "TiffDeflate.hpp"
+#include "TiffPackBits.hpp"
+#include "TiffPredictor.hpp"
+#include "TiffZstd.hpp"
+
+#include <condition_variable>
+#include <exception>
+#include <stdexcept>
+#include <algorithm>
+#include <optional>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <memory>
+#include <span>
+#include <bit>
+
+namespace TiffCraft {
+
+  struct WriteParams {
+    bool isBigTiff = false;                      // BigTIFF instead of classic TIFF
+    std::endian byteOrder = std::endian::native; // byte order of the file
+    bool isPlanar = false;                       // one set of strips per channel
+    int rowsPerStrip = 0;                        // 0 for strips of about 64 KiB
+    int sampleFormat = 1;                        // 1 = unsigned, 2 = signed, 3 = float
+    std::optional<int> photometric{};            // default: RGB for 3 or more
+                                                 //   channels; 5 (CMYK) needs 4
+    size_t bufferSize = size_t(1) << 20;         // bytes buffered between stream writes
+    int tileWidth = 0;                           // tiles instead of strips when not 0;
+    int tileLength = 0;                          //   both must be multiples of 16
+    int compression = 1;                         // 1, 5 (LZW), 8 (Deflate), 32773
+                                                 //   (PackBits), or 50000 (Zstandard)
+    int compressionLevel = 0;                    // 0 for the default of the codec
+    int predictor = 1;                           // 2 = horizontal, 3 = floating point
+    int threads = 0;                             // encoding threads, 0 for one per
+                                                 //   hardware thread
+    int maxTilesInFlight = 0;                    // strips or tiles queued or being
+                                                 //   encoded, 0 for two per thread
+  };
+
+  // Compression tag values that TiffWriter can encode
+  inline bool isWriteCompressionSupported(int compression)
+  {
+    switch (compression) {
+      case 1: // no compression
+      case 5: // LZW
+      case 8: // Deflate
+      case 32773: // PackBits
+#ifdef TIFFCRAFT_USE_ZSTD
+      case 50000: // Zstandard
+#endif
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  // A field of an IFD to write, with values in host byte order
+  struct TiffField {
+    Tag tag;
+    Type type;
+    uint64_t count;
+    std::vector<std::byte> values;
+
+    template <typename T>
+    static TiffField make(Tag tag, Type type, const std::vector<T>& values)
+    {
+      std::vector<std::byte> bytes(values.size() * sizeof(T));
+      std::memcpy(bytes.data(), values.data(), bytes.size());
+      return { tag, type, values.size(), std::move(bytes) };
+    }
+  };
+
+  // Buffered output of TIFF data in the byte order of the file. Large blocks
+  // bypass the buffer. The position is counted from the header.
+  class TiffOutput
+  {
+  public:
+    TiffOutput(std::ostream& stream, std::endian byteOrder, bool isBigTiff,
+      size_t bufferSize = size_t(1) << 20)
+      : stream_(stream), mustSwap_(byteOrder != std::endian::native),
+        byteOrder_(byteOrder), isBigTiff_(isBigTiff)
+    {
+      buffer_.reserve(std::max<size_t>(bufferSize, 4096));
+    }
+
+    std::ostream& stream() { return stream_; }
+    uint64_t position() const { return position_; }
+    bool isBigTiff() const { return isBigTiff_; }
+    bool mustSwap() const { return mustSwap_; }
+
+    void flush()
+    {
+      stream_.write(reinterpret_cast<const char*>(buffer_.data()), buffer_.size());
+      buffer_.clear();
+      if (!stream_) {
+        throw std::runtime_error("Failed to write TIFF data");
+      }
+    }
+
+    void put(const std::byte* data, size_t size)
+    {
+      position_ += size;
+      if (buffer_.size() + size > buffer_.capacity()) {
+        flush();
+      }
+      if (size >= buffer_.capacity()) {
+        // large blocks go straight to the stream
+        stream_.write(reinterpret_cast<const char*>(data), size);
+        if (!stream_) {
+          throw std::runtime_error("Failed to write TIFF data");
+        }
+        return;
+      }
+      buffer_.insert(buffer_.end(), data, data + size);
+    }
+
+    void put(std::byte value) { put(&value, 1); }
+
+    template <typename T>
+    void putValue(T value)
+    {
+      if (mustSwap_) {
+        value = swap(value);
+      }
+      put(reinterpret_cast<const std::byte*>(&value), sizeof(value));
+    }
+
+    // Offsets and counts, which are 64-bit in BigTIFF
+    void putOffset(uint64_t value)
+    {
+      if (isBigTiff_) {
+        putValue<uint64_t>(value);
+      } else {
+        putValue<uint32_t>(static_cast<uint32_t>(value));
+      }
+    }
+
+    // Writes samples of `bitDepth` bits in host byte order, swapping them in
+    // the buffer, one block at a time, if needed
+    void putSamples(std::span<const std::byte> samples, int bitDepth)
+    {
+      const size_t sampleBytes = bitDepth / 8;
+      if (!mustSwap_ || sampleBytes == 1) {
+        put(samples.data(), samples.size());
+        return;
+      }
+      while (!samples.empty()) {
+        if (buffer_.size() + sampleBytes > buffer_.capacity()) {
+          flush();
+        }
+        const size_t available = (buffer_.capacity() - buffer_.size()) / sampleBytes * sampleBytes;
+        const size_t bytes = std::min(samples.size(), available);
+        const size_t start = buffer_.size();
+        buffer_.insert(buffer_.end(), samples.begin(), samples.begin() + bytes);
+        swapSamples(buffer_.data() + start, bytes / sampleBytes, bitDepth);
+        position_ += bytes;
+        samples = samples.subspan(bytes);
+      }
+    }
+
+    // Pads the output to a word boundary
+    void align()
+    {
+      if (position_ & 1) {
+        put(std::byte{ 0 });
+      }
+    }
+
+    void writeHeader(uint64_t ifdOffset)
+    {
+      putValue<uint16_t>(byteOrder_ == std::endian::little ? 0x4949 : 0x4D4D);
+      putValue<uint16_t>(isBigTiff_ ? 43 : 42);
+      if (isBigTiff_) {
+        putValue<uint16_t>(8); // bytes per offset
+        putValue<uint16_t>(0);
+      }
+      putOffset(ifdOffset);
+    }
+
+    // Bytes taken by an IFD with `fields` and their out-of-line values
+    static uint64_t ifdBytes(const std::vector<TiffField>& fields, bool isBigTiff)
+    {
+      const uint64_t inlineBytes = isBigTiff ? 8 : 4;
+      uint64_t bytes = (isBigTiff ? 16 : 6) + fields.size() * (isBigTiff ? 20 : 12);
+      for (const auto& field : fields) {
+        if (field.values.size() > inlineBytes) {
+          bytes += field.values.size() + (field.values.size() & 1);
+        }
+      }
+      return bytes;
+    }
+
+    // Writes an IFD at the current position, which must be on a word
+    // boundary, followed by the out-of-line values. The fields must be
+    // sorted by tag.
+    void writeIFD(std::vector<TiffField> fields, uint64_t nextIFDOffset = 0)
+    {
+      const uint64_t inlineBytes = isBigTiff_ ? 8 : 4;
+      const uint64_t entryBytes = isBigTiff_ ? 20 : 12;
+      const uint64_t ifdBytes = (isBigTiff_ ? 16 : 6) + fields.size() * entryBytes;
+
+      // out-of-line values follow the IFD, each one on a word boundary
+      std::vector<uint64_t> valueOffsets;
+      uint64_t end = position_ + ifdBytes;
+      for (auto& field : fields) {
+        if (mustSwap_) {
+          swapArray(field.values.data(), field.type, field.count);
+        }
+        if (field.values.size() > inlineBytes) {
+          valueOffsets.push_back(end);
+          end += field.values.size() + (field.values.size() & 1);
+        } else {
+          valueOffsets.push_back(0);
+        }
+      }
+      if (!isBigTiff_ && end > UINT32_MAX) {
+        throw std::runtime_error("Image is too large for a classic TIFF file, use BigTIFF");
+      }
+
+      if (isBigTiff_) {
+        putValue<uint64_t>(fields.size());
+      } else {
+        putValue<uint16_t>(static_cast<uint16_t>(fields.size()));
+      }
+      for (size_t i = 0; i < fields.size(); ++i) {
+        const auto& field = fields[i];
+        putValue(field.tag);
+        putValue(field.type);
+        putOffset(field.count);
+        if (valueOffsets[i] > 0) {
+          putOffset(valueOffsets[i]);
+        } else {
+          std::byte value[8] = {};
+          std::memcpy(value, field.values.data(), field.values.size());
+          put(value, inlineBytes);
+        }
+      }
+      putOffset(nextIFDOffset);
+
+      for (size_t i = 0; i < fields.size(); ++i) {
+        if (valueOffsets[i] > 0) {
+          put(fields[i].values.data(), fields[i].values.size());
+          align();
+        }
+      }
+    }
+
+    static void swapSamples(std::byte* samples, size_t count, int bitDepth)
+    {
+      switch (bitDepth) {
+        case 16: swapArray(reinterpret_cast<uint16_t*>(samples), count); break;
+        case 32: swapArray(reinterpret_cast<uint32_t*>(samples), count); break;
+        case 64: swapArray(reinterpret_cast<uint64_t*>(samples), count); break;
+        default: break;
+      }
+    }
+
+  private:
+    std::ostream& stream_;
+    bool mustSwap_;
+    std::endian byteOrder_;
+    bool isBigTiff_;
+    uint64_t position_ = 0;
+    std::vector<std::byte> buffer_;
+  };
+
+  class TiffWriter
+  {
+  public:
+    // Starts writing an image of the given size and sample layout. Samples
+    // must be 8, 16, 32, or 64 bits.
+    TiffWriter(std::ostream& stream, int width, int height, int channels,
+      int bitDepth, const WriteParams& params = {})
+      : output_(stream, params.byteOrder, params.isBigTiff, params.bufferSize),
+        params_(params), width_(width), height_(height),
+        channels_(channels), bitDepth_(bitDepth)
+    {
+      if (width <= 0 || height <= 0 || channels <= 0 || channels > UINT16_MAX) {
+        throw std::runtime_error("Invalid image size");
+      }
+      if (bitDepth != 8 && bitDepth != 16 && bitDepth != 32 && bitDepth != 64) {
+        throw FormatNotSupportedError("Writing " + std::to_string(bitDepth) + "-bit samples");
+      }
+      if (params.sampleFormat < 1 || params.sampleFormat > 3
+        || (params.sampleFormat == 3 && bitDepth < 32)) {
+        throw std::runtime_error("Invalid sample format");
+      }
+      if (!isWriteCompressionSupported(params.compression)) {
+        throw FormatNotSupportedError(
+          "Writing compression " + std::to_string(params.compression));
+      }
+      if (params.predictor < 1 || params.predictor > 3
+        || (params.predictor > 1 && (params.compression == 1 || params.compression == 32773))
+        || (params.predictor == 3 && params.sampleFormat != 3)) {
+        throw std::runtime_error("Invalid predictor for the compression or sample format");
+      }
+      const bool isTiled = params.tileWidth != 0 || params.tileLength != 0;
+      if (isTiled && (params.tileWidth <= 0 || params.tileLength <= 0
+        || params.tileWidth % 16 != 0 || params.tileLength % 16 != 0)) {
+        throw std::runtime_error("Tile width and length must be multiples of 16");
+      }
+      if (channels < colorChannels(params.photometric.value_or(1))) {
+        throw std::runtime_error("Too few channels for the photometric interpretation");
+      }
+
+      const int planes = params.isPlanar ? channels : 1;
+      pixelBytes_ = size_t(params.isPlanar ? 1 : channels) * (bitDepth / 8);
+      rowBytes_ = size_t(width) * pixelBytes_;
+      rowsPerStrip_ = params.rowsPerStrip > 0 ? std::min(params.rowsPerStrip, height)
+        : static_cast<int>(std::clamp<size_t>((64 << 10) / rowBytes_, 1, height));
+      totalRows_ = uint64_t(height) * planes;
+
+      // strips are chunks as wide as the image, and the last one is shorter
+      chunkWidth_ = isTiled ? params.tileWidth : width;
+      chunkLength_ = isTiled ? params.tileLength : rowsPerStrip_;
+      chunksAcross_ = (width + chunkWidth_ - 1) / chunkWidth_;
+      chunksDown_ = (height + chunkLength_ - 1) / chunkLength_;
+      const size_t chunks = size_t(planes) * chunksAcross_ * chunksDown_;
+      offsets_.resize(chunks);
+      byteCounts_.resize(chunks);
+      isChunked_ = isTiled || params.compression != 1;
+
+      const uint64_t headerBytes = params.isBigTiff ? 16 : 8;
+      if (params.compression == 1) {
+        // the layout is known: chunks are written in order, unless tiled
+        uint64_t offset = headerBytes;
+        for (size_t i = 0; i < chunks; ++i) {
+          const int y = static_cast<int>(i / chunksAcross_ % chunksDown_) * chunkLength_;
+          byteCounts_[i] = isTiled ? uint64_t(chunkWidth_) * chunkLength_ * pixelBytes_
+            : rowBytes_ * std::min(chunkLength_, height - y);
+          offsets_[i] = offset;
+          offset += byteCounts_[i];
+        }
+        ifdOffset_ = offset + (offset & 1); // word boundary
+        if (!params.isBigTiff && ifdOffset_ > UINT32_MAX) {
+          throw std::runtime_error("Image is too large for a classic TIFF file, use BigTIFF");
+        }
+      } else {
+        // the IFD offset is written when known, relative to the current position
+        start_ = stream.tellp();
+        if (start_ < 0) {
+          throw std::runtime_error("Compressed output needs a seekable stream");
+        }
+      }
+
+      output_.writeHeader(ifdOffset_); // 0 until known, if compressed
+
+      if (isChunked_) {
+        band_.resize(size_t(chunkLength_) * rowBytes_);
+        const int threads = params.threads > 0 ? params.threads
+          : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+        maxInFlight_ = params.maxTilesInFlight > 0 ? params.maxTilesInFlight : 2 * threads;
+        if (threads > 1) {
+          for (int i = 0; i < threads; ++i) {
+            workers_.emplace_back([this]() { work(); });
+          }
+        }
+      }
+    }
+
+    ~TiffWriter() { stopWorkers(); }
+
+    TiffWriter(const TiffWriter&) = delete;
+    TiffWriter& operator=(const TiffWriter&) = delete;
+
+    size_t rowBytes() const { return rowBytes_; }
+    int rowsPerStrip() const { return rowsPerStrip_; }
+
+    // Writes whole rows of samples in host byte order, any number of rows at
+    // a time. In planar images, all the rows of the first channel come
+    // first, then all the rows of the second channel, and so on.
+    void writeRows(std::span<const std::byte> rows)
+    {
+      if (rows.size() % rowBytes_ != 0) {
+        throw std::runtime_error("Data is not a whole number of rows");
+      }
+      if (rowsWritten_ + rows.size() / rowBytes_ > totalRows_) {
+        throw std::runtime_error("More rows than the image height");
+      }
+      if (isChunked_) {
+        addToBand(rows);
+        return;
+      }
+      rowsWritten_ += rows.size() / rowBytes_;
+      output_.putSamples(rows, bitDepth_);
+    }
+
+    // Writes the IFD after the last row. The file is complete afterwards.
+    void finish()
+    {
+      if (rowsWritten_ != totalRows_) {
+        throw std::runtime_error("Not all the rows of the image were written");
+      }
+      if (isChunked_) {
+        waitForChunks();
+      }
+      output_.align();
+      if (params_.compression != 1) {
+        ifdOffset_ = output_.position();
+      }
+      output_.writeIFD(makeFields());
+      output_.flush();
+      auto& stream = output_.stream();
+      if (params_.compression != 1) {
+        // the offset of the IFD in the header
+        stream.seekp(start_ + std::streamoff(params_.isBigTiff ? 8 : 4));
+        output_.putOffset(ifdOffset_);
+        output_.flush();
+        stream.seekp(0, std::ios_base::end);
+      }
+      stream.flush();
+      if (!stream) {
+        throw std::runtime_error("Failed to write TIFF data");
+      }
+    }
+
+  private:
+    // A strip or tile waiting to be encoded
+    struct Chunk {
+      size_t index;
+      std::vector<std::byte> data;
+      size_t rows;
+    };
+
+    // Encoders of one thread, created when first needed
+    struct Encoders {
+      std::optional<LzwEncoder> lzw;
+      std::optional<DeflateEncoder> deflate;
+      std::optional<PackBitsEncoder> packBits;
+#ifdef TIFFCRAFT_USE_ZSTD
+      std::optional<ZstdEncoder> zstd;
+#endif
+      std::vector<std::byte> scratch;
+    };
+
+    TiffOutput output_;
+    WriteParams params_;
+    int width_;
+    int height_;
+    int channels_;
+    int bitDepth_;
+    size_t pixelBytes_ = 0;
+    size_t rowBytes_ = 0;
+    int rowsPerStrip_ = 0;
+    uint64_t totalRows_ = 0;
+    uint64_t rowsWritten_ = 0;
+    uint64_t ifdOffset_ = 0;
+    std::streamoff start_ = 0;  // position of the header in the stream
+
+    // strips or tiles
+    bool isChunked_ = false;
+    int chunkWidth_ = 0;
+    int chunkLength_ = 0;
+    int chunksAcross_ = 0;
+    int chunksDown_ = 0;
+    std::vector<uint64_t> offsets_;
+    std::vector<uint64_t> byteCounts_;
+    std::vector<std::byte> band_; // rows of the next strip or row of tiles
+    size_t bandRows_ = 0;
+    Encoders encoders_;           // used when there are no workers
+
+    // worker pool; the output is written by the workers under outputMutex_
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::mutex outputMutex_;
+    std::condition_variable chunkReady_;
+    std::condition_variable chunkDone_;
+    std::deque<Chunk> queue_;
+    size_t maxInFlight_ = 1;
+    size_t inFlight_ = 0;
+    bool isStopping_ = false;
+    std::exception_ptr error_;
+
+    // Copies rows into the band, and cuts it into strips or tiles when full
+    void addToBand(std::span<const std::byte> rows)
+    {
+      while (!rows.empty()) {
+        const uint64_t y = (rowsWritten_ - bandRows_) % height_; // first row of the band
+        const size_t bandLength = std::min<uint64_t>(chunkLength_, height_ - y);
+        const size_t count = std::min(rows.size() / rowBytes_, bandLength - bandRows_);
+        std::memcpy(band_.data() + bandRows_ * rowBytes_, rows.data(), count * rowBytes_);
+        rows = rows.subspan(count * rowBytes_);
+        bandRows_ += count;
+        rowsWritten_ += count;
+        if (bandRows_ == bandLength) {
+          cutBand();
+        }
+      }
+    }
+
+    void cutBand()
+    {
+      const uint64_t bandStart = rowsWritten_ - bandRows_;
+      const size_t plane = bandStart / height_;
+      const size_t row = (bandStart % height_) / chunkLength_;
+      const size_t first = (plane * chunksDown_ + row) * chunksAcross_;
+      if (chunkWidth_ == width_) {
+        // the band is the strip, or the tile padded with zero rows
+        const size_t rows = params_.tileLength > 0 ? chunkLength_ : bandRows_;
+        std::vector<std::byte> data(band_.size());
+        data.swap(band_);
+        data.resize(rows * rowBytes_);
+        submit({ first, std::move(data), rows });
+      } else {
+        const size_t chunkRowBytes = chunkWidth_ * pixelBytes_;
+        for (int i = 0; i < chunksAcross_; ++i) {
+          const size_t x = size_t(i) * chunkWidth_;
+          const size_t bytes = std::min<size_t>(chunkWidth_, width_ - x) * pixelBytes_;
+          std::vector<std::byte> data(chunkRowBytes * chunkLength_); // zero padding
+          for (size_t y = 0; y < bandRows_; ++y) {
+            std::memcpy(data.data() + y * chunkRowBytes,
+              band_.data() + y * rowBytes_ + x * pixelBytes_, bytes);
+          }
+          submit({ first + i, std::move(data), size_t(chunkLength_) });
+        }
+      }
+      bandRows_ = 0;
+    }
+
+    void submit(Chunk chunk)
+    {
+      if (workers_.empty()) {
+        encode(chunk, encoders_);
+        write(chunk);
+        return;
+      }
+      std::unique_lock lock(mutex_);
+      chunkDone_.wait(lock, [&]() { return inFlight_ < maxInFlight_ || error_; });
+      if (error_) {
+        std::rethrow_exception(error_);
+      }
+      ++inFlight_;
+      queue_.push_back(std::move(chunk));
+      chunkReady_.notify_one();
+    }
+
+    void work()
+    {
+      Encoders encoders;
+      for (;;) {
+        std::unique_lock lock(mutex_);
+        chunkReady_.wait(lock, [&]() { return !queue_.empty() || isStopping_; });
+        if (queue_.empty()) {
+          return;
+        }
+        Chunk chunk = std::move(queue_.front());
+        queue_.pop_front();
+        lock.unlock();
+
+        std::exception_ptr error;
+        try {
+          encode(chunk, encoders);
+          std::lock_guard outputLock(outputMutex_);
+          write(chunk);
+        } catch (...) {
+          error = std::current_exception();
+        }
+        lock.lock();
+        if (error && !error_) {
+          error_ = error;
+        }
+        --inFlight_;
+        chunkDone_.notify_all();
+      }
+    }
+
+    void waitForChunks()
+    {
+      std::unique_lock lock(mutex_);
+      chunkDone_.wait(lock, [&]() { return inFlight_ == 0; });
+      if (error_) {
+        std::rethrow_exception(error_);
+      }
+    }
+
+    void stopWorkers()
+    {
+      {
+        std::lock_guard lock(mutex_);
+        isStopping_ = true;
+      }
+      chunkReady_.notify_all();
+      for (auto& worker : workers_) {
+        worker.join();
+      }
+      workers_.clear();
+    }
+
+    // Applies the predictor, converts to the file byte order, and compresses
+    void encode(Chunk& chunk, Encoders& encoders)
+    {
+      const size_t rowBytes = chunk.data.size() / chunk.rows;
+      const size_t count = rowBytes / (bitDepth_ / 8);
+      const size_t channels = params_.isPlanar ? 1 : channels_;
+      for (size_t y = 0; y < chunk.rows; ++y) {
+        std::byte* row = chunk.data.data() + y * rowBytes;
+        if (params_.predictor == 2) {
+          switch (bitDepth_) {
+            case 8: applyHorizontalPredictor(reinterpret_cast<uint8_t*>(row), count, channels); break;
+            case 16: applyHorizontalPredictor(reinterpret_cast<uint16_t*>(row), count, channels); break;
+            case 32: applyHorizontalPredictor(reinterpret_cast<uint32_t*>(row), count, channels); break;
+            case 64: applyHorizontalPredictor(reinterpret_cast<uint64_t*>(row), count, channels); break;
+            default: break;
+          }
+        } else if (params_.predictor == 3) {
+          // the bytes are ordered by significance, whatever the byte order
+          applyFloatingPointPredictor(row, count, channels, bitDepth_ / 8, encoders.scratch);
+          continue;
+        }
+        if (output_.mustSwap()) {
+          TiffOutput::swapSamples(row, count, bitDepth_);
+        }
+      }
+
+      const int level = params_.compressionLevel;
+      switch (params_.compression) {
+        case 5:
+          if (!encoders.lzw) {
+            encoders.lzw.emplace();
+          }
+          chunk.data = encoders.lzw->encode(chunk.data);
+          break;
+        case 8:
+          if (!encoders.deflate) {
+            encoders.deflate.emplace(level > 0 ? level : 6);
+          }
+          chunk.data = encoders.deflate->encode(chunk.data);
+          break;
+        case 32773:
+          if (!encoders.packBits) {
+            encoders.packBits.emplace();
+          }
+          chunk.data = encoders.packBits->encode(chunk.data, rowBytes);
+          break;
+#ifdef TIFFCRAFT_USE_ZSTD
+        case 50000:
+          if (!encoders.zstd) {
+            encoders.zstd.emplace(level > 0 ? level : ZSTD_CLEVEL_DEFAULT);
+          }
+          chunk.data = encoders.zstd->encode(chunk.data);
+          break;
+#endif
+        default:
+          break;
+      }
+    }
+
+    // Appends an encoded strip or tile to the file
+    void write(const Chunk& chunk)
+    {
+      offsets_[chunk.index] = output_.position();
+      byteCounts_[chunk.index] = chunk.data.size();
+      output_.put(chunk.data.data(), chunk.data.size());
+    }
+
+    // Channels of the color model of a photometric interpretation, the
+    // following ones being extra samples
+    static int colorChannels(int photometric)
+    {
+      switch (photometric) {
+        case 2: // RGB
+        case 6: // YCbCr
+          return 3;
+        case 5: // separated, CMYK
+          return 4;
+        default:
+          return 1;
+      }
+    }
+
+    std::vector<TiffField> makeFields() const
+    {
+      auto offsetField = [&](Tag tag, const std::vector<uint64_t>& values) {
+        if (params_.isBigTiff) {
+          return TiffField::make(tag, Type::LONG8, values);
+        }
+        return TiffField::make(tag, Type::LONG, std::vector<uint32_t>(values.begin(), values.end()));
+      };
+
+      const int photometric = params_.photometric.value_or(channels_ >= 3 ? 2 : 1);
+      const int colors = colorChannels(photometric);
+      const auto u16 = [](int value) { return static_cast<uint16_t>(value); };
+      const auto u32 = [](int value) { return std::vector<uint32_t>{ uint32_t(value) }; };
+      const bool isTiled = params_.tileWidth > 0;
+
+      std::vector<TiffField> fields = {
+        TiffField::make(Tag::ImageWidth, Type::LONG, u32(width_)),
+        TiffField::make(Tag::ImageLength, Type::LONG, u32(height_)),
+        TiffField::make(Tag::BitsPerSample, Type::SHORT, std::vector<uint16_t>(channels_, u16(bitDepth_))),
+        TiffField::make(Tag::Compression, Type::SHORT, std::vector<uint16_t>{ u16(params_.compression) }),
+        TiffField::make(Tag::PhotometricInterpretation, Type::SHORT, std::vector<uint16_t>{ u16(photometric) }),
+        TiffField::make(Tag::SamplesPerPixel, Type::SHORT, std::vector<uint16_t>{ u16(channels_) }),
+        TiffField::make(Tag::PlanarConfiguration, Type::SHORT, std::vector<uint16_t>{ u16(params_.isPlanar ? 2 : 1) }),
+      };
+      if (isTiled) {
+        fields.push_back(TiffField::make(Tag::TileWidth, Type::LONG, u32(chunkWidth_)));
+        fields.push_back(TiffField::make(Tag::TileLength, Type::LONG, u32(chunkLength_)));
+        fields.push_back(offsetField(Tag::TileOffsets, offsets_));
+        fields.push_back(offsetField(Tag::TileByteCounts, byteCounts_));
+      } else {
+        fields.push_back(TiffField::make(Tag::RowsPerStrip, Type::LONG, u32(rowsPerStrip_)));
+        fields.push_back(offsetField(Tag::StripOffsets, offsets_));
+        fields.push_back(offsetField(Tag::StripByteCounts, byteCounts_));
+      }
+      if (params_.predictor != 1) {
+        fields.push_back(TiffField::make(Tag::Predictor, Type::SHORT, std::vector<uint16_t>{ u16(params_.predictor) }));
+      }
+      if (channels_ > colors) {
+        // the first extra channel of gray + alpha, RGBA or CMYKA images is alpha
+        std::vector<uint16_t> extraSamples(channels_ - colors, 0);
+        if (channels_ == colors + 1) {
+          extraSamples[0] = 2; // unassociated alpha
+        }
+        fields.push_back(TiffField::make(Tag::ExtraSamples, Type::SHORT, extraSamples));
+      }
+      if (params_.sampleFormat != 1) {
+        fields.push_back(TiffField::make(Tag::SampleFormat, Type::SHORT,
+          std::vector<uint16_t>(channels_, u16(params_.sampleFormat))));
+      }
+      std::sort(fields.begin(), fields.end(),
+        [](const TiffField& a, const TiffField& b) { return a.tag < b.tag; });
+      return fields;
+    }
+
+  };
+
+  // Passes the rows of `image` to `writer`, which may be a TiffWriter or any
+  // class with the same `writeRows()` function, in the planar or chunky
+  // layout, whatever the layout of `image`.
+  template <typename Writer>
+  void writeImageRows(Writer& writer, const Image& image, bool isPlanar)
+  {
+    const size_t sampleBytes = image.bitDepth / 8;
+    const int planes = isPlanar ? image.channels : 1;
+    const int rowChannels = isPlanar ? 1 : image.channels;
+    const bool isContiguous = (size_t(image.chanStride) == sampleBytes
+      || image.channels == 1 || isPlanar)
+      && size_t(image.colStride) == rowChannels * sampleBytes;
+
+    std::vector<std::byte> row(size_t(image.width) * rowChannels * sampleBytes);
+    for (int plane = 0; plane < planes; ++plane) {
+      for (int y = 0; y < image.height; ++y) {
+        const std::byte* src = image.data.data()
+          + size_t(plane) * image.chanStride + size_t(y) * image.rowStride;
+        if (isContiguous) {
+          writer.writeRows(std::span(src, row.size()));
+          continue;
+        }
+        std::byte* dst = row.data();
+        for (int x = 0; x < image.width; ++x) {
+          for (int c = 0; c < rowChannels; ++c) {
+            std::memcpy(dst, src + size_t(x) * image.colStride + size_t(c) * image.chanStride, sampleBytes);
+            dst += sampleBytes;
+          }
+        }
+        writer.writeRows(row);
+      }
+    }
+  }
+
+  // Writes `image` as a TIFF file. The samples are written in the layout
+  // selected by `params`, whatever the layout of `image`.
+  inline void save(std::ostream& stream, const Image& image, const WriteParams& params = {})
+  {
+    TiffWriter writer(stream, image.width, image.height, image.channels, image.bitDepth, params);
+    writeImageRows(writer, image, params.isPlanar);
+    writer.finish();
+  }
+
+  inline void save(const std::string& filename, const Image& image, const WriteParams& params = {})
+  {
+    std::ofstream file(filename, std::ios::binary);
+    if (!file) {
+      throw std::runtime_error("Failed to create TIFF file: " + filename);
+    }
+    save(file, image, params);
+  }
+
+} // namespace TiffCraft
@@ -0,0 +1,144 @@
+// BSD 2-Clause License
+// Copyright (c) 2025 Daniel Moreno
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS”
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+// ---------------------------------------------------------------------------
+//
+// TiffZstd.hpp
+// ============
+// This file contains the Zstandard codec used by TIFF images with
+// Compression=50000, available when TiffCraft is built with libzstd (see the
+// TIFFCRAFT_USE_ZSTD CMake option). Each strip or tile is a single Zstandard
+// frame.
+//
+
+#pragma once
+
+#ifdef TIFFCRAFT_USE_ZSTD
+
+#include <stdexcept>
+#include <cstdint>
+#include <string>
+#include <new>
+#include <vector>
+#include <span>
+
+#include <zstd.h>
+
+namespace TiffCraft {
+
+  class ZstdDecoder
+  {
+  public:
+    static constexpr const char* name = "zstd";
+
+    ZstdDecoder() : context_(ZSTD_createDCtx()) {
+      if (!context_) {
+        throw std::bad_alloc();
+      }
+    }
+
+    ~ZstdDecoder() { ZSTD_freeDCtx(context_); }
+
+    ZstdDecoder(const ZstdDecoder&) = delete;
+    ZstdDecoder& operator=(const ZstdDecoder&) = delete;
+
+    // Decodes `in` into `out` and returns the number of bytes written.
+    // Frames larger than `out` are decoded until the output is full.
+    size_t decode(std::span<const std::byte> in, std::span<std::byte> out)
+    {
+      // frames that fit in `out` are decoded in one call; the others, and
+      // frames without a content size, are decoded as a stream
+      const auto contentSize = ZSTD_getFrameContentSize(in.data(), in.size());
+      if (contentSize <= out.size()) {
+        const size_t size = ZSTD_decompressDCtx(context_,
+          out.data(), out.size(), in.data(), in.size());
+        if (ZSTD_isError(size)) {
+          throwCorrupted(size);
+        }
+        return size;
+      }
+      ZSTD_DCtx_reset(context_, ZSTD_reset_session_only);
+      ZSTD_inBuffer input{ in.data(), in.size(), 0 };
+      ZSTD_outBuffer output{ out.data(), out.size(), 0 };
+      while (output.pos < output.size) {
+        const size_t inPos = input.pos;
+        const size_t outPos = output.pos;
+        const size_t result = ZSTD_decompressStream(context_, &output, &input);
+        if (ZSTD_isError(result)) {
+          throwCorrupted(result);
+        }
+        if (result == 0 || (input.pos == inPos && output.pos == outPos)) {
+          break; // end of the frame, or truncated data
+        }
+      }
+      return output.pos;
+    }
+
+  private:
+    ZSTD_DCtx* context_;
+
+    [[noreturn]] static void throwCorrupted(size_t error) {
+      throw std::runtime_error(
+        std::string("Corrupted Zstandard data: ") + ZSTD_getErrorName(error));
+    }
+  };
+
+  class ZstdEncoder
+  {
+  public:
+    explicit ZstdEncoder(int level = ZSTD_CLEVEL_DEFAULT)
+      : context_(ZSTD_createCCtx()), level_(level)
+    {
+      if (!context_) {
+        throw std::bad_alloc();
+      }
+    }
+
+    ~ZstdEncoder() { ZSTD_freeCCtx(context_); }
+
+    ZstdEncoder(const ZstdEncoder&) = delete;
+    ZstdEncoder& operator=(const ZstdEncoder&) = delete;
+
+    // Encodes `in` as a single Zstandard frame.
+    std::vector<std::byte> encode(std::span<const std::byte> in)
+    {
+      std::vector<std::byte> out(ZSTD_compressBound(in.size()));
+      const size_t size = ZSTD_compressCCtx(context_,
+        out.data(), out.size(), in.data(), in.size(), level_);
+      if (ZSTD_isError(size)) {
+        throw std::runtime_error(
+          std::string("Zstandard compression failed: ") + ZSTD_getErrorName(size));
+      }
+      out.resize(size);
+      return out;
+    }
+
+  private:
+    ZSTD_CCtx* context_;
+    int level_;
+  };
+
+} // namespace TiffCraft
+
+#endif // TIFFCRAFT_USE_ZSTD
@@ -0,0 +1,161 @@
+// BSD 2-Clause License
+// Copyright (c) 2025 Daniel Moreno
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS”
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+// ---------------------------------------------------------------------------
+//
+// heapProfiler.hpp
+// ================
+// This file contains a heap profiler for the tests and benchmarks, built on
+// replacements of the global operator new and delete that count the calls,
+// the bytes allocated, and the peak of the bytes in use.
+//
+// The replacements are defined in the file that defines
+// HEAP_PROFILER_IMPLEMENTATION before including this header, which must be
+// only one file of the program.
+//
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace heapprofiler {
+
+  // Counters of the global operator new and delete
+  struct Counters {
+    std::atomic<uint64_t> allocations = 0;
+    std::atomic<uint64_t> bytes = 0;       // bytes allocated
+    std::atomic<int64_t> inUse = 0;        // bytes allocated and not freed
+    std::atomic<int64_t> peak = 0;         // highest value of `inUse`
+  };
+
+  inline Counters& counters() {
+    static Counters instance;
+    return instance;
+  }
+
+  // Allocations of a piece of code
+  struct Usage {
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;  // bytes allocated
+    uint64_t peak = 0;   // peak of the bytes in use, above those in use before
+  };
+
+  // Runs `f` and returns its allocations, including those of the threads it
+  // starts. Allocations of other threads running at the same time are
+  // counted too.
+  template <typename F>
+  Usage measure(F&& f) {
+    Counters& c = counters();
+    const uint64_t allocations = c.allocations;
+    const uint64_t bytes = c.bytes;
+    const int64_t inUse = c.inUse;
+    c.peak = inUse;
+    f();
+    const int64_t peak = c.peak;
+    return { c.allocations - allocations, c.bytes - bytes,
+      static_cast<uint64_t>(peak > inUse ? peak - inUse : 0) };
+  }
+
+  // Size stored before each block, keeping the alignment of operator new
+  constexpr size_t HeaderSize = __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+
+  // The block returned by malloc and the pointer returned by operator new
+  // are converted through their addresses, so that the compiler does not
+  // take the header read by operator delete, or the block it frees, for an
+  // access outside the object that operator new returned.
+  inline void* toPointer(unsigned char* block) noexcept {
+    return reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(block) + HeaderSize);
+  }
+
+  inline unsigned char* toBlock(void* ptr) noexcept {
+    return reinterpret_cast<unsigned char*>(reinterpret_cast<uintptr_t>(ptr) - HeaderSize);
+  }
+
+  // Allocates with malloc, storing the size in a header before the block
+  inline void* allocate(size_t size) noexcept {
+    auto* block = static_cast<unsigned char*>(std::malloc(size + HeaderSize));
+    if (!block) {
+      return nullptr;
+    }
+    std::memcpy(block, &size, sizeof(size));
+    Counters& c = counters();
+    ++c.allocations;
+    c.bytes += size;
+    const int64_t inUse = c.inUse += static_cast<int64_t>(size);
+    int64_t peak = c.peak;
+    while (inUse > peak && !c.peak.compare_exchange_weak(peak, inUse)) {
+    }
+    return toPointer(block);
+  }
+
+  // Frees with free a pointer returned by allocate, reading its header
+  inline void deallocate(void* ptr) noexcept {
+    if (!ptr) {
+      return;
+    }
+    unsigned char* block = toBlock(ptr);
+    size_t size;
+    std::memcpy(&size, block, sizeof(size));
+    counters().inUse -= static_cast<int64_t>(size);
+    std::free(block);
+  }
+
+} // namespace heapprofiler
+
+#ifdef HEAP_PROFILER_IMPLEMENTATION
+
+void* operator new(size_t size) {
+  if (void* ptr = heapprofiler::allocate(size)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+  if (void* ptr = heapprofiler::allocate(size)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  return heapprofiler::allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+  return heapprofiler::allocate(size);
+}
+
+void operator delete(void* ptr) noexcept { heapprofiler::deallocate(ptr); }
+void operator delete[](void* ptr) noexcept { heapprofiler::deallocate(ptr); }
+void operator delete(void* ptr, size_t) noexcept { heapprofiler::deallocate(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { heapprofiler::deallocate(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { heapprofiler::deallocate(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { heapprofiler::deallocate(ptr); }
+
+#endif // HEAP_PROFILER_IMPLEMENTATION
@@ -0,0 +1,164 @@
+// BSD 2-Clause License
+// Copyright (c) 2025 Daniel Moreno
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS”
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+// ---------------------------------------------------------------------------
+//
+// tiffBuilder.hpp
+// ===============
+// This file contains helpers to build small TIFF files in memory, so that the
+// unit tests can exercise layouts that are not available in the sample images.
+//
+
+#pragma once
+
+#include <tiffcraft/TiffImage.hpp>
+
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+namespace tiffbuilder {
+
+  using namespace TiffCraft;
+
+  // A single IFD field. Values are stored in host byte order.
+  struct Field {
+    Tag tag;
+    Type type;
+    uint32_t count;
+    std::vector<std::byte> values;
+  };
+
+  inline Field shorts(Tag tag, std::vector<uint16_t> values) {
+    std::vector<std::byte> bytes(values.size() * sizeof(uint16_t));
+    std::memcpy(bytes.data(), values.data(), bytes.size());
+    return { tag, Type::SHORT, static_cast<uint32_t>(values.size()), bytes };
+  }
+
+  inline Field longs(Tag tag, std::vector<uint32_t> values) {
+    std::vector<std::byte> bytes(values.size() * sizeof(uint32_t));
+    std::memcpy(bytes.data(), values.data(), bytes.size());
+    return { tag, Type::LONG, static_cast<uint32_t>(values.size()), bytes };
+  }
+
+  inline Field undefined(Tag tag, std::vector<std::byte> values) {
+    const auto count = static_cast<uint32_t>(values.size());
+    return { tag, Type::UNDEFINED, count, std::move(values) };
+  }
+
+  // Converts an array of samples to the file byte order.
+  template <typename T>
+  std::vector<std::byte> toBytes(const std::vector<T>& samples, bool bigEndian = false) {
+    std::vector<std::byte> bytes(samples.size() * sizeof(T));
+    std::memcpy(bytes.data(), samples.data(), bytes.size());
+    if (bigEndian != (std::endian::native == std::endian::big)) {
+      swapArray(reinterpret_cast<T*>(bytes.data()), samples.size());
+    }
+    return bytes;
+  }
+
+  // Builds a TIFF file with a single IFD. The `rects` are the strips (or the
+  // tiles, if `tiled` is true) already encoded as they should appear in the
+  // file. Offsets and byte counts entries are added automatically.
+  inline std::string makeTiff(
+    std::vector<Field> fields,
+    const std::vector<std::vector<std::byte>>& rects,
+    bool tiled = false,
+    bool bigEndian = false)
+  {
+    const bool mustSwap = bigEndian != (std::endian::native == std::endian::big);
+    auto align = [](uint32_t n) { return n + (n & 1); };
+
+    // layout: header, rectangles, out-of-line values, IFD
+    std::vector<uint32_t> offsets, byteCounts;
+    uint32_t pos = 8;
+    for (const auto& rect : rects) {
+      offsets.push_back(pos);
+      byteCounts.push_back(static_cast<uint32_t>(rect.size()));
+      pos = align(pos + static_cast<uint32_t>(rect.size()));
+    }
+    fields.push_back(longs(tiled ? Tag::TileOffsets : Tag::StripOffsets, offsets));
+    fields.push_back(longs(tiled ? Tag::TileByteCounts : Tag::StripByteCounts, byteCounts));
+    std::sort(fields.begin(), fields.end(),
+      [](const Field& a, const Field& b) { return a.tag < b.tag; });
+
+    std::vector<uint32_t> valueOffsets;
+    for (const auto& field : fields) {
+      if (field.values.size() > 4) {
+        valueOffsets.push_back(pos);
+        pos = align(pos + static_cast<uint32_t>(field.values.size()));
+      } else {
+        valueOffsets.push_back(0);
+      }
+    }
+    const uint32_t ifdOffset = pos;
+
+    std::ostringstream os(std::ios::binary);
+    writeValue<uint16_t>(os, bigEndian ? 0x4D4D : 0x4949);
+    writeValue<uint16_t>(os, 42, mustSwap);
+    writeValue<uint32_t>(os, ifdOffset, mustSwap);
+    for (size_t i = 0; i < rects.size(); ++i) {
+      writeAt(os, offsets[i], rects[i].data(), rects[i].size());
+    }
+
+    auto swapped = [&](const Field& field) {
+      auto values = field.values;
+      if (mustSwap) {
+        swapArray(values.data(), field.type, field.count);
+      }
+      return values;
+    };
+
+    for (size_t i = 0; i < fields.size(); ++i) {
+      if (valueOffsets[i] > 0) {
+        const auto values = swapped(fields[i]);
+        writeAt(os, valueOffsets[i], values.data(), values.size());
+      }
+    }
+
+    os.seekp(0, std::ios_base::end);
+    while (static_cast<uint32_t>(os.tellp()) < ifdOffset) {
+      os.put(0);
+    }
+    writeValue<uint16_t>(os, static_cast<uint16_t>(fields.size()), mustSwap);
+    for (size_t i = 0; i < fields.size(); ++i) {
+      const auto& field = fields[i];
+      writeValue(os, field.tag, mustSwap);
+      writeValue(os, field.type, mustSwap);
+      writeValue(os, field.count, mustSwap);
+      if (valueOffsets[i] > 0) {
+        writeValue(os, valueOffsets[i], mustSwap);
+      } else {
+        auto values = swapped(field);
+        values.resize(4);
+        os.write(reinterpret_cast<const char*>(values.data()), 4);
+      }
+    }
+    writeValue<uint32_t>(os, 0); // no more IFDs
+    return os.str();
+  }
+
+} // namespace tiffbuilder
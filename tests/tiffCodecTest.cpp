@@ -0,0 +1,1154 @@
+// BSD 2-Clause License
+// Copyright (c) 2025 Daniel Moreno
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS”
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+// ---------------------------------------------------------------------------
+//
+// tiffCodecTest.cpp
+// =================
+// Unit tests for <TiffCodec.hpp> and the compression codecs.
+//
+
+#include <tiffcraft/TiffExporter.hpp>
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#define DOCTEST_CONFIG_DOUBLE_STRINGIFY
+#include "doctest.h"
+
+#include <functional>
+#include <atomic>
+#include <sstream>
+#include <random>
+#include <string>
+#include <vector>
+#include <map>
+#include <cstring>
+#include <algorithm>
+
+#include "tiffBuilder.hpp"
+
+using namespace TiffCraft;
+
+std::vector<std::byte> makeBytes(std::initializer_list<int> values) {
+  std::vector<std::byte> bytes;
+  for (int v : values) { bytes.push_back(static_cast<std::byte>(v)); }
+  return bytes;
+}
+
+// Test data with long runs, repeated patterns, and noise
+std::vector<std::byte> makeTestData(size_t size, unsigned seed = 1) {
+  std::mt19937 rng(seed);
+  std::vector<std::byte> data(size);
+  for (size_t i = 0; i < size; ++i) {
+    const size_t block = (i / 997) % 3;
+    if (block == 0) {
+      data[i] = static_cast<std::byte>(i / 64);       // runs
+    } else if (block == 1) {
+      data[i] = static_cast<std::byte>((i * 7) % 23); // patterns
+    } else {
+      data[i] = static_cast<std::byte>(rng());        // noise
+    }
+  }
+  return data;
+}
+
+// Encodes old-style LZW data: LSB-first codes that widen one code later
+std::vector<std::byte> encodeOldStyleLzw(const std::vector<std::byte>& in) {
+  std::vector<std::byte> out;
+  uint64_t bitBuffer = 0;
+  uint32_t bitCount = 0;
+  uint32_t codeBits = 9;
+  auto putCode = [&](uint32_t code) {
+    bitBuffer |= uint64_t(code) << bitCount;
+    bitCount += codeBits;
+    while (bitCount >= 8) {
+      out.push_back(static_cast<std::byte>(bitBuffer & 0xFF));
+      bitBuffer >>= 8;
+      bitCount -= 8;
+    }
+  };
+  std::map<std::pair<uint32_t, std::byte>, uint32_t> table; // (prefix, byte)
+  uint32_t nextCode = 258;
+  putCode(256);
+  uint32_t prefix = std::to_integer<uint32_t>(in.at(0));
+  for (size_t i = 1; i < in.size(); ++i) {
+    auto it = table.find({ prefix, in[i] });
+    if (it != table.end()) {
+      prefix = it->second;
+      continue;
+    }
+    putCode(prefix);
+    table[{ prefix, in[i] }] = nextCode++;
+    if (nextCode == 4094) {
+      putCode(256);
+      table.clear();
+      nextCode = 258;
+      codeBits = 9;
+    } else if (nextCode > (1u << codeBits)) {
+      ++codeBits;
+    }
+    prefix = std::to_integer<uint32_t>(in[i]);
+  }
+  putCode(prefix);
+  putCode(257);
+  if (bitCount > 0) {
+    out.push_back(static_cast<std::byte>(bitBuffer & 0xFF));
+  }
+  return out;
+}
+
+TEST_CASE("LzwDecoder") {
+
+  { // strip written by libtiff: 8x4 pixels, 8 bits
+    const auto encoded = makeBytes({
+      0x80, 0x00, 0x00, 0x60, 0x60, 0x48, 0x30, 0x1e, 0x12, 0x0c, 0x01, 0x41,
+      0x00, 0xb0, 0x70, 0x44, 0x28, 0x17, 0x0e, 0x02, 0x81, 0xa1, 0x00, 0x98,
+      0x58, 0x32, 0x1c, 0x10, 0x41, 0xc2, 0xa1, 0x80, 0xd8, 0x78, 0x42, 0x27,
+      0x80, 0x80 });
+    const auto expected = makeBytes({
+      0,  3,  6,  9, 12, 15, 18, 24,  5,  8, 11, 14, 17, 20, 23, 28,
+      10, 13, 16, 19, 22, 25, 28, 32, 15, 18, 21, 24, 27, 30, 33, 39 });
+    std::vector<std::byte> decoded(expected.size());
+    LzwDecoder decoder;
+    CHECK(decoder.decode(encoded, decoded) == expected.size());
+    CHECK(decoded == expected);
+
+    // output shorter than the data stops decoding early
+    std::vector<std::byte> partial(10);
+    CHECK(decoder.decode(encoded, partial) == partial.size());
+    CHECK(std::equal(partial.begin(), partial.end(), expected.begin()));
+  }
+
+  { // round trip, including table resets after 4094 codes
+    for (size_t size : { size_t(0), size_t(1), size_t(2), size_t(1000), size_t(300000) }) {
+      INFO("Size: " << size);
+      const auto data = makeTestData(size);
+      const auto encoded = LzwEncoder().encode(data);
+      std::vector<std::byte> decoded(size);
+      CHECK(LzwDecoder().decode(encoded, decoded) == size);
+      CHECK(decoded == data);
+    }
+  }
+
+  { // old-style data
+    const auto data = makeTestData(20000, 2);
+    const auto encoded = encodeOldStyleLzw(data);
+    std::vector<std::byte> decoded(data.size());
+    CHECK(LzwDecoder().decode(encoded, decoded) == data.size());
+    CHECK(decoded == data);
+  }
+
+  { // corrupted data
+    const auto encoded = makeBytes({ 0x80, 0x7F, 0xF0, 0x00 }); // code 511 first
+    std::vector<std::byte> decoded(16);
+    CHECK_THROWS_AS(LzwDecoder().decode(encoded, decoded), std::runtime_error);
+  }
+}
+
+TEST_CASE("TiffExporter with LZW compression") {
+  using namespace tiffbuilder;
+
+  constexpr int width = 37;
+  constexpr int height = 23;
+  constexpr int rowsPerStrip = 6;
+
+  for (int bits : { 1, 8, 16 }) {
+    INFO("Bits per sample: " << bits);
+    const int stride = (width * bits + 7) / 8;
+    const auto data = makeTestData(stride * height, bits);
+
+    std::vector<std::vector<std::byte>> strips;
+    for (int y = 0; y < height; y += rowsPerStrip) {
+      const int rows = std::min(rowsPerStrip, height - y);
+      strips.push_back(LzwEncoder().encode(
+        std::span(data).subspan(y * stride, rows * stride)));
+    }
+    std::stringstream stream(makeTiff({
+      shorts(Tag::ImageWidth, { width }),
+      shorts(Tag::ImageLength, { height }),
+      shorts(Tag::BitsPerSample, { static_cast<uint16_t>(bits) }),
+      shorts(Tag::Compression, { 5 }),
+      shorts(Tag::PhotometricInterpretation, { 1 }),
+      shorts(Tag::RowsPerStrip, { rowsPerStrip }),
+    }, strips));
+
+    TiffExporterAny exporter;
+    load(stream, std::ref(exporter));
+    const auto& image = exporter.image();
+    REQUIRE(image.width == width);
+    REQUIRE(image.height == height);
+
+    // compare against the same data stored uncompressed
+    std::stringstream rawStream(makeTiff({
+      shorts(Tag::ImageWidth, { width }),
+      shorts(Tag::ImageLength, { height }),
+      shorts(Tag::BitsPerSample, { static_cast<uint16_t>(bits) }),
+      shorts(Tag::PhotometricInterpretation, { 1 }),
+    }, { data }));
+    TiffExporterAny rawExporter;
+    load(rawStream, std::ref(rawExporter));
+    CHECK(image.data == rawExporter.image().data);
+  }
+}
+
+TEST_CASE("Inflater") {
+
+  { // fixed Huffman codes, written by zlib
+    const auto encoded = makeBytes({
+      0x78, 0xda, 0x0b, 0xc9, 0x4c, 0x4b, 0x73, 0x2e, 0x4a, 0x4c, 0x2b, 0x51,
+      0x08, 0xc1, 0x64, 0x29, 0x02, 0x00, 0xa9, 0x84, 0x0a, 0xcd });
+    const std::string text = "TiffCraft TiffCraft TiffCraft!";
+    std::vector<std::byte> decoded(text.size());
+    CHECK(Inflater().decode(encoded, decoded) == text.size());
+    CHECK(std::memcmp(decoded.data(), text.data(), text.size()) == 0);
+  }
+
+  { // dynamic Huffman codes, written by zlib
+    const auto encoded = makeBytes({
+      0x78, 0xda, 0x95, 0x94, 0xc9, 0x11, 0x02, 0x31, 0x0c, 0x04, 0xff, 0x44,
+      0xa1, 0x10, 0x2c, 0x59, 0xbe, 0xc8, 0x86, 0x63, 0xb9, 0xc1, 0xb0, 0xb0,
+      0x5c, 0xd1, 0x53, 0x45, 0x06, 0xfd, 0xb6, 0x6c, 0x59, 0xd3, 0x9a, 0x09,
+      0x73, 0x79, 0xec, 0x06, 0xb9, 0x4d, 0xfb, 0xd5, 0x51, 0x96, 0x63, 0x7f,
+      0x5d, 0x64, 0xd3, 0xdf, 0x72, 0x98, 0xce, 0xd7, 0xbb, 0xf4, 0xe7, 0x30,
+      0xfe, 0x8f, 0x4f, 0x8b, 0xef, 0x47, 0xd6, 0x7d, 0x3b, 0x53, 0x56, 0xee,
+      0xac, 0xbc, 0xc1, 0xcf, 0x64, 0x56, 0x6f, 0x89, 0xd5, 0x47, 0xf8, 0xbe,
+      0xc3, 0xff, 0x67, 0x28, 0x4f, 0x85, 0xea, 0x6b, 0x08, 0xf0, 0x82, 0xd1,
+      0x0e, 0xee, 0x14, 0x19, 0x65, 0xdc, 0x28, 0x64, 0x4a, 0xd9, 0x12, 0xed,
+      0x50, 0xe1, 0x0c, 0xd1, 0x9c, 0x2e, 0x1e, 0xf5, 0x19, 0x25, 0xed, 0x4e,
+      0x3b, 0x54, 0x38, 0x43, 0x32, 0xa8, 0x52, 0x2a, 0x90, 0x43, 0xa6, 0xa4,
+      0x33, 0xed, 0x50, 0xe8, 0x0c, 0x85, 0xaa, 0x54, 0x29, 0x87, 0x46, 0x49,
+      0xb7, 0x8c, 0x53, 0x83, 0xae, 0xab, 0x06, 0xea, 0x08, 0x55, 0x6a, 0x3a,
+      0xc5, 0xbe, 0x56, 0xa3, 0xd1, 0xa1, 0x11, 0xa7, 0x93, 0xe3, 0x00, 0x4c,
+      0x34, 0x63, 0x7f, 0x53, 0xa4, 0xa5, 0xcb });
+    std::string text;
+    for (int i = 0; i < 40; ++i) {
+      text += std::to_string(i * i) + ": the quick brown fox jumps over the lazy dog\n";
+    }
+    std::vector<std::byte> decoded(text.size());
+    Inflater inflater;
+    CHECK(inflater.decode(encoded, decoded) == text.size());
+    CHECK(std::memcmp(decoded.data(), text.data(), text.size()) == 0);
+
+    // output shorter than the data stops decoding early
+    std::vector<std::byte> partial(100);
+    CHECK(inflater.decode(encoded, partial) == partial.size());
+    CHECK(std::memcmp(partial.data(), text.data(), partial.size()) == 0);
+  }
+
+  { // round trip, including stored blocks for the noise
+    for (int level : { 1, 6, 9 }) {
+      for (size_t size : { size_t(0), size_t(1), size_t(2), size_t(1000), size_t(300000) }) {
+        INFO("Level: " << level << ", size: " << size);
+        const auto data = makeTestData(size, level);
+        const auto encoded = Deflater(level).encode(data);
+        CHECK(deflate::adler32(data) == std::to_integer<uint32_t>(encoded[encoded.size() - 1])
+          + (std::to_integer<uint32_t>(encoded[encoded.size() - 2]) << 8)
+          + (std::to_integer<uint32_t>(encoded[encoded.size() - 3]) << 16)
+          + (std::to_integer<uint32_t>(encoded[encoded.size() - 4]) << 24));
+        std::vector<std::byte> decoded(size);
+        CHECK(Inflater().decode(encoded, decoded) == size);
+        CHECK(decoded == data);
+        CHECK(DeflateDecoder().decode(encoded, decoded) == size);
+        CHECK(decoded == data);
+      }
+    }
+    // incompressible data only
+    std::vector<std::byte> noise(100000);
+    std::mt19937 rng(3);
+    std::generate(noise.begin(), noise.end(), [&]() { return static_cast<std::byte>(rng()); });
+    const auto encoded = Deflater().encode(noise);
+    CHECK(encoded.size() < noise.size() + 64);
+    std::vector<std::byte> decoded(noise.size());
+    CHECK(Inflater().decode(encoded, decoded) == noise.size());
+    CHECK(decoded == noise);
+  }
+
+  { // corrupted data
+    std::vector<std::byte> decoded(16);
+    CHECK_THROWS_AS(Inflater().decode(makeBytes({ 0x78, 0x9c, 0xff }), decoded), std::runtime_error);
+    CHECK_THROWS_AS(Inflater().decode(makeBytes({ 0x78, 0x00, 0x01 }), decoded), std::runtime_error);
+    CHECK_THROWS_AS(Inflater().decode(makeBytes({ 0x78 }), decoded), std::runtime_error);
+    auto truncated = Deflater().encode(makeTestData(1000));
+    truncated.resize(truncated.size() / 2);
+    decoded.resize(1000);
+    CHECK_THROWS_AS(Inflater().decode(truncated, decoded), std::runtime_error);
+  }
+}
+
+TEST_CASE("TiffExporter with Deflate compression") {
+  using namespace tiffbuilder;
+
+  constexpr int width = 37;
+  constexpr int height = 23;
+  constexpr int rowsPerStrip = 6;
+
+  const auto data = makeTestData(size_t(width) * height * 3 * 2, 7);
+
+  // compare against the same data stored uncompressed
+  std::stringstream rawStream(makeTiff({
+    shorts(Tag::ImageWidth, { width }),
+    shorts(Tag::ImageLength, { height }),
+    shorts(Tag::BitsPerSample, { 16, 16, 16 }),
+    shorts(Tag::PhotometricInterpretation, { 2 }),
+    shorts(Tag::SamplesPerPixel, { 3 }),
+  }, { data }));
+  TiffExporterAny rawExporter;
+  load(rawStream, std::ref(rawExporter));
+
+  for (int compression : { 8, 32946 }) {
+    for (int threads : { 1, 4 }) {
+      INFO("Compression: " << compression << ", threads: " << threads);
+      const int stride = width * 3 * 2;
+      std::vector<std::vector<std::byte>> strips;
+      for (int y = 0; y < height; y += rowsPerStrip) {
+        const int rows = std::min(rowsPerStrip, height - y);
+        strips.push_back(Deflater().encode(
+          std::span(data).subspan(y * stride, rows * stride)));
+      }
+      std::stringstream stream(makeTiff({
+        shorts(Tag::ImageWidth, { width }),
+        shorts(Tag::ImageLength, { height }),
+        shorts(Tag::BitsPerSample, { 16, 16, 16 }),
+        shorts(Tag::Compression, { static_cast<uint16_t>(compression) }),
+        shorts(Tag::PhotometricInterpretation, { 2 }),
+        shorts(Tag::SamplesPerPixel, { 3 }),
+        shorts(Tag::RowsPerStrip, { rowsPerStrip }),
+      }, strips));
+
+      decodeThreads() = threads;
+      TiffExporterAny exporter;
+      load(stream, std::ref(exporter));
+      decodeThreads() = 0;
+      CHECK(exporter.image().data == rawExporter.image().data);
+    }
+  }
+
+  { // corrupted strips are reported from any thread
+    std::vector<std::vector<std::byte>> strips(4, makeBytes({ 0x78, 0x9c, 0xff }));
+    std::stringstream stream(makeTiff({
+      shorts(Tag::ImageWidth, { width }),
+      shorts(Tag::ImageLength, { height }),
+      shorts(Tag::BitsPerSample, { 8 }),
+      shorts(Tag::Compression, { 8 }),
+      shorts(Tag::PhotometricInterpretation, { 1 }),
+      shorts(Tag::RowsPerStrip, { rowsPerStrip }),
+    }, strips));
+    decodeThreads() = 4;
+    TiffExporterAny exporter;
+    CHECK_THROWS_AS(load(stream, std::ref(exporter)), std::runtime_error);
+    decodeThreads() = 0;
+  }
+}
+
+TEST_CASE("PackBitsDecoder") {
+
+  // example from the TIFF 6.0 specification
+  const auto encoded = makeBytes({
+    0xFE, 0xAA, 0x02, 0x80, 0x00, 0x2A, 0xFD, 0xAA, 0x03, 0x80, 0x00, 0x2A,
+    0x22, 0xF7, 0xAA });
+  const auto expected = makeBytes({
+    0xAA, 0xAA, 0xAA, 0x80, 0x00, 0x2A, 0xAA, 0xAA, 0xAA, 0xAA, 0x80, 0x00,
+    0x2A, 0x22, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA });
+
+  { // whole buffer
+    std::vector<std::byte> decoded(expected.size());
+    CHECK(PackBitsDecoder().decode(encoded, decoded) == expected.size());
+    CHECK(decoded == expected);
+  }
+
+  { // pieces of any size, with runs crossing from one piece to the next
+    for (size_t pieceSize : { 1, 2, 5, 7 }) {
+      INFO("Piece size: " << pieceSize);
+      PackBitsDecoder decoder(encoded);
+      std::vector<std::byte> decoded;
+      std::vector<std::byte> piece(pieceSize);
+      while (size_t n = decoder.decode(piece)) {
+        decoded.insert(decoded.end(), piece.begin(), piece.begin() + n);
+      }
+      CHECK(decoded == expected);
+    }
+  }
+
+  { // round trip
+    for (size_t rowBytes : { 0, 1, 13, 1000 }) {
+      INFO("Row bytes: " << rowBytes);
+      const auto data = makeTestData(30000, 4);
+      const auto packed = PackBitsEncoder().encode(data, rowBytes);
+      std::vector<std::byte> decoded(data.size());
+      CHECK(PackBitsDecoder().decode(packed, decoded) == data.size());
+      CHECK(decoded == data);
+    }
+  }
+
+  { // truncated data
+    std::vector<std::byte> decoded(expected.size());
+    const std::span<const std::byte> literal(encoded.data(), 5);
+    CHECK(PackBitsDecoder().decode(literal, decoded) == 5);
+    const std::span<const std::byte> repeat(encoded.data(), 7);
+    CHECK(PackBitsDecoder().decode(repeat, decoded) == 6);
+  }
+}
+
+TEST_CASE("TiffExporter with PackBits compression") {
+  using namespace tiffbuilder;
+
+  constexpr int width = 37;
+  constexpr int height = 23;
+
+  for (int bits : { 1, 4, 8 }) {
+    for (bool tiled : { false, true }) {
+      INFO("Bits per sample: " << bits << ", tiled: " << tiled);
+      const int rectWidth = tiled ? 16 : width;
+      const int rectHeight = tiled ? 16 : 6;
+      const int stride = (rectWidth * bits + 7) / 8;
+      const int imageStride = (width * bits + 7) / 8;
+
+      // scanned documents have long runs of white and black pixels
+      std::vector<std::byte> data(size_t(imageStride) * height);
+      for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = (i % 11 < 7) ? std::byte{ 0xFF } : static_cast<std::byte>(i);
+      }
+
+      // split the image into rectangles, padding partial ones
+      std::vector<std::vector<std::byte>> rects;
+      for (int y = 0; y < height; y += rectHeight) {
+        for (int x = 0; x < width; x += rectWidth) {
+          std::vector<std::byte> rect(size_t(stride) * rectHeight);
+          const int rows = tiled ? rectHeight : std::min(rectHeight, height - y);
+          rect.resize(size_t(stride) * rows);
+          for (int row = 0; row < rows && y + row < height; ++row) {
+            const int bytes = std::min(stride, imageStride - x * bits / 8);
+            std::memcpy(rect.data() + row * stride,
+              data.data() + (y + row) * imageStride + x * bits / 8, bytes);
+          }
+          rects.push_back(PackBitsEncoder().encode(rect, stride));
+        }
+      }
+      std::vector<Field> fields = {
+        shorts(Tag::ImageWidth, { width }),
+        shorts(Tag::ImageLength, { height }),
+        shorts(Tag::BitsPerSample, { static_cast<uint16_t>(bits) }),
+        shorts(Tag::Compression, { 32773 }),
+        shorts(Tag::PhotometricInterpretation, { 1 }),
+      };
+      if (tiled) {
+        fields.push_back(shorts(Tag::TileWidth, { static_cast<uint16_t>(rectWidth) }));
+        fields.push_back(shorts(Tag::TileLength, { static_cast<uint16_t>(rectHeight) }));
+      } else {
+        fields.push_back(shorts(Tag::RowsPerStrip, { static_cast<uint16_t>(rectHeight) }));
+      }
+      std::stringstream stream(makeTiff(fields, rects, tiled));
+      TiffExporterAny exporter;
+      load(stream, std::ref(exporter));
+
+      // compare against the same data stored uncompressed
+      std::stringstream rawStream(makeTiff({
+        shorts(Tag::ImageWidth, { width }),
+        shorts(Tag::ImageLength, { height }),
+        shorts(Tag::BitsPerSample, { static_cast<uint16_t>(bits) }),
+        shorts(Tag::PhotometricInterpretation, { 1 }),
+      }, { data }));
+      TiffExporterAny rawExporter;
+      load(rawStream, std::ref(rawExporter));
+      CHECK(exporter.image().data == rawExporter.image().data);
+    }
+  }
+}
+
+// Bilevel test page: runs of random lengths, with rows often repeated as in
+// scanned documents. Rows are packed, 1 for black.
+std::vector<std::byte> makeBilevelPage(int width, int height, unsigned seed) {
+  std::mt19937 rng(seed);
+  const size_t stride = (size_t(width) + 7) / 8;
+  std::vector<std::byte> page(stride * height);
+  for (int y = 0; y < height; ++y) {
+    std::byte* row = page.data() + y * stride;
+    if (y > 0 && rng() % 2) {
+      std::memcpy(row, row - stride, stride);
+      continue;
+    }
+    bool isBlack = rng() % 2;
+    for (int x = 0; x < width; isBlack = !isBlack) {
+      const int run = (rng() % 4 == 0) ? rng() % 3000 : rng() % 20;
+      for (int i = x; i < std::min(width, x + run); ++i) {
+        row[i / 8] |= isBlack ? std::byte(0x80 >> (i % 8)) : std::byte{ 0 };
+      }
+      x += run;
+    }
+  }
+  return page;
+}
+
+TEST_CASE("FaxDecoder") {
+
+  { // two rows of 8 pixels, Group 4
+    const auto encoded = makeBytes({ 0x2E, 0xFC, 0x00, 0x40, 0x04 });
+    const auto rows = makeBytes({ 0x3C, 0x3C });
+    CHECK(FaxEncoder(4, 8).encode(rows) == encoded);
+    std::vector<std::byte> decoded(2);
+    CHECK(FaxDecoder(encoded, 4, 8).decode(decoded) == 2);
+    CHECK(decoded == rows);
+  }
+
+  { // round trip of all the coding schemes
+    struct Scheme { int compression; uint32_t options; };
+    for (const auto& scheme : {
+      Scheme{ 2, 0 }, Scheme{ 3, 0 }, Scheme{ 3, FaxDecoder::TwoDimensional },
+      Scheme{ 3, FaxDecoder::FillBits }, Scheme{ 3, FaxDecoder::TwoDimensional | FaxDecoder::FillBits },
+      Scheme{ 4, 0 } }) {
+      for (int width : { 1, 7, 64, 1728, 2561, 6000 }) {
+        INFO("Compression: " << scheme.compression << ", options: " << scheme.options
+          << ", width: " << width);
+        const auto page = makeBilevelPage(width, 20, width);
+        const auto encoded = FaxEncoder(scheme.compression, width, scheme.options).encode(page);
+        std::vector<std::byte> decoded(page.size());
+        FaxDecoder decoder(encoded, scheme.compression, width, scheme.options);
+        CHECK(decoder.decode(decoded) == page.size());
+        CHECK(decoded == page);
+      }
+    }
+  }
+
+  { // runs written as values
+    const std::vector<int> changes = { 0, 3, 5 };
+    std::vector<uint8_t> row(8);
+    FaxDecoder::expandRow<uint8_t>(changes, 8, row.data(), 1, 255, 0);
+    CHECK(row == std::vector<uint8_t>{ 0, 0, 0, 255, 255, 0, 0, 0 });
+    FaxDecoder::expandRow<uint8_t>(changes, 4, row.data(), 2, 1, 2);
+    CHECK(row == std::vector<uint8_t>{ 2, 0, 2, 255, 2, 0, 1, 0 });
+  }
+
+  { // corrupted and truncated data
+    std::vector<std::byte> decoded(16);
+    CHECK_THROWS_AS(FaxDecoder(makeBytes({ 0x00, 0x00 }), 4, 8).decode(decoded), std::runtime_error);
+    const auto encoded = FaxEncoder(4, 64).encode(makeBilevelPage(64, 2, 1));
+    const auto truncated = std::vector<std::byte>(encoded.begin(), encoded.begin() + 2);
+    CHECK_THROWS_AS(FaxDecoder(truncated, 4, 64).decode(decoded), std::runtime_error);
+    CHECK_THROWS_AS(FaxDecoder(encoded, 3, 64, FaxDecoder::Uncompressed), std::runtime_error);
+  }
+}
+
+TEST_CASE("TiffExporter with CCITT compression") {
+  using namespace tiffbuilder;
+
+  constexpr int width = 301;
+  constexpr int height = 45;
+  const auto page = makeBilevelPage(width, height, 7);
+  const size_t imageStride = (width + 7) / 8;
+
+  // the same page stored uncompressed
+  std::stringstream rawStream(makeTiff({
+    shorts(Tag::ImageWidth, { width }),
+    shorts(Tag::ImageLength, { height }),
+    shorts(Tag::BitsPerSample, { 1 }),
+    shorts(Tag::PhotometricInterpretation, { 0 }),
+  }, { page }));
+  TiffExporterGray<uint8_t> rawExporter;
+  load(rawStream, std::ref(rawExporter));
+
+  struct Config { int compression; uint32_t options; int fillOrder; bool tiled; };
+  for (const auto& c : {
+    Config{ 2, 0, 1, false }, Config{ 3, 0, 2, false },
+    Config{ 3, FaxDecoder::TwoDimensional | FaxDecoder::FillBits, 1, false },
+    Config{ 4, 0, 1, false }, Config{ 4, 0, 2, true } }) {
+    INFO("Compression: " << c.compression << ", options: " << c.options
+      << ", fill order: " << c.fillOrder << ", tiled: " << c.tiled);
+    const int rectWidth = c.tiled ? 128 : width;
+    const int rectHeight = c.tiled ? 16 : 10;
+    const size_t stride = (rectWidth + 7) / 8;
+
+    // split the page into rectangles, padding partial tiles with white
+    std::vector<std::vector<std::byte>> rects;
+    for (int y = 0; y < height; y += rectHeight) {
+      for (int x = 0; x < width; x += rectWidth) {
+        const int rows = c.tiled ? rectHeight : std::min(rectHeight, height - y);
+        std::vector<std::byte> rect(stride * rows);
+        for (int row = 0; row < rows && y + row < height; ++row) {
+          const size_t bytes = std::min(stride, imageStride - x / 8);
+          std::memcpy(rect.data() + row * stride, page.data() + (y + row) * imageStride + x / 8, bytes);
+        }
+        for (int row = 0; row < rows; ++row) { // clear the padding bits
+          for (int col = std::max(0, width - x); col < rectWidth; ++col) {
+            rect[row * stride + col / 8] &= ~std::byte(0x80 >> (col % 8));
+          }
+        }
+        auto encoded = FaxEncoder(c.compression, rectWidth, c.options).encode(rect);
+        if (c.fillOrder == 2) {
+          for (auto& byte : encoded) {
+            uint8_t reversed = 0;
+            for (int bit = 0; bit < 8; ++bit) {
+              reversed |= ((std::to_integer<uint8_t>(byte) >> bit) & 1) << (7 - bit);
+            }
+            byte = std::byte{ reversed };
+          }
+        }
+        rects.push_back(encoded);
+      }
+    }
+
+    std::vector<Field> fields = {
+      shorts(Tag::ImageWidth, { width }),
+      shorts(Tag::ImageLength, { height }),
+      shorts(Tag::BitsPerSample, { 1 }),
+      shorts(Tag::Compression, { static_cast<uint16_t>(c.compression) }),
+      shorts(Tag::PhotometricInterpretation, { 0 }),
+      shorts(Tag::FillOrder, { static_cast<uint16_t>(c.fillOrder) }),
+    };
+    if (c.options != 0) {
+      fields.push_back(longs(c.compression == 3 ? Tag::T4Options : Tag::T6Options, { c.options }));
+    }
+    if (c.tiled) {
+      fields.push_back(shorts(Tag::TileWidth, { static_cast<uint16_t>(rectWidth) }));
+      fields.push_back(shorts(Tag::TileLength, { static_cast<uint16_t>(rectHeight) }));
+    } else {
+      fields.push_back(shorts(Tag::RowsPerStrip, { static_cast<uint16_t>(rectHeight) }));
+    }
+    const auto tiff = makeTiff(fields, rects, c.tiled);
+
+    // expanded to 8 bits straight from the runs
+    std::stringstream stream(tiff);
+    TiffExporterGray<uint8_t> exporter;
+    load(stream, std::ref(exporter));
+    CHECK(exporter.image().data == rawExporter.image().data);
+
+    // packed rows through the generic copy
+    std::stringstream stream16(tiff);
+    TiffExporterGray<uint16_t, uint16_t> exporter16;
+    load(stream16, std::ref(exporter16));
+    const auto* pixels16 = exporter16.image().dataPtr<uint16_t>();
+    const auto* pixels8 = rawExporter.image().dataPtr<uint8_t>();
+    bool isSame = true;
+    for (size_t i = 0; i < size_t(width) * height; ++i) {
+      isSame = isSame && ((pixels16[i] != 0) == (pixels8[i] != 0));
+    }
+    CHECK(isSame);
+  }
+
+  { // FillOrder=2 is only supported with CCITT compression
+    std::stringstream stream(makeTiff({
+      shorts(Tag::ImageWidth, { width }),
+      shorts(Tag::ImageLength, { height }),
+      shorts(Tag::BitsPerSample, { 1 }),
+      shorts(Tag::PhotometricInterpretation, { 0 }),
+      shorts(Tag::FillOrder, { 2 }),
+    }, { page }));
+    TiffExporterGray<uint8_t> exporter;
+    CHECK_THROWS_AS(load(stream, std::ref(exporter)), FormatNotSupportedError);
+  }
+}
+
+template <typename T>
+void checkHorizontalPredictor(size_t channels) {
+  std::mt19937 rng(static_cast<unsigned>(channels * sizeof(T)));
+  for (size_t count : { size_t(0), channels, size_t(7) * channels, size_t(101) * channels,
+         size_t(1001) * channels }) {
+    INFO("Bytes: " << sizeof(T) << ", channels: " << channels << ", count: " << count);
+    std::vector<T> row(count);
+    for (auto& sample : row) { sample = static_cast<T>(rng()); }
+    // reference: plain running sums
+    std::vector<T> expected = row;
+    for (size_t i = channels; i < count; ++i) {
+      expected[i] = static_cast<T>(expected[i] + expected[i - channels]);
+    }
+    auto decoded = row;
+    undoHorizontalPredictor(decoded.data(), count, channels);
+    CHECK(decoded == expected);
+    applyHorizontalPredictor(decoded.data(), count, channels);
+    CHECK(decoded == row);
+  }
+}
+
+TEST_CASE("Predictor") {
+
+  { // horizontal differencing, including the vectorized cases: 3 channels of
+    // 8 and 16 bits are the 12-byte kernels of RGB rows
+    for (size_t channels = 1; channels <= 6; ++channels) {
+      checkHorizontalPredictor<uint8_t>(channels);
+      checkHorizontalPredictor<uint16_t>(channels);
+      checkHorizontalPredictor<uint32_t>(channels);
+      checkHorizontalPredictor<uint64_t>(channels);
+    }
+  }
+
+  { // floating point predictor: MSB bytes first, then the next ones
+    const std::vector<float> samples = { 1.0f, -2.5f, 3.25f };
+    std::vector<std::byte> row(samples.size() * sizeof(float));
+    std::memcpy(row.data(), samples.data(), row.size());
+    std::vector<std::byte> scratch;
+    applyFloatingPointPredictor(row.data(), samples.size(), 1, sizeof(float), scratch);
+    // 1.0f = 3F800000, -2.5f = C0200000, 3.25f = 40500000
+    CHECK(row == makeBytes({
+      0x3F, 0x81, 0x80, 0x40, 0xA0, 0x30, 0xB0, 0x00, 0x00, 0x00, 0x00, 0x00 }));
+    undoFloatingPointPredictor(row.data(), samples.size(), 1, sizeof(float), scratch);
+    CHECK(std::memcmp(row.data(), samples.data(), row.size()) == 0);
+  }
+
+  { // floating point predictor of 2, 3, 4, and 8-byte samples of RGB rows
+    std::mt19937 rng(3);
+    for (size_t bytes : { 2, 3, 4, 8 }) {
+      INFO("Bytes: " << bytes);
+      std::vector<std::byte> samples(101 * 3 * bytes);
+      for (auto& value : samples) { value = static_cast<std::byte>(rng()); }
+      auto row = samples;
+      std::vector<std::byte> scratch;
+      applyFloatingPointPredictor(row.data(), 101 * 3, 3, bytes, scratch);
+      undoFloatingPointPredictor(row.data(), 101 * 3, 3, bytes, scratch);
+      CHECK(row == samples);
+    }
+  }
+
+  { // unsupported combinations
+    std::vector<std::byte> data(16);
+    CHECK_THROWS_AS(undoPredictor(2, data, 4, 1, 16, 1, 12, true), std::runtime_error);
+    CHECK_THROWS_AS(undoPredictor(4, data, 4, 1, 16, 1, 32, true), std::runtime_error);
+  }
+}
+
+TEST_CASE("TiffExporter with predictor") {
+  using namespace tiffbuilder;
+
+  constexpr int width = 37;
+  constexpr int height = 23;
+  constexpr int rowsPerStrip = 6;
+
+  struct Config { int predictor; int bits; int channels; bool planar; bool bigEndian; };
+  for (const auto& c : {
+    Config{ 2, 8, 1, false, false }, Config{ 2, 8, 3, false, false },
+    Config{ 2, 16, 1, false, true }, Config{ 2, 16, 3, false, false },
+    Config{ 2, 16, 3, true, true }, Config{ 2, 32, 1, false, false },
+    Config{ 3, 32, 1, false, false }, Config{ 3, 32, 1, false, true },
+    Config{ 3, 16, 3, false, false } }) {
+    INFO("Predictor: " << c.predictor << ", bits: " << c.bits << ", channels: "
+      << c.channels << ", planar: " << c.planar << ", big endian: " << c.bigEndian);
+
+    // samples in host byte order, one plane after the other when planar
+    const int bytes = c.bits / 8;
+    const auto data = makeTestData(size_t(width) * height * c.channels * bytes, c.bits);
+    const int rectChannels = c.planar ? 1 : c.channels;
+    const int stride = width * rectChannels * bytes;
+
+    std::vector<std::vector<std::byte>> strips, rawStrips;
+    std::vector<std::byte> scratch;
+    for (int plane = 0; plane < (c.planar ? c.channels : 1); ++plane) {
+      for (int y = 0; y < height; y += rowsPerStrip) {
+        const int rows = std::min(rowsPerStrip, height - y);
+        const size_t offset = (size_t(plane) * height + y) * stride;
+        std::vector<std::byte> strip(data.begin() + offset, data.begin() + offset + rows * stride);
+        auto swapToFile = [&](std::vector<std::byte>& samples) {
+          if (c.bigEndian != (std::endian::native == std::endian::big)) {
+            for (size_t i = 0; i < samples.size(); i += bytes) {
+              std::reverse(samples.begin() + i, samples.begin() + i + bytes);
+            }
+          }
+        };
+        auto raw = strip;
+        swapToFile(raw);
+        rawStrips.push_back(raw);
+        for (int row = 0; row < rows; ++row) {
+          std::byte* samples = strip.data() + size_t(row) * stride;
+          const size_t count = size_t(width) * rectChannels;
+          if (c.predictor == 3) {
+            applyFloatingPointPredictor(samples, count, rectChannels, bytes, scratch);
+          } else if (c.bits == 8) {
+            applyHorizontalPredictor(reinterpret_cast<uint8_t*>(samples), count, rectChannels);
+          } else if (c.bits == 16) {
+            applyHorizontalPredictor(reinterpret_cast<uint16_t*>(samples), count, rectChannels);
+          } else {
+            applyHorizontalPredictor(reinterpret_cast<uint32_t*>(samples), count, rectChannels);
+          }
+        }
+        if (c.predictor == 2) {
+          swapToFile(strip);
+        }
+        strips.push_back(LzwEncoder().encode(strip));
+      }
+    }
+
+    auto makeFields = [&](int compression, int predictor) {
+      std::vector<Field> fields = {
+        shorts(Tag::ImageWidth, { width }),
+        shorts(Tag::ImageLength, { height }),
+        shorts(Tag::BitsPerSample, std::vector<uint16_t>(c.channels, static_cast<uint16_t>(c.bits))),
+        shorts(Tag::Compression, { static_cast<uint16_t>(compression) }),
+        shorts(Tag::PhotometricInterpretation, { static_cast<uint16_t>(c.channels == 3 ? 2 : 1) }),
+        shorts(Tag::SamplesPerPixel, { static_cast<uint16_t>(c.channels) }),
+        shorts(Tag::RowsPerStrip, { rowsPerStrip }),
+        shorts(Tag::PlanarConfiguration, { static_cast<uint16_t>(c.planar ? 2 : 1) }),
+      };
+      if (predictor != 1) {
+        fields.push_back(shorts(Tag::Predictor, { static_cast<uint16_t>(predictor) }));
+      }
+      return fields;
+    };
+
+    std::stringstream stream(makeTiff(makeFields(5, c.predictor), strips, false, c.bigEndian));
+    TiffExporterAny exporter;
+    load(stream, std::ref(exporter));
+
+    // compare against the same data stored uncompressed
+    std::stringstream rawStream(makeTiff(makeFields(1, 1), rawStrips, false, c.bigEndian));
+    TiffExporterAny rawExporter;
+    load(rawStream, std::ref(rawExporter));
+    CHECK(exporter.image().data == rawExporter.image().data);
+  }
+}
+
+// In-house codec for the tests: bytes XORed with a key
+struct XorDecoder {
+  static inline std::atomic<int> instances = 0;
+  XorDecoder() { ++instances; }
+  size_t decode(std::span<const std::byte> in, std::span<std::byte> out) {
+    const size_t size = std::min(in.size(), out.size());
+    for (size_t i = 0; i < size; ++i) {
+      out[i] = in[i] ^ std::byte{ 0x5A };
+    }
+    return size;
+  }
+};
+
+TEST_CASE("CodecRegistry") {
+  using namespace tiffbuilder;
+
+  constexpr int width = 37;
+  constexpr int height = 23;
+  constexpr int rowsPerStrip = 6;
+  constexpr int compression = 65000;
+
+  auto& registry = codecRegistry();
+  CHECK(registry.contains(5));
+  CHECK(registry.contains(8));
+  CHECK(registry.usesPredictor(8));
+  CHECK_FALSE(registry.usesPredictor(32773));
+  CHECK_FALSE(registry.contains(compression));
+
+  const auto data = makeTestData(size_t(width) * height, 3);
+  std::vector<std::vector<std::byte>> strips;
+  for (int y = 0; y < height; y += rowsPerStrip) {
+    const int rows = std::min(rowsPerStrip, height - y);
+    std::vector<std::byte> strip(data.begin() + y * width, data.begin() + (y + rows) * width);
+    for (auto& byte : strip) {
+      byte ^= std::byte{ 0x5A };
+    }
+    strips.push_back(strip);
+  }
+  auto makeXorTiff = [&](int scheme) {
+    return makeTiff({
+      shorts(Tag::ImageWidth, { width }),
+      shorts(Tag::ImageLength, { height }),
+      shorts(Tag::BitsPerSample, { 8 }),
+      shorts(Tag::Compression, { static_cast<uint16_t>(scheme) }),
+      shorts(Tag::PhotometricInterpretation, { 1 }),
+      shorts(Tag::RowsPerStrip, { rowsPerStrip }),
+    }, strips);
+  };
+  const auto tiff = makeXorTiff(compression);
+
+  { // not registered
+    std::stringstream stream(tiff);
+    TiffExporterAny exporter;
+    CHECK_THROWS_AS(load(stream, std::ref(exporter)), FormatNotSupportedError);
+  }
+
+  registry.add<XorDecoder>(compression);
+  CHECK(registry.contains(compression));
+  decodeThreads() = 1;
+  for (int i = 0; i < 3; ++i) { // one instance for all strips and files
+    std::stringstream stream(tiff);
+    TiffExporterAny exporter;
+    load(stream, std::ref(exporter));
+    CHECK(exporter.image().data == data);
+  }
+  CHECK(XorDecoder::instances == 1);
+
+  // replacing the codec discards the instances of the old one
+  registry.add<XorDecoder>(compression);
+  std::stringstream stream(tiff);
+  TiffExporterAny exporter;
+  load(stream, std::ref(exporter));
+  CHECK(exporter.image().data == data);
+  CHECK(XorDecoder::instances == 2);
+
+  // the decoding threads, and so their instances, are kept between loads
+  constexpr int threads = 4;
+  decodeThreads() = threads;
+  for (int i = 0; i < 10; ++i) {
+    std::stringstream stream(tiff);
+    TiffExporterAny exporter;
+    load(stream, std::ref(exporter));
+    CHECK(exporter.image().data == data);
+  }
+  CHECK(XorDecoder::instances <= 2 + threads);
+  decodeThreads() = 0;
+
+  registry.remove(compression);
+  CHECK_FALSE(registry.contains(compression));
+  CHECK_FALSE(isCompressionSupported(compression));
+
+  // codecs registered for the built-in values replace the built-in codecs
+  for (int builtIn : { 3, 32773 }) {
+    CAPTURE(builtIn);
+    CHECK(isCompressionSupported(builtIn));
+    registry.add<XorDecoder>(builtIn, false);
+    std::stringstream stream(makeXorTiff(builtIn));
+    TiffExporterAny exporter;
+    load(stream, std::ref(exporter));
+    CHECK(exporter.image().data == data);
+  }
+  registry.add<FaxCodec>(3, false);
+  registry.add<PackBitsCodec>(32773, false);
+}
+
+#ifdef TIFFCRAFT_USE_LIBJPEG
+
+// Encodes 8-bit pixels as a JPEG stream. When `tables` is given, it receives
+// the tables (as stored in the JPEGTables tag) and the stream omits them.
+std::vector<std::byte> encodeJpeg(const std::vector<uint8_t>& pixels, int width,
+  int height, int channels, bool isYCbCr, std::vector<std::byte>* tables = nullptr)
+{
+  jpeg_compress_struct cinfo;
+  jpeg_error_mgr error;
+  cinfo.err = jpeg_std_error(&error);
+  jpeg_create_compress(&cinfo);
+  cinfo.image_width = width;
+  cinfo.image_height = height;
+  cinfo.input_components = channels;
+  cinfo.in_color_space = (channels == 1) ? JCS_GRAYSCALE : JCS_RGB;
+  jpeg_set_defaults(&cinfo);
+  jpeg_set_quality(&cinfo, 90, TRUE);
+  if (channels == 3 && !isYCbCr) {
+    jpeg_set_colorspace(&cinfo, JCS_RGB);
+  }
+
+  unsigned char* buffer = nullptr;
+  unsigned long size = 0;
+  auto takeBuffer = [&]() {
+    std::vector<std::byte> bytes(size);
+    std::memcpy(bytes.data(), buffer, size);
+    std::free(buffer);
+    buffer = nullptr;
+    size = 0;
+    return bytes;
+  };
+  if (tables) {
+    jpeg_mem_dest(&cinfo, &buffer, &size);
+    jpeg_write_tables(&cinfo);
+    *tables = takeBuffer();
+  }
+  jpeg_mem_dest(&cinfo, &buffer, &size);
+  jpeg_start_compress(&cinfo, tables == nullptr);
+  while (cinfo.next_scanline < cinfo.image_height) {
+    JSAMPROW row = const_cast<uint8_t*>(pixels.data())
+      + size_t(cinfo.next_scanline) * width * channels;
+    jpeg_write_scanlines(&cinfo, &row, 1);
+  }
+  jpeg_finish_compress(&cinfo);
+  jpeg_destroy_compress(&cinfo);
+  return takeBuffer();
+}
+
+TEST_CASE("TiffExporter with JPEG compression") {
+  using namespace tiffbuilder;
+
+  constexpr int width = 70;
+  constexpr int height = 45;
+
+  struct Config { int channels; int photometric; bool tiled; bool hasTables; };
+  for (const auto& c : {
+    Config{ 1, 1, true, false }, Config{ 1, 1, false, true },
+    Config{ 3, 6, true, true }, Config{ 3, 6, false, false },
+    Config{ 3, 2, true, true } }) {
+    INFO("Channels: " << c.channels << ", photometric: " << c.photometric
+      << ", tiled: " << c.tiled << ", tables: " << c.hasTables);
+    const int rectWidth = c.tiled ? 32 : width;
+    const int rectHeight = 16;
+
+    // smooth image, so that the JPEG error is small
+    std::vector<uint8_t> image(size_t(width) * height * c.channels);
+    for (int y = 0; y < height; ++y) {
+      for (int x = 0; x < width; ++x) {
+        for (int ch = 0; ch < c.channels; ++ch) {
+          image[(size_t(y) * width + x) * c.channels + ch] = static_cast<uint8_t>(x + 2 * y + 30 * ch);
+        }
+      }
+    }
+
+    // encodes every rectangle twice: with and without its own tables
+    std::vector<std::vector<std::byte>> rects, abbreviatedRects;
+    std::vector<std::byte> tables;
+    for (int y = 0; y < height; y += rectHeight) {
+      for (int x = 0; x < width; x += rectWidth) {
+        const int rows = c.tiled ? rectHeight : std::min(rectHeight, height - y);
+        std::vector<uint8_t> rect(size_t(rectWidth) * rows * c.channels);
+        for (int row = 0; row < rows; ++row) {
+          for (int col = 0; col < rectWidth; ++col) {
+            // partial tiles repeat the last column and row
+            const int srcX = std::min(x + col, width - 1);
+            const int srcY = std::min(y + row, height - 1);
+            std::memcpy(&rect[(size_t(row) * rectWidth + col) * c.channels],
+              &image[(size_t(srcY) * width + srcX) * c.channels], c.channels);
+          }
+        }
+        const bool isYCbCr = (c.photometric == 6);
+        rects.push_back(encodeJpeg(rect, rectWidth, rows, c.channels, isYCbCr));
+        abbreviatedRects.push_back(encodeJpeg(rect, rectWidth, rows, c.channels, isYCbCr, &tables));
+      }
+    }
+
+    auto loadImage = [&](const std::vector<std::vector<std::byte>>& rects, bool hasTables) {
+      std::vector<Field> fields = {
+        shorts(Tag::ImageWidth, { width }),
+        shorts(Tag::ImageLength, { height }),
+        shorts(Tag::BitsPerSample, std::vector<uint16_t>(c.channels, 8)),
+        shorts(Tag::Compression, { 7 }),
+        shorts(Tag::PhotometricInterpretation, { static_cast<uint16_t>(c.photometric) }),
+        shorts(Tag::SamplesPerPixel, { static_cast<uint16_t>(c.channels) }),
+      };
+      if (c.tiled) {
+        fields.push_back(shorts(Tag::TileWidth, { static_cast<uint16_t>(rectWidth) }));
+        fields.push_back(shorts(Tag::TileLength, { static_cast<uint16_t>(rectHeight) }));
+      } else {
+        fields.push_back(shorts(Tag::RowsPerStrip, { static_cast<uint16_t>(rectHeight) }));
+      }
+      if (hasTables) {
+        fields.push_back(undefined(Tag::JPEGTables, tables));
+      }
+      std::stringstream stream(makeTiff(fields, rects, c.tiled));
+      TiffExporterAny exporter;
+      load(stream, std::ref(exporter));
+      return exporter.image();
+    };
+
+    const auto decoded = loadImage(rects, c.hasTables);
+    REQUIRE(decoded.width == width);
+    REQUIRE(decoded.height == height);
+    REQUIRE(decoded.data.size() == image.size());
+    CHECK(loadImage(abbreviatedRects, true).data == decoded.data);
+
+    // lossy compression: small differences only
+    int maxError = 0;
+    for (size_t i = 0; i < image.size(); ++i) {
+      maxError = std::max(maxError, std::abs(int(image[i]) - std::to_integer<int>(decoded.data[i])));
+    }
+    CHECK(maxError <= 8);
+  }
+
+  SUBCASE("Without tables for abbreviated data") {
+    std::vector<uint8_t> pixels(16 * 16, 128);
+    std::vector<std::byte> tables;
+    std::stringstream stream(makeTiff({
+      shorts(Tag::ImageWidth, { 16 }),
+      shorts(Tag::ImageLength, { 16 }),
+      shorts(Tag::BitsPerSample, { 8 }),
+      shorts(Tag::Compression, { 7 }),
+      shorts(Tag::PhotometricInterpretation, { 1 }),
+    }, { encodeJpeg(pixels, 16, 16, 1, false, &tables) }));
+    TiffExporterAny exporter;
+    CHECK_THROWS_AS(load(stream, std::ref(exporter)), std::runtime_error);
+  }
+}
+
+#endif // TIFFCRAFT_USE_LIBJPEG
+
+#ifdef TIFFCRAFT_USE_ZSTD
+
+TEST_CASE("ZstdDecoder") {
+  const auto data = makeTestData(100000);
+  const auto encoded = ZstdEncoder().encode(data);
+  CHECK(encoded.size() < data.size());
+
+  ZstdDecoder decoder;
+  std::vector<std::byte> out(data.size() + 10);
+  REQUIRE(decoder.decode(encoded, out) == data.size());
+  CHECK(std::equal(data.begin(), data.end(), out.begin()));
+
+  // the output buffer is smaller than the frame
+  std::vector<std::byte> partial(1000);
+  REQUIRE(decoder.decode(encoded, partial) == partial.size());
+  CHECK(std::equal(partial.begin(), partial.end(), data.begin()));
+
+  // the context is reused after a partial decode
+  std::fill(out.begin(), out.end(), std::byte{ 0 });
+  REQUIRE(decoder.decode(encoded, out) == data.size());
+  CHECK(std::equal(data.begin(), data.end(), out.begin()));
+
+  auto corrupted = encoded;
+  corrupted[0] = std::byte{ 0 };
+  CHECK_THROWS_AS(decoder.decode(corrupted, out), std::runtime_error);
+}
+
+TEST_CASE("TiffExporter with Zstandard compression") {
+  using namespace tiffbuilder;
+
+  constexpr int width = 70;
+  constexpr int height = 45;
+  constexpr int tileSize = 32;
+
+  // 16-bit samples, compressed with and without horizontal differencing
+  const auto data = makeTestData(size_t(width) * height * 2, 5);
+  std::stringstream rawStream(makeTiff({
+    shorts(Tag::ImageWidth, { width }),
+    shorts(Tag::ImageLength, { height }),
+    shorts(Tag::BitsPerSample, { 16 }),
+    shorts(Tag::PhotometricInterpretation, { 1 }),
+  }, { data }));
+  TiffExporterAny rawExporter;
+  load(rawStream, std::ref(rawExporter));
+
+  for (int predictor : { 1, 2 }) {
+    for (int threads : { 1, 4 }) {
+      INFO("Predictor: " << predictor << ", threads: " << threads);
+      std::vector<std::vector<std::byte>> tiles;
+      for (int y = 0; y < height; y += tileSize) {
+        for (int x = 0; x < width; x += tileSize) {
+          std::vector<uint16_t> tile(tileSize * tileSize);
+          for (int row = 0; row < tileSize && y + row < height; ++row) {
+            const int cols = std::min(tileSize, width - x);
+            std::memcpy(&tile[row * tileSize], &data[((y + row) * width + x) * 2], cols * 2);
+            if (predictor == 2) {
+              applyHorizontalPredictor(&tile[row * tileSize], tileSize, 1);
+            }
+          }
+          tiles.push_back(ZstdEncoder().encode(std::as_bytes(std::span(tile))));
+        }
+      }
+      std::stringstream stream(makeTiff({
+        shorts(Tag::ImageWidth, { width }),
+        shorts(Tag::ImageLength, { height }),
+        shorts(Tag::BitsPerSample, { 16 }),
+        shorts(Tag::Compression, { 50000 }),
+        shorts(Tag::PhotometricInterpretation, { 1 }),
+        shorts(Tag::TileWidth, { tileSize }),
+        shorts(Tag::TileLength, { tileSize }),
+        shorts(Tag::Predictor, { static_cast<uint16_t>(predictor) }),
+      }, tiles, true));
+
+      decodeThreads() = threads;
+      TiffExporterAny exporter;
+      load(stream, std::ref(exporter));
+      decodeThreads() = 0;
+      CHECK(exporter.image().data == rawExporter.image().data);
+    }
+  }
+}
+
+#endif // TIFFCRAFT_USE_ZSTD
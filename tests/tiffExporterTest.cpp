@@ -30,6 +30,7 @@
 //
 
 #include <tiffcraft/TiffExporter.hpp>
+#include <tiffcraft/TiffCog.hpp>
 
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #define DOCTEST_CONFIG_DOUBLE_STRINGIFY
@@ -38,8 +39,11 @@
 #include <string>
 #include <filesystem>
 #include <iostream>
+#include <sstream>
+#include <random>
 
 #include "netpbm.hpp"
+#include "tiffBuilder.hpp"
 
 using namespace TiffCraft;
 
@@ -494,3 +498,483 @@ TEST_CASE("TiffExporterAnyTest") {
     TestExporter<TiffExporterAny>(testFiles);
   }
 }
+
+TEST_CASE("TiffExporterVerbatimTest") {
+  using namespace tiffbuilder;
+
+  constexpr int width = 20;
+  constexpr int height = 12;
+
+  auto makeSamples = []<typename T>(int channels) {
+    std::vector<T> samples(width * height * channels);
+    for (size_t i = 0; i < samples.size(); ++i) {
+      samples[i] = static_cast<T>(i * 2654435761u);
+    }
+    return samples;
+  };
+
+  auto splitStrips = [](const std::vector<std::byte>& bytes, size_t stripBytes) {
+    std::vector<std::vector<std::byte>> strips;
+    for (size_t i = 0; i < bytes.size(); i += stripBytes) {
+      const size_t n = std::min(stripBytes, bytes.size() - i);
+      strips.emplace_back(bytes.begin() + i, bytes.begin() + i + n);
+    }
+    return strips;
+  };
+
+  auto grayFields = [](int bits, int rowsPerStrip) {
+    return std::vector<Field>{
+      shorts(Tag::ImageWidth, { width }),
+      shorts(Tag::ImageLength, { height }),
+      shorts(Tag::BitsPerSample, { static_cast<uint16_t>(bits) }),
+      shorts(Tag::PhotometricInterpretation, { 1 }),
+      shorts(Tag::RowsPerStrip, { static_cast<uint16_t>(rowsPerStrip) }),
+    };
+  };
+
+  { // 16 bits, single strip: the strip buffer is adopted without a copy
+    const auto samples = makeSamples.template operator()<uint16_t>(1);
+    std::stringstream stream(makeTiff(grayFields(16, height), { toBytes(samples) }));
+    auto image = TiffImage::read(stream);
+    auto imageData = TiffImage::readImageStrips(stream, image.ifds()[0]);
+    const std::byte* stripPtr = imageData[0].data();
+
+    TiffExporterGray<uint16_t> exporter;
+    exporter(image.header(), image.ifds()[0], std::move(imageData));
+    const auto& result = exporter.image();
+    CHECK(result.dataPtr() == stripPtr);
+    REQUIRE(result.dataSize<uint16_t>() == samples.size());
+    CHECK(std::equal(samples.begin(), samples.end(), result.dataPtr<uint16_t>()));
+  }
+
+  { // 16 bits, several strips and both byte orders
+    const auto samples = makeSamples.template operator()<uint16_t>(1);
+    for (bool bigEndian : { false, true }) {
+      INFO("Big endian: " << bigEndian);
+      const auto strips = splitStrips(toBytes(samples, bigEndian), 5 * width * 2);
+      std::stringstream stream(makeTiff(grayFields(16, 5), strips, false, bigEndian));
+      TiffExporterGray<uint16_t> exporter;
+      load(stream, std::ref(exporter));
+      const auto& result = exporter.image();
+      REQUIRE(result.dataSize<uint16_t>() == samples.size());
+      CHECK(std::equal(samples.begin(), samples.end(), result.dataPtr<uint16_t>()));
+    }
+  }
+
+  { // 8 bits RGB, contiguous, several strips
+    const auto samples = makeSamples.template operator()<uint8_t>(3);
+    const auto strips = splitStrips(toBytes(samples), 4 * width * 3);
+    std::stringstream stream(makeTiff({
+      shorts(Tag::ImageWidth, { width }),
+      shorts(Tag::ImageLength, { height }),
+      shorts(Tag::BitsPerSample, { 8, 8, 8 }),
+      shorts(Tag::PhotometricInterpretation, { 2 }),
+      shorts(Tag::SamplesPerPixel, { 3 }),
+      shorts(Tag::RowsPerStrip, { 4 }),
+    }, strips));
+    TiffExporterRgb<uint8_t> exporter;
+    load(stream, std::ref(exporter));
+    const auto& result = exporter.image();
+    REQUIRE(result.dataSize() == samples.size());
+    CHECK(std::equal(samples.begin(), samples.end(), result.dataPtr<uint8_t>()));
+  }
+
+  { // 8 bits, tiled with partial tiles on the right and bottom edges
+    const auto samples = makeSamples.template operator()<uint8_t>(1);
+    constexpr int tileSize = 16;
+    std::vector<std::vector<std::byte>> tiles;
+    for (int ty = 0; ty < height; ty += tileSize) {
+      for (int tx = 0; tx < width; tx += tileSize) {
+        std::vector<std::byte> tile(tileSize * tileSize);
+        for (int y = ty; y < std::min(ty + tileSize, height); ++y) {
+          for (int x = tx; x < std::min(tx + tileSize, width); ++x) {
+            tile[(y - ty) * tileSize + (x - tx)] = std::byte{ samples[y * width + x] };
+          }
+        }
+        tiles.push_back(std::move(tile));
+      }
+    }
+    std::stringstream stream(makeTiff({
+      shorts(Tag::ImageWidth, { width }),
+      shorts(Tag::ImageLength, { height }),
+      shorts(Tag::BitsPerSample, { 8 }),
+      shorts(Tag::PhotometricInterpretation, { 1 }),
+      shorts(Tag::TileWidth, { tileSize }),
+      shorts(Tag::TileLength, { tileSize }),
+    }, tiles, true));
+    TiffExporterGray<uint8_t> exporter;
+    load(stream, std::ref(exporter));
+    const auto& result = exporter.image();
+    REQUIRE(result.dataSize() == samples.size());
+    CHECK(std::equal(samples.begin(), samples.end(), result.dataPtr<uint8_t>()));
+  }
+}
+
+// Stream buffer that counts the bytes read from it
+class CountingBuf : public std::stringbuf {
+public:
+  using std::stringbuf::stringbuf;
+  size_t bytesRead = 0;
+protected:
+  std::streamsize xsgetn(char* s, std::streamsize n) override {
+    const auto count = std::stringbuf::xsgetn(s, n);
+    bytesRead += static_cast<size_t>(count);
+    return count;
+  }
+};
+
+// Copies a region of an image
+Image cropImage(const Image& image, const LoadRegion& region) {
+  Image result = image;
+  result.width = region.width;
+  result.height = region.height;
+  result.rowStride = region.width * image.colStride;
+  const bool isPlanar = image.colStride < image.channels * image.chanStride;
+  const int planes = isPlanar ? image.channels : 1;
+  if (isPlanar) {
+    result.chanStride = result.rowStride * region.height;
+  }
+  result.data.clear();
+  for (int plane = 0; plane < planes; ++plane) {
+    for (int y = region.y; y < region.y + region.height; ++y) {
+      const auto* row = image.data.data() + (isPlanar ? size_t(plane) * image.chanStride : 0)
+        + size_t(y) * image.rowStride + size_t(region.x) * image.colStride;
+      result.data.insert(result.data.end(), row, row + result.rowStride);
+    }
+  }
+  return result;
+}
+
+Image makeRandomImage(int width, int height, bool isRgb, bool isPlanar, unsigned seed) {
+  std::mt19937 rng(seed);
+  Image image = isRgb ? Image::make<uint8_t, 3>(width, height, isPlanar)
+    : Image::make<uint16_t, 1>(width, height);
+  for (auto& value : image.data) {
+    value = static_cast<std::byte>(rng());
+  }
+  return image;
+}
+
+TEST_CASE("TiffExporter reduced-resolution loading") {
+  const Image gray = makeRandomImage(300, 200, false, false, 11);
+  WriteParams params;
+  params.tileWidth = 64;
+  params.tileLength = 64;
+  params.compression = 8;
+  std::stringstream cog;
+  saveCog(cog, gray, params); // 300x200, 150x100, 75x50, and 38x25
+
+  auto loadCog = [&](const LoadParams& loadParams) {
+    cog.clear();
+    cog.seekg(0);
+    TiffExporterAny exporter;
+    load(cog, std::ref(exporter), loadParams);
+    return exporter.takeImage();
+  };
+  const Image level2 = loadCog(LoadParams{ .ifdIndex = 2 });
+
+  SUBCASE("Smallest level of the target size") {
+    const Image thumbnail = loadCog(LoadParams{ .targetWidth = 70 });
+    CHECK(thumbnail.width == 75);
+    CHECK(thumbnail.height == 50);
+    CHECK(thumbnail.data == level2.data);
+    CHECK(loadCog(LoadParams{ .scale = 0.5 }).width == 150);
+    CHECK(loadCog(LoadParams{ .targetWidth = 20, .targetHeight = 26 }).height == 50);
+    CHECK(loadCog(LoadParams{ .targetWidth = 1000 }).width == 300);
+  }
+
+  SUBCASE("Only the strip and tile locations of the loaded level are read") {
+    // 4096 tiles at full resolution, whose offsets and byte counts take 32 KiB
+    WriteParams smallTiles = params;
+    smallTiles.tileWidth = 16;
+    smallTiles.tileLength = 16;
+    std::stringstream large;
+    saveCog(large, Image::make<uint16_t>(1024, 1024), smallTiles);
+    LoadStats stats;
+    TiffExporterAny exporter;
+    load(large, std::ref(exporter), LoadParams{ .targetWidth = 16, .stats = &stats });
+    CHECK(exporter.image().width == 16);
+    CHECK(stats.bytesRead < 8192);
+  }
+
+  SUBCASE("Region of the full resolution image") {
+    const LoadRegion region{ 100, 50, 120, 61 };
+    const Image image = loadCog(LoadParams{ .region = region });
+    CHECK(image.width == region.width);
+    CHECK(image.height == region.height);
+    CHECK(image.data == cropImage(gray, region).data);
+  }
+
+  SUBCASE("Region of an overview") {
+    const Image image = loadCog(LoadParams{ .scale = 0.25,
+      .region = LoadRegion{ 100, 50, 120, 60 } });
+    CHECK(image.width == 30);
+    CHECK(image.height == 16); // rows 12.5 to 27.5, rounded outwards
+    CHECK(image.data == cropImage(level2, LoadRegion{ 25, 12, 30, 16 }).data);
+  }
+
+  SUBCASE("Only the tiles of the region are read") {
+    CountingBuf whole(cog.str());
+    std::istream wholeStream(&whole);
+    TiffExporterAny wholeExporter;
+    load(wholeStream, std::ref(wholeExporter));
+    CountingBuf part(cog.str());
+    std::istream partStream(&part);
+    TiffExporterAny partExporter;
+    load(partStream, std::ref(partExporter), LoadParams{ .region = LoadRegion{ 0, 0, 10, 10 } });
+    CHECK(part.bytesRead * 8 < whole.bytesRead);
+  }
+
+  SUBCASE("Regions of strips") {
+    for (bool isPlanar : { false, true }) {
+      INFO("Planar: " << isPlanar);
+      const Image rgb = makeRandomImage(45, 37, true, isPlanar, 12);
+      WriteParams stripParams;
+      stripParams.isPlanar = isPlanar;
+      stripParams.rowsPerStrip = 7;
+      stripParams.compression = 5;
+      std::stringstream stream;
+      save(stream, rgb, stripParams);
+      const LoadRegion region{ 3, 9, 40, 20 };
+      TiffExporterRgb<uint8_t> exporter;
+      load(stream, std::ref(exporter), LoadParams{ .region = region });
+      CHECK(exporter.image().width == region.width);
+      CHECK(exporter.image().data == cropImage(rgb, region).data);
+    }
+  }
+
+  SUBCASE("Overviews in SubIFDs") {
+    const Image main = makeRandomImage(40, 30, false, false, 13);
+    const Image half = makeRandomImage(20, 15, false, false, 14);
+    auto fields = [](const Image& image, uint32_t offset, bool isOverview) {
+      std::vector<TiffField> result;
+      if (isOverview) {
+        result.push_back(TiffField::make(Tag::NewSubfileType, Type::LONG, std::vector<uint32_t>{ 1 }));
+      }
+      const auto width = static_cast<uint32_t>(image.width);
+      const auto height = static_cast<uint32_t>(image.height);
+      result.push_back(TiffField::make(Tag::ImageWidth, Type::LONG, std::vector<uint32_t>{ width }));
+      result.push_back(TiffField::make(Tag::ImageLength, Type::LONG, std::vector<uint32_t>{ height }));
+      result.push_back(TiffField::make(Tag::BitsPerSample, Type::SHORT, std::vector<uint16_t>{ 16 }));
+      result.push_back(TiffField::make(Tag::PhotometricInterpretation, Type::SHORT, std::vector<uint16_t>{ 1 }));
+      result.push_back(TiffField::make(Tag::StripOffsets, Type::LONG, std::vector<uint32_t>{ offset }));
+      result.push_back(TiffField::make(Tag::RowsPerStrip, Type::LONG, std::vector<uint32_t>{ height }));
+      result.push_back(TiffField::make(Tag::StripByteCounts, Type::LONG,
+        std::vector<uint32_t>{ static_cast<uint32_t>(image.dataSize()) }));
+      return result;
+    };
+    // header, pixels of both images, main IFD, and the SubIFD
+    std::stringstream stream;
+    TiffOutput output(stream, std::endian::native, false);
+    const uint32_t mainOffset = 8;
+    const auto halfOffset = static_cast<uint32_t>(mainOffset + main.dataSize());
+    const auto ifdOffset = static_cast<uint32_t>(halfOffset + half.dataSize());
+    auto mainFields = fields(main, mainOffset, false);
+    mainFields.push_back(TiffField::make(Tag::SubIFDs, Type::IFD, std::vector<uint32_t>{ 0 }));
+    const auto subIFDOffset = static_cast<uint32_t>(ifdOffset + TiffOutput::ifdBytes(mainFields, false));
+    mainFields.back() = TiffField::make(Tag::SubIFDs, Type::IFD, std::vector<uint32_t>{ subIFDOffset });
+    output.writeHeader(ifdOffset);
+    output.put(main.dataPtr(), main.dataSize());
+    output.put(half.dataPtr(), half.dataSize());
+    output.writeIFD(mainFields);
+    output.writeIFD(fields(half, halfOffset, true));
+    output.flush();
+
+    TiffExporterAny exporter;
+    load(stream, std::ref(exporter), LoadParams{ .targetWidth = 16 });
+    CHECK(exporter.image().width == 20);
+    CHECK(exporter.image().data == half.data);
+  }
+
+  SUBCASE("Errors") {
+    cog.seekg(0);
+    CHECK_THROWS_AS(load(cog, [](const TiffImage::Header&, const TiffImage::IFD&,
+      TiffImage::ImageData) {}, LoadParams{ .region = LoadRegion{ 0, 0, 1, 1 } }),
+      std::runtime_error);
+    CHECK_THROWS_AS(loadCog(LoadParams{ .region = LoadRegion{ 300, 0, 10, 10 } }),
+      std::runtime_error);
+  }
+}
+
+// Decimates a region of an image as TiffExporter does
+Image decimateImage(const Image& image, const LoadRegion& region) {
+  const int step = region.decimation;
+  Image result = cropImage(image, { 0, 0, (region.width + step - 1) / step,
+    (region.height + step - 1) / step });
+  const bool isPlanar = image.colStride < image.channels * image.chanStride;
+  const int planes = isPlanar ? image.channels : 1;
+  const int sampleBytes = image.bitDepth / 8;
+  const int samplesPerPixel = image.colStride / sampleBytes;
+  auto sample = [&](const Image& from, int plane, int x, int y, int s) -> std::byte* {
+    return const_cast<std::byte*>(from.data.data()) + (isPlanar ? size_t(plane) * from.chanStride : 0)
+      + size_t(y) * from.rowStride + size_t(x) * from.colStride + size_t(s) * sampleBytes;
+  };
+  for (int plane = 0; plane < planes; ++plane) {
+    for (int y = 0; y < result.height; ++y) {
+      for (int x = 0; x < result.width; ++x) {
+        for (int s = 0; s < samplesPerPixel; ++s) {
+          uint64_t sum = 0, count = 0;
+          const int boxSize = region.decimationMode == DecimationMode::Average ? step : 1;
+          for (int by = 0; by < boxSize && y * step + by < region.height; ++by) {
+            for (int bx = 0; bx < boxSize && x * step + bx < region.width; ++bx) {
+              uint64_t value = 0;
+              std::memcpy(&value, sample(image, plane, region.x + x * step + bx,
+                region.y + y * step + by, s), sampleBytes);
+              sum += value;
+              ++count;
+            }
+          }
+          const uint64_t value = (sum + count / 2) / count;
+          std::memcpy(sample(result, plane, x, y, s), &value, sampleBytes);
+        }
+      }
+    }
+  }
+  return result;
+}
+
+TEST_CASE("TiffExporter decimated loading") {
+  for (auto mode : { DecimationMode::Pick, DecimationMode::Average }) {
+    INFO("Average: " << (mode == DecimationMode::Average));
+
+    SUBCASE("Gray strips") {
+      const Image gray = makeRandomImage(103, 77, false, false, 15);
+      WriteParams params;
+      params.rowsPerStrip = 5;
+      params.compression = 5;
+      params.predictor = 2;
+      std::stringstream stream;
+      save(stream, gray, params);
+      for (int step : { 2, 4, 9 }) {
+        INFO("Decimation: " << step);
+        stream.clear();
+        stream.seekg(0);
+        TiffExporterGray<uint16_t> exporter;
+        load(stream, std::ref(exporter), LoadParams{ .decimation = step, .decimationMode = mode });
+        const Image expected = decimateImage(gray, { 0, 0, 103, 77, step, mode });
+        CHECK(exporter.image().width == expected.width);
+        CHECK(exporter.image().height == expected.height);
+        CHECK(exporter.image().data == expected.data);
+      }
+    }
+
+    SUBCASE("Regions of planar RGB tiles") {
+      const Image rgb = makeRandomImage(90, 70, true, true, 16);
+      WriteParams params;
+      params.isPlanar = true;
+      params.tileWidth = 16;
+      params.tileLength = 16;
+      params.compression = 8;
+      std::stringstream stream;
+      save(stream, rgb, params);
+      const LoadRegion region{ 5, 7, 80, 51, 3, mode };
+      TiffExporterAny exporter;
+      load(stream, std::ref(exporter), LoadParams{ .region = LoadRegion{ 5, 7, 80, 51 },
+        .decimation = 3, .decimationMode = mode });
+      const Image expected = decimateImage(rgb, region);
+      CHECK(exporter.image().width == 27);
+      CHECK(exporter.image().height == 17);
+      CHECK(exporter.image().data == expected.data);
+    }
+  }
+
+  SUBCASE("Strips without picked rows are not read") {
+    const Image gray = makeRandomImage(256, 256, false, false, 17);
+    WriteParams params;
+    params.rowsPerStrip = 1;
+    std::stringstream stream;
+    save(stream, gray, params);
+    CountingBuf whole(stream.str());
+    std::istream wholeStream(&whole);
+    TiffExporterAny wholeExporter;
+    load(wholeStream, std::ref(wholeExporter));
+    CountingBuf part(stream.str());
+    std::istream partStream(&part);
+    TiffExporterAny partExporter;
+    load(partStream, std::ref(partExporter), LoadParams{ .decimation = 8 });
+    CHECK(partExporter.image().width == 32);
+    CHECK(part.bytesRead * 6 < whole.bytesRead);
+  }
+
+  SUBCASE("Target size of the decimated image") {
+    const Image gray = makeRandomImage(300, 200, false, false, 18);
+    WriteParams params;
+    params.tileWidth = 64;
+    params.tileLength = 64;
+    std::stringstream cog;
+    saveCog(cog, gray, params);
+    TiffExporterAny exporter;
+    load(cog, std::ref(exporter), LoadParams{ .targetWidth = 70, .decimation = 2 });
+    CHECK(exporter.image().width == 75); // from the 150x100 overview
+  }
+}
+
+TEST_CASE("TiffExporter load statistics") {
+  SUBCASE("Strips of the whole image") {
+    const Image gray = makeRandomImage(64, 48, false, false, 19);
+    WriteParams params;
+    params.rowsPerStrip = 8;
+    params.compression = 5;
+    std::stringstream stream;
+    save(stream, gray, params);
+    CountingBuf buf(stream.str());
+    std::istream countedStream(&buf);
+    LoadStats stats;
+    TiffExporterGray<uint16_t> exporter;
+    load(countedStream, std::ref(exporter), LoadParams{ .stats = &stats });
+    CHECK(exporter.image().data == gray.data);
+    CHECK(stats.loads == 1);
+    CHECK(stats.strips == 6);
+    CHECK(stats.tiles == 0);
+    CHECK(stats.bytesRead == buf.bytesRead);
+    CHECK(stats.reads > 6);
+    CHECK(stats.seeks >= 6);
+    CHECK(stats.bytesAllocated >= exporter.image().dataSize());
+    CHECK(stats.totalTime >= stats.parseTime + stats.readTime + stats.exportTime);
+    CHECK(stats.exportTime > LoadStats::Clock::duration::zero());
+  }
+
+  SUBCASE("Tiles of a region, added to the previous load") {
+    const Image rgb = makeRandomImage(100, 100, true, false, 20);
+    WriteParams params;
+    params.tileWidth = 32;
+    params.tileLength = 32;
+    std::stringstream stream;
+    save(stream, rgb, params);
+    LoadStats stats;
+    for (int i = 0; i < 2; ++i) {
+      stream.clear();
+      stream.seekg(0);
+      TiffExporterRgb<uint8_t> exporter;
+      load(stream, std::ref(exporter), LoadParams{
+        .region = LoadRegion{ 10, 10, 30, 20 }, .stats = &stats });
+      CHECK(exporter.image().data == cropImage(rgb, { 10, 10, 30, 20 }).data);
+    }
+    CHECK(stats.loads == 2);
+    CHECK(stats.tiles == 2 * 2); // tiles 0 and 1 of the first row
+    CHECK(stats.bytesAllocated >= 2 * (2 * 32 * 32 * 3 + 30 * 20 * 3));
+  }
+
+  SUBCASE("Reads of a tile cache") {
+    const Image gray = makeRandomImage(64, 64, false, false, 21);
+    WriteParams params;
+    params.tileWidth = 16;
+    params.tileLength = 16;
+    params.compression = 8;
+    std::stringstream stream;
+    save(stream, gray, params);
+    TileCache cache(1 << 20);
+    LoadStats first, second;
+    for (LoadStats* stats : { &first, &second }) {
+      stream.clear();
+      stream.seekg(0);
+      TiffExporterGray<uint16_t> exporter;
+      load(stream, std::ref(exporter), LoadParams{
+        .tileCache = &cache, .fileId = 1, .stats = stats });
+      CHECK(exporter.image().data == gray.data);
+    }
+    CHECK(first.tiles == 16);
+    CHECK(second.tiles == 0);
+    CHECK(second.bytesRead < first.bytesRead);
+  }
+}
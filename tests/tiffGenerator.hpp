@@ -0,0 +1,406 @@
+// BSD 2-Clause License
+// Copyright (c) 2025 Daniel Moreno
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS”
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+// ---------------------------------------------------------------------------
+//
+// tiffGenerator.hpp
+// =================
+// This file contains a generator of uncompressed TIFF files of any size, to
+// benchmark and stress the library with realistic files without checking
+// them in: images up to 2^32 - 1 pixels across, strips or tiles, any number
+// of bits per sample, chunky or planar, in either byte order, with any
+// number of pages, and in BigTIFF format when the file needs it.
+//
+// The pixels are computed from their coordinates by `sampleValue()`, so a
+// reader can check any part of a file without holding the whole image. The
+// file is written one strip or tile at a time; sparse files skip the pixel
+// data entirely, leaving a hole that reads as zeros, so that files of many
+// gigabytes take no disk space.
+//
+
+#pragma once
+
+#include <tiffcraft/TiffImage.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <bit>
+
+namespace tiffgenerator {
+
+  using namespace TiffCraft;
+
+  enum class Pattern {
+    Gradient, // diagonal ramps, different in each sample and page
+    Random,   // a hash of the coordinates
+    Zero,
+  };
+
+  struct Params {
+    uint32_t width = 1024;
+    uint32_t height = 1024;
+    int bitsPerSample = 8;        // 1, 2, 4, 8, 16, 32, or 64
+    int samplesPerPixel = 1;      // 3 or more are RGB
+    bool isPlanar = false;        // one set of strips or tiles per sample
+    uint32_t rowsPerStrip = 0;    // 0 for strips of about 64 KiB
+    uint32_t tileWidth = 0;       // tiles instead of strips when not 0;
+    uint32_t tileLength = 0;      //   both must be multiples of 16
+    std::endian byteOrder = std::endian::little;
+    std::optional<bool> isBigTiff{}; // default: when offsets need 64 bits
+    uint32_t pages = 1;
+    bool isSparse = false;        // pixel data is not written, reads as zeros
+    Pattern pattern = Pattern::Gradient;
+    uint64_t seed = 1;
+  };
+
+  // Value of a sample of the pattern, within the range of the bits per sample
+  inline uint64_t sampleValue(const Params& params, uint32_t page,
+    uint64_t x, uint64_t y, int sample)
+  {
+    const uint64_t mask = params.bitsPerSample >= 64 ? ~uint64_t(0)
+      : (uint64_t(1) << params.bitsPerSample) - 1;
+    switch (params.pattern) {
+      case Pattern::Gradient:
+        return ((x + 2 * y + 37 * uint64_t(sample) + 11 * uint64_t(page))
+          * (params.bitsPerSample > 16 ? 65537 : 1)) & mask;
+      case Pattern::Random: {
+        // splitmix64 of the coordinates
+        uint64_t z = params.seed + 0x9E3779B97F4A7C15ull
+          * (1 + x + (y << 20) + (uint64_t(sample) << 40) + (uint64_t(page) << 48));
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return (z ^ (z >> 31)) & mask;
+      }
+      default:
+        return 0;
+    }
+  }
+
+  class Generator
+  {
+  public:
+    Generator(std::ostream& stream, const Params& params)
+      : stream_(stream), params_(params)
+    {
+      const int bits = params.bitsPerSample;
+      if (bits != 1 && bits != 2 && bits != 4 && bits != 8 && bits != 16
+        && bits != 32 && bits != 64) {
+        throw std::runtime_error("Unsupported bits per sample: " + std::to_string(bits));
+      }
+      if (params.width == 0 || params.height == 0 || params.pages == 0
+        || params.samplesPerPixel < 1 || params.samplesPerPixel > UINT16_MAX) {
+        throw std::runtime_error("Invalid image size");
+      }
+      isTiled_ = params.tileWidth > 0 || params.tileLength > 0;
+      if (isTiled_ && (params.tileWidth % 16 != 0 || params.tileLength % 16 != 0
+        || params.tileWidth == 0 || params.tileLength == 0)) {
+        throw std::runtime_error("Tile sizes must be multiples of 16");
+      }
+      const uint64_t pixelBits = uint64_t(bits) * (params.isPlanar ? 1 : params.samplesPerPixel);
+      if (isTiled_) {
+        rectWidth_ = params.tileWidth;
+        rectHeight_ = params.tileLength;
+      } else {
+        const uint64_t rowBytes = (params.width * pixelBits + 7) / 8;
+        rectWidth_ = params.width;
+        rectHeight_ = params.rowsPerStrip > 0 ? params.rowsPerStrip
+          : static_cast<uint32_t>(std::max<uint64_t>(1, 65536 / rowBytes));
+        rectHeight_ = std::min(rectHeight_, params.height);
+      }
+      rowBytes_ = (rectWidth_ * pixelBits + 7) / 8;
+      across_ = (params.width + rectWidth_ - 1) / rectWidth_;
+      down_ = (uint64_t(params.height) + rectHeight_ - 1) / rectHeight_;
+      planes_ = params.isPlanar ? params.samplesPerPixel : 1;
+      mustSwap_ = params.byteOrder != std::endian::native;
+
+      // BigTIFF when the last IFD would start beyond 4 GiB
+      const uint64_t rects = across_ * down_ * planes_;
+      const uint64_t pageBytes = rects * rectBytes(0) + rects * 16 + 4096;
+      isBigTiff_ = params.isBigTiff.value_or(pageBytes * params.pages > UINT32_MAX);
+      if (!isBigTiff_ && pageBytes * params.pages > UINT32_MAX) {
+        throw std::runtime_error("The file is too large for classic TIFF");
+      }
+    }
+
+    // Writes the whole file
+    void generate()
+    {
+      // header, with the offset of the first IFD patched later
+      writeValue<uint16_t>(stream_, params_.byteOrder == std::endian::little ? 0x4949 : 0x4D4D);
+      writeValue<uint16_t>(stream_, isBigTiff_ ? 43 : 42, mustSwap_);
+      uint64_t nextOffsetPos = 4;
+      if (isBigTiff_) {
+        writeValue<uint16_t>(stream_, 8, mustSwap_);
+        writeValue<uint16_t>(stream_, 0, mustSwap_);
+        writeValue<uint64_t>(stream_, 0, mustSwap_);
+        nextOffsetPos = 8;
+      } else {
+        writeValue<uint32_t>(stream_, 0, mustSwap_);
+      }
+      uint64_t pos = isBigTiff_ ? 16 : 8;
+      for (uint32_t page = 0; page < params_.pages; ++page) {
+        const uint64_t ifdOffset = writePage(page, pos);
+        writeAt(stream_, nextOffsetPos, offsetBytes(ifdOffset).data(), isBigTiff_ ? 8 : 4);
+        nextOffsetPos = ifdOffset + (isBigTiff_ ? 8 : 2) + entryBytes() * entryCount();
+        pos = nextOffsetPos + (isBigTiff_ ? 8 : 4);
+      }
+      stream_.seekp(0, std::ios_base::end);
+      stream_.flush();
+      if (!stream_) {
+        throw std::runtime_error("Failed to write the TIFF file");
+      }
+    }
+
+    bool isBigTiff() const { return isBigTiff_; }
+
+  private:
+    struct Entry {
+      Tag tag;
+      Type type;
+      std::vector<uint64_t> values;
+    };
+
+    std::ostream& stream_;
+    Params params_;
+    bool isTiled_ = false;
+    bool isBigTiff_ = false;
+    bool mustSwap_ = false;
+    uint32_t rectWidth_ = 0;
+    uint32_t rectHeight_ = 0;
+    uint64_t rowBytes_ = 0;
+    uint64_t across_ = 0;
+    uint64_t down_ = 0;
+    int planes_ = 1;
+
+    size_t entryBytes() const { return isBigTiff_ ? 20 : 12; }
+
+    size_t entryCount() const
+    {
+      return 11 + (params_.pages > 1) + (isTiled_ ? 1 : 0)
+        + (params_.samplesPerPixel == 2 || params_.samplesPerPixel > 3);
+    }
+
+    // Bytes of the strips or tiles in row `rectY`; only the last strip is
+    // shorter than the others
+    uint64_t rectBytes(uint64_t rectY) const
+    {
+      const uint64_t rows = isTiled_ ? rectHeight_
+        : std::min<uint64_t>(rectHeight_, params_.height - rectY * rectHeight_);
+      return rowBytes_ * rows;
+    }
+
+    std::vector<std::byte> offsetBytes(uint64_t offset) const
+    {
+      std::ostringstream os;
+      if (isBigTiff_) {
+        writeValue<uint64_t>(os, offset, mustSwap_);
+      } else {
+        writeValue<uint32_t>(os, static_cast<uint32_t>(offset), mustSwap_);
+      }
+      const std::string bytes = os.str();
+      return std::vector<std::byte>(reinterpret_cast<const std::byte*>(bytes.data()),
+        reinterpret_cast<const std::byte*>(bytes.data()) + bytes.size());
+    }
+
+    // Pixels of one strip or tile in the file byte order
+    std::vector<std::byte> makeRect(uint32_t page, uint64_t rectX, uint64_t rectY, int plane) const
+    {
+      const uint64_t rows = rectBytes(rectY) / rowBytes_;
+      std::vector<std::byte> rect(rowBytes_ * rows);
+      if (params_.pattern == Pattern::Zero) {
+        return rect;
+      }
+      const int bits = params_.bitsPerSample;
+      const int firstSample = params_.isPlanar ? plane : 0;
+      const int samples = params_.isPlanar ? 1 : params_.samplesPerPixel;
+      for (uint64_t row = 0; row < rows; ++row) {
+        const uint64_t y = rectY * rectHeight_ + row;
+        if (y >= params_.height) {
+          break;
+        }
+        std::byte* out = rect.data() + row * rowBytes_;
+        uint64_t bit = 0;
+        for (uint64_t col = 0; col < rectWidth_; ++col) {
+          const uint64_t x = rectX * rectWidth_ + col;
+          if (x >= params_.width) {
+            break;
+          }
+          for (int s = firstSample; s < firstSample + samples; ++s, bit += bits) {
+            const uint64_t value = sampleValue(params_, page, x, y, s);
+            if (bits < 8) {
+              out[bit / 8] |= std::byte(value << (8 - bits - bit % 8));
+              continue;
+            }
+            std::byte* sample = out + bit / 8;
+            switch (bits) {
+              case 8: *sample = std::byte(value); break;
+              case 16: store<uint16_t>(sample, value); break;
+              case 32: store<uint32_t>(sample, value); break;
+              default: store<uint64_t>(sample, value); break;
+            }
+          }
+        }
+      }
+      return rect;
+    }
+
+    template <typename T>
+    void store(std::byte* out, uint64_t value) const
+    {
+      T sample = static_cast<T>(value);
+      if (mustSwap_) {
+        sample = swap(sample);
+      }
+      std::memcpy(out, &sample, sizeof(T));
+    }
+
+    // Writes the pixels, the values, and the IFD of a page from `pos`, and
+    // returns the offset of the IFD
+    uint64_t writePage(uint32_t page, uint64_t pos)
+    {
+      std::vector<uint64_t> offsets, byteCounts;
+      for (int plane = 0; plane < planes_; ++plane) {
+        for (uint64_t rectY = 0; rectY < down_; ++rectY) {
+          for (uint64_t rectX = 0; rectX < across_; ++rectX) {
+            const uint64_t size = rectBytes(rectY);
+            if (!params_.isSparse) {
+              const auto rect = makeRect(page, rectX, rectY, plane);
+              writeAt(stream_, pos, rect.data(), rect.size());
+            }
+            offsets.push_back(pos);
+            byteCounts.push_back(size);
+            pos += size + (size & 1);
+          }
+        }
+      }
+
+      const Type offsetType = isBigTiff_ ? Type::LONG8 : Type::LONG;
+      const uint16_t spp = static_cast<uint16_t>(params_.samplesPerPixel);
+      std::vector<Entry> entries = {
+        { Tag::NewSubfileType, Type::LONG, { params_.pages > 1 ? 2u : 0u } },
+        { Tag::ImageWidth, Type::LONG, { params_.width } },
+        { Tag::ImageLength, Type::LONG, { params_.height } },
+        { Tag::BitsPerSample, Type::SHORT, std::vector<uint64_t>(spp, params_.bitsPerSample) },
+        { Tag::Compression, Type::SHORT, { 1 } },
+        { Tag::PhotometricInterpretation, Type::SHORT, { spp >= 3 ? 2u : 1u } },
+        { Tag::SamplesPerPixel, Type::SHORT, { spp } },
+        { Tag::PlanarConfiguration, Type::SHORT, { params_.isPlanar ? 2u : 1u } },
+      };
+      if (params_.pages > 1) {
+        entries.push_back({ static_cast<Tag>(0x0129), Type::SHORT, { page, params_.pages } }); // PageNumber
+      }
+      if (isTiled_) {
+        entries.push_back({ Tag::TileWidth, Type::LONG, { rectWidth_ } });
+        entries.push_back({ Tag::TileLength, Type::LONG, { rectHeight_ } });
+        entries.push_back({ Tag::TileOffsets, offsetType, std::move(offsets) });
+        entries.push_back({ Tag::TileByteCounts, offsetType, std::move(byteCounts) });
+      } else {
+        entries.push_back({ Tag::StripOffsets, offsetType, std::move(offsets) });
+        entries.push_back({ Tag::RowsPerStrip, Type::LONG, { rectHeight_ } });
+        entries.push_back({ Tag::StripByteCounts, offsetType, std::move(byteCounts) });
+      }
+      if (spp == 2 || spp > 3) {
+        entries.push_back({ Tag::ExtraSamples, Type::SHORT,
+          std::vector<uint64_t>(spp - (spp > 3 ? 3 : 1), 0) });
+      }
+      std::sort(entries.begin(), entries.end(),
+        [](const Entry& a, const Entry& b) { return a.tag < b.tag; });
+      if (entries.size() != entryCount()) {
+        throw std::logic_error("Unexpected IFD entry count");
+      }
+
+      // values that do not fit in the entries, then the IFD
+      std::ostringstream ifd;
+      const size_t inlineBytes = isBigTiff_ ? 8 : 4;
+      const uint64_t ifdOffset = [&]() {
+        uint64_t end = pos;
+        for (const auto& entry : entries) {
+          const size_t bytes = entry.values.size() * typeBytes(entry.type);
+          if (bytes > inlineBytes) {
+            end += bytes + (bytes & 1);
+          }
+        }
+        return end;
+      }();
+      if (isBigTiff_) {
+        writeValue<uint64_t>(ifd, entries.size(), mustSwap_);
+      } else {
+        writeValue<uint16_t>(ifd, static_cast<uint16_t>(entries.size()), mustSwap_);
+      }
+      for (const auto& entry : entries) {
+        std::ostringstream values;
+        for (uint64_t value : entry.values) {
+          switch (entry.type) {
+            case Type::SHORT: writeValue<uint16_t>(values, static_cast<uint16_t>(value), mustSwap_); break;
+            case Type::LONG: writeValue<uint32_t>(values, static_cast<uint32_t>(value), mustSwap_); break;
+            default: writeValue<uint64_t>(values, value, mustSwap_); break;
+          }
+        }
+        std::string bytes = values.str();
+        writeValue(ifd, entry.tag, mustSwap_);
+        writeValue(ifd, entry.type, mustSwap_);
+        if (isBigTiff_) {
+          writeValue<uint64_t>(ifd, entry.values.size(), mustSwap_);
+        } else {
+          writeValue<uint32_t>(ifd, static_cast<uint32_t>(entry.values.size()), mustSwap_);
+        }
+        if (bytes.size() > inlineBytes) {
+          writeAt(stream_, pos, reinterpret_cast<const std::byte*>(bytes.data()), bytes.size());
+          const auto offset = offsetBytes(pos);
+          ifd.write(reinterpret_cast<const char*>(offset.data()), offset.size());
+          pos += bytes.size() + (bytes.size() & 1);
+        } else {
+          bytes.resize(inlineBytes);
+          ifd.write(bytes.data(), bytes.size());
+        }
+      }
+      const auto next = offsetBytes(0);
+      ifd.write(reinterpret_cast<const char*>(next.data()), next.size());
+      const std::string ifdBytes = ifd.str();
+      writeAt(stream_, ifdOffset, reinterpret_cast<const std::byte*>(ifdBytes.data()), ifdBytes.size());
+      return ifdOffset;
+    }
+  };
+
+  inline void generate(std::ostream& stream, const Params& params)
+  {
+    Generator(stream, params).generate();
+  }
+
+  inline void generate(const std::string& filename, const Params& params)
+  {
+    std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+    if (!file) {
+      throw std::runtime_error("Failed to create " + filename);
+    }
+    generate(file, params);
+  }
+
+} // namespace tiffgenerator
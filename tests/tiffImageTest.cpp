@@ -36,6 +36,8 @@
 #define DOCTEST_CONFIG_DOUBLE_STRINGIFY
 #include "doctest.h"
 
+#include "tiffGenerator.hpp"
+
 #include <iostream>
 #include <filesystem>
 #include <fstream>
@@ -240,7 +242,7 @@ TEST_CASE("TiffImage Header class") {
   }
 
   { // Test wrong magic number
-    HeaderBytes headerBytes{ 0x4949, 43, 8 }; // Magic number should be 42
+    HeaderBytes headerBytes{ 0x4949, 44, 8 }; // Magic number should be 42 or 43
     std::stringstream stream;
     headerBytes.write(stream);
     // This should throw an exception due to invalid magic number
@@ -248,13 +250,34 @@ TEST_CASE("TiffImage Header class") {
   }
 
   { // Test wrong offset
-    HeaderBytes headerBytes{ 0x4949, 43, 7 }; // Offset should be >= 8
+    HeaderBytes headerBytes{ 0x4949, 42, 7 }; // Offset should be >= 8
     std::stringstream stream;
     headerBytes.write(stream);
     // This should throw an exception due to invalid first IFD offset
     CHECK_THROWS_AS(TiffImage::Header::read(stream), std::runtime_error);
   }
 
+  { // Test BigTIFF header
+    std::stringstream stream;
+    writeValue<uint16_t>(stream, 0x4D4D);
+    writeValue<uint16_t>(stream, 43, isHostLittleEndian());
+    writeValue<uint16_t>(stream, 8, isHostLittleEndian());
+    writeValue<uint16_t>(stream, 0);
+    writeValue<uint64_t>(stream, 0x100000010ull, isHostLittleEndian());
+
+    TiffImage::Header header = TiffImage::Header::read(stream);
+    CHECK(header.byteOrder() == std::endian::big);
+    CHECK(header.isBigTiff());
+    CHECK(header.firstIFDOffset() == 0x100000010ull);
+  }
+
+  { // Test truncated BigTIFF header
+    HeaderBytes headerBytes{ 0x4949, 43, 8 };
+    std::stringstream stream;
+    headerBytes.write(stream);
+    CHECK_THROWS_AS(TiffImage::Header::read(stream), std::runtime_error);
+  }
+
   { // Test invalid stream
     std::stringstream stream;
     // This should throw an exception due to invalid stream
@@ -494,3 +517,167 @@ TEST_CASE("TiffImage class") {
     );
   }
 }
+
+TEST_CASE("TiffImage generated files") {
+  using namespace tiffgenerator;
+
+  SUBCASE("Pages of planar RGB tiles in big-endian order") {
+    Params params;
+    params.width = 150;
+    params.height = 100;
+    params.bitsPerSample = 16;
+    params.samplesPerPixel = 3;
+    params.isPlanar = true;
+    params.tileWidth = 32;
+    params.tileLength = 48;
+    params.byteOrder = std::endian::big;
+    params.pages = 3;
+    params.pattern = Pattern::Random;
+    std::stringstream stream;
+    generate(stream, params);
+    const TiffImage image = TiffImage::read(stream);
+    CHECK(image.ifds().size() == 3);
+    CHECK_FALSE(image.header().isBigTiff());
+
+    stream.clear();
+    stream.seekg(0);
+    TiffExporterRgb<uint16_t> exporter;
+    load(stream, std::ref(exporter), LoadParams{ .ifdIndex = 2 });
+    const Image& rgb = exporter.image();
+    REQUIRE(rgb.width == 150);
+    size_t mismatches = 0;
+    for (int sample = 0; sample < 3; ++sample) {
+      for (int y = 0; y < rgb.height; ++y) {
+        for (int x = 0; x < rgb.width; ++x) {
+          const uint16_t value = rgb.dataPtr<uint16_t>()[(sample * rgb.chanStride
+            + y * rgb.rowStride + x * rgb.colStride) / 2];
+          mismatches += value != sampleValue(params, 2, x, y, sample);
+        }
+      }
+    }
+    CHECK(mismatches == 0);
+  }
+
+  SUBCASE("Bilevel strips") {
+    Params params;
+    params.width = 1001;
+    params.height = 77;
+    params.bitsPerSample = 1;
+    params.rowsPerStrip = 10;
+    std::stringstream stream;
+    generate(stream, params);
+    TiffExporterGray<uint8_t> exporter;
+    load(stream, std::ref(exporter));
+    const Image& gray = exporter.image();
+    REQUIRE(gray.width == 1001);
+    CHECK(gray.dataPtr<uint8_t>()[76 * gray.rowStride + 1000]
+      == (sampleValue(params, 0, 1000, 76, 0) ? 255 : 0));
+  }
+
+#ifdef __linux__
+  // needs a file system with sparse files
+  SUBCASE("Sparse BigTIFF with offsets beyond 4 GiB") {
+    Params params;
+    params.width = 100000;
+    params.height = 100000;
+    params.tileWidth = 512;
+    params.tileLength = 512;
+    params.isSparse = true;
+    const auto path = std::filesystem::temp_directory_path() / "tiffcraft_test_sparse.tif";
+    generate(path.string(), params);
+    CHECK(std::filesystem::file_size(path) > (uint64_t(10) << 30) - (uint64_t(1) << 30));
+    {
+      std::ifstream file(path, std::ios::binary);
+      const TiffImage image = TiffImage::read(file);
+      CHECK(image.header().isBigTiff());
+      const auto [offsets, byteCounts] = TiffImage::rectangleLocations(image.ifds().front());
+      CHECK(offsets.size() == 196 * 196);
+      CHECK(offsets.back() > UINT32_MAX);
+
+      TiffExporterGray<uint8_t> exporter;
+      load(path.string(), std::ref(exporter),
+        LoadParams{ .region = LoadRegion{ 99900, 99900, 100, 100 } });
+      const auto& data = exporter.image().data;
+      CHECK(data.size() == 100 * 100);
+      CHECK(std::all_of(data.begin(), data.end(), [](std::byte b) { return b == std::byte{ 0 }; }));
+    }
+    std::filesystem::remove(path);
+  }
+#endif
+}
+
+TEST_CASE("TiffImage tag filter") {
+  using namespace tiffgenerator;
+  Params params;
+  params.width = 100;
+  params.height = 80;
+  params.samplesPerPixel = 3;
+  params.rowsPerStrip = 10;
+  params.byteOrder = std::endian::big;
+  std::stringstream stream;
+  generate(stream, params);
+
+  const TiffImage image = TiffImage::read(stream,
+    [](Tag tag) { return tag == Tag::BitsPerSample; });
+  REQUIRE(image.ifds().size() == 1);
+  const auto& ifd = image.ifds().front();
+  const auto& bitsPerSample = ifd.getEntry(Tag::BitsPerSample);
+  CHECK(bitsPerSample.isLoaded());
+  CHECK(bitsPerSample.values<uint16_t>()[2] == 8);
+  CHECK(ifd.getValue(Tag::RowsPerStrip) == 10);
+
+  // offsets are skipped, but their count and location are known
+  const auto& offsets = ifd.getEntry(Tag::StripOffsets);
+  CHECK_FALSE(offsets.isLoaded());
+  CHECK(offsets.count() == 8);
+  CHECK(offsets.valueOffset() >= 8);
+  CHECK_THROWS(offsets.values<uint32_t>());
+  CHECK_THROWS(ifd.getValue(Tag::StripOffsets));
+
+  stream.clear();
+  stream.seekg(0);
+  const TiffImage full = TiffImage::read(stream);
+  const auto& fullOffsets = full.ifds().front().getEntry(Tag::StripOffsets);
+  CHECK(fullOffsets.isLoaded());
+  CHECK(fullOffsets.valueOffset() == offsets.valueOffset());
+}
+
+TEST_CASE("ReadRecorder") {
+  using namespace tiffgenerator;
+  Params params;
+  params.width = 64;
+  params.height = 64;
+  params.tileWidth = 16;
+  params.tileLength = 16;
+  std::stringstream file;
+  generate(file, params);
+  file.seekg(0);
+
+  ReadRecorder recorder;
+  RecordingStreamBuf buf(file.rdbuf(), recorder);
+  std::istream stream(&buf);
+  const TiffImage image = TiffImage::read(stream);
+  const auto [offsets, byteCounts] = TiffImage::rectangleLocations(image.ifds().front());
+  TiffImage::readImageTiles(stream, image.ifds().front());
+  const auto records = recorder.records();
+
+  // the header first, then the IFD, then every tile where it is stored
+  REQUIRE(records.size() > offsets.size());
+  CHECK(records.front().offset == 0);
+  CHECK(records.front().length == 2);
+  CHECK(records.front().thread > 0);
+  CHECK(std::is_sorted(records.begin(), records.end(),
+    [](const ReadRecord& a, const ReadRecord& b) { return a.time < b.time; }));
+  const size_t first = records.size() - offsets.size();
+  for (size_t i = 0; i < offsets.size(); ++i) {
+    CHECK(records[first + i].offset == offsets[i]);
+    CHECK(records[first + i].length == byteCounts[i]);
+  }
+
+  // CSV round trip
+  std::stringstream log;
+  recorder.write(log);
+  CHECK(ReadRecorder::read(log) == records);
+  std::istringstream invalid("offset,length,time_ns,thread\n1,2,x\n");
+  CHECK_THROWS(ReadRecorder::read(invalid));
+}
@@ -0,0 +1,152 @@
+// BSD 2-Clause License
+// Copyright (c) 2025 Daniel Moreno
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS”
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+// ---------------------------------------------------------------------------
+//
+// tiffIndexTest.cpp
+// =================
+// Unit tests for <TiffIndex.hpp>.
+//
+
+#include <tiffcraft/TiffCraft.hpp>
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#define DOCTEST_CONFIG_DOUBLE_STRINGIFY
+#include "doctest.h"
+
+#include "tiffGenerator.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace TiffCraft;
+
+// Empty directory removed at the end of a test
+struct TempDirectory {
+  std::filesystem::path path = std::filesystem::temp_directory_path()
+    / ("tiffcraft_test_" + std::to_string(std::random_device{}()));
+  TempDirectory() { std::filesystem::remove_all(path); std::filesystem::create_directories(path); }
+  ~TempDirectory() { std::filesystem::remove_all(path); }
+};
+
+void checkSameImage(const TiffImage& a, const TiffImage& b) {
+  CHECK(a.header().byteOrder() == b.header().byteOrder());
+  CHECK(a.header().isBigTiff() == b.header().isBigTiff());
+  CHECK(a.header().firstIFDOffset() == b.header().firstIFDOffset());
+  REQUIRE(a.ifds().size() == b.ifds().size());
+  for (size_t i = 0; i < a.ifds().size(); ++i) {
+    CHECK(a.ifds()[i].entries() == b.ifds()[i].entries());
+  }
+}
+
+TEST_CASE("TiffIndex") {
+  using namespace tiffgenerator;
+  TempDirectory temp;
+  const auto file = temp.path / "image.tif";
+  Params params;
+  params.width = 200;
+  params.height = 120;
+  params.bitsPerSample = 16;
+  params.samplesPerPixel = 3;
+  params.tileWidth = 32;
+  params.tileLength = 32;
+  params.byteOrder = std::endian::big;
+  params.pages = 3;
+  params.pattern = Pattern::Random;
+  generate(file.string(), params);
+  const TiffImage parsed = TiffImage::read(file.string());
+
+  SUBCASE("Write and read in memory") {
+    const auto stamp = TiffIndex::FileStamp::of(file);
+    std::ostringstream os(std::ios::binary);
+    TiffIndex::write(os, parsed, stamp);
+    const std::string data = os.str();
+    CHECK(data.size() % 8 == 0);
+    const std::span<const std::byte> bytes(
+      reinterpret_cast<const std::byte*>(data.data()), data.size());
+
+    auto image = TiffIndex::read(bytes, stamp);
+    REQUIRE(image);
+    checkSameImage(*image, parsed);
+
+    // a different file, or a truncated index, is rejected
+    CHECK_FALSE(TiffIndex::read(bytes, { stamp.size + 1, stamp.time }));
+    CHECK_FALSE(TiffIndex::read(bytes, { stamp.size, stamp.time + 1 }));
+    CHECK_FALSE(TiffIndex::read(bytes.first(bytes.size() - 8), stamp));
+    CHECK_FALSE(TiffIndex::read(bytes.first(20), stamp));
+  }
+
+  SUBCASE("Entries without values") {
+    std::ifstream stream(file, std::ios::binary);
+    const TiffImage lazy = TiffImage::read(stream, [](Tag) { return false; });
+    std::ostringstream os(std::ios::binary);
+    TiffIndex::write(os, lazy, {});
+    const std::string data = os.str();
+    auto image = TiffIndex::read(
+      { reinterpret_cast<const std::byte*>(data.data()), data.size() }, {});
+    REQUIRE(image);
+    const auto& offsets = image->ifds()[0].getEntry(Tag::TileOffsets);
+    CHECK_FALSE(offsets.isLoaded());
+    CHECK(offsets.count() == 7 * 4);
+    CHECK(offsets.valueOffset() == lazy.ifds()[0].getEntry(Tag::TileOffsets).valueOffset());
+  }
+
+  SUBCASE("Sidecar file") {
+    CHECK_FALSE(TiffIndex::load(file));
+    const TiffImage opened = TiffIndex::open(file);
+    checkSameImage(opened, parsed);
+    REQUIRE(std::filesystem::exists(TiffIndex::path(file)));
+
+    auto indexed = TiffIndex::load(file);
+    REQUIRE(indexed);
+    checkSameImage(*indexed, parsed);
+
+    // the pixels are the same when loaded with the index
+    TiffExporterRgb<uint16_t> expected;
+    load(file.string(), expected, LoadParams{ .ifdIndex = 1 });
+    TiffExporterRgb<uint16_t> exporter;
+    LoadStats stats;
+    load(file.string(), exporter, LoadParams{ .ifdIndex = 1, .stats = &stats,
+      .image = &*indexed });
+    CHECK(exporter.image().data == expected.image().data);
+    CHECK(stats.reads == 7 * 4); // only the tiles
+
+    // a modified file makes the index stale, and it is written again
+    std::filesystem::last_write_time(file,
+      std::filesystem::last_write_time(file) + std::chrono::seconds(1));
+    CHECK_FALSE(TiffIndex::load(file));
+    checkSameImage(TiffIndex::open(file), parsed);
+    CHECK(TiffIndex::load(file));
+
+    // a corrupted index is ignored
+    std::filesystem::resize_file(TiffIndex::path(file), 100);
+    CHECK_FALSE(TiffIndex::load(file));
+    checkSameImage(TiffIndex::open(file, false), parsed);
+    CHECK_FALSE(TiffIndex::load(file));
+  }
+}
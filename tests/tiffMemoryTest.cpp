@@ -0,0 +1,138 @@
+// BSD 2-Clause License
+// Copyright (c) 2025 Daniel Moreno
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS”
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+// ---------------------------------------------------------------------------
+//
+// tiffMemoryTest.cpp
+// ==================
+// Peak heap usage of loading and exporting images, relative to the size of
+// the exported image. The bounds catch extra copies of the pixel data.
+//
+
+#define HEAP_PROFILER_IMPLEMENTATION
+#include "heapProfiler.hpp"
+
+#include <tiffcraft/TiffCraft.hpp>
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#define DOCTEST_CONFIG_DOUBLE_STRINGIFY
+#include "doctest.h"
+
+#include <functional>
+#include <sstream>
+#include <string>
+
+using namespace TiffCraft;
+
+namespace {
+
+  template <typename T, int N>
+  Image makeImage(int width, int height, bool isPlanar = false) {
+    Image image = Image::make<T, N>(width, height, isPlanar);
+    for (size_t i = 0; i < image.dataSize(); ++i) {
+      image.data[i] = static_cast<std::byte>((i / 7) ^ (i % 13));
+    }
+    return image;
+  }
+
+  std::string saved(const Image& image, const WriteParams& params) {
+    std::ostringstream os;
+    save(os, image, params);
+    return os.str();
+  }
+
+  // Peak heap usage of loading `file` with `Exporter` and taking the image,
+  // divided by the size of the image
+  template <typename Exporter>
+  double peakRatio(const std::string& file, const LoadParams& params = {}) {
+    size_t imageBytes = 0;
+    auto run = [&]() {
+      std::istringstream stream(file);
+      Exporter exporter;
+      load(stream, std::ref(exporter), params);
+      const Image image = exporter.takeImage();
+      imageBytes = image.dataSize();
+    };
+    run(); // warm up the buffers of this thread
+    const auto usage = heapprofiler::measure(run);
+    MESSAGE("peak " << usage.peak << " bytes, " << usage.allocations << " allocations");
+    return double(usage.peak) / imageBytes;
+  }
+
+} // namespace
+
+TEST_CASE("Peak memory of loading") {
+  constexpr int size = 1024;
+  const Image gray16 = makeImage<uint16_t, 1>(size, size);
+  const Image rgb8 = makeImage<uint8_t, 3>(size, size);
+  const Image planar = makeImage<uint8_t, 3>(size, size, true);
+  const size_t fileCopy = 1; // the input stream copies the file
+
+  SUBCASE("Single strip adopted as the image") {
+    const std::string file = saved(gray16, { .rowsPerStrip = size });
+    CHECK(peakRatio<TiffExporterGray<uint16_t>>(file) < fileCopy + 1.05);
+  }
+
+  SUBCASE("Uncompressed strips") {
+    const std::string file = saved(gray16, {});
+    CHECK(peakRatio<TiffExporterGray<uint16_t>>(file) < fileCopy + 2.05);
+  }
+
+  SUBCASE("Compressed tiles exported by TiffExporterAny") {
+    const std::string file = saved(rgb8, { .tileWidth = 128, .tileLength = 128,
+      .compression = 8 });
+    const double compressed = double(file.size()) / rgb8.dataSize();
+    // each decoding thread has a buffer of one tile
+    decodeThreads() = 4;
+    CHECK(peakRatio<TiffExporterAny>(file) < 2 * compressed + 1.1);
+    decodeThreads() = 0;
+  }
+
+  SUBCASE("Planar strips exported by TiffExporterAny") {
+    const std::string file = saved(planar, { .isPlanar = true });
+    CHECK(peakRatio<TiffExporterAny>(file) < fileCopy + 2.05);
+  }
+
+  SUBCASE("Region of tiles") {
+    const std::string file = saved(rgb8, { .tileWidth = 64, .tileLength = 64 });
+    const LoadRegion region{ 100, 100, 512, 512 };
+    // the tiles that overlap the region, 640 x 640 pixels, are read and
+    // copied to the image before it is cropped
+    const double tiles = 640.0 * 640 / (512 * 512);
+    CHECK(peakRatio<TiffExporterAny>(file, { .region = region })
+      < double(file.size()) / (512 * 512 * 3) + 2 * tiles + 0.05);
+  }
+}
+
+TEST_CASE("Taking the exported image does not copy it") {
+  const std::string file = saved(makeImage<uint16_t, 1>(256, 256), {});
+  std::istringstream stream(file);
+  TiffExporterAny exporter;
+  load(stream, std::ref(exporter));
+  const auto usage = heapprofiler::measure([&]() {
+    const Image image = exporter.takeImage();
+    CHECK(image.dataSize() == 256 * 256 * 2);
+  });
+  CHECK(usage.allocations == 0);
+}
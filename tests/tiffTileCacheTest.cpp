@@ -0,0 +1,390 @@
+// BSD 2-Clause License
+// Copyright (c) 2025 Daniel Moreno
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS”
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+// ---------------------------------------------------------------------------
+//
+// tiffTileCacheTest.cpp
+// =====================
+// Unit tests for <TiffTileCache.hpp>, including the disk cache.
+//
+
+#include <tiffcraft/TiffCraft.hpp>
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#define DOCTEST_CONFIG_DOUBLE_STRINGIFY
+#include "doctest.h"
+
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <fstream>
+#include <atomic>
+#include <sstream>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace TiffCraft;
+
+TileCache::Tile makeTile(size_t size, uint8_t value = 0) {
+  return std::make_shared<const std::vector<std::byte>>(size, std::byte{ value });
+}
+
+// Stream buffer that counts the bytes read from it
+class CountingBuf : public std::stringbuf {
+public:
+  using std::stringbuf::stringbuf;
+  size_t bytesRead = 0;
+protected:
+  std::streamsize xsgetn(char* s, std::streamsize n) override {
+    const auto count = std::stringbuf::xsgetn(s, n);
+    bytesRead += static_cast<size_t>(count);
+    return count;
+  }
+};
+
+TEST_CASE("TileCache") {
+  SUBCASE("Hits and misses") {
+    TileCache cache(1000, 1);
+    const TileKey key{ 1, 0, 3, 7 };
+    CHECK(cache.find(key) == nullptr);
+    const auto tile = makeTile(10, 5);
+    cache.insert(key, tile);
+    CHECK(cache.find(key) == tile);
+    CHECK(cache.find(TileKey{ 1, 0, 3, 8 }) == nullptr); // another format
+    CHECK(cache.find(TileKey{ 2, 0, 3, 7 }) == nullptr); // another file
+    const auto stats = cache.stats();
+    CHECK(stats.hits == 1);
+    CHECK(stats.misses == 3);
+    CHECK(stats.tiles == 1);
+    CHECK(stats.bytes == 10);
+  }
+
+  SUBCASE("Least recently used tiles are evicted") {
+    TileCache cache(300, 1);
+    for (uint64_t i = 0; i < 3; ++i) {
+      cache.insert(TileKey{ 1, 0, i }, makeTile(100));
+    }
+    CHECK(cache.find(TileKey{ 1, 0, 0 }) != nullptr); // 1 is now the oldest
+    cache.insert(TileKey{ 1, 0, 3 }, makeTile(100));
+    CHECK(cache.find(TileKey{ 1, 0, 1 }) == nullptr);
+    CHECK(cache.find(TileKey{ 1, 0, 0 }) != nullptr);
+    CHECK(cache.find(TileKey{ 1, 0, 3 }) != nullptr);
+    cache.insert(TileKey{ 1, 0, 4 }, makeTile(250));
+    auto stats = cache.stats();
+    CHECK(stats.evictions == 4);
+    CHECK(stats.tiles == 1);
+    CHECK(stats.bytes == 250);
+
+    cache.insert(TileKey{ 1, 0, 5 }, makeTile(301)); // larger than the budget
+    CHECK(cache.find(TileKey{ 1, 0, 5 }) == nullptr);
+    cache.clear();
+    stats = cache.stats();
+    CHECK(stats.tiles == 0);
+    CHECK(stats.bytes == 0);
+  }
+
+  SUBCASE("Replacing a tile") {
+    TileCache cache(1000, 1);
+    cache.insert(TileKey{ 1 }, makeTile(100));
+    cache.insert(TileKey{ 1 }, makeTile(40, 2));
+    CHECK(cache.stats().bytes == 40);
+    CHECK(cache.find(TileKey{ 1 })->front() == std::byte{ 2 });
+  }
+
+  SUBCASE("Concurrent lookups") {
+    TileCache cache(1 << 20);
+    for (uint64_t i = 0; i < 256; ++i) {
+      cache.insert(TileKey{ 1, 0, i }, makeTile(64, uint8_t(i)));
+    }
+    std::vector<std::thread> threads;
+    std::atomic<int> errors = 0;
+    for (int t = 0; t < 4; ++t) {
+      threads.emplace_back([&, t]() {
+        for (uint64_t i = 0; i < 10000; ++i) {
+          const uint64_t index = (i * 7 + t) % 300;
+          auto tile = cache.find(TileKey{ 1, 0, index });
+          if (index < 256 && (!tile || tile->front() != std::byte(index))) {
+            ++errors;
+          }
+          if (index >= 256) {
+            cache.insert(TileKey{ 1, 0, index }, makeTile(64, uint8_t(index)));
+          }
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    CHECK(errors == 0);
+    const auto stats = cache.stats();
+    CHECK(stats.hits + stats.misses == 40000);
+    CHECK(stats.evictions == 0);
+  }
+}
+
+TEST_CASE("TileCache loading") {
+  std::mt19937 rng(21);
+  Image rgb = Image::make<uint8_t, 3>(200, 150, true);
+  for (auto& value : rgb.data) {
+    value = static_cast<std::byte>(rng() % 16); // compressible
+  }
+  WriteParams params;
+  params.isPlanar = true;
+  params.tileWidth = 32;
+  params.tileLength = 32;
+  params.compression = 8;
+  std::stringstream stream;
+  save(stream, rgb, params);
+  const std::string file = stream.str();
+
+  TileCache cache(1 << 24);
+  auto loadCached = [&](auto& exporter, LoadParams loadParams, size_t* bytesRead = nullptr) {
+    CountingBuf buf(file);
+    std::istream input(&buf);
+    loadParams.tileCache = &cache;
+    loadParams.fileId = 1;
+    load(input, std::ref(exporter), loadParams);
+    if (bytesRead) {
+      *bytesRead = buf.bytesRead;
+    }
+  };
+
+  SUBCASE("Cached tiles are not read again") {
+    size_t firstRead = 0, secondRead = 0;
+    TiffExporterAny first;
+    loadCached(first, {}, &firstRead);
+    CHECK(first.image().data == rgb.data);
+    const size_t tiles = 7 * 5 * 3;
+    CHECK(cache.stats().misses == tiles);
+    CHECK(cache.stats().tiles == tiles);
+
+    TiffExporterAny second;
+    loadCached(second, {}, &secondRead);
+    CHECK(second.image().data == rgb.data);
+    CHECK(cache.stats().hits == tiles);
+    CHECK(secondRead * 4 < firstRead);
+  }
+
+  SUBCASE("Regions and decimation use the cached tiles") {
+    TiffExporterAny whole;
+    loadCached(whole, {});
+    const LoadRegion region{ 40, 30, 100, 70 };
+    TiffExporterAny part;
+    loadCached(part, LoadParams{ .region = region });
+    TiffExporterAny uncached;
+    std::istringstream input(file);
+    load(input, std::ref(uncached), LoadParams{ .region = region });
+    CHECK(part.image().width == region.width);
+    CHECK(part.image().data == uncached.image().data);
+    CHECK(cache.stats().misses == 7 * 5 * 3);
+
+    TiffExporterAny decimated;
+    loadCached(decimated, LoadParams{ .decimation = 4, .decimationMode = DecimationMode::Average });
+    TiffExporterAny expected;
+    input.clear();
+    input.seekg(0);
+    load(input, std::ref(expected), LoadParams{ .decimation = 4, .decimationMode = DecimationMode::Average });
+    CHECK(decimated.image().data == expected.image().data);
+    CHECK(cache.stats().misses == 7 * 5 * 3);
+  }
+
+  SUBCASE("Output formats are cached separately") {
+    TiffExporterRgb<uint8_t> narrow;
+    loadCached(narrow, {});
+    TiffExporterRgb<uint16_t, uint8_t> wide;
+    loadCached(wide, {});
+    CHECK(cache.stats().hits == 0);
+    CHECK(wide.image().width == rgb.width);
+    CHECK(wide.image().dataPtr<uint16_t>()[0] == narrow.image().dataPtr<uint8_t>()[0] * 257);
+  }
+
+  SUBCASE("A file identity is needed") {
+    std::istringstream input(file);
+    TiffExporterAny exporter;
+    CHECK_THROWS(load(input, std::ref(exporter), LoadParams{ .tileCache = &cache }));
+  }
+}
+
+// Empty directory removed at the end of a test
+struct TempDirectory {
+  std::filesystem::path path = std::filesystem::temp_directory_path()
+    / ("tiffcraft_test_" + std::to_string(std::random_device{}()));
+  TempDirectory() { std::filesystem::remove_all(path); }
+  ~TempDirectory() { std::filesystem::remove_all(path); }
+};
+
+size_t countFiles(const std::filesystem::path& directory, const std::string& extension) {
+  size_t count = 0;
+  for (const auto& entry : std::filesystem::recursive_directory_iterator(directory)) {
+    count += entry.is_regular_file() && entry.path().extension() == extension;
+  }
+  return count;
+}
+
+TEST_CASE("DiskTileCache") {
+  TempDirectory temp;
+
+  SUBCASE("Tiles are kept between instances") {
+    const TileKey key{ 1, 2, 3, 4 };
+    {
+      DiskTileCache cache(temp.path, 1 << 20);
+      CHECK(cache.find(key) == nullptr);
+      cache.insert(key, *makeTile(100, 9));
+    }
+    DiskTileCache cache(temp.path, 1 << 20);
+    CHECK(cache.bytes() == sizeof(DiskTileCache::FileHeader) + 100);
+    const auto tile = cache.find(key);
+    REQUIRE(tile != nullptr);
+    CHECK(*tile == *makeTile(100, 9));
+    CHECK(cache.find(TileKey{ 1, 2, 3, 5 }) == nullptr);
+
+    // the pixels follow the header
+    std::ifstream file(cache.path(key), std::ios::binary);
+    std::vector<char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    REQUIRE(bytes.size() == sizeof(DiskTileCache::FileHeader) + 100);
+    CHECK(bytes[sizeof(DiskTileCache::FileHeader)] == 9);
+  }
+
+  SUBCASE("Truncated or corrupt files are misses and are removed") {
+    DiskTileCache cache(temp.path, 1 << 20);
+    const TileKey key{ 1, 2, 3, 4 };
+    cache.insert(key, *makeTile(100, 9));
+    const auto file = cache.path(key);
+    std::filesystem::resize_file(file, sizeof(DiskTileCache::FileHeader) + 50);
+    CHECK(cache.find(key) == nullptr);
+    CHECK(!std::filesystem::exists(file));
+
+    // a header claiming more pixels than any file holds
+    cache.insert(key, *makeTile(100, 9));
+    {
+      std::fstream stream(file, std::ios::binary | std::ios::in | std::ios::out);
+      const uint64_t size = uint64_t(1) << 60;
+      stream.seekp(offsetof(DiskTileCache::FileHeader, size));
+      stream.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    }
+    CHECK(cache.find(key) == nullptr);
+    CHECK(!std::filesystem::exists(file));
+
+    cache.insert(key, *makeTile(100, 9));
+    std::filesystem::resize_file(file, 3);
+    CHECK(cache.find(key) == nullptr);
+    CHECK(!std::filesystem::exists(file));
+  }
+
+  SUBCASE("Least recently used files are removed") {
+    const size_t fileSize = sizeof(DiskTileCache::FileHeader) + 1000;
+    DiskTileCache cache(temp.path, fileSize * 8);
+    const auto start = std::filesystem::file_time_type::clock::now();
+    for (uint64_t i = 0; i < 8; ++i) {
+      cache.insert(TileKey{ 1, 0, i }, *makeTile(1000));
+      std::filesystem::last_write_time(cache.path(TileKey{ 1, 0, i }),
+        start - std::chrono::seconds(100 - i));
+    }
+    CHECK(cache.find(TileKey{ 1, 0, 0 }) != nullptr); // now the most recent
+    cache.insert(TileKey{ 1, 0, 8 }, *makeTile(1000));
+    CHECK(countFiles(temp.path, ".tile") == 6);
+    CHECK(cache.bytes() == fileSize * 6);
+    CHECK(cache.find(TileKey{ 1, 0, 0 }) != nullptr);
+    CHECK(cache.find(TileKey{ 1, 0, 1 }) == nullptr);
+    CHECK(cache.find(TileKey{ 1, 0, 3 }) == nullptr);
+    CHECK(cache.find(TileKey{ 1, 0, 4 }) != nullptr);
+
+    // reads of recently used files do not write their time
+    const auto file = cache.path(TileKey{ 1, 0, 4 });
+    const auto recent = std::filesystem::file_time_type::clock::now() - std::chrono::seconds(10);
+    std::filesystem::last_write_time(file, recent);
+    CHECK(cache.find(TileKey{ 1, 0, 4 }) != nullptr);
+    CHECK(std::filesystem::last_write_time(file) == recent);
+  }
+
+  SUBCASE("Concurrent writers") {
+    DiskTileCache cache(temp.path, 1 << 24);
+    std::vector<std::thread> threads;
+    std::atomic<int> errors = 0;
+    for (int t = 0; t < 4; ++t) {
+      threads.emplace_back([&]() {
+        for (uint64_t i = 0; i < 40; ++i) {
+          const TileKey key{ 1, 0, i % 10 };
+          cache.insert(key, *makeTile(5000, uint8_t(i % 10)));
+          auto tile = cache.find(key);
+          if (tile && (tile->size() != 5000 || tile->back() != std::byte(i % 10))) {
+            ++errors;
+          }
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    CHECK(errors == 0);
+    CHECK(countFiles(temp.path, ".tile") == 10);
+    CHECK(countFiles(temp.path, ".tmp") == 0);
+    CHECK(cache.bytes() == 10 * (sizeof(DiskTileCache::FileHeader) + 5000));
+  }
+
+  SUBCASE("Existing tiles are not rewritten") {
+    DiskTileCache cache(temp.path, 1 << 20);
+    const TileKey key{ 1, 2, 3, 4 };
+    cache.insert(key, *makeTile(100, 9));
+    const auto file = cache.path(key);
+    const auto time = std::filesystem::file_time_type::clock::now() - std::chrono::seconds(10);
+    std::filesystem::last_write_time(file, time);
+    cache.insert(key, *makeTile(100, 9));
+    CHECK(std::filesystem::last_write_time(file) == time);
+    CHECK(cache.bytes() == sizeof(DiskTileCache::FileHeader) + 100);
+    CHECK(countFiles(temp.path, ".tmp") == 0);
+  }
+
+  SUBCASE("Tile cache backed by the disk cache") {
+    std::mt19937 rng(22);
+    Image gray = Image::make<uint16_t, 1>(100, 80);
+    for (auto& value : gray.data) {
+      value = static_cast<std::byte>(rng());
+    }
+    WriteParams params;
+    params.rowsPerStrip = 10;
+    params.compression = 5;
+    const std::string file = (temp.path / "gray.tif").string();
+    std::filesystem::create_directories(temp.path);
+    save(file, gray, params);
+
+    auto disk = std::make_shared<DiskTileCache>(temp.path / "cache", 1 << 24);
+    auto loadCached = [&](TileCache& cache) {
+      cache.setDiskCache(disk);
+      TiffExporterGray<uint16_t> exporter;
+      load(file, std::ref(exporter), LoadParams{ .tileCache = &cache });
+      CHECK(exporter.image().data == gray.data);
+    };
+    TileCache first(1 << 20);
+    loadCached(first);
+    CHECK(first.stats().misses == 8);
+    TileCache second(1 << 20);
+    loadCached(second);
+    CHECK(second.stats().diskHits == 8);
+    CHECK(second.stats().misses == 0);
+    loadCached(second);
+    CHECK(second.stats().hits == 8);
+  }
+}
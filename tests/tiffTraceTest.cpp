@@ -0,0 +1,126 @@
+// BSD 2-Clause License
+// Copyright (c) 2025 Daniel Moreno
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS”
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+// ---------------------------------------------------------------------------
+//
+// tiffTraceTest.cpp
+// =================
+// Unit tests for <TiffTrace.hpp>, built with tracing compiled in.
+//
+
+#include <tiffcraft/TiffCraft.hpp>
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#define DOCTEST_CONFIG_DOUBLE_STRINGIFY
+#include "doctest.h"
+
+#include <functional>
+#include <sstream>
+#include <string>
+
+#ifndef TIFFCRAFT_USE_TRACE
+#error "tiffTraceTest must be built with TIFFCRAFT_USE_TRACE"
+#endif
+
+using namespace TiffCraft;
+
+// Number of events named `name` in a trace
+size_t countEvents(const std::string& trace, const std::string& name) {
+  const std::string pattern = "{\"name\":\"" + name + "\"";
+  size_t count = 0;
+  for (size_t pos = trace.find(pattern); pos != std::string::npos;
+    pos = trace.find(pattern, pos + 1)) {
+    ++count;
+  }
+  return count;
+}
+
+std::string tiledImage() {
+  Image image = Image::make<uint16_t, 1>(64, 64);
+  for (size_t i = 0; i < image.dataSize<uint16_t>(); ++i) {
+    image.dataPtr<uint16_t>()[i] = static_cast<uint16_t>(i * 37);
+  }
+  WriteParams params;
+  params.tileWidth = 16;
+  params.tileLength = 16;
+  params.compression = 8;
+  std::stringstream stream;
+  save(stream, image, params);
+  return stream.str();
+}
+
+TEST_CASE("Trace events of a load") {
+  std::istringstream stream(tiledImage());
+  decodeThreads() = 4;
+  startTrace();
+  TiffExporterGray<uint16_t> exporter;
+  load(stream, std::ref(exporter));
+  stopTrace();
+  decodeThreads() = 0;
+  std::ostringstream os;
+  writeTrace(os);
+  const std::string trace = os.str();
+
+  CHECK(trace.starts_with("{\"traceEvents\":["));
+  CHECK(trace.find("\"droppedEvents\":0}") != std::string::npos);
+  CHECK(countEvents(trace, "load") == 1);
+  CHECK(countEvents(trace, "read header") == 1);
+  CHECK(countEvents(trace, "read IFD") == 1);
+  CHECK(countEvents(trace, "read tile") == 16);
+  CHECK(countEvents(trace, "decode rectangle") == 16);
+  CHECK(countEvents(trace, "export") == 1);
+  CHECK(trace.find("\"args\":{\"index\":15}") != std::string::npos);
+
+  // the events were discarded when written
+  std::ostringstream empty;
+  writeTrace(empty);
+  CHECK(countEvents(empty.str(), "load") == 0);
+}
+
+TEST_CASE("No trace events when stopped") {
+  std::istringstream stream(tiledImage());
+  startTrace();
+  stopTrace();
+  TiffExporterGray<uint16_t> exporter;
+  load(stream, std::ref(exporter));
+  std::ostringstream os;
+  writeTrace(os);
+  CHECK(os.str().find("\"name\"") == std::string::npos);
+}
+
+TEST_CASE("Oldest trace events are overwritten") {
+  startTrace();
+  for (int i = 0; i < TIFFCRAFT_TRACE_EVENTS + 10; ++i) {
+    TIFFCRAFT_TRACE_SCOPE("event", "i", i);
+  }
+  stopTrace();
+  CHECK(tracer().dropped() == 10);
+  std::ostringstream os;
+  writeTrace(os);
+  const std::string trace = os.str();
+  CHECK(countEvents(trace, "event") == TIFFCRAFT_TRACE_EVENTS);
+  CHECK(trace.find("\"args\":{\"i\":9}") == std::string::npos);
+  CHECK(trace.find("\"args\":{\"i\":10}") != std::string::npos);
+  CHECK(trace.find("\"droppedEvents\":10}") != std::string::npos);
+}
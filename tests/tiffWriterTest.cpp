@@ -0,0 +1,415 @@
+// BSD 2-Clause License
+// Copyright (c) 2025 Daniel Moreno
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS”
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+// ---------------------------------------------------------------------------
+//
+// tiffWriterTest.cpp
+// ==================
+// Unit tests for <TiffWriter.hpp> and <TiffCog.hpp>.
+//
+
+#include <tiffcraft/TiffWriter.hpp>
+#include <tiffcraft/TiffCog.hpp>
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#define DOCTEST_CONFIG_DOUBLE_STRINGIFY
+#include "doctest.h"
+
+#include <functional>
+#include <streambuf>
+#include <sstream>
+#include <random>
+#include <string>
+#include <vector>
+#include <cstring>
+
+using namespace TiffCraft;
+
+template <typename T, int N>
+Image makeTestImage(int width, int height, bool isPlanar = false, unsigned seed = 1) {
+  std::mt19937 rng(seed);
+  Image image = Image::make<T, N>(width, height, isPlanar);
+  for (auto& value : image.data) {
+    value = static_cast<std::byte>(rng());
+  }
+  return image;
+}
+
+// Concatenates the strips of the first image in `file`
+std::vector<std::byte> readStrips(const std::string& file,
+  std::function<void(const TiffImage::Header&, const TiffImage::IFD&)> check = {}) {
+  std::istringstream stream(file);
+  std::vector<std::byte> data;
+  load(stream, [&](const TiffImage::Header& header, const TiffImage::IFD& ifd,
+    TiffImage::ImageData imageData) {
+    if (check) {
+      check(header, ifd);
+    }
+    for (const auto& strip : imageData) {
+      data.insert(data.end(), strip.begin(), strip.end());
+    }
+  });
+  return data;
+}
+
+// Stream buffer that only supports writing forward, like a pipe
+class ForwardOnlyBuf : public std::stringbuf {
+protected:
+  pos_type seekoff(off_type, std::ios_base::seekdir, std::ios_base::openmode) override {
+    return pos_type(off_type(-1));
+  }
+  pos_type seekpos(pos_type, std::ios_base::openmode) override {
+    return pos_type(off_type(-1));
+  }
+};
+
+TEST_CASE("TiffWriter round trip") {
+  for (bool isBigTiff : { false, true }) {
+    for (std::endian byteOrder : { std::endian::little, std::endian::big }) {
+      INFO("BigTIFF: " << isBigTiff << ", big endian: " << (byteOrder == std::endian::big));
+      WriteParams params;
+      params.isBigTiff = isBigTiff;
+      params.byteOrder = byteOrder;
+      params.rowsPerStrip = 7;
+
+      SUBCASE("Gray 8 bits") {
+        const Image image = makeTestImage<uint8_t, 1>(61, 40);
+        std::stringstream stream;
+        save(stream, image, params);
+        CHECK(stream.str().size() % 2 == 0);
+
+        TiffExporterAny exporter;
+        load(stream, std::ref(exporter));
+        CHECK(exporter.image().width == image.width);
+        CHECK(exporter.image().height == image.height);
+        CHECK(exporter.image().data == image.data);
+      }
+      SUBCASE("RGB 16 bits") {
+        const Image image = makeTestImage<uint16_t, 3>(33, 20, false, 2);
+        std::stringstream stream;
+        save(stream, image, params);
+
+        TiffExporterAny exporter;
+        load(stream, std::ref(exporter));
+        CHECK(exporter.image().channels == 3);
+        CHECK(exporter.image().data == image.data);
+      }
+      SUBCASE("RGB 8 bits, planar") {
+        const Image image = makeTestImage<uint8_t, 3>(33, 20, true, 3);
+        params.isPlanar = true;
+        std::stringstream stream;
+        save(stream, image, params);
+        const auto strips = readStrips(stream.str(),
+          [](const TiffImage::Header&, const TiffImage::IFD& ifd) {
+            CHECK(ifd.entries().at(Tag::PlanarConfiguration).values<uint16_t>()[0] == 2);
+            CHECK(ifd.entries().at(Tag::StripOffsets).count() == 3 * 3);
+          });
+        CHECK(strips == image.data);
+      }
+      SUBCASE("Chunky image written as planar, and the reverse") {
+        const Image chunky = makeTestImage<uint16_t, 3>(17, 9, false, 4);
+        Image planar = Image::make<uint16_t, 3>(17, 9, true);
+        for (int y = 0; y < 9; ++y) {
+          for (int x = 0; x < 17; ++x) {
+            for (int c = 0; c < 3; ++c) {
+              std::memcpy(&planar.data[y * planar.rowStride + x * planar.colStride + c * planar.chanStride],
+                &chunky.data[y * chunky.rowStride + x * chunky.colStride + c * chunky.chanStride], 2);
+            }
+          }
+        }
+        std::stringstream planarStream, chunkyStream;
+        params.isPlanar = true;
+        save(planarStream, chunky, params);
+        params.isPlanar = false;
+        save(chunkyStream, planar, params);
+
+        TiffExporterAny exporter;
+        load(chunkyStream, std::ref(exporter));
+        CHECK(exporter.image().data == chunky.data);
+
+        auto strips = readStrips(planarStream.str());
+        if (byteOrder != std::endian::native) {
+          swapArray(reinterpret_cast<uint16_t*>(strips.data()), strips.size() / 2);
+        }
+        CHECK(strips == planar.data);
+      }
+      SUBCASE("Float 32 bits with alpha") {
+        params.sampleFormat = 3;
+        const Image image = makeTestImage<float, 2>(13, 11, false, 5);
+        std::stringstream stream;
+        save(stream, image, params);
+        auto strips = readStrips(stream.str(),
+          [&](const TiffImage::Header& header, const TiffImage::IFD& ifd) {
+            CHECK(header.isBigTiff() == isBigTiff);
+            CHECK(ifd.entries().at(Tag::SampleFormat).values<uint16_t>()[1] == 3);
+            CHECK(ifd.entries().at(Tag::ExtraSamples).values<uint16_t>()[0] == 2);
+          });
+        if (byteOrder != std::endian::native) {
+          swapArray(reinterpret_cast<uint32_t*>(strips.data()), strips.size() / 4);
+        }
+        CHECK(strips == image.data);
+      }
+      SUBCASE("CMYK with and without alpha") {
+        params.photometric = 5;
+        std::stringstream cmyk, cmyka;
+        save(cmyk, makeTestImage<uint8_t, 4>(9, 5, false, 6), params);
+        save(cmyka, makeTestImage<uint8_t, 5>(9, 5, false, 7), params);
+        readStrips(cmyk.str(), [](const TiffImage::Header&, const TiffImage::IFD& ifd) {
+          CHECK(ifd.entries().at(Tag::PhotometricInterpretation).values<uint16_t>()[0] == 5);
+          CHECK(ifd.entries().count(Tag::ExtraSamples) == 0);
+        });
+        readStrips(cmyka.str(), [](const TiffImage::Header&, const TiffImage::IFD& ifd) {
+          const auto extraSamples = ifd.entries().at(Tag::ExtraSamples).values<uint16_t>();
+          CHECK(extraSamples.size() == 1);
+          CHECK(extraSamples[0] == 2);
+        });
+      }
+    }
+  }
+}
+
+TEST_CASE("TiffWriter streaming") {
+  const Image image = makeTestImage<uint16_t, 1>(45, 101);
+
+  // rows in irregular bands, a buffer smaller than a strip, and an output
+  // stream that cannot seek
+  ForwardOnlyBuf buffer;
+  std::ostream out(&buffer);
+  WriteParams params;
+  params.bufferSize = 100;
+  params.byteOrder = std::endian::big;
+  TiffWriter writer(out, 45, 101, 1, 16, params);
+  CHECK(writer.rowsPerStrip() == 101);
+  const size_t rowBytes = writer.rowBytes();
+  int y = 0;
+  for (int rows : { 1, 3, 0, 20, 50, 27 }) {
+    writer.writeRows(std::span(image.data).subspan(y * rowBytes, rows * rowBytes));
+    y += rows;
+  }
+  writer.finish();
+
+  std::stringstream stream(buffer.str());
+  TiffExporterAny exporter;
+  load(stream, std::ref(exporter));
+  CHECK(exporter.image().data == image.data);
+}
+
+TEST_CASE("TiffWriter with compression") {
+  std::vector<int> compressions = { 1, 5, 8, 32773 };
+#ifdef TIFFCRAFT_USE_ZSTD
+  compressions.push_back(50000);
+#endif
+  const Image gray = makeTestImage<uint16_t, 1>(70, 45, false, 6);
+  const Image rgb = makeTestImage<uint8_t, 3>(70, 45, true, 7);
+  const Image floats = makeTestImage<uint32_t, 1>(70, 45, false, 8);
+
+  for (int compression : compressions) {
+    for (int tileSize : { 0, 32 }) {
+      for (int threads : { 1, 4 }) {
+        INFO("Compression: " << compression << ", tile size: " << tileSize << ", threads: " << threads);
+        WriteParams params;
+        params.compression = compression;
+        params.tileWidth = tileSize;
+        params.tileLength = tileSize;
+        params.rowsPerStrip = 8;
+        params.threads = threads;
+        params.maxTilesInFlight = 3;
+        params.byteOrder = threads == 1 ? std::endian::little : std::endian::big;
+        const bool hasPredictor = compression != 1 && compression != 32773;
+
+        params.predictor = hasPredictor ? 2 : 1;
+        std::stringstream grayStream;
+        save(grayStream, gray, params);
+        TiffExporterAny grayExporter;
+        load(grayStream, std::ref(grayExporter));
+        CHECK(grayExporter.image().data == gray.data);
+
+        params.isPlanar = true;
+        std::stringstream rgbStream;
+        save(rgbStream, rgb, params);
+        TiffExporterAny rgbExporter;
+        load(rgbStream, std::ref(rgbExporter));
+        CHECK(rgbExporter.image().data == rgb.data);
+
+        params.isPlanar = false;
+        params.sampleFormat = 3;
+        params.predictor = hasPredictor ? 3 : 1;
+        std::stringstream floatStream;
+        save(floatStream, floats, params);
+        TiffExporterAny floatExporter;
+        load(floatStream, std::ref(floatExporter));
+        CHECK(floatExporter.image().data == floats.data);
+      }
+    }
+  }
+
+  // the header is completed last, which needs a seekable stream
+  ForwardOnlyBuf buffer;
+  std::ostream out(&buffer);
+  WriteParams params;
+  params.compression = 8;
+  CHECK_THROWS_AS(save(out, gray, params), std::runtime_error);
+}
+
+// Reduces a chunky 16-bit image to half its size with a 2 x 2 box filter
+Image halve(const Image& image) {
+  const int width = (image.width + 1) / 2;
+  const int height = (image.height + 1) / 2;
+  Image half = Image::make<uint16_t, 1>(width, height, false);
+  auto sample = [&](int x, int y) {
+    x = std::min(x, image.width - 1);
+    y = std::min(y, image.height - 1);
+    uint16_t value;
+    std::memcpy(&value, image.data.data() + (size_t(y) * image.width + x) * 2, 2);
+    return int(value);
+  };
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      const uint16_t value = static_cast<uint16_t>((sample(2 * x, 2 * y) + sample(2 * x + 1, 2 * y)
+        + sample(2 * x, 2 * y + 1) + sample(2 * x + 1, 2 * y + 1) + 2) / 4);
+      std::memcpy(half.data.data() + (size_t(y) * width + x) * 2, &value, 2);
+    }
+  }
+  return half;
+}
+
+TEST_CASE("CogWriter") {
+  const Image gray = makeTestImage<uint16_t, 1>(133, 70, false, 9);
+  for (bool isBigTiff : { false, true }) {
+    for (int compression : { 1, 8 }) {
+      INFO("BigTIFF: " << isBigTiff << ", compression: " << compression);
+      WriteParams params;
+      params.isBigTiff = isBigTiff;
+      params.compression = compression;
+      params.tileWidth = 32;
+      params.tileLength = 16;
+      params.threads = 2;
+      std::stringstream stream;
+      saveCog(stream, gray, params);
+
+      // 133x70, 67x35, 34x18, 17x9: the last one fits in a tile
+      stream.seekg(0);
+      const TiffImage tiff = TiffImage::read(stream);
+      REQUIRE(tiff.ifds().size() == 4);
+      std::vector<uint64_t> firstOffsets, lastOffsets;
+      for (size_t i = 0; i < tiff.ifds().size(); ++i) {
+        const auto& ifd = tiff.ifds()[i];
+        const auto& entries = ifd.entries();
+        CHECK(entries.contains(Tag::NewSubfileType) == (i > 0));
+        if (i > 0) {
+          CHECK(ifd.getEntry(Tag::NewSubfileType).values<uint32_t>()[0] == 1);
+        }
+        const int expectedWidth = i == 0 ? 133 : i == 1 ? 67 : i == 2 ? 34 : 17;
+        std::vector<uint64_t> width;
+        const auto& widthEntry = ifd.getEntry(Tag::ImageWidth);
+        copyVector<uint64_t>(widthEntry.type(), widthEntry.values(), widthEntry.count(), width);
+        CHECK(width[0] == uint64_t(expectedWidth));
+        std::vector<uint64_t> offsets;
+        const auto& entry = ifd.getEntry(Tag::TileOffsets);
+        copyVector<uint64_t>(entry.type(), entry.values(), entry.count(), offsets);
+        firstOffsets.push_back(offsets.front());
+        lastOffsets.push_back(offsets.back());
+      }
+      // IFDs first, then the tiles from the coarsest level to the finest
+      CHECK(tiff.header().firstIFDOffset() == (isBigTiff ? 16u : 8u));
+      CHECK(lastOffsets[3] < firstOffsets[2]);
+      CHECK(lastOffsets[2] < firstOffsets[1]);
+      CHECK(lastOffsets[1] < firstOffsets[0]);
+
+      TiffExporterAny full;
+      stream.seekg(0);
+      load(stream, std::ref(full), LoadParams{ 0 });
+      CHECK(full.image().data == gray.data);
+
+      TiffExporterAny overview;
+      stream.seekg(0);
+      load(stream, std::ref(overview), LoadParams{ 1 });
+      CHECK(overview.image().data == halve(gray).data);
+
+      TiffExporterAny coarsest;
+      stream.seekg(0);
+      load(stream, std::ref(coarsest), LoadParams{ 3 });
+      CHECK(coarsest.image().data == halve(halve(halve(gray))).data);
+    }
+  }
+
+  SUBCASE("Planar images and explicit overview counts") {
+    const Image rgb = makeTestImage<uint8_t, 3>(50, 41, true, 10);
+    WriteParams params;
+    params.isPlanar = true;
+    params.tileWidth = 16;
+    params.tileLength = 16;
+    std::stringstream stream;
+    saveCog(stream, rgb, params, CogParams{ .overviews = 1 });
+    stream.seekg(0);
+    CHECK(TiffImage::read(stream).ifds().size() == 2);
+
+    TiffExporterAny overview;
+    stream.seekg(0);
+    load(stream, std::ref(overview), LoadParams{ 1 });
+    const Image& half = overview.image();
+    REQUIRE(half.width == 25);
+    REQUIRE(half.height == 21);
+    // the last row of an odd height is averaged with itself
+    const auto sample = [](const Image& image, int x, int y, int c) {
+      return int(image.data[size_t(y) * image.rowStride + size_t(x) * image.colStride
+        + size_t(c) * image.chanStride]);
+    };
+    for (int c = 0; c < 3; ++c) {
+      const int expected = (2 * sample(rgb, 48, 40, c) + 2 * sample(rgb, 49, 40, c) + 2) / 4;
+      CHECK(sample(half, 24, 20, c) == expected);
+    }
+  }
+}
+
+TEST_CASE("TiffWriter errors") {
+  std::stringstream stream;
+  CHECK_THROWS_AS(TiffWriter(stream, 0, 10, 1, 8), std::runtime_error);
+  CHECK_THROWS_AS(TiffWriter(stream, 10, 10, 1, 12), FormatNotSupportedError);
+  WriteParams params;
+  params.sampleFormat = 3;
+  CHECK_THROWS_AS(TiffWriter(stream, 10, 10, 1, 16, params), std::runtime_error);
+  params = {};
+  params.compression = 7;
+  CHECK_THROWS_AS(TiffWriter(stream, 10, 10, 1, 8, params), FormatNotSupportedError);
+  params.compression = 32773;
+  params.predictor = 2;
+  CHECK_THROWS_AS(TiffWriter(stream, 10, 10, 1, 8, params), std::runtime_error);
+  params = {};
+  params.tileWidth = 20;
+  params.tileLength = 16;
+  CHECK_THROWS_AS(TiffWriter(stream, 10, 10, 1, 8, params), std::runtime_error);
+  params = {};
+  params.photometric = 5;
+  CHECK_THROWS_AS(TiffWriter(stream, 10, 10, 3, 8, params), std::runtime_error);
+
+  TiffWriter writer(stream, 10, 4, 1, 8);
+  std::vector<std::byte> rows(30);
+  CHECK_THROWS_AS(writer.writeRows(std::span(rows).first(15)), std::runtime_error);
+  writer.writeRows(rows);
+  CHECK_THROWS_AS(writer.finish(), std::runtime_error);
+  CHECK_THROWS_AS(writer.writeRows(rows), std::runtime_error);
+  writer.writeRows(std::span(rows).first(10));
+  CHECK_NOTHROW(writer.finish());
+}